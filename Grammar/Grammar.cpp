@@ -31,20 +31,27 @@ cl::opt<string> BitcodeFileName("b", cl::desc("Specify input bitcode filename"),
 cl::opt<string> BlockInfoFilename("bi", cl::desc("Specify input BlockInfo filename"), cl::value_desc("BlockInfo filename"));
 cl::opt<string> ProfileFileName("p", cl::desc("Specify input profile filename"), cl::value_desc("profile filename"));
 cl::opt<string> OutputFile("o", cl::desc("Specify output json filename"), cl::value_desc("json filename"));
+cl::opt<string> LoopSummaryFile("l", cl::desc("Specify input static loop summary json filename (optional, written by LoopInfoPass)"), cl::value_desc("loop summary filename"));
 
 int main(int argc, char *argv[])
 {
     cl::ParseCommandLineOptions(argc, argv);
     // load dynamic source code information
-    ReadBlockInfo(BlockInfoFilename);
+    ProfileContext context;
+    ReadBlockInfo(context, BlockInfoFilename);
     // load bitcode
-    LLVMContext context;
-    SMDiagnostic smerror;
-    auto SourceBitcode = parseIRFile(BitcodeFileName, smerror, context);
-    Cyclebite::Util::Format(*SourceBitcode, false);
+    auto SourceBitcode = ReadBitcode(BitcodeFileName, false);
+    if (SourceBitcode == nullptr)
+    {
+        return EXIT_FAILURE;
+    }
     // construct its callgraph
 
     InitializeIDMaps(SourceBitcode.get());
+    if( !LoopSummaryFile.empty() )
+    {
+        ReadLoopSummary(LoopSummaryFile, IDToValue);
+    }
     // build IR to source maps (must be done after ID maps are initialized)
     InitSourceMaps(SourceBitcode);
 
@@ -53,14 +60,20 @@ int main(int argc, char *argv[])
     // construct program control graph and call graph
     ControlGraph cg;
     Cyclebite::Graph::CallGraph dynamicCG;
-    getDynamicInformation( cg, dynamicCG, ProfileFileName, SourceBitcode, staticCG, blockCallers, threadStarts, IDToBlock, false );
+    getDynamicInformation( context, cg, dynamicCG, ProfileFileName, SourceBitcode, staticCG, IDToBlock );
+    // the block to node mapping below needs one node per block
+    if (context.markovOrder > 1)
+    {
+        spdlog::critical("The input profile must have markov order 1!");
+        return EXIT_FAILURE;
+    }
     // construct block ID to node ID mapping
     map<int64_t, shared_ptr<ControlNode>> blockToNode;
-    for (const auto &it : NIDMap)
+    for (uint64_t block = 0; block < context.NIDMap.size(); block++)
     {
-        for (const auto &block : it.first)
+        if (context.NIDMap[block] != UNMAPPED_NID)
         {
-            blockToNode[block] = cg.getNode(it.second);
+            blockToNode[(int64_t)block] = cg.getNode(context.NIDMap[block]);
         }
     }
 
@@ -140,7 +140,7 @@ uint32_t Cyclebite::Grammar::isAllocatingFunction(const llvm::CallBase* call)
             {
                 if( const auto& inst = llvm::dyn_cast<llvm::Instruction>(Q.front()) )
                 {
-                    if( DNIDMap.find(inst) == DNIDMap.end() )
+                    if( !DNIDMap.contains(inst) )
                     {
                         Q.pop_front();
                         continue;
@@ -256,7 +256,7 @@ const llvm::Value* Cyclebite::Grammar::getPointerSource(const llvm::Value* ptr)
         else if( const auto& arg = llvm::dyn_cast<llvm::Argument>(Q.front()) )
         {
             // check the significant pointer list
-            if( Graph::DNIDMap.find(arg) != DNIDMap.end() )
+            if( Graph::DNIDMap.contains(arg) )
             {
                 if( SignificantMemInst.find( Graph::DNIDMap.at(arg) ) != SignificantMemInst.end() )
                 {
@@ -377,7 +377,10 @@ set<shared_ptr<BasePointer>> Cyclebite::Grammar::getBasePointers(const shared_pt
                             else if( auto alloc = llvm::dyn_cast<llvm::AllocaInst>(Q.front()) )
                             {
                                 // an originating alloc indicates a base pointer, if it is big enough
-                                auto allocParam = alloc->getAllocationSizeInBits(alloc->getParent()->getParent()->getParent()->getDataLayout());
+                                auto allocParam = [&]() {
+                                    lock_guard<mutex> lock(dataLayoutMutex);
+                                    return alloc->getAllocationSizeInBits(alloc->getParent()->getParent()->getParent()->getDataLayout());
+                                }();
                                 if( allocParam )
                                 {
                                     auto allocSize = allocParam->getFixedValue()/8;
@@ -467,7 +470,12 @@ set<shared_ptr<BasePointer>> Cyclebite::Grammar::getBasePointers(const shared_pt
                                     // must meet minimum pointer size
                                     bool canBeNull = false;
                                     bool canBeFreed = false;
-                                    if( glob->getPointerDereferenceableBytes(n->getInst()->getParent()->getParent()->getParent()->getDataLayout(), canBeNull, canBeFreed) > ALLOC_THRESHOLD )
+                                    uint64_t bytes;
+                                    {
+                                        lock_guard<mutex> lock(dataLayoutMutex);
+                                        bytes = glob->getPointerDereferenceableBytes(n->getInst()->getParent()->getParent()->getParent()->getDataLayout(), canBeNull, canBeFreed);
+                                    }
+                                    if( bytes > ALLOC_THRESHOLD )
                                     {
                                         if( DNIDMap.contains(glob) )
                                         {
@@ -302,36 +302,42 @@ set<shared_ptr<Cycle>> VectorizeExpression( const shared_ptr<Expression>& expr )
     return reductionCycles;
 }
 
-void Cyclebite::Grammar::Export( const map<shared_ptr<Task>, vector<shared_ptr<Expression>>>& taskToExpr )
+ExportPlan Cyclebite::Grammar::PlanExport( const shared_ptr<Task>& t, const shared_ptr<Expression>& expr )
+{
+#ifdef DEBUG
+    for( const auto& coll : expr->getCollections() )
+    {
+        auto dotString = VisualizeCollection(coll);
+        ofstream tStream("Task"+to_string(expr->getTask()->getID())+"_Collection"+to_string(coll->getID())+".dot");
+        tStream << dotString;
+        tStream.close();
+    }
+#endif
+    ExportPlan plan;
+    plan.task = t;
+    plan.expr = expr;
+    plan.parallelSpots = ParallelizeCycles( expr );
+    plan.vectorSpots   = VectorizeExpression( expr );
+    plan.label = MapTaskToName(expr, plan.parallelSpots);
+    return plan;
+}
+
+void Cyclebite::Grammar::Export( const vector<ExportPlan>& plans )
 {
     // first, task name
     cout << endl;
     // second, task optimization and export
-    for( const auto& t : taskToExpr )
+    for( const auto& plan : plans )
     {
-        for( const auto& expr : t.second )
+        try
         {
-#ifdef DEBUG
-            for( const auto& coll : expr->getCollections() )
-            {
-                auto dotString = VisualizeCollection(coll);
-                ofstream tStream("Task"+to_string(expr->getTask()->getID())+"_Collection"+to_string(coll->getID())+".dot");
-                tStream << dotString;
-                tStream.close();
-            }
-#endif
-            try
-            {
-                auto parallelSpots = ParallelizeCycles( expr );
-                auto vectorSpots   = VectorizeExpression( expr );
-                spdlog::info("Cyclebite-Template Label: Task"+to_string(t.first->getID())+" -> "+MapTaskToName(expr, parallelSpots));
-                OMPAnnotateSource(parallelSpots, vectorSpots);
-                cout << endl;
-            }
-            catch( CyclebiteException& e )
-            {
-                spdlog::critical(e.what());
-            }
+            spdlog::info("Cyclebite-Template Label: Task"+to_string(plan.task->getID())+" -> "+plan.label);
+            OMPAnnotateSource(plan.parallelSpots, plan.vectorSpots);
+            cout << endl;
+        }
+        catch( CyclebiteException& e )
+        {
+            spdlog::critical(e.what());
         }
     }
-}
\ No newline at end of file
+}
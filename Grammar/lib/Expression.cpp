@@ -11,6 +11,7 @@
 #include "TaskParameter.h"
 #include "OperatorExpression.h"
 #include "Graph/inc/Dijkstra.h"
+#include "IO.h"
 #include "Graph/inc/IO.h"
 #include "Util/Exceptions.h"
 #include "Util/Print.h"
@@ -20,7 +21,7 @@
 using namespace std;
 using namespace Cyclebite::Grammar;
 
-bool Expression::printedName = false;
+thread_local bool Expression::printedName = false;
 
 void Expression::FindInputs( Expression* expr )
 {
@@ -357,7 +358,12 @@ vector<shared_ptr<Symbol>> buildExpression( const shared_ptr<Cyclebite::Graph::I
                 {
                     bool canBeNull = false;
                     bool canBeFreed = false;
-                    if( con->getPointerDereferenceableBytes(node->getInst()->getParent()->getParent()->getParent()->getDataLayout(), canBeNull, canBeFreed) < ALLOC_THRESHOLD )
+                    uint64_t bytes;
+                    {
+                        lock_guard<mutex> lock(dataLayoutMutex);
+                        bytes = con->getPointerDereferenceableBytes(node->getInst()->getParent()->getParent()->getParent()->getDataLayout(), canBeNull, canBeFreed);
+                    }
+                    if( bytes < ALLOC_THRESHOLD )
                     {
                         // the pointer's allocation is not large enough, thus there is no collection that will represent it
                         // we still need this value in our expression, whatever it may be, so just make a constant symbol for it
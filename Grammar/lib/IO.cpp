@@ -22,6 +22,8 @@ using namespace Cyclebite::Grammar;
 map<string, vector<string>> Cyclebite::Grammar::fileLines;
 map<uint32_t, pair<string,uint32_t>> Cyclebite::Grammar::blockToSource;
 set<shared_ptr<Cyclebite::Graph::Inst>, Cyclebite::Graph::p_GNCompare> Cyclebite::Grammar::SignificantMemInst;
+mutex Cyclebite::Grammar::dataLayoutMutex;
+map<const llvm::Value*, StaticInductionVariable> Cyclebite::Grammar::staticIVs;
 
 void Cyclebite::Grammar::InitSourceMaps(const std::unique_ptr<llvm::Module>& SourceBitcode)
 {
@@ -76,7 +78,7 @@ void Cyclebite::Grammar::InjectSignificantMemoryInstructions(const nlohmann::jso
     {
         if( const auto& inst = llvm::dyn_cast<llvm::Instruction>(IDToValue.at(value)) )
         {
-            if( Cyclebite::Graph::DNIDMap.find(inst) == Cyclebite::Graph::DNIDMap.end() )
+            if( !Cyclebite::Graph::DNIDMap.contains(inst) )
             {
                 PrintVal(inst);
                 throw CyclebiteException("Found a significant memory op that's not live!");
@@ -92,6 +94,40 @@ void Cyclebite::Grammar::InjectSignificantMemoryInstructions(const nlohmann::jso
     }
 }
 
+void Cyclebite::Grammar::ReadLoopSummary(const string& fileName, const map<int64_t, const llvm::Value*>& IDToValue)
+{
+    nlohmann::json summary;
+    try
+    {
+        ifstream summaryFile(fileName);
+        summaryFile >> summary;
+        summaryFile.close();
+    }
+    catch( exception& e )
+    {
+        spdlog::warn("Couldn't read loop summary "+fileName+": "+string(e.what())+". Induction variables will be found through the DFG.");
+        return;
+    }
+    for( const auto& loop : summary["Loops"] )
+    {
+        for( const auto& iv : loop["InductionVariables"] )
+        {
+            // only the functions that were profiled are in the bitcode
+            if( !IDToValue.contains(iv["Value"].get<int64_t>()) )
+            {
+                continue;
+            }
+            StaticInductionVariable var;
+            var.constantStart = iv["Start"].is_number_integer();
+            var.start = var.constantStart ? iv["Start"].get<int64_t>() : 0;
+            var.step = iv["Step"].get<int64_t>();
+            var.constantExit = iv.contains("ExitValue") && iv["ExitValue"].is_number_integer();
+            var.exitValue = var.constantExit ? iv["ExitValue"].get<int64_t>() : 0;
+            staticIVs[IDToValue.at(iv["Value"].get<int64_t>())] = var;
+        }
+    }
+}
+
 inline string getInstName( uint64_t NID, const llvm::Value* v )
 {
     string name = "";
@@ -740,6 +740,12 @@ set<shared_ptr<IndexVariable>> Cyclebite::Grammar::getIndexVariables(const share
                         of.constant = (int)var->getSpace().stride;
                         of.transform = var->getSpace().min < var->getSpace().max ? Graph::Operation::add : Graph::Operation::sub;
                     }
+                    else if( staticIVs.contains(phi) )
+                    {
+                        // the static loop summary knows the step of the phi even when it isn't one of the task's induction variables
+                        of.constant = (int)staticIVs.at(phi).step;
+                        of.transform = Cyclebite::Graph::Operation::add;
+                    }
                     else
                     {
                         // we don't know what the affine offset is (for sure), so just push + 1
@@ -10,6 +10,7 @@
 #include "Util/Annotate.h"
 #include <deque>
 #include <llvm/IR/Instructions.h>
+#include <limits>
 #include "Util/Exceptions.h"
 #include "Util/Print.h"
 #include <spdlog/spdlog.h>
@@ -20,6 +21,22 @@ using namespace std;
 
 InductionVariable::InductionVariable( const std::shared_ptr<Cyclebite::Graph::DataValue>& n, const std::shared_ptr<Cycle>& c, const llvm::Instruction* targetExit ) : Counter(n, c), Symbol("var")
 {
+    // the static loop summary already knows the space of affine IVs whose loops have a constant trip count
+    if( staticIVs.contains(n->getVal()) )
+    {
+        const auto& iv = staticIVs.at(n->getVal());
+        // the exit value is the boundary the comparator checks, the first value the body doesn't see
+        auto fitsInt = [](int64_t v) { return (v >= numeric_limits<int>::min()) && (v <= numeric_limits<int>::max()); };
+        // a space that doesn't fit the int fields of the dimension is left to the walk below
+        if( iv.constantStart && iv.constantExit && fitsInt(iv.start) && fitsInt(iv.step) && fitsInt(iv.exitValue) )
+        {
+            space.min = iv.step < 0 ? (int)iv.exitValue : (int)iv.start;
+            space.max = iv.step < 0 ? (int)iv.start : (int)iv.exitValue;
+            space.stride = (int)iv.step;
+            space.pattern = StridePattern::Sequential;
+            return;
+        }
+    }
     // crawl the uses of the induction variable and try to ascertain what its dimensions and access patterns are
     deque<const llvm::Value*> Q;
     set<const llvm::Value*> covered;
@@ -779,7 +796,7 @@ set<shared_ptr<InductionVariable>> Cyclebite::Grammar::getInductionVariables(con
                     {
                         for( const auto& use : Q.front()->users() )
                         {
-                            if( DNIDMap.find(use) == DNIDMap.end() )
+                            if( !DNIDMap.contains(use) )
                             {
                                 continue;
                             }
@@ -19,7 +19,11 @@
 #include "Export.h"
 #include <llvm/IR/InstrTypes.h>
 #include <llvm/IR/Instructions.h>
+#include <algorithm>
+#include <atomic>
 #include <deque>
+#include <exception>
+#include <thread>
 
 using namespace Cyclebite::Grammar;
 using namespace Cyclebite::Graph;
@@ -109,84 +113,143 @@ vector<shared_ptr<InductionVariable>> getOrdering( const llvm::GetElementPtrInst
     return order;
 }
 
-void Cyclebite::Grammar::Process(const set<shared_ptr<Task>>& tasks)
+/// Runs the grammar on one task, returns its expressions (empty if the task could not be interpreted)
+vector<shared_ptr<Expression>> ProcessTask(const shared_ptr<Task>& t)
 {
-    // each expression maps 1:1 with tasks from the cartographer
-    map<shared_ptr<Task>, vector<shared_ptr<Expression>>> taskToExpr;
-    for( const auto& t : tasks )
+    try
     {
-        try
+#ifdef DEBUG
+        cout << endl;
+        spdlog::info("Task "+to_string(t->getID()));
+#endif
+        // get all induction variables
+        auto vars = getInductionVariables(t);
+#ifdef DEBUG
+        spdlog::info("Induction Variables:");
+        for( const auto& var : vars )
         {
+            spdlog::info(var->dump()+" -> "+PrintVal(var->getNode()->getVal(), false));
+        }            
+#endif
+        // get all reduction variables
+        auto rvs = getReductionVariables(t, vars);
 #ifdef DEBUG
-            cout << endl;
-            spdlog::info("Task "+to_string(t->getID()));
+        spdlog::info("Reductions");
+        for( const auto& rv : rvs )
+        {
+            spdlog::info(rv->dump()+" -> "+PrintVal(rv->getNode()->getVal(), false));
+        }
 #endif
-            // get all induction variables
-            auto vars = getInductionVariables(t);
+        // get all base pointers
+        auto bps  = getBasePointers(t);
 #ifdef DEBUG
-            spdlog::info("Induction Variables:");
-            for( const auto& var : vars )
-            {
-                spdlog::info(var->dump()+" -> "+PrintVal(var->getNode()->getVal(), false));
-            }            
+        spdlog::info("Base Pointers");
+        for( const auto& bp : bps )
+        {
+            spdlog::info(bp->dump()+" -> "+PrintVal(bp->getNode()->getVal(), false));
+        }
 #endif
-            // get all reduction variables
-            auto rvs = getReductionVariables(t, vars);
+        // get index variables
+        auto idxVars = getIndexVariables(t, vars);
 #ifdef DEBUG
-            spdlog::info("Reductions");
-            for( const auto& rv : rvs )
-            {
-                spdlog::info(rv->dump()+" -> "+PrintVal(rv->getNode()->getVal(), false));
-            }
+        spdlog::info("Index Variables:");
+        for( const auto& idx : idxVars )
+        {
+            string dimension = "";
+            dimension = "(dimension "+to_string(idx->getDimensionIndex())+") ";
+            spdlog::info(dimension+idx->dump()+" -> "+PrintVal(idx->getNode()->getInst(), false));
+        }
 #endif
-            // get all base pointers
-            auto bps  = getBasePointers(t);
+        // construct collections
+        auto cs   = getCollections(t, bps, idxVars);
 #ifdef DEBUG
-            spdlog::info("Base Pointers");
-            for( const auto& bp : bps )
-            {
-                spdlog::info(bp->dump()+" -> "+PrintVal(bp->getNode()->getVal(), false));
-            }
+        spdlog::info("Collections:");
+        for( const auto& c : cs )
+        {
+            spdlog::info(c->dump());
+        }
 #endif
-            // get index variables
-            auto idxVars = getIndexVariables(t, vars);
+        // each task should have exactly one expression
+        auto exprs = getExpressions(t, cs, rvs, vars);
 #ifdef DEBUG
-            spdlog::info("Index Variables:");
-            for( const auto& idx : idxVars )
-            {
-                string dimension = "";
-                dimension = "(dimension "+to_string(idx->getDimensionIndex())+") ";
-                spdlog::info(dimension+idx->dump()+" -> "+PrintVal(idx->getNode()->getInst(), false));
-            }
+        spdlog::info("Expressions:");
+        for( const auto& expr : exprs )
+        {
+            spdlog::info("\t"+expr->dump());
+        }
+        spdlog::info("Grammar Success");
 #endif
-            // construct collections
-            auto cs   = getCollections(t, bps, idxVars);
+        return exprs;
+    }
+    catch(CyclebiteException& e)
+    {
+        spdlog::critical(e.what());
 #ifdef DEBUG
-            spdlog::info("Collections:");
-            for( const auto& c : cs )
+        cout << endl;
+#endif
+    }
+    return vector<shared_ptr<Expression>>();
+}
+
+void Cyclebite::Grammar::Process(const set<shared_ptr<Task>>& tasks)
+{
+    // tasks only read the program graphs and each builds its own expressions, so they are interpreted in parallel
+    // workers take the next unclaimed task until there are none left, so a few expensive tasks don't hold up the cheap ones
+    // results are kept per task and exported in task ID order, so the output doesn't depend on the thread schedule
+    vector<shared_ptr<Task>> order(tasks.begin(), tasks.end());
+    sort(order.begin(), order.end(), [](const shared_ptr<Task>& lhs, const shared_ptr<Task>& rhs) { return lhs->getID() < rhs->getID(); });
+    vector<vector<ExportPlan>> plans(order.size());
+    // anything other than a CyclebiteException is handed back to the calling thread
+    vector<exception_ptr> errors(order.size());
+    atomic<size_t> nextTask = 0;
+    auto work = [&]() {
+        for( auto i = nextTask++; i < order.size(); i = nextTask++ )
+        {
+            try
             {
-                spdlog::info(c->dump());
+                for( const auto& expr : ProcessTask(order[i]) )
+                {
+                    try
+                    {
+                        plans[i].push_back(PlanExport(order[i], expr));
+                    }
+                    catch( CyclebiteException& e )
+                    {
+                        spdlog::critical(e.what());
+                    }
+                }
             }
-#endif
-            // each task should have exactly one expression
-            auto exprs = getExpressions(t, cs, rvs, vars);
-#ifdef DEBUG
-            spdlog::info("Expressions:");
-            for( const auto& expr : exprs )
+            catch(...)
             {
-                spdlog::info("\t"+expr->dump());
+                errors[i] = current_exception();
             }
-            spdlog::info("Grammar Success");
-#endif
-            taskToExpr[t] = exprs;
         }
-        catch(CyclebiteException& e)
-        {
-            spdlog::critical(e.what());
+    };
 #ifdef DEBUG
-            cout << endl;
+    // debug prints of different tasks would interleave
+    size_t threads = 1;
+#else
+    auto threads = min((size_t)max(1u, thread::hardware_concurrency()), order.size());
 #endif
+    vector<thread> workers;
+    for( size_t t = 1; t < threads; t++ )
+    {
+        workers.emplace_back(work);
+    }
+    work();
+    for( auto& w : workers )
+    {
+        w.join();
+    }
+    vector<ExportPlan> merged;
+    for( size_t i = 0; i < order.size(); i++ )
+    {
+        if( errors[i] )
+        {
+            rethrow_exception(errors[i]);
         }
+        merged.insert(merged.end(), plans[i].begin(), plans[i].end());
     }
-    Export(taskToExpr);
+    // source annotation is done here, on this thread only
+    Export(merged);
 }
\ No newline at end of file
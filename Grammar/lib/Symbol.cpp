@@ -34,4 +34,4 @@ uint64_t Symbol::getNextUID()
     return nextUID++;
 }
 
-uint64_t Symbol::nextUID = 0;
\ No newline at end of file
+std::atomic<uint64_t> Symbol::nextUID = 0;
\ No newline at end of file
@@ -4,12 +4,28 @@
 //==------------------------------==//
 #pragma once
 #include <memory>
-#include <map>
+#include <set>
+#include <string>
 #include <vector>
 
 namespace Cyclebite::Grammar
 {
     class Task;
     class Expression;
-    void Export( const std::map<std::shared_ptr<Task>, std::vector<std::shared_ptr<Expression>>>& expr );
-} // namespace Cyclebite::Grammar
\ No newline at end of file
+    class Cycle;
+    /// Optimizations found for one expression of a task
+    struct ExportPlan
+    {
+        std::shared_ptr<Task> task;
+        std::shared_ptr<Expression> expr;
+        std::set<std::shared_ptr<Cycle>> parallelSpots;
+        std::set<std::shared_ptr<Cycle>> vectorSpots;
+        std::string label;
+    };
+    /// Finds the parallel and vectorizable cycles of an expression and labels it
+    /// Only reads the expression and its task, so the expressions of different tasks can be planned on different threads at once
+    ExportPlan PlanExport( const std::shared_ptr<Task>& t, const std::shared_ptr<Expression>& expr );
+    /// Prints the label of each plan and annotates the source with its pragmas, in the order of the plans
+    /// This is the only writer of the source lines (fileLines), so it must only run on one thread
+    void Export( const std::vector<ExportPlan>& plans );
+} // namespace Cyclebite::Grammar
@@ -64,7 +64,8 @@ namespace Cyclebite::Grammar
         std::vector<Cyclebite::Graph::Operation> ops;
         // contains the symbols, in op order, for the expression. Will always be of size (ops.size() + 1)
         std::vector<std::shared_ptr<Symbol>> symbols;
-        static bool printedName;
+        /// dump() recurses through nested expressions, this tracks whether the outer-most name has been printed on the calling thread
+        static thread_local bool printedName;
         static void FindInputs( Expression* expr );
     };
     class ReductionVariable;
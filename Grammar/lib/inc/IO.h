@@ -6,6 +6,7 @@
 #include "Graph/inc/Inst.h"
 #include "Graph/inc/DataGraph.h"
 #include <nlohmann/json.hpp>
+#include <mutex>
 
 namespace Cyclebite::Grammar
 {
@@ -18,8 +19,25 @@ namespace Cyclebite::Grammar
     extern std::map<uint32_t, std::pair<std::string,uint32_t>> blockToSource;
     // contains all datanodes (loads and stores) that touches significant memory
     extern std::set<std::shared_ptr<Cyclebite::Graph::Inst>, Cyclebite::Graph::p_GNCompare> SignificantMemInst;
+    /// Guards DataLayout queries made while tasks are processed in parallel. The DataLayout lazily caches struct layouts, which is not thread safe
+    extern std::mutex dataLayoutMutex;
+    /// @brief What ScalarEvolution found out about an induction variable (see the static loop summary of Utilities/LoopInfoPass.cpp)
+    struct StaticInductionVariable
+    {
+        /// value in the first iteration, only valid when constantStart is set
+        int64_t start;
+        bool constantStart;
+        int64_t step;
+        /// value the IV leaves its loop at (the first value the body doesn't run with), only valid when constantExit is set
+        int64_t exitValue;
+        bool constantExit;
+    };
+    /// Maps the header phis of loops to their static recurrences, empty when no loop summary was given
+    extern std::map<const llvm::Value*, StaticInductionVariable> staticIVs;
     void InitSourceMaps(const std::unique_ptr<llvm::Module>& SourceBitcode);
     void InjectSignificantMemoryInstructions(const nlohmann::json& instanceJson, const std::map<int64_t, const llvm::Value*>& IDToValue);
+    /// Reads the induction variables of the static loop summary, IVs found there don't have to be rediscovered by walking the DFG
+    void ReadLoopSummary(const std::string& fileName, const std::map<int64_t, const llvm::Value*>& IDToValue);
     std::string PrintIdxVarTree( const std::set<std::shared_ptr<IndexVariable>>& idxVars );
     std::string VisualizeCollection( const std::shared_ptr<Collection>& coll );
     void OMPAnnotateSource( const std::set<std::shared_ptr<Cycle>>& parallelSpots, const std::set<std::shared_ptr<Cycle>>& vectorSpots );
@@ -3,6 +3,7 @@
 // SPDX-License-Identifier: Apache-2.0
 //==------------------------------==//
 #pragma once
+#include <atomic>
 #include <string>
 #include <memory>
 
@@ -17,7 +18,8 @@ namespace Cyclebite::Grammar
         virtual std::string dump() const;
     protected:
         uint64_t UID;
-        static uint64_t nextUID;
+        /// tasks are processed on several threads at once (see Process), so symbols are numbered from a shared atomic counter
+        static std::atomic<uint64_t> nextUID;
         std::string name;
         static uint64_t getNextUID(); 
         Symbol(std::string n);
@@ -118,14 +118,14 @@ int main(int argc, char *argv[])
     // construct program control graph and call graph
     ControlGraph cg;
     Cyclebite::Graph::CallGraph dynamicCG;
-    getDynamicInformation(cg, dynamicCG, ProfileFileName, SourceBitcode, staticCG, blockCallers, threadStarts, IDToBlock, false );
+    getDynamicInformation(cg, dynamicCG, ProfileFileName, SourceBitcode, staticCG, blockCallers, threadStarts, IDToBlock );
     // construct block ID to node ID mapping
     map<int64_t, shared_ptr<ControlNode>> blockToNode;
-    for (const auto &it : NIDMap)
+    for (uint64_t block = 0; block < NIDMap.size(); block++)
     {
-        for (const auto &block : it.first)
+        if (NIDMap[block] != UNMAPPED_NID)
         {
-            blockToNode[block] = cg.getNode(it.second);
+            blockToNode[(int64_t)block] = cg.getNode(NIDMap[block]);
         }
     }
 
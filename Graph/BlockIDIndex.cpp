@@ -0,0 +1,155 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "BlockIDIndex.h"
+#include "ControlNode.h"
+#include "ImaginaryEdge.h"
+#include "UnconditionalEdge.h"
+#include "VirtualEdge.h"
+#include "VirtualNode.h"
+#include "Util/Exceptions.h"
+#include <deque>
+
+using namespace std;
+using namespace Cyclebite::Graph;
+
+/// @brief Finds the underlying edge that comes right after the entrance (or right before the exit) of a node
+const shared_ptr<UnconditionalEdge> FindUnderlyingEdge(const shared_ptr<GraphNode> &node, bool entrance)
+{
+    deque<shared_ptr<GraphNode>> Q;
+    set<shared_ptr<ControlNode>, p_GNCompare> underlying;
+    Q.push_front(node);
+    while (!Q.empty())
+    {
+        if (auto vn = dynamic_pointer_cast<VirtualNode>(Q.front()))
+        {
+            for (const auto &n : vn->getSubgraph())
+            {
+                Q.push_back(n);
+            }
+        }
+        else if (auto cn = dynamic_pointer_cast<ControlNode>(Q.front()))
+        {
+            underlying.insert(cn);
+        }
+        Q.pop_front();
+    }
+    if (entrance)
+    {
+        // we want the edge that comes out of the first node
+        for (const auto &n : underlying)
+        {
+            bool outside = true;
+            for (const auto &pred : n->getPredecessors())
+            {
+                if (underlying.find(pred->getSrc()) != underlying.end())
+                {
+                    outside = false;
+                    break;
+                }
+            }
+            if (outside)
+            {
+                if (n->getSuccessors().size() != 1)
+                {
+                    throw CyclebiteException("Cannot handle the case where an underlying entrance has more than one successor!");
+                }
+                return *n->getSuccessors().begin();
+            }
+        }
+        throw CyclebiteException("No beginning node could be found for subgraph!");
+    }
+    // we want the edge that precedes the last node in the graph
+    for (const auto &n : underlying)
+    {
+        bool outside = true;
+        for (const auto &succ : n->getSuccessors())
+        {
+            if (underlying.find(succ->getSnk()) != underlying.end())
+            {
+                outside = false;
+                break;
+            }
+        }
+        if (outside)
+        {
+            if (n->getPredecessors().size() != 1)
+            {
+                throw CyclebiteException("Cannot handle the case where an underlying exit has more than one predecessor!");
+            }
+            return *n->getPredecessors().begin();
+        }
+    }
+    throw CyclebiteException("No ending node could be found for subgraph!");
+}
+
+const set<pair<int64_t, int64_t>> &BlockIDIndex::getEdgeBlocks(const shared_ptr<UnconditionalEdge> &edge)
+{
+    auto found = edgeBlocks.find(edge);
+    if (found != edgeBlocks.end())
+    {
+        return found->second;
+    }
+    set<pair<int64_t, int64_t>> blocks;
+    if (auto ve = dynamic_pointer_cast<VirtualEdge>(edge))
+    {
+        if (ve->getEdges().empty())
+        {
+            throw CyclebiteException("Virtual edge has no underlying edges!");
+        }
+        for (const auto &e : ve->getEdges())
+        {
+            const auto &sub = getEdgeBlocks(e);
+            blocks.insert(sub.begin(), sub.end());
+        }
+    }
+    else if (auto ie = dynamic_pointer_cast<ImaginaryEdge>(edge))
+    {
+        // we have hit the start or end of the program
+        // the start of the program maps to the edge that comes after the entrance, the end maps to the edge that comes right before the exit
+        const auto &sub = ie->isEntrance() ? getEdgeBlocks(FindUnderlyingEdge(ie->getSnk(), true)) : getEdgeBlocks(FindUnderlyingEdge(ie->getSrc(), false));
+        blocks.insert(sub.begin(), sub.end());
+    }
+    else
+    {
+        // we have found the original edge, its src node should have the originalBlock it was constructed for
+        if (edge->getWeightedSrc()->originalBlocks.empty() || edge->getWeightedSnk()->originalBlocks.empty())
+        {
+            throw CyclebiteException("Rock bottom nodes did not contain original blocks!");
+        }
+        blocks.insert(pair(edge->getWeightedSrc()->originalBlocks.back(), edge->getWeightedSnk()->originalBlocks.back()));
+    }
+    if (blocks.empty())
+    {
+        throw CyclebiteException("Could not map graph edge to src,snk pair!");
+    }
+    return edgeBlocks[edge] = std::move(blocks);
+}
+
+const set<int64_t> &BlockIDIndex::getNodeBlocks(const shared_ptr<ControlNode> &node)
+{
+    auto found = nodeBlocks.find(node);
+    if (found != nodeBlocks.end())
+    {
+        return found->second;
+    }
+    set<int64_t> blocks;
+    if (auto vn = dynamic_pointer_cast<VirtualNode>(node))
+    {
+        for (const auto &sn : vn->getSubgraph())
+        {
+            const auto &sub = getNodeBlocks(sn);
+            blocks.insert(sub.begin(), sub.end());
+        }
+    }
+    else if (!node->originalBlocks.empty())
+    {
+        blocks.insert(node->originalBlocks.back());
+    }
+    else
+    {
+        throw CyclebiteException("Rock bottom node did not contain original blocks!");
+    }
+    return nodeBlocks[node] = std::move(blocks);
+}
@@ -18,6 +18,11 @@ const std::set<std::shared_ptr<CallEdge>, GECompare> &CallGraphEdge::getCallEdge
     return calls;
 }
 
+void CallGraphEdge::addCallEdge(const std::shared_ptr<CallEdge> &call)
+{
+    calls.insert(call);
+}
+
 const std::shared_ptr<CallGraphNode> CallGraphEdge::getChild() const
 {
     return static_pointer_cast<CallGraphNode>(snk);
@@ -0,0 +1,166 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "CallGraphSCC.h"
+#include "CallGraph.h"
+#include "Util/Exceptions.h"
+#include <algorithm>
+
+using namespace std;
+using namespace Cyclebite::Graph;
+
+/// Marks a function Tarjan's algorithm has not visited yet
+constexpr uint32_t UNVISITED = UINT32_MAX;
+
+CallGraphSCC::CallGraphSCC(const CallGraph &graph)
+{
+    // snapshot the call graph into adjacency lists, in NID order so the numbering of components doesn't depend on pointer values
+    vector<shared_ptr<CallGraphNode>> nodes;
+    for (const auto &node : graph.getNodes())
+    {
+        index[node->NID] = (uint32_t)nodes.size();
+        nodes.push_back(static_pointer_cast<CallGraphNode>(node));
+    }
+    auto n = (uint32_t)nodes.size();
+    vector<vector<uint32_t>> children(n);
+    selfCall.assign(n, false);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        for (const auto &child : nodes[i]->getChildren())
+        {
+            auto found = index.find(child->getChild()->NID);
+            if (found == index.end())
+            {
+                continue;
+            }
+            if (found->second == i)
+            {
+                selfCall[i] = true;
+            }
+            children[i].push_back(found->second);
+        }
+    }
+
+    // Tarjan's algorithm, with an explicit stack so deep call graphs don't overflow the real one
+    component.assign(n, UNVISITED);
+    vector<uint32_t> order(n, UNVISITED);
+    vector<uint32_t> low(n, 0);
+    vector<bool> onStack(n, false);
+    vector<uint32_t> stack;
+    // each frame is a function and the next child of it to visit
+    vector<pair<uint32_t, uint32_t>> frames;
+    uint32_t nextOrder = 0;
+    for (uint32_t root = 0; root < n; root++)
+    {
+        if (order[root] != UNVISITED)
+        {
+            continue;
+        }
+        frames.push_back(pair(root, 0));
+        while (!frames.empty())
+        {
+            auto &[v, next] = frames.back();
+            if (next == 0)
+            {
+                order[v] = low[v] = nextOrder++;
+                stack.push_back(v);
+                onStack[v] = true;
+            }
+            if (next < children[v].size())
+            {
+                auto w = children[v][next++];
+                if (order[w] == UNVISITED)
+                {
+                    frames.push_back(pair(w, 0));
+                }
+                else if (onStack[w])
+                {
+                    low[v] = min(low[v], order[w]);
+                }
+                continue;
+            }
+            // every child of v is done, v is either the root of a component or it passes its low link up to its caller
+            auto done = v;
+            frames.pop_back();
+            if (low[done] == order[done])
+            {
+                auto c = (uint32_t)members.size();
+                members.emplace_back();
+                uint32_t w;
+                do
+                {
+                    w = stack.back();
+                    stack.pop_back();
+                    onStack[w] = false;
+                    component[w] = c;
+                    members.back().insert(nodes[w]);
+                } while (w != done);
+            }
+            if (!frames.empty())
+            {
+                auto caller = frames.back().first;
+                low[caller] = min(low[caller], low[done]);
+            }
+        }
+    }
+
+    // entrances of a component are the calls into it that come from another component
+    entrances.resize(members.size());
+    for (uint32_t i = 0; i < n; i++)
+    {
+        for (const auto &parent : nodes[i]->getParents())
+        {
+            auto found = index.find(parent->getParent()->NID);
+            if ((found == index.end()) || (component[found->second] != component[i]))
+            {
+                entrances[component[i]].insert(parent);
+            }
+        }
+    }
+}
+
+uint32_t CallGraphSCC::size() const
+{
+    return (uint32_t)members.size();
+}
+
+const set<shared_ptr<CallGraphNode>, p_GNCompare> &CallGraphSCC::operator[](uint32_t c) const
+{
+    return members[c];
+}
+
+uint32_t CallGraphSCC::position(const shared_ptr<CallGraphNode> &node) const
+{
+    auto found = index.find(node->NID);
+    if (found == index.end())
+    {
+        throw CyclebiteException("Function " + string(node->getFunction()->getName()) + " is not in the call graph of this SCC!");
+    }
+    return found->second;
+}
+
+uint32_t CallGraphSCC::getComponent(const shared_ptr<CallGraphNode> &node) const
+{
+    return component[position(node)];
+}
+
+bool CallGraphSCC::hasDirectRecursion(const shared_ptr<CallGraphNode> &node) const
+{
+    return selfCall[position(node)];
+}
+
+bool CallGraphSCC::hasIndirectRecursion(const shared_ptr<CallGraphNode> &node) const
+{
+    return members[getComponent(node)].size() > 1;
+}
+
+const set<shared_ptr<CallGraphNode>, p_GNCompare> &CallGraphSCC::getCycle(const shared_ptr<CallGraphNode> &node) const
+{
+    return members[getComponent(node)];
+}
+
+const set<shared_ptr<CallGraphEdge>, GECompare> &CallGraphSCC::getEntrances(const shared_ptr<CallGraphNode> &node) const
+{
+    return entrances[getComponent(node)];
+}
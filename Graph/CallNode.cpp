@@ -24,6 +24,11 @@ CallNode::CallNode(const Inst *upgrade, const set<shared_ptr<ControlBlock>, p_GN
     }
 }
 
+void CallNode::addDestination(const shared_ptr<ControlBlock>& dest)
+{
+    destinations.insert(dest);
+}
+
 const set<shared_ptr<ControlBlock>, p_GNCompare>& CallNode::getDestinations() const
 {
     return destinations;
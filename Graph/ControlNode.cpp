@@ -8,15 +8,11 @@
 
 using namespace Cyclebite::Graph;
 
-ControlNode::ControlNode() : GraphNode()
-{
-    blocks = std::set<int64_t>();
-}
+ControlNode::ControlNode() : GraphNode() {}
 
 bool ControlNode::addBlock(int64_t newBlock)
 {
-    auto i = blocks.insert(newBlock);
-    return i.second;
+    return blocks.insert(newBlock);
 }
 
 void ControlNode::addBlocks(const std::set<int64_t> &newBlocks)
@@ -27,7 +23,7 @@ void ControlNode::addBlocks(const std::set<int64_t> &newBlocks)
 bool ControlNode::mergeSuccessor(const ControlNode &succ)
 {
     // the blocks of the node simply get added, if unique
-    blocks.insert(succ.blocks.begin(), succ.blocks.end());
+    blocks |= succ.blocks;
     // the original blocks have to be added in order such that we preserve which original block ID is the current block, and which blocks preceded it (in the order they executed)
     for (const auto &block : succ.originalBlocks)
     {
@@ -0,0 +1,82 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "DataValueMap.h"
+#include "DataValue.h"
+#include "Util/Annotate.h"
+#include "Util/Exceptions.h"
+
+using namespace std;
+using namespace Cyclebite::Graph;
+
+void DataValueMap::reserve(uint64_t count)
+{
+    if (count > byID.size())
+    {
+        byID.resize(count);
+    }
+}
+
+bool DataValueMap::dense(int64_t ID) const
+{
+    return (ID >= 0) && ((uint64_t)ID < byID.size());
+}
+
+bool DataValueMap::contains(const llvm::Value *v) const
+{
+    return contains(v, Cyclebite::Util::GetValueID(v));
+}
+
+bool DataValueMap::contains(const llvm::Value *v, int64_t ID) const
+{
+    if (dense(ID))
+    {
+        return byID[(uint64_t)ID] != nullptr;
+    }
+    return unnumbered.contains(v);
+}
+
+const shared_ptr<DataValue> &DataValueMap::at(const llvm::Value *v) const
+{
+    return at(v, Cyclebite::Util::GetValueID(v));
+}
+
+const shared_ptr<DataValue> &DataValueMap::at(const llvm::Value *v, int64_t ID) const
+{
+    if (dense(ID))
+    {
+        if (byID[(uint64_t)ID])
+        {
+            return byID[(uint64_t)ID];
+        }
+    }
+    else if (auto found = unnumbered.find(v); found != unnumbered.end())
+    {
+        return found->second;
+    }
+    throw CyclebiteException("Value " + to_string(ID) + " has no node in the data flow graph!");
+}
+
+void DataValueMap::insert(const llvm::Value *v, const shared_ptr<DataValue> &node)
+{
+    insert(v, Cyclebite::Util::GetValueID(v), node);
+}
+
+void DataValueMap::insert(const llvm::Value *v, int64_t ID, const shared_ptr<DataValue> &node)
+{
+    if (dense(ID))
+    {
+        byID[(uint64_t)ID] = node;
+    }
+    else
+    {
+        unnumbered[v] = node;
+    }
+}
+
+void DataValueMap::clear()
+{
+    byID.clear();
+    unnumbered.clear();
+}
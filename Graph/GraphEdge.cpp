@@ -7,7 +7,7 @@
 
 using namespace Cyclebite::Graph;
 
-uint64_t GraphEdge::nextEID = 0;
+std::atomic<uint64_t> GraphEdge::nextEID = 0;
 
 GraphEdge::GraphEdge() : EID(getNextEID()), weight(0.0f) {}
 
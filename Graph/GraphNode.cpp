@@ -6,7 +6,8 @@
 
 using namespace Cyclebite::Graph;
 
-uint64_t GraphNode::nextNID = 0;
+std::atomic<uint64_t> GraphNode::nextNID = 0;
+thread_local uint64_t GraphNode::threadNID = GraphNode::NO_NID;
 
 GraphNode::GraphNode()
 {
@@ -19,9 +20,23 @@ GraphNode::~GraphNode() = default;
 
 uint64_t GraphNode::getNextNID()
 {
+    if (threadNID != NO_NID)
+    {
+        return threadNID++;
+    }
     return nextNID++;
 }
 
+uint64_t GraphNode::reserveNIDs(uint64_t count)
+{
+    return nextNID.fetch_add(count);
+}
+
+void GraphNode::useNIDs(uint64_t base)
+{
+    threadNID = base;
+}
+
 std::shared_ptr<GraphEdge> GraphNode::isPredecessor(std::shared_ptr<GraphNode> succ) const
 {
     for (const auto &s : successors)
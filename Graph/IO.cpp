@@ -4,27 +4,37 @@
 //==------------------------------==//
 #include "IO.h"
 #include "Util/Annotate.h"
+#include "Util/JsonWriter.h"
 #include "Util/Print.h"
 #include "CallEdge.h"
 #include "CallGraph.h"
+#include "CallGraphSCC.h"
 #include "CallNode.h"
 #include "ControlBlock.h"
 #include "ControlGraph.h"
 #include "DataGraph.h"
 #include "Dijkstra.h"
 #include "MLCycle.h"
+#include "BlockIDIndex.h"
+#include "MarkovProfile.h"
+#include "ProfileContainer.h"
 #include "ReturnEdge.h"
+#include "StationaryDistribution.h"
 #include "Transforms.h"
 #include "ImaginaryNode.h"
 #include "ImaginaryEdge.h"
 #include "VirtualEdge.h"
 #include "VirtualNode.h"
 #include "llvm/IR/CFG.h"
+#include <atomic>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <llvm/IR/Statepoint.h>
 #include <nlohmann/json.hpp>
+#include <sstream>
+#include <thread>
 
 using namespace std;
 using namespace llvm;
@@ -33,19 +43,11 @@ using namespace Cyclebite::Graph;
 /// Cutoff threshold for number of edges in an unabridged highlighted graph
 constexpr uint64_t MAX_EDGE_UNABRIDGED = 2000;
 
-uint32_t markovOrder;
-
 // maps the dynamic pass IDs to their LLVM objects
 map<int64_t, const BasicBlock *> Cyclebite::Graph::IDToBlock;
 map<int64_t, const Value *> Cyclebite::Graph::IDToValue;
-// dynamic info from the markov profile
-map<int64_t, vector<int64_t>> Cyclebite::Graph::blockCallers;
-map<int64_t, map<string, int64_t>> Cyclebite::Graph::blockLabels;
-set<int64_t> Cyclebite::Graph::threadStarts;
-/// Maps a vector of basic block IDs to a node ID
-map<vector<uint32_t>, uint64_t> Cyclebite::Graph::NIDMap;
 /// Maps each unique instruction to its datanode
-map<const llvm::Value *, const shared_ptr<DataValue>> Cyclebite::Graph::DNIDMap;
+DataValueMap Cyclebite::Graph::DNIDMap;
 /// Maps each basic block to its ControlBlock
 std::map<const llvm::BasicBlock*, const std::shared_ptr<ControlBlock>> Cyclebite::Graph::BBCBMap;
 
@@ -57,9 +59,8 @@ std::string to_string_float(float f, int precision = 3)
     return stream.str();
 }
 
-void Cyclebite::Graph::ReadBlockInfo(const std::string &BlockInfo)
+void Cyclebite::Graph::ReadBlockInfo(ProfileContext &context, const std::string &BlockInfo)
 {
-    std::map<int64_t, std::vector<int64_t>> blockCallers;
     std::ifstream inputJson;
     nlohmann::json j;
     try
@@ -77,112 +78,120 @@ void Cyclebite::Graph::ReadBlockInfo(const std::string &BlockInfo)
     {
         if (j[bbid.key()].find("BlockCallers") != j[bbid.key()].end())
         {
-            blockCallers[stol(bbid.key())] = j[bbid.key()]["BlockCallers"].get<std::vector<int64_t>>();
+            context.blockCallers[stol(bbid.key())] = j[bbid.key()]["BlockCallers"].get<std::vector<int64_t>>();
         }
     }
 
-    std::map<int64_t, std::map<std::string, int64_t>> blockLabels;
     for (const auto &bbid : j.items())
     {
         if (j[bbid.key()].find("Labels") != j[bbid.key()].end())
         {
             auto labelCounts = j[bbid.key()]["Labels"].get<std::map<std::string, int64_t>>();
-            blockLabels[stol(bbid.key())] = labelCounts;
+            context.blockLabels[stol(bbid.key())] = labelCounts;
         }
     }
 
-    std::set<int64_t> threadStarts;
     if( j.find("ThreadEntrances") != j.end() )
     {
         for( const auto& id : j["ThreadEntrances"].get<std::vector<int64_t>>() )
         {
-            threadStarts.insert(id);
+            context.threadStarts.insert(id);
         }
     }
 }
 
-void RecurseThroughOperands(llvm::Value *val, std::map<int64_t, const llvm::Value *> &IDToValue)
+/// Reads a packed array of T out of a container section, unaligned
+template <typename T>
+T readPacked(std::span<const uint8_t> section, uint64_t offset)
 {
-    if( llvm::isa<llvm::DbgInfoIntrinsic>(val) )
-    {
-        return;
-    }
-    if (auto inst = llvm::dyn_cast<llvm::Instruction>(val))
+    T val;
+    memcpy(&val, section.data() + offset, sizeof(T));
+    return val;
+}
+
+/// @brief Fills blockCallers, blockLabels and threadStarts of context from the LABELS, CALLERS and THREAD_ENTRANCES sections of a profile container
+/// @throws CyclebiteException when a section is corrupt
+void Cyclebite::Graph::ReadBlockInfo(ProfileContext &context, const ProfileContainer &container)
+{
+    auto labels = container.getSection(__TA_SECTION_LABELS);
+    uint64_t offset = 0;
+    while (offset < labels.size())
     {
-        if (Cyclebite::Util::GetValueID(inst) < 0)
-        {
-            throw CyclebiteException("Found an instruction that did not have a ValueID.");
-        }
-        if (IDToValue.find(Cyclebite::Util::GetValueID(val)) == IDToValue.end())
-        {
-            IDToValue[Cyclebite::Util::GetValueID(val)] = val;
-        }
-        else
+        if (offset + 2 * sizeof(uint32_t) + sizeof(uint64_t) > labels.size())
         {
-            return;
+            throw CyclebiteException("Label section of the profile container is truncated!");
         }
-        for (unsigned int i = 0; i < inst->getNumOperands(); i++)
+        auto block = readPacked<uint32_t>(labels, offset);
+        auto length = readPacked<uint32_t>(labels, offset + sizeof(uint32_t));
+        auto frequency = readPacked<uint64_t>(labels, offset + 2 * sizeof(uint32_t));
+        offset += 2 * sizeof(uint32_t) + sizeof(uint64_t);
+        if (offset + length > labels.size())
         {
-            if (auto subVal = llvm::dyn_cast<llvm::Value>(inst->getOperand(i)))
-            {
-                RecurseThroughOperands(subVal, IDToValue);
-            }
+            throw CyclebiteException("Label section of the profile container is truncated!");
         }
+        context.blockLabels[block][string((const char *)labels.data() + offset, length)] = (int64_t)frequency;
+        offset += length;
     }
-    else if (auto go = llvm::dyn_cast<llvm::GlobalObject>(val))
+    auto callers = container.getSection(__TA_SECTION_CALLERS);
+    constexpr uint64_t callerRecord = 3 * sizeof(uint32_t);
+    if (callers.size() % callerRecord)
     {
-        if (Cyclebite::Util::GetValueID(go) < 0)
-        {
-            throw CyclebiteException("Found a global object that did not have a ValueID.");
-        }
-        if (IDToValue.find(Cyclebite::Util::GetValueID(val)) == IDToValue.end())
-        {
-            IDToValue[Cyclebite::Util::GetValueID(go)] = val;
-        }
-        else
-        {
-            return;
-        }
-        for (unsigned int i = 0; i < go->getNumOperands(); i++)
-        {
-            if (auto subVal = llvm::dyn_cast<llvm::Value>(go->getOperand(i)))
-            {
-                RecurseThroughOperands(subVal, IDToValue);
-            }
-        }
+        throw CyclebiteException("Caller section of the profile container is truncated!");
     }
-    else if (auto arg = llvm::dyn_cast<llvm::Argument>(val))
+    for (offset = 0; offset < callers.size(); offset += callerRecord)
     {
-        if (Cyclebite::Util::GetValueID(arg) < 0)
-        {
-            throw CyclebiteException("Found a global object that did not have a ValueID.");
-        }
-        if (IDToValue.find(Cyclebite::Util::GetValueID(val)) == IDToValue.end())
-        {
-            IDToValue[Cyclebite::Util::GetValueID(arg)] = val;
-        }
-        else
-        {
-            return;
-        }
+        // every call has its own block ID in the analysis view, so the position of the call within its original block is not needed and dropped just like in BlockInfo.json
+        context.blockCallers[readPacked<uint32_t>(callers, offset)].push_back(readPacked<uint32_t>(callers, offset + sizeof(uint32_t)));
+    }
+    auto entrances = container.getSection(__TA_SECTION_THREAD_ENTRANCES);
+    for (offset = 0; offset + sizeof(uint32_t) <= entrances.size(); offset += sizeof(uint32_t))
+    {
+        context.threadStarts.insert(readPacked<uint32_t>(entrances, offset));
     }
 }
 
+/// @brief Maps the dynamic pass IDs of a module to their blocks and values
+///
+/// Every value that gets an ID from Annotate() is a global object, a function argument or an instruction, so one flat walk over the module reaches all of them without following operands
 void Cyclebite::Graph::InitializeIDMaps(llvm::Module *M)
 {
+    for (auto &go : M->global_objects())
+    {
+        auto id = Cyclebite::Util::GetValueID(&go);
+        if (id >= 0)
+        {
+            IDToValue.try_emplace(id, &go);
+        }
+    }
     for (auto &F : *M)
     {
-        for (auto BB = F.begin(); BB != F.end(); BB++)
+        for (auto &arg : F.args())
+        {
+            auto id = Cyclebite::Util::GetValueID(&arg);
+            if (id >= 0)
+            {
+                IDToValue.try_emplace(id, &arg);
+            }
+        }
+        for (auto &BB : F)
         {
-            auto *block = llvm::cast<llvm::BasicBlock>(BB);
-            if (( Cyclebite::Util::GetBlockID(block) >= 0) && (IDToBlock[Cyclebite::Util::GetBlockID(block)] == nullptr))
+            auto blockID = Cyclebite::Util::GetBlockID(&BB);
+            if (blockID >= 0)
             {
-                IDToBlock[Cyclebite::Util::GetBlockID(block)] = block;
+                IDToBlock.try_emplace(blockID, &BB);
             }
-            for (auto it = block->begin(); it != block->end(); it++)
+            for (auto &inst : BB)
             {
-                auto inst = llvm::cast<llvm::Instruction>(it);
-                RecurseThroughOperands(inst, IDToValue);
+                if (llvm::isa<llvm::DbgInfoIntrinsic>(inst))
+                {
+                    continue;
+                }
+                auto id = Cyclebite::Util::GetValueID(&inst);
+                if (id < 0)
+                {
+                    throw CyclebiteException("Found an instruction that did not have a ValueID.");
+                }
+                IDToValue.try_emplace(id, &inst);
             }
         }
     }
@@ -190,111 +199,131 @@ void Cyclebite::Graph::InitializeIDMaps(llvm::Module *M)
 
 /// @brief Reads an input profile
 ///
+/// The profile may be a markov.bin file or a profile container, the container is detected by its magic
+/// @param context  Context of the profile, its markov order and node maps are set here
 /// @param graph    Structure that will hold the raw profile input. Raw profile input only has control edges and Conditional/Unconditional nodes. This profile may not pass all checks in Cyclebite::Graph::Checks because of function pointers.
 /// @param filename Profile filename
-/// @param HotCodeDetection     Flag enabling hotcode detection checks on the profile. Right now there is only one check: the input profile must have markov order 1
-int Cyclebite::Graph::BuildCFG(Graph &graph, const std::string &filename, bool HotCodeDetection)
+/// @throws CyclebiteException when the profile cannot be read
+void Cyclebite::Graph::BuildCFG(ProfileContext &context, Graph &graph, const std::string &filename)
 {
-    // first initialize the graph to all the blocks in the
-    FILE *f = fopen(filename.data(), "rb");
-    if (!f)
+    if (ProfileContainer::isContainer(filename))
     {
-        return 1;
+        ProfileContainer container(filename);
+        BuildCFG(context, graph, container);
+        return;
     }
-    // first word is a uint32_t of the markov order of the graph
-    fread(&markovOrder, sizeof(uint32_t), 1, f);
-
-    // second word is a uint32_t of the total number of blocks in the graph (each block may or may not be connected to the rest of the graph)
-    uint32_t blocks;
-    fread(&blocks, sizeof(uint32_t), 1, f);
-
-    // third word is a uint32_t of how many edges there are in the file
-    uint32_t numEdges;
-    fread(&numEdges, sizeof(uint32_t), 1, f);
+    MarkovProfile profile(filename);
+    BuildCFG(context, graph, profile);
+}
 
-    if (HotCodeDetection)
+/// @brief Builds the CFG from the edge section of a profile container
+/// @throws CyclebiteException when the container has no edge section or the section is corrupt
+void Cyclebite::Graph::BuildCFG(ProfileContext &context, Graph &graph, const ProfileContainer &container)
+{
+    if (!container.hasSection(__TA_SECTION_EDGES))
     {
-        if (markovOrder != 1)
-        {
-            spdlog::critical("Hot code detection can only be performed on an input profile that has markov order 1!");
-            return 1;
-        }
+        throw CyclebiteException("Profile container does not have an edge section!");
     }
+    auto edges = container.getSection(__TA_SECTION_EDGES);
+    MarkovProfile profile(edges.data(), edges.size());
+    BuildCFG(context, graph, profile);
+}
 
-    // list of source nodes for a new edge being read from the input profile
-    // nodes go in order of least recent to most recent
-    uint32_t newSources[markovOrder];
-    for (uint32_t i = 0; i < markovOrder; i++)
-    {
-        newSources[i] = 0;
-    }
-    // place to read in a given sink ID from the input profile
-    uint32_t sink = 0;
-    // place to read in a given edge frequency from the input profile
-    uint64_t frequency = 0;
-    for (uint32_t i = 0; i < numEdges; i++)
-    {
-        // source node IDs go in order or least recent to most recent
-        fread(&newSources, sizeof(uint32_t), markovOrder, f);
-        fread(&sink, sizeof(uint32_t), 1, f);
-        fread(&frequency, sizeof(uint64_t), 1, f);
-        std::vector<uint32_t> newSourceIDs;
-        std::shared_ptr<ControlNode> sourceNode = nullptr;
-        for (auto &id : newSources)
-        {
-            newSourceIDs.push_back(id);
-        }
-        if (NIDMap.find(newSourceIDs) == NIDMap.end())
+/// @brief Builds the CFG of a profile above markov order 1
+///
+/// Each node is a path of markov order blocks, oldest first. A record of order+1 blocks is the edge from the path of its first blocks to the path of its last blocks
+/// A block belongs to many paths, so nodes are found through PathNIDMap
+/// NIDMap maps each block to the first node whose path ends in it, so BlockToNode() finds every block of the profile instead of taking it for dead code
+void BuildPathCFG(ProfileContext &context, Graph &graph, const MarkovProfile &profile)
+{
+    map<vector<uint32_t>, shared_ptr<ControlNode>> pathNodes;
+    auto getNode = [&](span<const uint32_t> path) -> const shared_ptr<ControlNode> & {
+        for (const auto &block : path)
         {
-            sourceNode = make_shared<ControlNode>();
-            NIDMap[newSourceIDs] = sourceNode->NID;
-            sourceNode->blocks.insert(newSourceIDs.begin(), newSourceIDs.end());
-            sourceNode->originalBlocks = newSourceIDs;
-            graph.addNode(sourceNode);
+            if (block >= profile.getBlockCount())
+            {
+                throw CyclebiteException("Found a node described in an edge that does not exist in the BBID space!");
+            }
         }
-        else
+        vector<uint32_t> key(path.begin(), path.end());
+        auto &node = pathNodes[key];
+        if (node == nullptr)
         {
-            sourceNode = static_pointer_cast<ControlNode>(graph.getOriginalNode(NIDMap[newSourceIDs]));
+            node = make_shared<ControlNode>();
+            context.PathNIDMap[key] = node->NID;
+            if (context.NIDMap[key.back()] == UNMAPPED_NID)
+            {
+                context.NIDMap[key.back()] = node->NID;
+            }
+            node->blocks.insert(key.begin(), key.end());
+            node->originalBlocks = key;
+            graph.addNode(node);
         }
-        if (sourceNode == nullptr)
+        return node;
+    };
+    for (uint32_t i = 0; i < profile.getEdgeCount(); i++)
+    {
+        auto blocks = profile.getBlocks(i);
+        const auto &sourceNode = getNode(blocks.first(context.markovOrder));
+        const auto &sinkNode = getNode(blocks.last(context.markovOrder));
+        if (sourceNode->isPredecessor(sinkNode))
         {
-            throw CyclebiteException("Found a node described in an edge that does not exist in the BBID space!");
+            throw CyclebiteException("This sink node ID is already a neighbor of this source node!");
         }
+        auto newEdge = make_shared<UnconditionalEdge>(profile.getFrequency(i), sourceNode, sinkNode);
+        graph.addEdge(newEdge);
+        sourceNode->addSuccessor(newEdge);
+        sinkNode->addPredecessor(newEdge);
+    }
+}
 
-        // now synthesize the sink neighbor of this node, if a node for it doesn't yet exist
-        // first we insert all newSourceIDs except the oldest one
-        // then we insert the sink node ID to complete all IDs for the neighbor node
-        vector<uint32_t> neighborSourceIDs(next(newSourceIDs.begin()), newSourceIDs.end());
-        neighborSourceIDs.push_back(sink);
-        std::shared_ptr<ControlNode> sinkNode = nullptr;
-        if (NIDMap.find(neighborSourceIDs) == NIDMap.end())
-        {
-            sinkNode = make_shared<ControlNode>();
-            NIDMap[neighborSourceIDs] = sinkNode->NID;
-            sinkNode->blocks.insert(neighborSourceIDs.begin(), neighborSourceIDs.end());
-            sinkNode->originalBlocks = neighborSourceIDs;
-            graph.addNode(sinkNode);
-        }
-        else
+/// @brief Builds the CFG from the edge array of a profile
+///
+/// The edge array is walked in place
+/// Node storage is sized by the block count in the profile header, so every block lookup is a flat index into NIDMap
+/// Profiles above markov order 1 are built by BuildPathCFG
+void Cyclebite::Graph::BuildCFG(ProfileContext &context, Graph &graph, const MarkovProfile &profile)
+{
+    context.markovOrder = profile.getMarkovOrder();
+    context.NIDMap.assign(profile.getBlockCount(), UNMAPPED_NID);
+    context.PathNIDMap.clear();
+    if (context.markovOrder > 1)
+    {
+        BuildPathCFG(context, graph, profile);
+        return;
+    }
+    // holds the node of each block ID so we don't have to search the graph for it
+    vector<shared_ptr<ControlNode>> blockNodes(profile.getBlockCount());
+    auto getNode = [&](uint32_t block) -> const shared_ptr<ControlNode> & {
+        if (block >= blockNodes.size())
         {
-            sinkNode = static_pointer_cast<ControlNode>(graph.getOriginalNode(NIDMap[neighborSourceIDs]));
+            throw CyclebiteException("Found a node described in an edge that does not exist in the BBID space!");
         }
-        if (sinkNode == nullptr)
+        auto &node = blockNodes[block];
+        if (node == nullptr)
         {
-            throw CyclebiteException("Could not find a node in the graph that matches the NID found to map to this neighbor!");
+            node = make_shared<ControlNode>();
+            context.NIDMap[block] = node->NID;
+            node->blocks.insert(block);
+            node->originalBlocks.push_back(block);
+            graph.addNode(node);
         }
+        return node;
+    };
+    for (const auto &edge : profile)
+    {
+        const auto &sourceNode = getNode(edge.src);
+        const auto &sinkNode = getNode(edge.snk);
         if (sourceNode->isPredecessor(sinkNode))
         {
             throw CyclebiteException("This sink node ID is already a neighbor of this source node!");
         }
         // each edge is a basic edge with a frequency count and two nodes, upgrading to more specific edge types like ConditionalEdge and CallEdge are done in UpgradeEdges()
-        auto newEdge = make_shared<UnconditionalEdge>(frequency, sourceNode, sinkNode);
+        auto newEdge = make_shared<UnconditionalEdge>(edge.frequency, sourceNode, sinkNode);
         graph.addEdge(newEdge);
         sourceNode->addSuccessor(newEdge);
         sinkNode->addPredecessor(newEdge);
     }
-    fclose(f);
-    return 0;
 }
 
 /// @brief Finds the destination nodes of null function calls and puts then in snkNodes
@@ -303,9 +332,9 @@ int Cyclebite::Graph::BuildCFG(Graph &graph, const std::string &filename, bool H
 /// @param snkNodes     The destination nodes of the function call. This can be more than one node because null function calls can take on multiple values during runtime.
 /// @param call         Call instruction in question
 /// @param graph        The control graph that contains the input profile
-/// @param blockCallers Maps a calling block ID to a vector of its observed destination blocks
+/// @param context      Context of the profile, its blockCallers map a calling block ID to a vector of its observed destination blocks
 /// @param IDToBlock    Maps a block ID to a basic block pointer
-void resolveNullFunctionCall(const shared_ptr<ControlNode> &srcNode, set<shared_ptr<ControlNode>, p_GNCompare> &snkNodes, const CallBase *call, const Graph &graph, const std::map<int64_t, std::vector<int64_t>> &blockCallers, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock)
+void resolveNullFunctionCall(ProfileContext &context, const shared_ptr<ControlNode> &srcNode, set<shared_ptr<ControlNode>, p_GNCompare> &snkNodes, const CallBase *call, const Graph &graph, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock)
 {
     // blockCallers should tell us which basic block this null function call goes to next
 
@@ -319,14 +348,14 @@ void resolveNullFunctionCall(const shared_ptr<ControlNode> &srcNode, set<shared_
     // at this point, the only way I can think of to detect this case is to see if there is actually a function name (with a preceding @ symbol)
     // the above mechanism will fail if the null function call has a global variable in its arguments list (globals are preceded by @ too)
     auto instString = PrintVal(call, false);
-    if (blockCallers.find(Cyclebite::Util::GetBlockID(call->getParent())) != blockCallers.end())
+    if (context.blockCallers.find(Cyclebite::Util::GetBlockID(call->getParent())) != context.blockCallers.end())
     {
         // this is a multi-dimensional problem, even with basic block splitting
         // a function pointer is allowed to call any function that matches a signature
         // when a function pointer goes to more than one function, we have to be able to enumerate that case here
-        for (auto callee : blockCallers.at(Cyclebite::Util::GetBlockID(call->getParent())))
+        for (auto callee : context.blockCallers.at(Cyclebite::Util::GetBlockID(call->getParent())))
         {
-            auto n = BlockToNode(graph, IDToBlock.at(callee), NIDMap);
+            auto n = BlockToNode(context, graph, IDToBlock.at(callee));
             if( n )
             {
                 snkNodes.insert(static_pointer_cast<ControlNode>(n));
@@ -365,7 +394,7 @@ void resolveNullFunctionCall(const shared_ptr<ControlNode> &srcNode, set<shared_
     }
 }
 
-void buildFunctionSubgraph(shared_ptr<CallEdge> &newCall, const Graph &graph, const std::map<int64_t, std::vector<int64_t>> &blockCallers, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock, const BasicBlock *functionBlock)
+void buildFunctionSubgraph(ProfileContext &context, shared_ptr<CallEdge> &newCall, const Graph &graph, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock, const BasicBlock *functionBlock)
 {
     // this section builds out the function subgraph in dynamic nodes
     // the subgraph should include all functions below this one
@@ -377,7 +406,7 @@ void buildFunctionSubgraph(shared_ptr<CallEdge> &newCall, const Graph &graph, co
     {
         for (auto fb = Q.front()->begin(); fb != Q.front()->end(); fb++)
         {
-            auto n = BlockToNode(graph, llvm::cast<llvm::BasicBlock>(fb), NIDMap);
+            auto n = BlockToNode(context, graph, llvm::cast<llvm::BasicBlock>(fb));
             if( n )
             {
                 newCall->rets.functionNodes.insert(static_pointer_cast<ControlNode>(n));
@@ -397,9 +426,9 @@ void buildFunctionSubgraph(shared_ptr<CallEdge> &newCall, const Graph &graph, co
                                 }
                             }
                         }
-                        else if (blockCallers.find(Cyclebite::Util::GetBlockID(llvm::cast<llvm::BasicBlock>(fb))) != blockCallers.end())
+                        else if (context.blockCallers.find(Cyclebite::Util::GetBlockID(llvm::cast<llvm::BasicBlock>(fb))) != context.blockCallers.end())
                         {
-                            for (auto callee : blockCallers.at(Cyclebite::Util::GetBlockID(llvm::cast<llvm::BasicBlock>(fb))))
+                            for (auto callee : context.blockCallers.at(Cyclebite::Util::GetBlockID(llvm::cast<llvm::BasicBlock>(fb))))
                             {
                                 auto calleeParent = IDToBlock.at(callee)->getParent();
                                 if (!calleeParent->empty())
@@ -485,7 +514,7 @@ void TransformDynamicReturnEdges(shared_ptr<CallEdge> &newCall, Graph &graph)
 /// They also  fill in the gaps that are created by multithreaded applications
 /// For example when threads are allowed to terminate without a join (pthread_exit)
 /// Cyclebyte fills in these kinds of gaps with imaginary edges, which point (for example) from the ends of a thread to the imaginary edge at the end of main
-shared_ptr<ControlNode> AddImaginaryEdges(llvm::Module* sourceBitcode, Graph& graph, std::set<int64_t> threadStarts)
+shared_ptr<ControlNode> AddImaginaryEdges(ProfileContext &context, llvm::Module* sourceBitcode, Graph& graph)
 {
     // here we add the imaginary nodes and edges that precede and succeed the main function
     // this must happen before we put imaginary edges at the end of threads
@@ -498,7 +527,7 @@ shared_ptr<ControlNode> AddImaginaryEdges(llvm::Module* sourceBitcode, Graph& gr
     {
         if( fi->getName() == "main" )
         {
-            auto firstNode = static_pointer_cast<ControlNode>(BlockToNode(graph, llvm::cast<BasicBlock>(fi->begin()), NIDMap));
+            auto firstNode = static_pointer_cast<ControlNode>(BlockToNode(context, graph, llvm::cast<BasicBlock>(fi->begin())));
             auto zeroEdge = make_shared<ImaginaryEdge>(firstFirstNode, firstNode);
             static_pointer_cast<GraphNode>(firstNode)->addPredecessor(zeroEdge);
             firstFirstNode->addSuccessor(zeroEdge);
@@ -513,7 +542,7 @@ shared_ptr<ControlNode> AddImaginaryEdges(llvm::Module* sourceBitcode, Graph& gr
             {
                 // we know that any block within main who has no successors is the exit of the program
                 // this is because the dynamic profile guarantees that the node within main's context that has no successors must be the exit
-                auto node = BlockToNode(graph, llvm::cast<BasicBlock>(bi), NIDMap);
+                auto node = BlockToNode(context, graph, llvm::cast<BasicBlock>(bi));
                 if( node )
                 {
                     if( node->getSuccessors().empty() )
@@ -542,12 +571,12 @@ shared_ptr<ControlNode> AddImaginaryEdges(llvm::Module* sourceBitcode, Graph& gr
             // threads must start at functions, so the function entrance block should be in threadStarts if this function was the start of a new thread
             auto BB = llvm::cast<BasicBlock>(fi->begin());
             auto ID = Cyclebite::Util::GetBlockID(BB);
-            if( threadStarts.find(ID) != threadStarts.end() )
+            if( context.threadStarts.find(ID) != context.threadStarts.end() )
             {
                 // get the last block in the function
                 // this can be found in the call instruction that precedes the first node
                 set<shared_ptr<ControlNode>, p_GNCompare> returnNodes;
-                for( const auto& pred : BlockToNode(graph, BB, NIDMap)->getPredecessors() )
+                for( const auto& pred : BlockToNode(context, graph, BB)->getPredecessors() )
                 {
                     if( auto call = dynamic_pointer_cast<CallEdge>(pred) )
                     {
@@ -568,13 +597,124 @@ shared_ptr<ControlNode> AddImaginaryEdges(llvm::Module* sourceBitcode, Graph& gr
     return terminator;
 }
 
+/// @brief Upgrades the edges of a profile above markov order 1
+///
+/// A path node cannot be matched to the branch of one block, so every node with more than one observed successor is treated as a branch and its edges become ConditionalEdges
+/// Call and return edges are not recovered at this order, the nodes of a path already carry the caller and the callee
+void UpgradePathEdges(Graph &graph)
+{
+    for (const auto &node : graph.nodes())
+    {
+        if (node->getSuccessors().size() < 2)
+        {
+            continue;
+        }
+        uint64_t sum = 0;
+        set<shared_ptr<ConditionalEdge>, GECompare> newEdges;
+        auto origEdges = node->getSuccessors();
+        for (const auto &origEdge : origEdges)
+        {
+            auto ue = dynamic_pointer_cast<UnconditionalEdge>(origEdge);
+            if (!ue)
+            {
+                continue;
+            }
+            auto newEdge = make_shared<ConditionalEdge>(*ue);
+            auto snk = origEdge->getSnk();
+            node->removeSuccessor(origEdge);
+            snk->removePredecessor(origEdge);
+            graph.removeEdge(origEdge);
+            node->addSuccessor(newEdge);
+            snk->addPredecessor(newEdge);
+            graph.addEdge(newEdge);
+            newEdges.insert(newEdge);
+            sum += ue->getFreq();
+        }
+        for (const auto &newEdge : newEdges)
+        {
+            newEdge->setWeight(sum);
+        }
+    }
+}
+
+/// @brief Implements imaginary edges for a profile above markov order 1
+///
+/// The first path of main is the path that starts at main's entry block and was never entered from another path
+/// The program terminator is the path with no successors that ends in a block of main, every other path with no successors ended a thread and points to the imaginary node at the end of main
+/// @throws CyclebiteException when the first or last path of main cannot be found
+shared_ptr<ControlNode> AddImaginaryPathEdges(llvm::Module* sourceBitcode, Graph& graph)
+{
+    auto main = sourceBitcode->getFunction("main");
+    if( !main || main->empty() )
+    {
+        throw CyclebiteException("Cannot find the main function in the source bitcode!");
+    }
+    set<int64_t> mainBlocks;
+    for( const auto& BB : *main )
+    {
+        mainBlocks.insert(Cyclebite::Util::GetBlockID(&BB));
+    }
+    auto entry = Cyclebite::Util::GetBlockID(&main->getEntryBlock());
+    shared_ptr<ControlNode> firstNode = nullptr;
+    shared_ptr<ControlNode> terminator = nullptr;
+    vector<shared_ptr<ControlNode>> threadEnds;
+    for( const auto& node : graph.nodes() )
+    {
+        auto cn = dynamic_pointer_cast<ControlNode>(node);
+        if( !cn || cn->originalBlocks.empty() )
+        {
+            continue;
+        }
+        if( !firstNode && cn->getPredecessors().empty() && (cn->originalBlocks.front() == (uint32_t)entry) )
+        {
+            firstNode = cn;
+        }
+        if( cn->getSuccessors().empty() )
+        {
+            if( !terminator && mainBlocks.contains(cn->originalBlocks.back()) )
+            {
+                terminator = cn;
+            }
+            else
+            {
+                threadEnds.push_back(cn);
+            }
+        }
+    }
+    if( !firstNode )
+    {
+        throw CyclebiteException("Cannot find the first path of main in the input profile!");
+    }
+    if( !terminator )
+    {
+        throw CyclebiteException("Cannot yet handle the case where the program terminates outside main!");
+    }
+    shared_ptr<ImaginaryNode> firstFirstNode = make_shared<ImaginaryNode>();
+    shared_ptr<ImaginaryNode> lastLastNode = make_shared<ImaginaryNode>();
+    graph.addNode(firstFirstNode);
+    graph.addNode(lastLastNode);
+    auto zeroEdge = make_shared<ImaginaryEdge>(firstFirstNode, firstNode);
+    static_pointer_cast<GraphNode>(firstNode)->addPredecessor(zeroEdge);
+    firstFirstNode->addSuccessor(zeroEdge);
+    graph.addEdge(zeroEdge);
+    threadEnds.push_back(terminator);
+    for( const auto& end : threadEnds )
+    {
+        auto imRet = make_shared<ImaginaryEdge>(end, lastLastNode);
+        static_pointer_cast<GraphNode>(end)->addSuccessor(imRet);
+        lastLastNode->addPredecessor(imRet);
+        graph.addEdge(imRet);
+    }
+    return terminator;
+}
+
 /// @brief This function reads through all edges in the dynamic profile and upgrade UnconditionalEdges to conditional edges, call/return edges, etc
 ///
 /// @param sourceBitcode    The formatted bitcode that was the source LLVM IR for the profile
 /// @param graph            A raw profile that has been turned into a graph. By the end of this method, graph will pass all checks in Cyclebite::Graph::Checks
-/// @param blockCallers     A map connecting caller basic blocks to their callees
+/// @param context          Context of the profile, its blockCallers connect caller basic blocks to their callees
 /// @param IDToBlock        A map connecting basic block IDs to an llvm::BasicBlock pointer
-void UpgradeEdges(const llvm::Module *sourceBitcode, Graph &graph, const std::map<int64_t, std::vector<int64_t>> &blockCallers, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock)
+void UpgradeEdges(ProfileContext &context, const llvm::Module *sourceBitcode, Graph &graph, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock)
 {
     // for each function in the bitcode, parse its static structures (function calls, branch instructions) and inject that information into the dynamic graph
     // 0. Put imaginary nodes at start and end of main
@@ -587,7 +727,7 @@ void UpgradeEdges(const llvm::Module *sourceBitcode, Graph &graph, const std::ma
         {
             auto BB = cast<BasicBlock>(bi);
             // this statement makes sure this basic block was observed in the profile
-            auto BBnode = BlockToNode(graph, BB, NIDMap);
+            auto BBnode = BlockToNode(context, graph, BB);
             if (!BBnode)
             {
                 continue;
@@ -602,7 +742,7 @@ void UpgradeEdges(const llvm::Module *sourceBitcode, Graph &graph, const std::ma
                 for (unsigned int i = 0; i < BB->getTerminator()->getNumSuccessors(); i++)
                 {
                     auto succ = BB->getTerminator()->getSuccessor(i);
-                    auto snkNode = BlockToNode(graph, succ, NIDMap);
+                    auto snkNode = BlockToNode(context, graph, succ);
                     if (snkNode)
                     {
                         snkNodes.push_back(snkNode);
@@ -788,12 +928,12 @@ void UpgradeEdges(const llvm::Module *sourceBitcode, Graph &graph, const std::ma
     for (const auto &call : calls)
     {
         auto BB = call->getParent();
-        auto BBnode = static_pointer_cast<ControlNode>(BlockToNode(graph, BB, NIDMap));
+        auto BBnode = static_pointer_cast<ControlNode>(BlockToNode(context, graph, BB));
         shared_ptr<ControlNode> srcNode = nullptr;
         set<shared_ptr<ControlNode>, p_GNCompare> snkNodes;
         // we attempt to find an edge in the graph that represents this function call
         // we should have a direct mapping between this caller basic block and the entrance block of the function
-        srcNode = static_pointer_cast<ControlNode>(BlockToNode(graph, BB, NIDMap));
+        srcNode = static_pointer_cast<ControlNode>(BlockToNode(context, graph, BB));
         if (srcNode == nullptr)
         {
             continue;
@@ -803,11 +943,11 @@ void UpgradeEdges(const llvm::Module *sourceBitcode, Graph &graph, const std::ma
         {
             if (!call->getCalledFunction()->empty())
             {
-                if( blockCallers.find(Cyclebite::Util::GetBlockID(BB)) != blockCallers.end() )
+                if( context.blockCallers.find(Cyclebite::Util::GetBlockID(BB)) != context.blockCallers.end() )
                 {
-                    for (auto callee : blockCallers.at(Cyclebite::Util::GetBlockID(BB)))
+                    for (auto callee : context.blockCallers.at(Cyclebite::Util::GetBlockID(BB)))
                     {
-                        snkNodes.insert(static_pointer_cast<ControlNode>(BlockToNode(graph, IDToBlock.at(callee), NIDMap)));
+                        snkNodes.insert(static_pointer_cast<ControlNode>(BlockToNode(context, graph, IDToBlock.at(callee))));
                     }
                 }
             }
@@ -822,7 +962,7 @@ void UpgradeEdges(const llvm::Module *sourceBitcode, Graph &graph, const std::ma
         }
         else
         {
-            resolveNullFunctionCall(srcNode, snkNodes, call, graph, blockCallers, IDToBlock);
+            resolveNullFunctionCall(context, srcNode, snkNodes, call, graph, IDToBlock);
         }
         for (auto snkNode : snkNodes)
         {
@@ -839,7 +979,7 @@ void UpgradeEdges(const llvm::Module *sourceBitcode, Graph &graph, const std::ma
                 newCall->rets.callerNode = BBnode;
                 auto functionBlock = NodeToBlock(snkNode, IDToBlock);
                 newCall->rets.f = functionBlock->getParent();
-                buildFunctionSubgraph(newCall, graph, blockCallers, IDToBlock, functionBlock);
+                buildFunctionSubgraph(context, newCall, graph, IDToBlock, functionBlock);
 
                 // the snk node of the return edge is just the BB with the function call inst
                 // to find the src node of the return edge of this call edge, we have to look through all return instructions of the called function
@@ -892,7 +1032,7 @@ void UpgradeEdges(const llvm::Module *sourceBitcode, Graph &graph, const std::ma
                 // this phenomenon is caused by the fact that the profiler does not record the return edge (this would create a control flow cycle that starts and ends with the caller basic block)
                 for (auto &exit : exits)
                 {
-                    auto snk = static_pointer_cast<ControlNode>(BlockToNode(graph, exit->getParent(), NIDMap));
+                    auto snk = static_pointer_cast<ControlNode>(BlockToNode(context, graph, exit->getParent()));
                     if (snk)
                     {
                         // static information for the calledge, mapped to entities in the dynamic graph
@@ -903,7 +1043,7 @@ void UpgradeEdges(const llvm::Module *sourceBitcode, Graph &graph, const std::ma
                         // then map those successor blocks (of the caller block) to dynamic edges (from the callee return node to the caller node successor)
                         for (unsigned int i = 0; i < BB->getTerminator()->getNumSuccessors(); i++)
                         {
-                            auto succNode = static_pointer_cast<ControlNode>(BlockToNode(graph, BB->getTerminator()->getSuccessor(i), NIDMap));
+                            auto succNode = static_pointer_cast<ControlNode>(BlockToNode(context, graph, BB->getTerminator()->getSuccessor(i)));
                             if (succNode)
                             {
                                 // find an edge between this node and the return node of the callee function
@@ -980,12 +1120,12 @@ void UpgradeEdges(const llvm::Module *sourceBitcode, Graph &graph, const std::ma
     for( auto call : calls )
     {
         auto BB = call->getParent();
-        auto BBnode = static_pointer_cast<ControlNode>(BlockToNode(graph, BB, NIDMap));
+        auto BBnode = static_pointer_cast<ControlNode>(BlockToNode(context, graph, BB));
         shared_ptr<ControlNode> srcNode = nullptr;
         set<shared_ptr<ControlNode>, p_GNCompare> snkNodes;
         // we attempt to find an edge in the graph that represents this function call
         // we should have a direct mapping between this caller basic block and the entrance block of the function
-        srcNode = static_pointer_cast<ControlNode>(BlockToNode(graph, BB, NIDMap));
+        srcNode = static_pointer_cast<ControlNode>(BlockToNode(context, graph, BB));
         if( srcNode == nullptr )
         {
             continue;
@@ -1002,7 +1142,7 @@ void UpgradeEdges(const llvm::Module *sourceBitcode, Graph &graph, const std::ma
         else
         {
             set<shared_ptr<ControlNode>, p_GNCompare> targets;
-            resolveNullFunctionCall(srcNode, targets, call, graph, blockCallers, IDToBlock);
+            resolveNullFunctionCall(context, srcNode, targets, call, graph, IDToBlock);
             for( const auto& node : targets )
             {
                 auto block = NodeToBlock(node, IDToBlock);
@@ -1059,7 +1199,7 @@ void UpgradeEdges(const llvm::Module *sourceBitcode, Graph &graph, const std::ma
                 for( const auto& f : fpArgs )
                 {
                     // each one of these inserts is a function that we could possibly go to inside the black box
-                    snkNodes.insert( static_pointer_cast<ControlNode>(BlockToNode(graph, cast<BasicBlock>(f->begin()), NIDMap)) );
+                    snkNodes.insert( static_pointer_cast<ControlNode>(BlockToNode(context, graph, cast<BasicBlock>(f->begin()))) );
                 }
             } // if function is nonempty
         } // for function in possible functions to call from this callbase
@@ -1077,7 +1217,7 @@ void UpgradeEdges(const llvm::Module *sourceBitcode, Graph &graph, const std::ma
                 newCall->rets.callerNode = BBnode;
                 auto functionBlock = NodeToBlock(snkNode, IDToBlock);
                 newCall->rets.f = functionBlock->getParent();
-                buildFunctionSubgraph(newCall, graph, blockCallers, IDToBlock, functionBlock);
+                buildFunctionSubgraph(context, newCall, graph, IDToBlock, functionBlock);
 
                 auto firstFunctionBlock = NodeToBlock(newCall->getWeightedSnk(), IDToBlock);
                 set<llvm::ReturnInst*> exits;
@@ -1091,7 +1231,7 @@ void UpgradeEdges(const llvm::Module *sourceBitcode, Graph &graph, const std::ma
                 // for each basic block with a ret instruction, find its dynamic node, and build out the dynamic equivalents of the return edge
                 for( auto& exit : exits )
                 {
-                    auto snk = static_pointer_cast<ControlNode>(BlockToNode(graph, exit->getParent(), NIDMap));
+                    auto snk = static_pointer_cast<ControlNode>(BlockToNode(context, graph, exit->getParent()));
                     if( snk )
                     {
                         // static information for the calledge, mapped to entities in the dynamic graph
@@ -1148,7 +1288,7 @@ void UpgradeEdges(const llvm::Module *sourceBitcode, Graph &graph, const std::ma
 /// This method looks through all live functions in the bitcode and repairs their incoming edges to call edges, because these call edges will be invisible when evaluating the incoming LLVM bitcode
 /// @param dynamicCG    Dynamic callgraph generated from getDynamicCallGraph(). This argument will have all information discovered injected into itself, thus the argument is not const
 /// @param graph        Dynamic controlgraph imported from the input profile. This argument may have edges upgraded, thus the argument is not const
-void PatchFunctionEdges(const llvm::CallGraph &staticCG, Cyclebite::Graph::Graph &graph, const std::map<int64_t, vector<int64_t>> &blockCallers, const map<int64_t, const llvm::BasicBlock *> &IDToBlock)
+void PatchFunctionEdges(ProfileContext &context, const llvm::CallGraph &staticCG, Cyclebite::Graph::Graph &graph, const map<int64_t, const llvm::BasicBlock *> &IDToBlock)
 {
     for (auto node = staticCG.begin(); node != staticCG.end(); node++)
     {
@@ -1161,7 +1301,7 @@ void PatchFunctionEdges(const llvm::CallGraph &staticCG, Cyclebite::Graph::Graph
                     continue;
                 }
                 auto firstBlock = llvm::cast<llvm::BasicBlock>(node->second->getFunction()->begin());
-                auto firstNode = static_pointer_cast<ControlNode>(BlockToNode(graph, firstBlock, NIDMap));
+                auto firstNode = static_pointer_cast<ControlNode>(BlockToNode(context, graph, firstBlock));
                 if (firstNode)
                 {
                     auto predCopy = firstNode->getPredecessors();
@@ -1183,7 +1323,7 @@ void PatchFunctionEdges(const llvm::CallGraph &staticCG, Cyclebite::Graph::Graph
                             auto newCall = make_shared<CallEdge>(pred->getFreq(), pred->getWeightedSrc(), pred->getWeightedSnk());
                             newCall->rets.callerNode = pred->getWeightedSrc();
                             newCall->rets.f = node->second->getFunction();
-                            buildFunctionSubgraph(newCall, graph, blockCallers, IDToBlock, firstBlock);
+                            buildFunctionSubgraph(context, newCall, graph, IDToBlock, firstBlock);
                             set<const llvm::Instruction *> exits;
                             for (auto block = firstBlock->getParent()->begin(); block != firstBlock->getParent()->end(); block++)
                             {
@@ -1230,7 +1370,7 @@ void PatchFunctionEdges(const llvm::CallGraph &staticCG, Cyclebite::Graph::Graph
                             // for each basic block with a ret instruction, find its dynamic node, and build out the dynamic equivalents of the return edge
                             for (auto &exit : exits)
                             {
-                                auto snk = static_pointer_cast<ControlNode>(BlockToNode(graph, exit->getParent(), NIDMap));
+                                auto snk = static_pointer_cast<ControlNode>(BlockToNode(context, graph, exit->getParent()));
                                 if (snk)
                                 {
                                     // static information for the calledge, mapped to entities in the dynamic graph
@@ -1240,7 +1380,7 @@ void PatchFunctionEdges(const llvm::CallGraph &staticCG, Cyclebite::Graph::Graph
                                     // we have to use the dynamic profile to find the right edges to turn into return edges
                                     for( unsigned i = 0; i < callerBlock->getTerminator()->getNumSuccessors(); i++ )
                                     {
-                                        auto succNode = BlockToNode(graph, callerBlock->getTerminator()->getSuccessor(i), NIDMap);
+                                        auto succNode = BlockToNode(context, graph, callerBlock->getTerminator()->getSuccessor(i));
                                         if( succNode )
                                         {
                                             auto finderEdge = make_shared<UnconditionalEdge>(snk, succNode);
@@ -1298,6 +1438,7 @@ void RemoveTailHeadCalls( Cyclebite::Graph::ControlGraph& cg, const Cyclebite::G
 {
     // set of edges that should be removed from the input control graph (because they are caused by blind spots in the dynamic profile)
     set<shared_ptr<CallEdge>, GECompare> toRemove;
+    CallGraphSCC scc(dynamicCG);
     // for each call edge in the dynamic graph, we are going to see if it is actually "backed" by a call edge in the call graph
     for (const auto &edge : cg.edges())
     {
@@ -1308,7 +1449,7 @@ void RemoveTailHeadCalls( Cyclebite::Graph::ControlGraph& cg, const Cyclebite::G
             if (srcBlock && snkBlock)
             {
                 auto CGN = dynamicCG[srcBlock->getParent()];
-                if( !hasDirectRecursion(dynamicCG, CGN) && !hasIndirectRecursion(dynamicCG, CGN) )
+                if( !scc.hasDirectRecursion(CGN) && !scc.hasIndirectRecursion(CGN) )
                 {
                     // this is a non-recursive function call, check to see if this is the tail-head call we are looking for
                     // this case arises from an empty function calling a comparator functions (examples: FFTW -> fftwf_dimcmp, C++ -> any STL container with a specialized comparator ie operator()( const T& lhs, const T& rhs ) )
@@ -1367,28 +1508,33 @@ void RemoveTailHeadCalls( Cyclebite::Graph::ControlGraph& cg, const Cyclebite::G
     }
 }
 
-void Cyclebite::Graph::getDynamicInformation(Cyclebite::Graph::ControlGraph& cg, Cyclebite::Graph::CallGraph& dynamicCG, const std::string& filePath, const unique_ptr<llvm::Module>& SourceBitcode, const llvm::CallGraph& staticCG, const map<int64_t, vector<int64_t>>& blockCallers, const set<int64_t>& threadStarts, const map<int64_t, const BasicBlock*>& IDToBlock, bool HotCodeDetection)
+/// Builds the control graph and dynamic call graph from the raw profile graph, shared by both ways of reading a profile
+void FinishDynamicInformation(ProfileContext &context, Cyclebite::Graph::Graph& graph, Cyclebite::Graph::ControlGraph& cg, Cyclebite::Graph::CallGraph& dynamicCG, const unique_ptr<llvm::Module>& SourceBitcode, const llvm::CallGraph& staticCG, const map<int64_t, const BasicBlock*>& IDToBlock)
 {
-    Graph graph;
     // node that was observed to exit the program
     shared_ptr<ControlNode> terminator;
     try
     {
-        auto err = BuildCFG(graph, filePath, HotCodeDetection);
-        if (err)
-        {
-            throw CyclebiteException("Failed to read input profile file!");
-        }
         if (graph.empty())
         {
             throw CyclebiteException("No nodes could be read from the input profile!");
         }
-        UpgradeEdges(SourceBitcode.get(), graph, blockCallers, IDToBlock);
-        PatchFunctionEdges(staticCG, graph, blockCallers, IDToBlock);
-        terminator = AddImaginaryEdges(SourceBitcode.get(), graph, threadStarts);
-        dynamicCG = getDynamicCallGraph(SourceBitcode.get(), graph, blockCallers, IDToBlock);
-        cg = ControlGraph(graph, terminator);
-        RemoveTailHeadCalls(cg, dynamicCG, IDToBlock);
+        if (context.markovOrder > 1)
+        {
+            // path nodes have no single block to match against the static code, so the call graph stays empty and only the control graph is built
+            UpgradePathEdges(graph);
+            terminator = AddImaginaryPathEdges(SourceBitcode.get(), graph);
+            cg = ControlGraph(graph, terminator);
+        }
+        else
+        {
+            UpgradeEdges(context, SourceBitcode.get(), graph, IDToBlock);
+            PatchFunctionEdges(context, staticCG, graph, IDToBlock);
+            terminator = AddImaginaryEdges(context, SourceBitcode.get(), graph);
+            dynamicCG = getDynamicCallGraph(context, SourceBitcode.get(), graph, IDToBlock);
+            cg = ControlGraph(graph, terminator);
+            RemoveTailHeadCalls(cg, dynamicCG, IDToBlock);
+        }
     }
     catch (CyclebiteException &e)
     {
@@ -1397,7 +1543,7 @@ void Cyclebite::Graph::getDynamicInformation(Cyclebite::Graph::ControlGraph& cg,
     }
 #ifdef DEBUG
     ofstream LabeledMCG("LabeledMCG.dot");
-    auto LMCG = GenerateDot(graph, true);
+    auto LMCG = GenerateDot(graph, true, context.markovOrder);
     LabeledMCG << LMCG << "\n";
     LabeledMCG.close();
     ofstream DynamicCallallGraphDot("DynamicCallGraph.dot");
@@ -1407,7 +1553,10 @@ void Cyclebite::Graph::getDynamicInformation(Cyclebite::Graph::ControlGraph& cg,
     try
     {
         Checks(cg, "ProfileRead");
-        CallGraphChecks(staticCG, dynamicCG, cg, IDToBlock);
+        if (context.markovOrder == 1)
+        {
+            CallGraphChecks(context, staticCG, dynamicCG, cg, IDToBlock);
+        }
     }
     catch (CyclebiteException &e)
     {
@@ -1417,9 +1566,55 @@ void Cyclebite::Graph::getDynamicInformation(Cyclebite::Graph::ControlGraph& cg,
 #endif
 }
 
-const Cyclebite::Graph::CallGraph Cyclebite::Graph::getDynamicCallGraph(llvm::Module *mod, const Graph &graph, const std::map<int64_t, std::vector<int64_t>> &blockCallers, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock)
+void Cyclebite::Graph::getDynamicInformation(ProfileContext &context, Cyclebite::Graph::ControlGraph& cg, Cyclebite::Graph::CallGraph& dynamicCG, const std::string& filePath, const unique_ptr<llvm::Module>& SourceBitcode, const llvm::CallGraph& staticCG, const map<int64_t, const BasicBlock*>& IDToBlock)
+{
+    Graph graph;
+    try
+    {
+        BuildCFG(context, graph, filePath);
+    }
+    catch (CyclebiteException &e)
+    {
+        spdlog::critical(e.what());
+        exit(EXIT_FAILURE);
+    }
+    FinishDynamicInformation(context, graph, cg, dynamicCG, SourceBitcode, staticCG, IDToBlock);
+}
+
+/// @brief Reads the dynamic information from a profile that is already open (e.g. the profile of one thread)
+void Cyclebite::Graph::getDynamicInformation(ProfileContext &context, Cyclebite::Graph::ControlGraph& cg, Cyclebite::Graph::CallGraph& dynamicCG, const MarkovProfile& profile, const unique_ptr<llvm::Module>& SourceBitcode, const llvm::CallGraph& staticCG, const map<int64_t, const BasicBlock*>& IDToBlock)
+{
+    Graph graph;
+    try
+    {
+        BuildCFG(context, graph, profile);
+    }
+    catch (CyclebiteException &e)
+    {
+        spdlog::critical(e.what());
+        exit(EXIT_FAILURE);
+    }
+    FinishDynamicInformation(context, graph, cg, dynamicCG, SourceBitcode, staticCG, IDToBlock);
+}
+
+const Cyclebite::Graph::CallGraph Cyclebite::Graph::getDynamicCallGraph(ProfileContext &context, llvm::Module *mod, const Graph &graph, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock)
 {
     Cyclebite::Graph::CallGraph dynamicCG;
+    // each parent-child pair gets exactly one edge in the callgraph, every call between the two is added to it
+    map<pair<shared_ptr<CallGraphNode>, shared_ptr<CallGraphNode>>, shared_ptr<CallGraphEdge>> callGraphEdges;
+    auto addCall = [&](const shared_ptr<CallGraphNode> &parent, const shared_ptr<CallGraphNode> &child, const shared_ptr<CallEdge> &ce) {
+        auto &edge = callGraphEdges[pair(parent, child)];
+        // nodes can be removed from the callgraph after their edges are made, so the interned edge has to still be in the graph
+        if (edge && dynamicCG.Graph::find(static_pointer_cast<GraphEdge>(edge)))
+        {
+            edge->addCallEdge(ce);
+            return;
+        }
+        edge = make_shared<CallGraphEdge>(parent, child, set<shared_ptr<CallEdge>, GECompare>{ce});
+        parent->addSuccessor(edge);
+        child->addPredecessor(edge);
+        dynamicCG.addEdge(edge);
+    };
     for (auto f = mod->begin(); f != mod->end(); f++)
     {
         const llvm::Function *F = cast<Function>(f);
@@ -1428,7 +1623,7 @@ const Cyclebite::Graph::CallGraph Cyclebite::Graph::getDynamicCallGraph(llvm::Mo
         if (!F->empty())
         {
             auto firstBlock = cast<BasicBlock>(F->begin());
-            if (BlockToNode(graph, firstBlock, NIDMap))
+            if (BlockToNode(context, graph, firstBlock))
             {
                 if (!dynamicCG.find(F))
                 {
@@ -1449,7 +1644,7 @@ const Cyclebite::Graph::CallGraph Cyclebite::Graph::getDynamicCallGraph(llvm::Mo
         for (auto b = F->begin(); b != F->end(); b++)
         {
             // confirm that this block is live
-            if (!BlockToNode(graph, cast<BasicBlock>(b), NIDMap))
+            if (!BlockToNode(context, graph, cast<BasicBlock>(b)))
             {
                 continue;
             }
@@ -1469,9 +1664,9 @@ const Cyclebite::Graph::CallGraph Cyclebite::Graph::getDynamicCallGraph(llvm::Mo
                     {
                         // try to find a block caller entry for this function, if it's not there we have to move on
                         auto BBID = Cyclebite::Util::GetBlockID(llvm::cast<llvm::BasicBlock>(b));
-                        if (blockCallers.find(BBID) != blockCallers.end())
+                        if (context.blockCallers.find(BBID) != context.blockCallers.end())
                         {
-                            for (auto entry : blockCallers.at(BBID))
+                            for (auto entry : context.blockCallers.at(BBID))
                             {
                                 children.push_back(IDToBlock.at(entry)->getParent());
                             }
@@ -1490,38 +1685,15 @@ const Cyclebite::Graph::CallGraph Cyclebite::Graph::getDynamicCallGraph(llvm::Mo
                             dynamicCG.addNode(childNode);
                         }
                         // this is a check to see if the edge from the call instruction to the callee function is live
-                        auto callerNode = BlockToNode(graph, cast<BasicBlock>(b), NIDMap);
-                        auto calleeNode = BlockToNode(graph, cast<BasicBlock>(child->begin()), NIDMap);
+                        auto callerNode = BlockToNode(context, graph, cast<BasicBlock>(b));
+                        auto calleeNode = BlockToNode(context, graph, cast<BasicBlock>(child->begin()));
                         auto finderEdge = make_shared<UnconditionalEdge>(0, callerNode, calleeNode);
                         if (graph.find(finderEdge))
                         {
                             auto e = graph.getOriginalEdge(finderEdge);
                             if (auto ce = dynamic_pointer_cast<CallEdge>(e))
                             {
-                                set<shared_ptr<CallEdge>, GECompare> callEdges;
-                                callEdges.insert(ce);
-                                if (newNode->isPredecessor(childNode))
-                                {
-                                    // this edge already exists between parent and child, add the CallEdge to the CallGraphEdge
-                                    shared_ptr<CallGraphEdge> childEdge = nullptr;
-                                    auto childrenCopy = newNode->getChildren();
-                                    for (const auto &succ : childrenCopy)
-                                    {
-                                        if (succ->getChild() == childNode)
-                                        {
-                                            childEdge = succ;
-                                            callEdges.insert(childEdge->getCallEdges().begin(), childEdge->getCallEdges().end());
-                                            childNode->removePredecessor(childEdge);
-                                            newNode->removeSuccessor(childEdge);
-                                            dynamicCG.removeEdge(childEdge);
-                                            break;
-                                        }
-                                    }
-                                }
-                                auto newEdge = make_shared<CallGraphEdge>(newNode, childNode, callEdges);
-                                newNode->addSuccessor(newEdge);
-                                childNode->addPredecessor(newEdge);
-                                dynamicCG.addEdge(newEdge);
+                                addCall(newNode, childNode, ce);
                             }
                             else
                             {
@@ -1555,7 +1727,7 @@ const Cyclebite::Graph::CallGraph Cyclebite::Graph::getDynamicCallGraph(llvm::Mo
         // this can arise if the current function is called by an empty function
         // but we need to be careful here - we don't want to inject blindspots from the dynamic profile into the dynamic call graph
         // - for example, when we get the TailToHeadCaller case (see RemoveTailHeadCalls()), we want to ignore that edge because it doesn't actually exist (it can make a non-recursive function look recursive)
-        auto entryNode = BlockToNode(graph, llvm::cast<llvm::BasicBlock>(newNode->getFunction()->begin()), NIDMap);
+        auto entryNode = BlockToNode(context, graph, llvm::cast<llvm::BasicBlock>(newNode->getFunction()->begin()));
         for (const auto &pred : entryNode->getPredecessors())
         {
             if (auto ce = dynamic_pointer_cast<CallEdge>(pred))
@@ -1592,37 +1764,14 @@ const Cyclebite::Graph::CallGraph Cyclebite::Graph::getDynamicCallGraph(llvm::Mo
                     throw CyclebiteException("Found a dead function in the dynamic control graph!");
                 }
 
-                set<shared_ptr<CallEdge>, GECompare> callEdges;
-                callEdges.insert(ce);
-                if (newNode->isSuccessor(parent))
-                {
-                    // this edge already exists between parent and child, add the CallEdge to the CallGraphEdge
-                    shared_ptr<CallGraphEdge> parentEdge = nullptr;
-                    auto parentsCopy = newNode->getParents();
-                    for (const auto &pred : parentsCopy)
-                    {
-                        if (pred->getParent() == parent)
-                        {
-                            parentEdge = pred;
-                            callEdges.insert(parentEdge->getCallEdges().begin(), parentEdge->getCallEdges().end());
-                            parent->removeSuccessor(parentEdge);
-                            newNode->removePredecessor(parentEdge);
-                            dynamicCG.removeEdge(parentEdge);
-                            break;
-                        }
-                    }
-                }
-                auto newEdge = make_shared<CallGraphEdge>(parent, newNode, callEdges);
-                newNode->addPredecessor(newEdge);
-                parent->addSuccessor(newEdge);
-                dynamicCG.addEdge(newEdge);
+                addCall(parent, newNode, ce);
             }
         }
     }
     return dynamicCG;
 }
 
-void Cyclebite::Graph::CallGraphChecks(const llvm::CallGraph &SCG, const Cyclebite::Graph::CallGraph &DCG, const Graph &dynamicGraph, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock)
+void Cyclebite::Graph::CallGraphChecks(ProfileContext &context, const llvm::CallGraph &SCG, const Cyclebite::Graph::CallGraph &DCG, const Graph &dynamicGraph, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock)
 {
     // do the dynamicGraph calledges and the DCG edges agree?
     for (const auto &edge : DCG.edges())
@@ -1668,7 +1817,7 @@ void Cyclebite::Graph::CallGraphChecks(const llvm::CallGraph &SCG, const Cyclebi
                 // we don't do this analysis for main because we won't have call edges for main
                 if (string(node.second->getFunction()->getName()) != "main")
                 {
-                    auto firstNode = BlockToNode(dynamicGraph, llvm::cast<BasicBlock>(node.second->getFunction()->begin()), NIDMap);
+                    auto firstNode = BlockToNode(context, dynamicGraph, llvm::cast<BasicBlock>(node.second->getFunction()->begin()));
                     if (firstNode)
                     {
                         // this is a live function
@@ -1707,15 +1856,13 @@ void Cyclebite::Graph::CallGraphChecks(const llvm::CallGraph &SCG, const Cyclebi
     // who is empty in the static callgraph? Do they have edges to non-empty functions? Have we accounted for them all in the dynamic graph?
 }
 
-shared_ptr<Inst> ConstructCallNode( DataGraph& graph, 
-                                    set<std::shared_ptr<ControlBlock>, p_GNCompare> &programFlow, 
-                                    const shared_ptr<Inst>& newNode, 
-                                    const llvm::CallBase* call, 
-                                    const Cyclebite::Graph::CallGraph& dynamicCG, 
-                                    const map<int64_t, std::shared_ptr<ControlNode>> &blockToNode, 
-                                    const std::map<int64_t, const llvm::BasicBlock*>& IDToBlock )
+/// Returns the ControlBlocks a call can go to, making placeholder blocks for callees whose instructions have not been built yet
+set<shared_ptr<ControlBlock>, p_GNCompare> CallDestinations( set<std::shared_ptr<ControlBlock>, p_GNCompare> &programFlow, 
+                                                             const llvm::CallBase* call, 
+                                                             const Cyclebite::Graph::CallGraph& dynamicCG, 
+                                                             const map<int64_t, std::shared_ptr<ControlNode>> &blockToNode, 
+                                                             const std::map<int64_t, const llvm::BasicBlock*>& IDToBlock )
 {
-    // upgrade to a CallNode
     // the llvm::CallBase instruction may contain missing information ie a function pointer
     // to fill in this information, we have to create a mapping between llvm::CallBase and Cyclebite::Graph::CallEdge
     // right now this mapping doesn't exist apriori, so we have to do it manually
@@ -1845,31 +1992,126 @@ shared_ptr<Inst> ConstructCallNode( DataGraph& graph,
             throw CyclebiteException("Could not find live function in the dynamicCG!");
         }
     }
-    // do the upgrading
-    auto callNode = make_shared<Cyclebite::Graph::CallNode>(newNode.get(), dests);
-    auto oldPreds = callNode->getPredecessors();
-    auto oldSuccs = callNode->getSuccessors();
-    for( auto pred : oldPreds )
+    return dests;
+}
+
+/// Data flow of one function, built on a worker thread and merged into the DataGraph by BuildDFG
+struct FunctionDFG
+{
+    const llvm::Function *f;
+    /// First NID of the range reserved for this function
+    uint64_t firstNID;
+    /// Nodes in the order they were built (ascending NID)
+    vector<shared_ptr<DataValue>> nodes;
+    set<shared_ptr<GraphEdge>, GECompare> edges;
+    /// Live blocks of the function and the nodes of their instructions, in program order
+    vector<pair<const llvm::BasicBlock *, set<shared_ptr<Inst>, p_GNCompare>>> blocks;
+    /// Values that have no slot in DNIDMap, they are merged into the map with the rest of the function
+    map<const llvm::Value *, shared_ptr<DataValue>> unnumbered;
+};
+
+/// @brief Builds the data flow of a function without touching any shared state
+///
+/// Instructions can only use values of their own function, so each function owns its DNIDMap slots and the slots can be written while other functions are being built
+/// IDs are read with the metadata kinds in kinds, looking a kind up by name is not thread-safe
+void BuildFunctionDFG(FunctionDFG &local, const map<int64_t, std::shared_ptr<ControlNode>> &blockToNode, const Cyclebite::Util::IDKinds &kinds)
+{
+    GraphNode::useNIDs(local.firstNID);
+    // calls in live blocks become CallNodes (their destinations are filled in by BuildDFG), everything else is an Inst
+    set<const llvm::BasicBlock *> live;
+    for (const auto &BB : *local.f)
     {
-        auto newPred = make_shared<UnconditionalEdge>(pred->getSrc(), callNode);
-        pred->getSrc()->removeSuccessor(pred);
-        callNode->removePredecessor(pred);
-        pred->getSrc()->addSuccessor(newPred);
-        callNode->addPredecessor(newPred);
-        graph.removeEdge(pred);
-        graph.addEdge(newPred);
+        if (blockToNode.contains(Cyclebite::Util::GetBlockID(&BB, kinds)))
+        {
+            live.insert(&BB);
+        }
+        else
+        {
+            //throw CyclebiteException("Cannot map a basic block to a ControlNode!");
+            spdlog::warn("Cannot map a basic block to a ControlNode!");
+        }
     }
-    for( auto succ : oldSuccs )
+    // finds the node of a value, or builds one
+    auto getNode = [&](const llvm::Value *v) -> shared_ptr<DataValue> {
+        auto ID = Cyclebite::Util::GetValueID(v, kinds);
+        if (DNIDMap.dense(ID))
+        {
+            if (DNIDMap.contains(v, ID))
+            {
+                return DNIDMap.at(v, ID);
+            }
+        }
+        else if (auto found = local.unnumbered.find(v); found != local.unnumbered.end())
+        {
+            return found->second;
+        }
+        shared_ptr<DataValue> node = nullptr;
+        if (const auto &inst = dyn_cast<Instruction>(v))
+        {
+            if (isa<CallBase>(inst) && live.contains(inst->getParent()))
+            {
+                node = make_shared<CallNode>(inst, set<shared_ptr<ControlBlock>, p_GNCompare>());
+            }
+            else
+            {
+                node = make_shared<Inst>(inst);
+            }
+        }
+        else
+        {
+            node = make_shared<DataValue>(v);
+        }
+        if (DNIDMap.dense(ID))
+        {
+            DNIDMap.insert(v, ID, node);
+        }
+        else
+        {
+            local.unnumbered[v] = node;
+        }
+        local.nodes.push_back(node);
+        return node;
+    };
+    auto connect = [&](const shared_ptr<DataValue> &src, const shared_ptr<DataValue> &snk) {
+        auto newEdge = static_pointer_cast<UnconditionalEdge>(*local.edges.insert(make_shared<UnconditionalEdge>(src, snk)).first);
+        src->addSuccessor(newEdge);
+        snk->addPredecessor(newEdge);
+    };
+    for (const auto &BB : *local.f)
     {
-        auto newSucc = make_shared<UnconditionalEdge>(callNode, succ->getSnk());
-        succ->getSnk()->removePredecessor(succ);
-        callNode->removeSuccessor(succ);
-        succ->getSnk()->addPredecessor(succ);
-        callNode->addSuccessor(newSucc);
-        graph.removeEdge(succ);
-        graph.addEdge(newSucc);
+        if (!live.contains(&BB))
+        {
+            continue;
+        }
+        // these instructions will be passed into a ControlBlock at the end
+        set<std::shared_ptr<Inst>, p_GNCompare> blockInstructions;
+        for (const auto &inst : BB)
+        {
+            auto newNode = getNode(&inst);
+            blockInstructions.insert(static_pointer_cast<Inst>(newNode));
+            for (const auto &use : inst.users())
+            {
+                // we have a user and we need to find a direct mapping between this instruction and that user
+                // in order for the mapping to be direct (ie directly inferrable from the input profile) the user instruction must be MARKOV_ORDER basic blocks or less away from this one
+                // right now we are not going to deal with this
+                if (const auto &user = dyn_cast<Instruction>(use))
+                {
+                    connect(newNode, getNode(user));
+                }
+            }
+            for (const auto &val : inst.operands())
+            {
+                // you can only communicate with globals via ld/st in LLVM IR
+                // thus, all we have to do is look at instruction operands to find their uses (ie an instruction cannot be used directly by a global)
+                if (isa<Instruction>(val) || isa<Argument>(val))
+                {
+                    connect(getNode(val), newNode);
+                }
+            }
+        }
+        local.blocks.push_back(pair(&BB, std::move(blockInstructions)));
     }
-    return callNode;
+    GraphNode::useNIDs(GraphNode::NO_NID);
 }
 
 void Cyclebite::Graph::BuildDFG( set<std::shared_ptr<ControlBlock>, p_GNCompare> &programFlow, 
@@ -1880,161 +2122,68 @@ void Cyclebite::Graph::BuildDFG( set<std::shared_ptr<ControlBlock>, p_GNCompare>
                                  const std::map<int64_t, const llvm::BasicBlock*>& IDToBlock)
 {
     // this section constructs the data flow of instructions (Cyclebite::Graph::Inst) and Cyclebite::Graph::ControlBlock
-    for (auto f = SourceBitcode->begin(); f != SourceBitcode->end(); f++)
+    // first each function builds its own data flow in parallel, then the functions are merged into the graph in module order and their calls are resolved
+    // every function gets a range of NIDs large enough for its instructions and arguments, so node IDs don't depend on the thread schedule
+    DNIDMap.reserve(IDToValue.empty() ? 0 : (uint64_t)IDToValue.rbegin()->first + 1);
+    vector<FunctionDFG> functions;
+    for (const auto &f : *SourceBitcode)
     {
-        for (auto bit = f->begin(); bit != f->end(); bit++)
+        if (f.empty())
         {
-            auto blockID = Cyclebite::Util::GetBlockID(cast<BasicBlock>(bit));
-            if ( !blockToNode.contains(blockID) )
-            {
-                //throw CyclebiteException("Cannot map a basic block to a ControlNode!");
-                spdlog::warn("Cannot map a basic block to a ControlNode!");
-                continue;
-            }
-            // these instructions will be passed into a ControlBlock at the end
-            set<std::shared_ptr<Inst>, p_GNCompare> blockInstructions;
-            for (auto it = bit->begin(); it != bit->end(); it++)
-            {
-                const auto inst = cast<Instruction>(it);
-                std::shared_ptr<Inst> newNode = nullptr;
-                if (DNIDMap.find(inst) == DNIDMap.end())
-                {
-                    newNode = make_shared<Inst>(inst);
-                    if( auto call = dyn_cast<CallBase>(inst) )
-                    {
-                        newNode = ConstructCallNode(graph, programFlow, newNode, call, dynamicCG, blockToNode, IDToBlock);
-                    }
-                    graph.addNode(newNode);
-                }
-                else
-                {
-                    newNode = static_pointer_cast<Inst>(DNIDMap[inst]);
-                    DNIDMap.erase(inst);
-                    if( auto call = llvm::dyn_cast<llvm::CallBase>(inst) )
-                    {
-                        graph.removeNode(newNode);
-                        newNode = ConstructCallNode(graph, programFlow, newNode, call, dynamicCG, blockToNode, IDToBlock);
-                        graph.addNode(newNode);
-                    }
-                }
-                DNIDMap.insert(pair<const llvm::Instruction*, const shared_ptr<Inst>>(inst, newNode));
-                blockInstructions.insert(newNode);
-                for (const auto& use : inst->users())
-                {
-                    if (const auto& user = dyn_cast<Instruction>(use))
-                    {
-                        shared_ptr<Inst> neighborNode = nullptr;
-                        if (DNIDMap.find(user) != DNIDMap.end())
-                        {
-                            neighborNode = static_pointer_cast<Inst>(DNIDMap[user]);
-                        }
-                        else
-                        {
-                            neighborNode = make_shared<Inst>(user);
-                            graph.addNode(neighborNode);
-                        }
-                        // we have a user and we need to find a direct mapping between this instruction and that user
-                        // in order for the mapping to be direct (ie directly inferrable from the input profile) the user instruction must be MARKOV_ORDER basic blocks or less away from this one
-                        // right now we are not going to deal with this
-                        auto newEdge = make_shared<UnconditionalEdge>(newNode, neighborNode);
-                        if (!graph.find(newEdge))
-                        {
-                            graph.addEdge(newEdge);
-                        }
-                        else
-                        {
-                            auto staleEdge = newEdge;
-                            newEdge = static_pointer_cast<UnconditionalEdge>(graph.getOriginalEdge(staleEdge));
-                        }
-                        newNode->addSuccessor(newEdge);
-                        neighborNode->addPredecessor(newEdge);
-                        DNIDMap.insert(pair<const llvm::Instruction*, const shared_ptr<Inst>>(user, neighborNode));
-                    }
-                }
-                for (const auto &val : inst->operands())
+            continue;
+        }
+        uint64_t values = f.arg_size();
+        for (const auto &BB : f)
+        {
+            values += BB.size();
+        }
+        functions.push_back(FunctionDFG{&f, GraphNode::reserveNIDs(values), {}, {}, {}, {}});
+    }
+    Cyclebite::Util::IDKinds kinds(*SourceBitcode);
+    atomic<size_t> nextFunction = 0;
+    auto work = [&]() {
+        for (auto i = nextFunction++; i < functions.size(); i = nextFunction++)
+        {
+            BuildFunctionDFG(functions[i], blockToNode, kinds);
+        }
+    };
+    vector<thread> workers;
+    auto threads = min((size_t)max(1u, thread::hardware_concurrency()), functions.size());
+    for (size_t t = 1; t < threads; t++)
+    {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto &w : workers)
+    {
+        w.join();
+    }
+
+    for (auto &local : functions)
+    {
+        for (const auto &node : local.nodes)
+        {
+            graph.addNode(node);
+        }
+        graph.addEdges(local.edges);
+        for (const auto &entry : local.unnumbered)
+        {
+            DNIDMap.insert(entry.first, entry.second);
+        }
+        for (auto &[BB, blockInstructions] : local.blocks)
+        {
+            // calls are resolved here because their destinations are ControlBlocks, which can belong to any function
+            for (const auto &inst : blockInstructions)
+            {
+                if (auto call = dynamic_pointer_cast<CallNode>(inst))
                 {
-                    if (const auto& predInst = dyn_cast<Instruction>(val))
-                    {
-                        std::shared_ptr<Inst> nodePred = nullptr;
-                        if (DNIDMap.find(predInst) != DNIDMap.end())
-                        {
-                            nodePred = static_pointer_cast<Inst>(DNIDMap[predInst]);
-                        }
-                        else
-                        {
-                            nodePred = make_shared<Inst>(predInst);
-                            DNIDMap.insert(pair<const llvm::Instruction*, const shared_ptr<Inst>>(predInst, nodePred));
-                            graph.addNode(nodePred);
-                        }
-                        auto newEdge = make_shared<UnconditionalEdge>(nodePred, newNode);
-                        if (!graph.find(newEdge))
-                        {
-                            graph.addEdge(newEdge);
-                        }
-                        else
-                        {
-                            auto staleEdge = newEdge;
-                            newEdge = static_pointer_cast<UnconditionalEdge>(graph.getOriginalEdge(staleEdge));
-                        }
-                        newNode->addPredecessor(newEdge);
-                        nodePred->addSuccessor(newEdge);
-                    }
-                    else if( const auto& arg = dyn_cast<Argument>(val) )
+                    for (const auto &dest : CallDestinations(programFlow, cast<CallBase>(call->getInst()), dynamicCG, blockToNode, IDToBlock))
                     {
-                        std::shared_ptr<DataValue> argNode = nullptr;
-                        if( DNIDMap.find(arg) != DNIDMap.end() )
-                        {
-                            argNode = DNIDMap.at(arg);
-                        }
-                        else
-                        {
-                            argNode = make_shared<DataValue>(arg);
-                            DNIDMap.insert(pair<const llvm::Value*, const shared_ptr<DataValue>>(arg, argNode));
-                            graph.addNode(argNode);
-                        }
-                        auto newEdge = make_shared<UnconditionalEdge>(argNode, newNode);
-                        if (!graph.find(newEdge))
-                        {
-                            graph.addEdge(newEdge);
-                        }
-                        else
-                        {
-                            auto staleEdge = newEdge;
-                            newEdge = static_pointer_cast<UnconditionalEdge>(graph.getOriginalEdge(staleEdge));
-                        }
-                        newNode->addPredecessor(newEdge);
-                        argNode->addSuccessor(newEdge);
+                        call->addDestination(dest);
                     }
-                    // you can only communicate with globals via ld/st in LLVM IR
-                    // thus, all we have to do is look at instruction operands to find their uses (ie an instruction cannot be used directly by a global)
-                    /*else if( const auto& glob = dyn_cast<GlobalValue>(val) )
-                    {
-                        std::shared_ptr<Global> globalNode = nullptr;
-                        if( DNIDMap.find(glob) != DNIDMap.end() )
-                        {
-                            globalNode = static_pointer_cast<Global>(DNIDMap.at(glob));
-                        }
-                        else
-                        {
-                            globalNode = make_shared<Global>(glob);
-                            DNIDMap.insert(pair<const llvm::GlobalValue*, const shared_ptr<Global>>(glob, globalNode));
-                            graph.addNode(globalNode);
-                        }
-                        auto newEdge = make_shared<UnconditionalEdge>(globalNode, newNode);
-                        if (!graph.find(newEdge))
-                        {
-                            graph.addEdge(newEdge);
-                        }
-                        else
-                        {
-                            auto staleEdge = newEdge;
-                            newEdge = static_pointer_cast<UnconditionalEdge>(graph.getOriginalEdge(staleEdge));
-                        }
-                        newNode->addPredecessor(newEdge);
-                        globalNode->addSuccessor(newEdge);
-                    }*/
                 }
             }
+            auto blockID = Cyclebite::Util::GetBlockID(BB);
             // there is a one-to-one mapping between llvm::BasicBlock and Cyclebite::Graph::ControlBlock
             shared_ptr<Cyclebite::Graph::ControlBlock> newBBsub = nullptr;
             if( programFlow.contains(blockToNode.at(blockID)) )
@@ -2056,8 +2205,7 @@ void Cyclebite::Graph::BuildDFG( set<std::shared_ptr<ControlBlock>, p_GNCompare>
                 inst->parent = newBBsub;
             }
             programFlow.insert(newBBsub);
-            BBCBMap.insert(pair<const llvm::BasicBlock*, const shared_ptr<ControlBlock>>(cast<BasicBlock>(bit), newBBsub));
-            blockInstructions.clear();
+            BBCBMap.insert(pair<const llvm::BasicBlock*, const shared_ptr<ControlBlock>>(BB, newBBsub));
         }
     }
 }
@@ -2190,16 +2338,23 @@ map<string, map<string, map<string, int>>> Cyclebite::Graph::ProfileKernels(cons
     return fin;
 }
 
-string Cyclebite::Graph::GenerateDot(const Graph &graph, bool original)
+string Cyclebite::Graph::GenerateDot(const Graph &graph, bool original, uint32_t markovOrder)
 {
-    string dotString = "digraph{\n";
+    ostringstream dotString;
+    GenerateDot(dotString, graph, original, markovOrder);
+    return dotString.str();
+}
+
+void Cyclebite::Graph::GenerateDot(std::ostream &dot, const Graph &graph, bool original, uint32_t markovOrder)
+{
+    dot << "digraph{\n";
     // label imaginary nodes and kernels
     int mappedKID = 0;
     for( const auto& node : graph.nodes() )
     {
         if( auto in = dynamic_pointer_cast<ImaginaryNode>(node) )
         {
-            dotString += "\t" + to_string(in->NID) + " [label=VOID];\n";
+            dot << "\t" + to_string(in->NID) + " [label=VOID];\n";
         }
         else if( auto mlc = dynamic_pointer_cast<MLCycle>(node) )
         {
@@ -2208,7 +2363,7 @@ string Cyclebite::Graph::GenerateDot(const Graph &graph, bool original)
             {
                 label = mlc->Label;
             }
-            dotString += "\t" + to_string(mlc->NID) + " [label=\"" + label + "\", color=blue];\n";
+            dot << "\t" + to_string(mlc->NID) + " [label=\"" + label + "\", color=blue];\n";
         }
     }
 
@@ -2244,7 +2399,7 @@ string Cyclebite::Graph::GenerateDot(const Graph &graph, bool original)
             {
                 origBlocks = "VOID";
             }
-            dotString += "\t" + to_string(node->NID) + " [label=\"" + origBlocks + "\"];\n";
+            dot << "\t" + to_string(node->NID) + " [label=\"" + origBlocks + "\"];\n";
         }
     }
     // now build out the nodes in the graph
@@ -2252,23 +2407,23 @@ string Cyclebite::Graph::GenerateDot(const Graph &graph, bool original)
     {
         if (auto call = dynamic_pointer_cast<CallEdge>(edge))
         {
-            dotString += "\t" + to_string(call->getSrc()->NID) + " -> " + to_string(call->getSnk()->NID) + " [style=dashed, color=red, label=\""+to_string(call->getFreq())+","+to_string_float(call->getWeight()) + "\"];\n";
+            dot << "\t" + to_string(call->getSrc()->NID) + " -> " + to_string(call->getSnk()->NID) + " [style=dashed, color=red, label=\""+to_string(call->getFreq())+","+to_string_float(call->getWeight()) + "\"];\n";
         }
         else if (auto ret = dynamic_pointer_cast<ReturnEdge>(edge))
         {
-            dotString += "\t" + to_string(ret->getSrc()->NID) + " -> " + to_string(ret->getSnk()->NID) + " [style=dashed, color=blue, label=\""+to_string(ret->getFreq())+","+to_string_float(ret->getWeight()) + "\"];\n";
+            dot << "\t" + to_string(ret->getSrc()->NID) + " -> " + to_string(ret->getSnk()->NID) + " [style=dashed, color=blue, label=\""+to_string(ret->getFreq())+","+to_string_float(ret->getWeight()) + "\"];\n";
         }
         else if (auto cond = dynamic_pointer_cast<ConditionalEdge>(edge))
         {
-            dotString += "\t" + to_string(cond->getSrc()->NID) + " -> " + to_string(cond->getSnk()->NID) + " [style=dotted, label=\""+to_string(cond->getFreq())+","+to_string_float(cond->getWeight()) + "\"];\n";
+            dot << "\t" + to_string(cond->getSrc()->NID) + " -> " + to_string(cond->getSnk()->NID) + " [style=dotted, label=\""+to_string(cond->getFreq())+","+to_string_float(cond->getWeight()) + "\"];\n";
         }
         else if( auto ie = dynamic_pointer_cast<ImaginaryEdge>(edge) )
         {
-            dotString += "\t" + to_string(ie->getSrc()->NID) + " -> " + to_string(ie->getSnk()->NID) + " [label=Imaginary];\n";
+            dot << "\t" + to_string(ie->getSrc()->NID) + " -> " + to_string(ie->getSnk()->NID) + " [label=Imaginary];\n";
         }
         else if( auto ue = dynamic_pointer_cast<UnconditionalEdge>(edge) )
         {
-            dotString += "\t" + to_string(ue->getSrc()->NID) + " -> " + to_string(ue->getSnk()->NID) + " [label=\""+to_string(ue->getFreq())+","+to_string_float(1.0f)+"\"];\n";
+            dot << "\t" + to_string(ue->getSrc()->NID) + " -> " + to_string(ue->getSnk()->NID) + " [label=\""+to_string(ue->getFreq())+","+to_string_float(1.0f)+"\"];\n";
         }
         else
         {
@@ -2285,18 +2440,17 @@ string Cyclebite::Graph::GenerateDot(const Graph &graph, bool original)
             {
                 for (const auto &c : Q.front()->getChildKernels())
                 {
-                    dotString += "\t" + to_string(c->NID) + " -> " + to_string(Q.front()->NID) + " [style=dashed];\n";
+                    dot << "\t" + to_string(c->NID) + " -> " + to_string(Q.front()->NID) + " [style=dashed];\n";
                     Q.push_back(c.get());
                 }
                 Q.pop_front();
             }
         }
     }
-    dotString += "}";
-    return dotString;
+    dot << "}";
 }
 
-string Cyclebite::Graph::GenerateCoverageDot(const set<std::shared_ptr<ControlNode>, p_GNCompare> &coveredNodes, const set<std::shared_ptr<ControlNode>, p_GNCompare> &uncoveredNodes)
+string Cyclebite::Graph::GenerateCoverageDot(const set<std::shared_ptr<ControlNode>, p_GNCompare> &coveredNodes, const set<std::shared_ptr<ControlNode>, p_GNCompare> &uncoveredNodes, uint32_t markovOrder)
 {
     string dotString = "digraph{\n";
     // label nodes based on their original blocks and color them based on whether they are covered or uncovered
@@ -2437,51 +2591,14 @@ string Cyclebite::Graph::GenerateTransformedSegmentedDot(const set<std::shared_p
 
 double Cyclebite::Graph::EntropyCalculation(const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &nodes)
 {
-    /// Ben 5/17/22 This is wrong and needs to be refactored
-    /// To calculate the stationary distribution correctly, we need to solve the following equation for x
-    /// x = xP
-    /// where
-    /// x is a vector of stationary distributions for each node in the graph
-    /// P is the normalized transition table of the graph (each column sums to 1)
-    // first, calculate the stationary distribution for each existing node
-    // stationary distribution is the probability that I am in a certain state at any given time (it's an asymptotic measure)
-    vector<double> stationaryDistribution(nodes.size(), 0.0);
-    for (unsigned int i = 0; i < nodes.size(); i++)
-    {
-        auto it = nodes.begin();
-        advance(it, i);
-        // we sum along the columns (the probabilities of going to the current node), so we use the edge weight coming from each predecessor to this node
-        for (const auto &pred : (*it)->getPredecessors())
-        {
-            // retrieve the edge probability and accumulate it to this node
-            stationaryDistribution[i] += (double)pred->getFreq();
-        }
-    }
-    // normalize each stationaryDistribution entry by the total edge weights in the state transition matrix
-    double totalEdgeWeights = 0.0;
-    for (const auto &node : nodes)
-    {
-        for (const auto &nei : node->getSuccessors())
-        {
-            totalEdgeWeights += (double)nei->getFreq();
-        }
-    }
-    for (auto &entry : stationaryDistribution)
-    {
-        entry /= totalEdgeWeights;
-    }
-    // second, calculate the average entropy of each node (the entropy rate)
-    double entropyRate = 0.0;
-    for (unsigned int i = 0; i < stationaryDistribution.size(); i++)
-    {
-        auto it = nodes.begin();
-        advance(it, i);
-        for (const auto &nei : (*it)->getSuccessors())
-        {
-            entropyRate -= stationaryDistribution[i] * nei->getWeight() * log2(nei->getWeight());
-        }
-    }
-    return entropyRate;
+    StationaryDistribution stationary;
+    return EntropyCalculation(nodes, stationary);
+}
+
+double Cyclebite::Graph::EntropyCalculation(const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &nodes, StationaryDistribution &stationary)
+{
+    // the entropy rate is the average entropy of each node, weighted by the stationary distribution x = xP of the graph
+    return stationary.solve(nodes);
 }
 
 double Cyclebite::Graph::TotalEntropy(const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &nodes)
@@ -2499,223 +2616,18 @@ double Cyclebite::Graph::TotalEntropy(const std::set<std::shared_ptr<ControlNode
 
 using json = nlohmann::json;
 
-/// @brief Used to find the underlying edge that occurs before or after the 
-const shared_ptr<UnconditionalEdge> FindUnderlyingEdge(const shared_ptr<GraphNode>& node, bool entrance)
-{
-    deque<shared_ptr<GraphNode>> Q;
-    set<shared_ptr<ControlNode>, p_GNCompare> underlying;
-    Q.push_front(node);
-    while( !Q.empty() )
-    {
-        if( auto vn = dynamic_pointer_cast<VirtualNode>(Q.front()) )
-        {
-            for( const auto& n : vn->getSubgraph() )
-            {
-                Q.push_back(n);
-            }
-        }
-        else if( auto cn = dynamic_pointer_cast<ControlNode>(Q.front()) )
-        {
-            underlying.insert(cn);
-        }
-    }
-    set<shared_ptr<UnconditionalEdge>, GECompare> underlying_e;
-    for( const auto& n : underlying )
-    {
-        for( const auto& pred : n->getPredecessors() )
-        {
-            if( underlying.find(pred->getSrc()) != underlying.end() )
-            {
-                underlying_e.insert(pred);
-            }
-        }
-        for( const auto& succ : n->getSuccessors() )
-        {
-            if( underlying.find(succ->getSnk()) != underlying.end() )
-            {
-                underlying_e.insert(succ);
-            }
-        }
-    }
-    if( entrance )
-    {
-        // we want the edge that comes out of the first node
-        shared_ptr<ControlNode> first = nullptr;
-        for( const auto& node : underlying ) 
-        {
-            bool outside = true;
-            for( const auto& pred : node->getPredecessors() )
-            {
-                if( underlying.find(pred->getSrc()) != underlying.end() )
-                {
-                    outside = false;
-                    break;
-                }
-            }
-            if( outside )
-            {
-                first = node;
-                break;
-            }
-        }
-        if( first )
-        {
-            if( first->getSuccessors().size() != 1 )
-            {
-                throw CyclebiteException("Cannot handle the case where an underlying entrance has more than one successor!");
-            }
-            else
-            {
-                return *first->getSuccessors().begin();
-            }
-        }
-        else
-        {
-            throw CyclebiteException("No beginning node could be found for subgraph!");
-        }
-    }
-    else
-    {
-        // we want the edge that precedes the last node in the graph
-        shared_ptr<ControlNode> last = nullptr;
-        for( const auto& node : underlying )
-        {
-            bool outside = true;
-            for( const auto& succ : node->getSuccessors() )
-            {
-                if( underlying.find( succ->getSnk()) != underlying.end() )
-                {
-                    outside = false;
-                    break;
-                }
-            }
-            if( outside )
-            {
-                last = node;
-                break;
-            }
-        }
-        if( last )
-        {
-            if( last->getPredecessors().size() != 1 )
-            {
-                throw CyclebiteException("Cannot handle the case where an underlying exit has more than one predecessor!");
-            }
-            else
-            {
-                return *last->getPredecessors().begin();
-            }
-        }
-        else
-        {
-            throw CyclebiteException("No ending node could be found for subgraph!");
-        }
-    }
-}
-
 set<pair<int64_t, int64_t>> Cyclebite::Graph::findOriginalBlockIDs(const shared_ptr<UnconditionalEdge>& edge)
 {
-    struct EdgeSort
-    {
-        // the following operator implements a "less than" operator ie lhs < rhs
-        bool operator()(const shared_ptr<UnconditionalEdge>& lhs, const shared_ptr<UnconditionalEdge>& rhs) const
-        {
-            if( lhs->getSnk() == rhs->getSrc() )
-            {
-                // lhs is "less than" rhs because lhs comes before rhs in the graph
-                return true;
-            }
-            else if( lhs->getSrc() == rhs->getSnk() )
-            {
-                // lhs is "greater than" rhs because lhs comes after rhs in the graph
-                return false;
-            }
-            else if( lhs->getSrc() == rhs->getSrc() )
-            {
-                // on a match with one node we compare the other side
-                // thus if two edges have matching sources but different sinks, they are put in a random order
-                // and, if two edges have the same src and snk, they will match in either case
-                return lhs->getSnk()->NID < rhs->getSnk()->NID;
-            }
-            else if( lhs->getSnk() == rhs->getSnk() )
-            {
-                return lhs->getSrc()->NID < rhs->getSrc()->NID;
-            }
-            else
-            {
-                // when there is no overlap at all between two edges, we simply sort by their pointer
-                return lhs.get() < rhs.get();
-            }
-        }
-    };
-    set<pair<int64_t, int64_t>> eEdges;
-    deque<shared_ptr<UnconditionalEdge>> Q;
-    Q.push_front(edge);
+    BlockIDIndex index;
     try
     {
-        while (!Q.empty())
-        {
-            if (auto ve = dynamic_pointer_cast<VirtualEdge>(Q.front()))
-            {
-                if( ve->getEdges().size() == 1 )
-                {
-                    Q.push_back(*ve->getEdges().begin());
-                }
-                else if( ve->getEdges().empty() )
-                {
-                    throw CyclebiteException("Virtual edge has no underlying edges!");
-                }
-                else
-                {
-                    for( const auto& e : ve->getEdges() )
-                    {
-                        Q.push_back(e);
-                    }
-                }
-            }
-            else if( auto ie = dynamic_pointer_cast<ImaginaryEdge>(Q.front()) )
-            {
-                // we have hit the start or end of the program
-                // if it is the start of the program we want to return the edge that comes after us
-                // if we are at the end we want to return the edge that comes right before
-                if( ie->isEntrance() )
-                {
-                    // finding an imaginary edge reveals that we actually started on the wrong edge
-                    // so we are going to basically start the algorithm over by pushing the edge that comes immediately after the snk node
-                    Q.push_back(FindUnderlyingEdge(ie->getSnk(), true));
-                }
-                else
-                {
-                    Q.push_back(FindUnderlyingEdge(ie->getSrc(), false));
-                }
-            }
-            else
-            {
-                // we have found the original edge, its src node should have the originalBlock it was constructed for
-                if (!Q.front()->getWeightedSrc()->originalBlocks.empty() && !Q.front()->getWeightedSnk()->originalBlocks.empty())
-                {
-                    auto srcBlock = Q.front()->getWeightedSrc()->originalBlocks.back();
-                    auto snkBlock = Q.front()->getWeightedSnk()->originalBlocks.back();
-                    eEdges.insert( pair(srcBlock, snkBlock) );
-                }
-                else
-                {
-                    throw CyclebiteException("Rock bottom nodes did not contain  original blocks!");
-                }
-            }
-            Q.pop_front();
-        }
-        if (eEdges.empty())
-        {
-            throw CyclebiteException("Could not map graph edge to src,snk pair!");
-        }
+        return index.getEdgeBlocks(edge);
     }
     catch( CyclebiteException& e )
     {
         spdlog::critical(e.what());
         exit(EXIT_FAILURE);
     }
-    return eEdges;
 }
 
 set<int64_t> findOriginalBlockIDs(const shared_ptr<ControlNode>& ent)
@@ -2764,85 +2676,29 @@ set<int64_t> findOriginalBlockIDs(const shared_ptr<ControlNode>& ent)
 
 void Cyclebite::Graph::WriteKernelFile(const ControlGraph &graph, const set<std::shared_ptr<MLCycle>, KCompare> &kernels, const map<int64_t, const llvm::BasicBlock *> &IDToBlock, const map<int64_t, std::vector<int64_t>> &blockCallers, const EntropyInfo &info, const string &OutputFileName, bool hotCode)
 {
-    // write kernel file
-    json outputJson;
-    // valid blocks and block callers sections provide tik with necessary info about the CFG
-    outputJson["ValidBlocks"] = std::vector<int64_t>();
-    for (const auto &id : IDToBlock)
-    {
-        outputJson["ValidBlocks"].push_back(id.first);
-    }
-    for (const auto &bid : blockCallers)
-    {
-        outputJson["BlockCallers"][to_string(bid.first)] = bid.second;
-    }
-    // Entropy information
-    outputJson["Entropy"] = map<string, map<string, uint64_t>>();
-    outputJson["Entropy"]["Start"]["Entropy Rate"] = info.start_entropy_rate;
-    outputJson["Entropy"]["Start"]["Total Entropy"] = info.start_total_entropy;
-    outputJson["Entropy"]["Start"]["Nodes"] = info.start_node_count;
-    outputJson["Entropy"]["Start"]["Edges"] = info.start_edge_count;
-    outputJson["Entropy"]["End"]["Entropy Rate"] = info.end_entropy_rate;
-    outputJson["Entropy"]["End"]["Total Entropy"] = info.end_total_entropy;
-    outputJson["Entropy"]["End"]["Nodes"] = info.end_node_count;
-    outputJson["Entropy"]["End"]["Edges"] = info.end_edge_count;
+    BlockIDIndex index;
+    WriteKernelFile(graph, kernels, IDToBlock, blockCallers, info, OutputFileName, hotCode, index);
+}
 
+/// @brief Writes the kernel file for a set of kernels
+///
+/// Everything that needs the whole kernel set (hierarchy, dominators, non-kernel code) is computed first, then the document is streamed to the file in one pass
+/// @param index Flattens the entrances and exits of the kernels to profile block IDs. Share one index between all kernel files written for the same graph
+void Cyclebite::Graph::WriteKernelFile(const ControlGraph &graph, const set<std::shared_ptr<MLCycle>, KCompare> &kernels, const map<int64_t, const llvm::BasicBlock *> &IDToBlock, const map<int64_t, std::vector<int64_t>> &blockCallers, const EntropyInfo &info, const string &OutputFileName, bool hotCode, BlockIDIndex &index)
+{
     // sequential ID for each kernel and a map from KID to sequential ID
-    uint32_t id = 0;
     map<uint32_t, uint32_t> SIDMap;
-    // average nodes per kernel
-    float totalNodes = 0.0;
-    // average blocks per kernel
-    float totalBlocks = 0.0;
     for (const auto &kernel : kernels)
     {
-        totalNodes += (float)kernel->getSubgraph().size();
-        totalBlocks += (float)kernel->blocks.size();
-        for (const auto &n : kernel->getSubgraph())
-        {
-            outputJson["Kernels"][to_string(id)]["Nodes"].push_back(n->NID);
-        }
-        for (const auto &k : kernel->blocks)
-        {
-            outputJson["Kernels"][to_string(id)]["Blocks"].push_back(k);
-        }
-        outputJson["Kernels"][to_string(id)]["Labels"] = std::vector<string>();
-        outputJson["Kernels"][to_string(id)]["Labels"].push_back(kernel->Label);
-        // entrances and exits
-        for (const auto &e : kernel->getEntrances())
-        {
-            // we need to figure out which blocks are on the border of this entrance edge
-            auto entrances = findOriginalBlockIDs(e);
-            for( const auto& ent : entrances )
-            {
-                outputJson["Kernels"][to_string(id)]["Entrances"][to_string(ent.first)].push_back(to_string(ent.second));
-            }
-        }
-        for (const auto &e : kernel->getExits())
-        {
-            // we need to figure out which blocks are on the border of this entrance edge
-            auto exits = findOriginalBlockIDs(e);
-            for( const auto& ex : exits )
-            {
-                outputJson["Kernels"][to_string(id)]["Exits"][to_string(ex.first)].push_back(to_string(ex.second));
-            }
-        }
-        SIDMap[kernel->KID] = id;
-        id++;
-    }
-    // now assign hierarchy to each kernel
-    for (const auto &kern : kernels)
-    {
-        outputJson["Kernels"][to_string(SIDMap[kern->KID])]["Children"] = vector<uint32_t>();
-        outputJson["Kernels"][to_string(SIDMap[kern->KID])]["Parents"] = vector<uint32_t>();
+        SIDMap[kernel->KID] = (uint32_t)SIDMap.size();
     }
     // fill in parent category for children while we're filling in the children
+    map<uint32_t, vector<uint32_t>> parents;
     for (const auto &kern : kernels)
     {
         for (const auto &child : kern->getChildKernels())
         {
-            outputJson["Kernels"][to_string(SIDMap[kern->KID])]["Children"].push_back(SIDMap[child->KID]);
-            outputJson["Kernels"][to_string(SIDMap[child->KID])]["Parents"].push_back(SIDMap[kern->KID]);
+            parents[SIDMap[child->KID]].push_back(SIDMap[kern->KID]);
         }
     }
     // introspect non-kernel code, and make a set of non-kernel blocks
@@ -2859,7 +2715,6 @@ void Cyclebite::Graph::WriteKernelFile(const ControlGraph &graph, const set<std:
             // get the blocks of this virtual node and add them to the nonkernel block set
             deque<shared_ptr<VirtualNode>> Q;
             Q.push_front(vn);
-            shared_ptr<ControlNode> re = static_pointer_cast<ControlNode>(node);
             while (!Q.empty())
             {
                 for (const auto &sub : Q.front()->getSubgraph())
@@ -2885,8 +2740,7 @@ void Cyclebite::Graph::WriteKernelFile(const ControlGraph &graph, const set<std:
             nonKernelBlocks.insert(cn->blocks.begin(), cn->blocks.end());
         }
     }
-    outputJson["NonKernelBlocks"] = nonKernelBlocks;
-
+    map<uint32_t, set<uint32_t>> kernelDominators;
     if( !hotCode )
     {
         // build the dominator tree for kernels
@@ -2940,174 +2794,151 @@ void Cyclebite::Graph::WriteKernelFile(const ControlGraph &graph, const set<std:
 
         for( const auto& kern : dominators )
         {
-            set<uint32_t> doms;
             for( const auto& dom : kern.second )
             {
-                doms.insert(SIDMap.at(dom->KID));
+                kernelDominators[SIDMap.at(kern.first->KID)].insert(SIDMap.at(dom->KID));
             }
-            outputJson["Kernels"][to_string(SIDMap.at(kern.first->KID))]["Dominators"] = doms;
         }
-        /*
-        // for each kernel, find its dominating kernels
-        // a dominating kernel is a kernel that must execute before the target kernel
-        for( const auto& kern : kernels )
+    }
+
+    // average nodes per kernel
+    float totalNodes = 0.0;
+    // average blocks per kernel
+    float totalBlocks = 0.0;
+    ofstream oStream(OutputFileName);
+    Cyclebite::Util::JsonStreamWriter writer(oStream);
+    writer.beginObject();
+    // valid blocks and block callers sections provide tik with necessary info about the CFG
+    writer.key("ValidBlocks");
+    writer.beginArray();
+    for (const auto &id : IDToBlock)
+    {
+        writer.value(id.first);
+    }
+    writer.endArray();
+    if (!blockCallers.empty())
+    {
+        writer.key("BlockCallers");
+        writer.beginObject();
+        for (const auto &bid : blockCallers)
+        {
+            writer.key(to_string(bid.first));
+            writer.array(bid.second);
+        }
+        writer.endObject();
+    }
+    // Entropy information
+    writer.key("Entropy");
+    writer.beginObject();
+    writer.key("Start");
+    writer.beginObject();
+    writer.field("Entropy Rate", info.start_entropy_rate);
+    writer.field("Total Entropy", info.start_total_entropy);
+    writer.field("Nodes", info.start_node_count);
+    writer.field("Edges", info.start_edge_count);
+    writer.endObject();
+    writer.key("End");
+    writer.beginObject();
+    writer.field("Entropy Rate", info.end_entropy_rate);
+    writer.field("Total Entropy", info.end_total_entropy);
+    writer.field("Nodes", info.end_node_count);
+    writer.field("Edges", info.end_edge_count);
+    writer.endObject();
+    writer.endObject();
+
+    // entrances and exits are objects keyed by source block, each source maps to its sink blocks
+    auto writeBorders = [&](const string &name, const map<int64_t, vector<string>> &borders) {
+        if (borders.empty())
+        {
+            return;
+        }
+        writer.key(name);
+        writer.beginObject();
+        for (const auto &border : borders)
         {
-            for( const auto& domKern : kernels )
+            writer.key(to_string(border.first));
+            writer.array(border.second);
+        }
+        writer.endObject();
+    };
+    writer.key("Kernels");
+    writer.beginObject();
+    try
+    {
+        for (const auto &kernel : kernels)
+        {
+            auto id = SIDMap[kernel->KID];
+            totalNodes += (float)kernel->getSubgraph().size();
+            totalBlocks += (float)kernel->blocks.size();
+            writer.key(to_string(id));
+            writer.beginObject();
+            writer.key("Nodes");
+            writer.beginArray();
+            for (const auto &n : kernel->getSubgraph())
             {
-                if( kern == domKern )
-                {
-                    continue;
-                }
-                // look at the exit block of this kernel and figure out if it dominates the entrance block of this kernel
-                for( const auto& ex : domKern->getExits() )
-                {
-                    auto exitBlock = NodeToBlock(ex->getWeightedSnk(), IDToBlock);
-                    for( const auto& ent : kern->getEntrances() )
-                    {
-                        auto entBlock = NodeToBlock(ent->getWeightedSnk(), IDToBlock);
-                        // now we have to see if the exitblock of the dominator kernel dominates the entrance block of the current kernel in question
-                        // first find their closest common ancestor in the callgraph of the program
-                        // second, find the basic blocks in which their function calls exist
-                        // third, run the dominator thing on them
-                    }
-                }
+                writer.value(n->NID);
             }
-            // this set contains all blocks that are not part of kernels and predicate this kernel
-            set<int64_t> predicateBlocks;
-            // now walk back from this parent kernel until we find a block that is not a non-kernel block
-            deque<shared_ptr<ControlNode>> Q;
-            set<shared_ptr<ControlNode>, p_GNCompare> covered;
-            covered.insert(kern->getSubgraph().begin(), kern->getSubgraph().end());
-            for( const auto& ent : kern->getEntrances() )
+            writer.endArray();
+            writer.key("Blocks");
+            writer.array(kernel->blocks);
+            writer.field("Labels", vector<string>{kernel->Label});
+            // entrances and exits
+            // we need to figure out which blocks are on the border of each entrance and exit edge
+            map<int64_t, vector<string>> entrances;
+            for (const auto &e : kernel->getEntrances())
             {
-                if( dynamic_pointer_cast<MLCycle>(ent->getWeightedSrc()) == nullptr )
-                {
-                    if( covered.find(ent->getWeightedSrc()) == covered.end() )
-                    {
-                        Q.push_back(ent->getWeightedSrc());
-                        covered.insert(ent->getWeightedSrc());
-                    }
-                }
-                while( !Q.empty() )
+                for (const auto &ent : index.getEdgeBlocks(e))
                 {
-                    auto blocks = findOriginalBlockIDs(Q.front());
-                    predicateBlocks.insert(blocks.begin(), blocks.end());
-                    for( const auto& pred : Q.front()->getPredecessors() )
-                    {
-                        if( dynamic_pointer_cast<MLCycle>(pred->getSrc()) == nullptr )
-                        {
-                            if( covered.find(pred->getWeightedSrc()) == covered.end() )
-                            {
-                                Q.push_back(pred->getWeightedSrc());
-                                covered.insert(pred->getWeightedSrc());
-                            }
-                        }
-                    }
-                    for( const auto& succ : Q.front()->getSuccessors() )
-                    {
-                        if( dynamic_pointer_cast<MLCycle>(succ->getSnk()) == nullptr )
-                        {
-                            if( covered.find(succ->getWeightedSnk()) == covered.end() )
-                            {
-                                Q.push_back(succ->getWeightedSnk());
-                                covered.insert(succ->getWeightedSnk());
-                            }
-                        }
-                    }
-                    Q.pop_front();
+                    entrances[ent.first].push_back(to_string(ent.second));
                 }
             }
-            outputJson["Kernels"][to_string(SIDMap.at(kern->KID))]["PredicateBlocks"] = predicateBlocks;
-            // now find successorBlocks
-            // a successor block is a block that cannot reach back to this kernel ie when it has executed we know this kernel cannot possibly be live
-            set<int64_t> successorBlocks;
-            Q.clear();
-            covered.clear();
-            covered.insert(kern->getSubgraph().begin(), kern->getSubgraph().end());
-            for( const auto& ex : kern->getExits() )
+            map<int64_t, vector<string>> exits;
+            for (const auto &e : kernel->getExits())
             {
-                if( dynamic_pointer_cast<MLCycle>(ex->getWeightedSnk()) == nullptr )
+                for (const auto &ex : index.getEdgeBlocks(e))
                 {
-                    if( covered.find(ex->getWeightedSnk()) == covered.end() )
-                    {
-                        Q.push_back(ex->getWeightedSnk());
-                        covered.insert(ex->getWeightedSnk());
-                    }
-                }
-                while( !Q.empty() )
-                {
-                    // do dijkstras between the current node and each entrance
-                    bool cycleFound = false;
-                    for( auto ent : kern->getEntrances() )
-                    {
-                        auto cycle = Cyclebite::Graph::Dijkstras(graph, Q.front()->NID, ent->getSnk()->NID);
-                        if( !cycle.empty() )
-                        {
-                            cycleFound = true;
-                            break;
-                        }
-                    }
-                    if( !cycleFound )
-                    {
-                        auto blocks = findOriginalBlockIDs(Q.front());
-                        successorBlocks.insert(blocks.begin(), blocks.end());
-                    }
-                    for( const auto& pred : Q.front()->getPredecessors() )
-                    {
-                        if( dynamic_pointer_cast<MLCycle>(pred->getSrc()) == nullptr )
-                        {
-                            if( covered.find(pred->getWeightedSrc()) == covered.end() )
-                            {
-                                Q.push_back(pred->getWeightedSrc());
-                                covered.insert(pred->getWeightedSrc());
-                            }
-                        }
-                    }
-                    for( const auto& succ : Q.front()->getSuccessors() )
-                    {
-                        if( dynamic_pointer_cast<MLCycle>(succ->getSnk()) == nullptr )
-                        {
-                            if( covered.find(succ->getWeightedSnk()) == covered.end() )
-                            {
-                                Q.push_back(succ->getWeightedSnk());
-                                covered.insert(succ->getWeightedSnk());
-                            }
-                        }
-                    }
-                    Q.pop_front();
+                    exits[ex.first].push_back(to_string(ex.second));
                 }
             }
-            outputJson["Kernels"][to_string(SIDMap.at(kern->KID))]["SuccessorBlocks"] = successorBlocks;
-        }*/
+            writeBorders("Entrances", entrances);
+            writeBorders("Exits", exits);
+            // now assign hierarchy to each kernel
+            writer.key("Children");
+            writer.beginArray();
+            for (const auto &child : kernel->getChildKernels())
+            {
+                writer.value(SIDMap[child->KID]);
+            }
+            writer.endArray();
+            writer.key("Parents");
+            writer.array(parents[id]);
+            if (!hotCode)
+            {
+                writer.key("Dominators");
+                writer.array(kernelDominators[id]);
+            }
+            writer.endObject();
+        }
     }
-
-    if (!kernels.empty())
+    catch (CyclebiteException &e)
     {
-        outputJson["Average Kernel Size (Nodes)"] = float(totalNodes / (float)kernels.size());
-        outputJson["Average Kernel Size (Blocks)"] = float(totalBlocks / (float)kernels.size());
+        spdlog::critical(e.what());
+        exit(EXIT_FAILURE);
     }
-    else
+    writer.endObject();
+    writer.key("NonKernelBlocks");
+    writer.array(nonKernelBlocks);
+    if (!kernels.empty())
     {
-        outputJson["Average Kernel Size (Nodes)"] = 0.0;
-        outputJson["Average Kernel Size (Blocks)"] = 0.0;
+        writer.field("Average Kernel Size (Nodes)", float(totalNodes / (float)kernels.size()));
+        writer.field("Average Kernel Size (Blocks)", float(totalBlocks / (float)kernels.size()));
     }
-
-    // performance intrinsics
-    map<string, set<int64_t>> kernelBlockSets;
-    for (const auto &kernel : outputJson["Kernels"].items())
+    else
     {
-        if (outputJson["Kernels"].find(kernel.key()) != outputJson["Kernels"].end())
-        {
-            if (outputJson["Kernels"][kernel.key()].find("Blocks") != outputJson["Kernels"][kernel.key()].end())
-            {
-                auto blockSet = outputJson["Kernels"][kernel.key()]["Blocks"].get<set<int64_t>>();
-                kernelBlockSets[kernel.key()] = blockSet;
-            }
-        }
+        writer.field("Average Kernel Size (Nodes)", 0.0);
+        writer.field("Average Kernel Size (Blocks)", 0.0);
     }
-
-    ofstream oStream(OutputFileName);
-    oStream << setw(4) << outputJson;
+    writer.endObject();
     oStream.close();
 }
 
@@ -3190,7 +3021,7 @@ ControlGraph Cyclebite::Graph::GenerateStaticCFG(llvm::Module *M)
     return staticGraph;
 }
 
-void Cyclebite::Graph::GenerateDynamicCoverage(const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &dynamicNodes, const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &staticNodes)
+void Cyclebite::Graph::GenerateDynamicCoverage(const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &dynamicNodes, const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &staticNodes, uint32_t markovOrder)
 {
     // we need a static to dynamic node mapping
     map<std::shared_ptr<ControlNode>, set<std::shared_ptr<ControlNode>, p_GNCompare>> StaticToDynamic;
@@ -3224,7 +3055,7 @@ void Cyclebite::Graph::GenerateDynamicCoverage(const std::set<std::shared_ptr<Co
             uncovered.insert(node.first);
         }
     }
-    auto dot = GenerateCoverageDot(covered, uncovered);
+    auto dot = GenerateCoverageDot(covered, uncovered, markovOrder);
     ofstream dotStream("DynamicCoverage.dot");
     dotStream << dot << "\n";
     dotStream.close();
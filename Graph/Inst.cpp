@@ -10,7 +10,6 @@ using namespace Cyclebite::Graph;
 Inst::Inst(const llvm::Instruction* inst, DNC t) : DataValue(inst), inst(inst), type(t)
 {
     op = GetOp(inst->getOpcode());
-    initOpToString();
 }
 
 const llvm::Instruction* Inst::getInst() const
@@ -11,7 +11,7 @@
 using namespace std;
 using namespace Cyclebite::Graph;
 
-uint32_t MLCycle::nextKID = 0;
+std::atomic<uint32_t> MLCycle::nextKID = 0;
 
 MLCycle::MLCycle()
 {
@@ -24,7 +24,7 @@ MLCycle::MLCycle()
 bool MLCycle::addNode(const std::shared_ptr<ControlNode> &newNode)
 {
     auto i = subgraph.insert(newNode);
-    blocks.insert(newNode->blocks.begin(), newNode->blocks.end());
+    blocks |= newNode->blocks;
     if (auto ML = dynamic_pointer_cast<MLCycle>(newNode))
     {
         childKernels.insert(ML);
@@ -81,12 +81,18 @@ void MLCycle::addNodes(const std::set<std::shared_ptr<ControlNode>, p_GNCompare>
     blocks.clear();
     for (const auto &node : subgraph)
     {
-        blocks.insert(node->blocks.begin(), node->blocks.end());
+        blocks |= node->blocks;
     }
-    set<int64_t> setDiff;
+    Cyclebite::Util::BlockSet setDiff;
     for (auto &child : childKernels)
     {
-        set_difference(blocks.begin(), blocks.end(), child->blocks.begin(), child->blocks.end(), std::inserter(setDiff, setDiff.begin()));
+        for (const auto &b : blocks)
+        {
+            if (!child->blocks.contains(b))
+            {
+                setDiff.insert(b);
+            }
+        }
         blocks = setDiff;
     }
 }
@@ -0,0 +1,179 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "MarkovProfile.h"
+#include "Util/Exceptions.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace Cyclebite::Graph;
+using namespace std;
+
+/// Number of words in the profile header: markov order, block count, edge count
+constexpr size_t PROFILE_HEADER_WORDS = 3;
+
+MarkovProfile::MarkovProfile(const string &filename)
+{
+    int fd = open(filename.data(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw CyclebiteException("Could not open input profile " + filename);
+    }
+    struct stat st;
+    if (fstat(fd, &st) || ((size_t)st.st_size < PROFILE_HEADER_WORDS * sizeof(uint32_t)))
+    {
+        close(fd);
+        throw CyclebiteException("Input profile " + filename + " is too small to contain a header!");
+    }
+    length = (size_t)st.st_size;
+    auto map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping holds its own reference to the file
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        throw CyclebiteException("Could not memory-map input profile " + filename);
+    }
+    // the edge array is consumed front to back exactly once
+    madvise(map, length, MADV_SEQUENTIAL);
+    base = (const uint8_t *)map;
+    mapped = true;
+    try
+    {
+        parseHeader(filename);
+    }
+    catch (...)
+    {
+        munmap(map, length);
+        throw;
+    }
+}
+
+MarkovProfile::MarkovProfile(const uint8_t *data, size_t length) : base(data), length(length), mapped(false)
+{
+    if (length < PROFILE_HEADER_WORDS * sizeof(uint32_t))
+    {
+        throw CyclebiteException("Input profile is too small to contain a header!");
+    }
+    parseHeader("section");
+}
+
+void MarkovProfile::parseHeader(const string &name)
+{
+    // first word is the markov order, second is the number of blocks in the program, third is the number of edges in the file
+    auto header = (const uint32_t *)base;
+    markovOrder = header[0];
+    blockCount = header[1];
+    edgeCount = header[2];
+    if (markovOrder == 0)
+    {
+        throw CyclebiteException("Input profile " + name + " has markov order 0!");
+    }
+    recordSize = ((size_t)markovOrder + 1) * sizeof(uint32_t) + sizeof(uint64_t);
+    if ((length - PROFILE_HEADER_WORDS * sizeof(uint32_t)) / recordSize < (size_t)edgeCount)
+    {
+        throw CyclebiteException("Input profile " + name + " is truncated: header promises " + to_string(edgeCount) + " edges");
+    }
+    records = base + PROFILE_HEADER_WORDS * sizeof(uint32_t);
+}
+
+MarkovProfile::~MarkovProfile()
+{
+    if (mapped)
+    {
+        munmap((void *)base, length);
+    }
+}
+
+uint32_t MarkovProfile::getMarkovOrder() const
+{
+    return markovOrder;
+}
+
+uint32_t MarkovProfile::getBlockCount() const
+{
+    return blockCount;
+}
+
+uint32_t MarkovProfile::getEdgeCount() const
+{
+    return edgeCount;
+}
+
+const ProfileEdge *MarkovProfile::begin() const
+{
+    if (markovOrder != 1)
+    {
+        throw CyclebiteException("Profile has markov order " + to_string(markovOrder) + ", only markov order 1 profiles have an edge array!");
+    }
+    return (const ProfileEdge *)records;
+}
+
+const ProfileEdge *MarkovProfile::end() const
+{
+    return begin() + edgeCount;
+}
+
+const ProfileEdge &MarkovProfile::operator[](uint32_t i) const
+{
+    return ((const ProfileEdge *)records)[i];
+}
+
+span<const uint32_t> MarkovProfile::getBlocks(uint32_t i) const
+{
+    // the header and every record are a multiple of 4 bytes long, so block IDs are always aligned
+    return span<const uint32_t>((const uint32_t *)(records + i * recordSize), markovOrder + 1);
+}
+
+uint64_t MarkovProfile::getFrequency(uint32_t i) const
+{
+    // the frequency follows the blocks and is only 4-byte aligned
+    uint64_t frequency;
+    memcpy(&frequency, records + i * recordSize + recordSize - sizeof(uint64_t), sizeof(frequency));
+    return frequency;
+}
+
+vector<span<const uint8_t>> MarkovProfile::getThreadProfiles() const
+{
+    auto edgeEnd = PROFILE_HEADER_WORDS * sizeof(uint32_t) + (size_t)edgeCount * recordSize;
+    if (length == edgeEnd)
+    {
+        return vector<span<const uint8_t>>();
+    }
+    return splitThreadProfiles(span<const uint8_t>(base + edgeEnd, length - edgeEnd));
+}
+
+vector<span<const uint8_t>> MarkovProfile::splitThreadProfiles(span<const uint8_t> payload)
+{
+    vector<span<const uint8_t>> threads;
+    if (payload.size() < sizeof(uint32_t))
+    {
+        throw CyclebiteException("Thread profiles are too small to contain a thread count!");
+    }
+    uint32_t threadCount;
+    memcpy(&threadCount, payload.data(), sizeof(threadCount));
+    size_t offset = sizeof(threadCount);
+    for (uint32_t i = 0; i < threadCount; i++)
+    {
+        if (payload.size() - offset < PROFILE_HEADER_WORDS * sizeof(uint32_t))
+        {
+            throw CyclebiteException("Profile of thread " + to_string(i) + " is too small to contain a header!");
+        }
+        uint32_t header[PROFILE_HEADER_WORDS];
+        memcpy(header, payload.data() + offset, sizeof(header));
+        // each record is the order+1 blocks of a path and its frequency
+        auto recordSize = ((size_t)header[0] + 1) * sizeof(uint32_t) + sizeof(uint64_t);
+        // the edge count is compared against what is left instead of multiplied out, which could wrap
+        if ((payload.size() - offset - sizeof(header)) / recordSize < (size_t)header[2])
+        {
+            throw CyclebiteException("Profile of thread " + to_string(i) + " is truncated: header promises " + to_string(header[2]) + " edges");
+        }
+        auto size = sizeof(header) + (size_t)header[2] * recordSize;
+        threads.push_back(payload.subspan(offset, size));
+        offset += size;
+    }
+    return threads;
+}
@@ -6,7 +6,6 @@
 
 using namespace Cyclebite::Graph;
 
-std::map<Operation, const char *> Cyclebite::Graph::OperationToString;
 
 Operation Cyclebite::Graph::GetOp(unsigned int op)
 {
@@ -136,9 +135,11 @@ Operation Cyclebite::Graph::GetOp(unsigned int op)
     }
 }
 
-void Cyclebite::Graph::initOpToString()
+/// Builds OperationToString
+std::map<Operation, const char *> buildOpToString()
 {
-    map_init(OperationToString)
+    std::map<Operation, const char *> opToString;
+    map_init(opToString)
         // terminator ops
         (Operation::ret, "function_return")(Operation::br, "br")(Operation::sw, "switch")(Operation::ibr, "indirect_br")(Operation::invoke, "invoke")(Operation::resume, "resume")
         // memory ops
@@ -155,4 +156,8 @@ void Cyclebite::Graph::initOpToString()
         (Operation::landingpad, "landingpad")(Operation::freeze, "freeze")
         // default case
         (Operation::nop, "nop");
-}
\ No newline at end of file
+    return opToString;
+}
+
+// filled during static initialization, before any thread that builds data flow graphs can read it
+std::map<Operation, const char *> Cyclebite::Graph::OperationToString = buildOpToString();
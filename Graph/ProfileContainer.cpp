@@ -0,0 +1,147 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "ProfileContainer.h"
+#include "Util/Exceptions.h"
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+using namespace Cyclebite::Graph;
+using namespace std;
+
+/// Largest chunk zlib will take in one call (its lengths are 32-bit)
+constexpr uint64_t ZLIB_CHUNK = 0x40000000;
+
+ProfileContainer::ProfileContainer(const string &filename) : name(filename)
+{
+    int fd = open(filename.data(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw CyclebiteException("Could not open profile container " + filename);
+    }
+    struct stat st;
+    if (fstat(fd, &st) || ((size_t)st.st_size < sizeof(__TA_ProfileHeader)))
+    {
+        close(fd);
+        throw CyclebiteException("Profile container " + filename + " is too small to contain a header!");
+    }
+    length = (size_t)st.st_size;
+    auto map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        throw CyclebiteException("Could not memory-map profile container " + filename);
+    }
+    base = (const uint8_t *)map;
+    __TA_ProfileHeader header;
+    memcpy(&header, base, sizeof(header));
+    version = header.version;
+    if (memcmp(header.magic, PROFILE_CONTAINER_MAGIC, sizeof(PROFILE_CONTAINER_MAGIC)) != 0)
+    {
+        munmap(map, length);
+        throw CyclebiteException(filename + " is not a profile container!");
+    }
+    if (version != PROFILE_CONTAINER_VERSION)
+    {
+        munmap(map, length);
+        throw CyclebiteException("Profile container " + filename + " has version " + to_string(version) + ", only version " + to_string(PROFILE_CONTAINER_VERSION) + " is supported!");
+    }
+    // written so that a corrupt offset or count can't wrap around
+    if ((header.tableOffset > length) || ((length - header.tableOffset) / sizeof(__TA_ProfileSection) < header.sectionCount))
+    {
+        munmap(map, length);
+        throw CyclebiteException("Section table of profile container " + filename + " is truncated!");
+    }
+    for (uint32_t i = 0; i < header.sectionCount; i++)
+    {
+        __TA_ProfileSection section;
+        memcpy(&section, base + header.tableOffset + i * sizeof(__TA_ProfileSection), sizeof(section));
+        if ((section.offset > length) || (section.storedSize > length - section.offset))
+        {
+            munmap(map, length);
+            throw CyclebiteException("Section " + to_string(section.type) + " of profile container " + filename + " is truncated!");
+        }
+        // uncompressed payloads are handed out in place, so they have to be exactly as large as they claim
+        if ((section.compression == __TA_COMPRESSION_NONE) && (section.size != section.storedSize))
+        {
+            munmap(map, length);
+            throw CyclebiteException("Uncompressed section " + to_string(section.type) + " of profile container " + filename + " stores " + to_string(section.storedSize) + " bytes but claims " + to_string(section.size) + "!");
+        }
+        sections[section.type] = section;
+    }
+}
+
+ProfileContainer::~ProfileContainer()
+{
+    munmap((void *)base, length);
+}
+
+bool ProfileContainer::isContainer(const string &filename)
+{
+    char magic[sizeof(PROFILE_CONTAINER_MAGIC)] = {0};
+    ifstream f(filename, ios::binary);
+    f.read(magic, sizeof(magic));
+    return f.good() && (memcmp(magic, PROFILE_CONTAINER_MAGIC, sizeof(magic)) == 0);
+}
+
+uint32_t ProfileContainer::getVersion() const
+{
+    return version;
+}
+
+bool ProfileContainer::hasSection(__TA_ProfileSectionType type) const
+{
+    return sections.contains(type);
+}
+
+span<const uint8_t> ProfileContainer::getSection(__TA_ProfileSectionType type) const
+{
+    if (loaded.contains(type))
+    {
+        return loaded.at(type);
+    }
+    if (!sections.contains(type))
+    {
+        return {};
+    }
+    const auto &section = sections.at(type);
+    span<const uint8_t> payload;
+    if (section.compression == __TA_COMPRESSION_NONE)
+    {
+        payload = span<const uint8_t>(base + section.offset, section.size);
+    }
+    else if (section.compression == __TA_COMPRESSION_ZLIB)
+    {
+        auto &buffer = inflated[type];
+        buffer.resize(section.size);
+        uLongf size = (uLongf)section.size;
+        if ((uncompress(buffer.data(), &size, base + section.offset, (uLong)section.storedSize) != Z_OK) || (size != section.size))
+        {
+            inflated.erase(type);
+            throw CyclebiteException("Could not inflate section " + to_string(type) + " of profile container " + name);
+        }
+        payload = span<const uint8_t>(buffer.data(), buffer.size());
+    }
+    else
+    {
+        throw CyclebiteException("Section " + to_string(type) + " of profile container " + name + " uses compression " + to_string(section.compression) + ", which this build does not support!");
+    }
+    uLong crc = crc32(0L, Z_NULL, 0);
+    for (uint64_t i = 0; i < payload.size(); i += ZLIB_CHUNK)
+    {
+        crc = crc32(crc, payload.data() + i, (uInt)min(ZLIB_CHUNK, payload.size() - i));
+    }
+    if ((uint32_t)crc != section.checksum)
+    {
+        inflated.erase(type);
+        throw CyclebiteException("Checksum mismatch in section " + to_string(type) + " of profile container " + name);
+    }
+    loaded[type] = payload;
+    return payload;
+}
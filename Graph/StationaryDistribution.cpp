@@ -0,0 +1,252 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "StationaryDistribution.h"
+#include "ControlNode.h"
+#include "UnconditionalEdge.h"
+#include "VirtualNode.h"
+#include <algorithm>
+#include <barrier>
+#include <cmath>
+#include <spdlog/spdlog.h>
+#include <thread>
+
+using namespace std;
+using namespace Cyclebite::Graph;
+
+/// Graphs with fewer rows than this are solved on the calling thread, the barrier costs more than the rows
+constexpr uint32_t PARALLEL_ROWS = 4096;
+
+StationaryDistribution::StationaryDistribution(double tol, uint32_t maxIter, unsigned threadCount) : tolerance(tol), maxIterations(maxIter), threads(threadCount), lastIterations(0)
+{
+    if (this->threads == 0)
+    {
+        this->threads = max(1u, thread::hardware_concurrency());
+    }
+}
+
+double StationaryDistribution::solve(const set<shared_ptr<ControlNode>, p_GNCompare> &nodes)
+{
+    snapshot(nodes);
+    if (!x.empty())
+    {
+        iterate();
+    }
+    previous.clear();
+    previous.reserve(x.size());
+    for (uint32_t i = 0; i < x.size(); i++)
+    {
+        previous[NIDs[i]] = x[i];
+    }
+    return entropyRate();
+}
+
+double StationaryDistribution::entropyRate() const
+{
+    double rate = 0.0;
+    for (uint32_t i = 0; i < x.size(); i++)
+    {
+        rate += x[i] * nodeEntropy[i];
+    }
+    return rate;
+}
+
+double StationaryDistribution::totalEntropy() const
+{
+    double total = 0.0;
+    for (const auto &h : nodeEntropy)
+    {
+        total += h;
+    }
+    return total;
+}
+
+uint32_t StationaryDistribution::iterations() const
+{
+    return lastIterations;
+}
+
+double StationaryDistribution::operator[](uint64_t NID) const
+{
+    auto found = previous.find(NID);
+    return found == previous.end() ? 0.0 : found->second;
+}
+
+void StationaryDistribution::snapshot(const set<shared_ptr<ControlNode>, p_GNCompare> &nodes)
+{
+    auto n = (uint32_t)nodes.size();
+    NIDs.clear();
+    NIDs.reserve(n);
+    for (const auto &node : nodes)
+    {
+        NIDs.push_back(node->NID);
+    }
+    // the node set is ordered by NID, so the row of a node can be found with a binary search
+    auto row = [&](uint64_t NID) -> int64_t {
+        auto it = lower_bound(NIDs.begin(), NIDs.end(), NID);
+        return (it != NIDs.end()) && (*it == NID) ? (int64_t)(it - NIDs.begin()) : -1;
+    };
+    rowStart.assign(n + 1, 0);
+    cols.clear();
+    probs.clear();
+    leak.assign(n, 1.0);
+    restart.assign(n, 0.0);
+    nodeEntropy.assign(n, 0.0);
+    x.assign(n, 0.0);
+    uint32_t entries = 0;
+    uint32_t i = 0;
+    for (const auto &node : nodes)
+    {
+        // outgoing edges give this node's entropy and how much probability leaves the set
+        for (const auto &succ : node->getSuccessors())
+        {
+            double p = succ->getWeight();
+            if (p > 0.0)
+            {
+                nodeEntropy[i] -= p * log2(p);
+                if (row(succ->getSnk()->NID) >= 0)
+                {
+                    leak[i] -= p;
+                }
+            }
+        }
+        leak[i] = max(leak[i], 0.0);
+        // incoming edges make the row of the transposed transition matrix
+        bool entry = true;
+        for (const auto &pred : node->getPredecessors())
+        {
+            auto src = row(pred->getSrc()->NID);
+            double p = pred->getWeight();
+            if ((src >= 0) && (p > 0.0))
+            {
+                cols.push_back((uint32_t)src);
+                probs.push_back(p);
+                entry = false;
+            }
+        }
+        if (entry)
+        {
+            restart[i] = 1.0;
+            entries++;
+        }
+        rowStart[i + 1] = cols.size();
+        x[i] = warmStart(node);
+        i++;
+    }
+    // leaked probability re-enters the graph where the program does, if nothing looks like an entrance it is spread evenly
+    for (auto &r : restart)
+    {
+        r = entries ? r / entries : 1.0 / n;
+    }
+    double sum = 0.0;
+    for (const auto &v : x)
+    {
+        sum += v;
+    }
+    for (auto &v : x)
+    {
+        v = sum > 0.0 ? v / sum : 1.0 / n;
+    }
+}
+
+double StationaryDistribution::warmStart(const shared_ptr<ControlNode> &node) const
+{
+    auto found = previous.find(node->NID);
+    if (found != previous.end())
+    {
+        return found->second;
+    }
+    // a virtual node made since the last solve holds the probability of everything it swallowed
+    double mass = 0.0;
+    if (auto vn = dynamic_pointer_cast<VirtualNode>(node))
+    {
+        for (const auto &sub : vn->getSubgraph())
+        {
+            mass += warmStart(sub);
+        }
+    }
+    return mass;
+}
+
+void StationaryDistribution::iterate()
+{
+    auto n = (uint32_t)x.size();
+    unsigned T = n < PARALLEL_ROWS ? 1 : min(threads, n / PARALLEL_ROWS + 1);
+    vector<double> next(n);
+    vector<double> partialDiff(T);
+    vector<double> partialLeak(T);
+    double leaked = 0.0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        leaked += x[i] * leak[i];
+    }
+    uint32_t iteration = 0;
+    bool done = false;
+    // runs on one thread once every thread has finished its rows of an iteration
+    auto step = [&]() noexcept {
+        double diff = 0.0;
+        leaked = 0.0;
+        for (unsigned t = 0; t < T; t++)
+        {
+            diff += partialDiff[t];
+            leaked += partialLeak[t];
+        }
+        x.swap(next);
+        iteration++;
+        done = (diff < tolerance) || (iteration >= maxIterations);
+    };
+    barrier sync((ptrdiff_t)T, step);
+    auto work = [&](unsigned t) {
+        auto lo = (uint32_t)((uint64_t)n * t / T);
+        auto hi = (uint32_t)((uint64_t)n * (t + 1) / T);
+        while (!done)
+        {
+            double diff = 0.0;
+            double sliceLeak = 0.0;
+            for (uint32_t j = lo; j < hi; j++)
+            {
+                double in = restart[j] * leaked;
+                for (auto k = rowStart[j]; k < rowStart[j + 1]; k++)
+                {
+                    in += probs[k] * x[cols[k]];
+                }
+                double v = 0.5 * (x[j] + in);
+                diff += fabs(v - x[j]);
+                sliceLeak += v * leak[j];
+                next[j] = v;
+            }
+            partialDiff[t] = diff;
+            partialLeak[t] = sliceLeak;
+            sync.arrive_and_wait();
+        }
+    };
+    vector<thread> workers;
+    for (unsigned t = 1; t < T; t++)
+    {
+        workers.emplace_back(work, t);
+    }
+    work(0);
+    for (auto &w : workers)
+    {
+        w.join();
+    }
+    lastIterations = iteration;
+    if (iteration >= maxIterations)
+    {
+        spdlog::warn("Stationary distribution did not converge to " + to_string(tolerance) + " within " + to_string(maxIterations) + " iterations");
+    }
+    // rounding (and leaks of more than the node had) drift the total away from 1
+    double sum = 0.0;
+    for (const auto &v : x)
+    {
+        sum += v;
+    }
+    if (sum > 0.0)
+    {
+        for (auto &v : x)
+        {
+            v /= sum;
+        }
+    }
+}
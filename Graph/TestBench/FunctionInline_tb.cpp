@@ -775,11 +775,7 @@ int main()
     Graph original;
     try
     {
-        auto err = BuildCFG(original, IP, false);
-        if (err)
-        {
-            throw CyclebiteException("Failed to read input profile file!");
-        }
+        BuildCFG(original, IP);
         if (original.nodes.empty())
         {
             throw CyclebiteException("No nodes could be read from the input profile!");
@@ -0,0 +1,117 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "TransformTrace.h"
+#include "Graph.h"
+#include "IO.h"
+#include "ProfileContext.h"
+#include "Util/IO.h"
+#include <cstdlib>
+#include <map>
+#include <spdlog/spdlog.h>
+
+using namespace std;
+using namespace Cyclebite::Graph;
+
+TraceLevel Cyclebite::Graph::GetTraceLevel()
+{
+    static TraceLevel level = []() {
+#ifdef DEBUG
+        auto level = TraceLevel::Dot;
+#else
+        auto level = TraceLevel::Off;
+#endif
+        if (auto env = getenv("CYCLEBITE_TRACE"))
+        {
+            string value(env);
+            if ((value == "off") || (value == "0"))
+            {
+                level = TraceLevel::Off;
+            }
+            else if ((value == "counters") || (value == "1"))
+            {
+                level = TraceLevel::Counters;
+            }
+            else if ((value == "dot") || (value == "2"))
+            {
+                level = TraceLevel::Dot;
+            }
+            else
+            {
+                spdlog::warn("Did not recognize CYCLEBITE_TRACE=" + value + ", expected off, counters or dot");
+            }
+        }
+        if ((int)level > CYCLEBITE_TRACE_LEVEL)
+        {
+            spdlog::warn("Transform trace level was limited to " + to_string(CYCLEBITE_TRACE_LEVEL) + " at compile time");
+            level = (TraceLevel)CYCLEBITE_TRACE_LEVEL;
+        }
+        return level;
+    }();
+    return level;
+}
+
+void Cyclebite::Graph::CountTransform(map<string, TransformCounters> &counters, const string &transform, uint64_t nodesCollapsed, uint64_t edgesRewritten, double seconds)
+{
+    auto &c = counters[transform];
+    c.applications++;
+    c.nodesCollapsed += nodesCollapsed;
+    c.edgesRewritten += edgesRewritten;
+    c.seconds += seconds;
+}
+
+void Cyclebite::Graph::ReportTransforms(map<string, TransformCounters> &counters)
+{
+    for (const auto &t : counters)
+    {
+        spdlog::info("TRANSFORMTRACE: " + t.first + " applications=" + to_string(t.second.applications) + " nodesCollapsed=" + to_string(t.second.nodesCollapsed) + " edgesRewritten=" + to_string(t.second.edgesRewritten) + " time=" + to_string(t.second.seconds) + "s");
+    }
+    counters.clear();
+}
+
+TransformScope::TransformScope(ProfileContext &context, const char *transform, const Graph &graph, const Graph *subgraph, const char *dotFile) : context(context), transform(transform), graph(graph), active(Tracing(TraceLevel::Counters)), nodes(0), edges(0), rewritten(0)
+{
+    if (!active)
+    {
+        return;
+    }
+    if (Tracing(TraceLevel::Dot))
+    {
+        dot.open(dotFile);
+        dot << "# " << transform << "\n\n# Subgraph\n";
+        if (subgraph)
+        {
+            GenerateDot(dot, *subgraph, false, context.markovOrder);
+        }
+        dot << "\n# Old Graph\n";
+        GenerateDot(dot, graph, false, context.markovOrder);
+        dot << "\n# New Graph\n";
+    }
+    nodes = graph.node_count();
+    edges = graph.edge_count();
+    while (clock_gettime(CLOCK_MONOTONIC, &start)) {}
+}
+
+TransformScope::~TransformScope()
+{
+    if (!active)
+    {
+        return;
+    }
+    struct timespec end;
+    while (clock_gettime(CLOCK_MONOTONIC, &end)) {}
+    auto nodesAfter = graph.node_count();
+    auto edgesAfter = graph.edge_count();
+    CountTransform(context.transforms, transform, nodes > nodesAfter ? nodes - nodesAfter : 0, (edges > edgesAfter ? edges - edgesAfter : 0) + rewritten, CalculateTime(&start, &end));
+    if (dot.is_open())
+    {
+        GenerateDot(dot, graph, false, context.markovOrder);
+        dot << "\n";
+    }
+}
+
+void TransformScope::rewrote(uint64_t count)
+{
+    rewritten += count;
+}
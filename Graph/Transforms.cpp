@@ -9,10 +9,14 @@
 #include "ImaginaryNode.h"
 #include "ImaginaryEdge.h"
 #include "CallGraph.h"
+#include "CallGraphSCC.h"
 #include "ControlGraph.h"
 #include "Dijkstra.h"
 #include "IO.h"
+#include "ProfileContext.h"
 #include "VirtualEdge.h"
+#include "StationaryDistribution.h"
+#include "TransformTrace.h"
 #include <deque>
 #include <llvm/IR/InstrTypes.h>
 #include <spdlog/spdlog.h>
@@ -25,23 +29,19 @@ constexpr uint32_t MAX_BOTTLENECK_SIZE = 200;
 /// Minimum nuumber of child kernels that must be present in a loop comprehension kernel in order to ignore the "every embedded kernel must have a child" rule
 constexpr uint32_t MIN_CHILD_KERNEL_EXCEPTION = 5;
 
-/// Maps a node from the profile to a set of Virtual Nodes that represent it
-map<shared_ptr<ControlNode>, set<shared_ptr<VirtualNode>, p_GNCompare>, p_GNCompare> NodeToVN;
-map<shared_ptr<UnconditionalEdge>, set<shared_ptr<VirtualEdge>, GECompare>, GECompare> EdgeToVE;
-/// Keeps track of basic blocks that are dead
-set<const llvm::BasicBlock *> Cyclebite::Graph::deadCode;
-/// This function returns null when the input basic block could not be found in the NIDMap
+/// This function returns null when the input basic block could not be found in the NIDMap of the context
 /// The NID Map is created when reading in the original dynamic profile, and represents all blocks that were observed during that profile
 /// So if a basic block cannot be found in it, it means that basic block was not in the dynamic profile ie it is dead code
-shared_ptr<GraphNode> Cyclebite::Graph::BlockToNode(const Graph &graph, const llvm::BasicBlock *block, const std::map<vector<uint32_t>, uint64_t> &NIDMap)
+shared_ptr<GraphNode> Cyclebite::Graph::BlockToNode(ProfileContext &context, const Graph &graph, const llvm::BasicBlock *block)
 {
-    vector<uint32_t> bbID;
-    bbID.push_back((uint32_t)Cyclebite::Util::GetBlockID(llvm::cast<llvm::BasicBlock>(block)));
-    if (NIDMap.find(bbID) != NIDMap.end())
+    const auto &NIDMap = context.NIDMap;
+    auto bbID = Cyclebite::Util::GetBlockID(llvm::cast<llvm::BasicBlock>(block));
+    if ((bbID >= 0) && ((uint64_t)bbID < NIDMap.size()) && (NIDMap[(uint64_t)bbID] != UNMAPPED_NID))
     {
-        if (graph.find_node(NIDMap.at(bbID)))
+        auto NID = NIDMap[(uint64_t)bbID];
+        if (graph.find_node(NID))
         {
-            return graph.getOriginalNode(NIDMap.at(bbID));
+            return graph.getOriginalNode(NID);
         }
         else
         {
@@ -50,7 +50,7 @@ shared_ptr<GraphNode> Cyclebite::Graph::BlockToNode(const Graph &graph, const ll
             // once we find the node that maps to this entry in the NIDMap, we return its parent-most virtual node
             for (const auto &node : graph.nodes())
             {
-                if (node->NID == NIDMap.at(bbID))
+                if (node->NID == NID)
                 {
                     return node;
                 }
@@ -64,7 +64,7 @@ shared_ptr<GraphNode> Cyclebite::Graph::BlockToNode(const Graph &graph, const ll
                     {
                         for (const auto &subnode : Q.front()->getSubgraph())
                         {
-                            if (subnode->NID == NIDMap.at(bbID))
+                            if (subnode->NID == NID)
                             {
                                 return VN;
                             }
@@ -80,15 +80,14 @@ shared_ptr<GraphNode> Cyclebite::Graph::BlockToNode(const Graph &graph, const ll
                     }
                 }
             }
-            throw CyclebiteException("Could not find a node that maps to basic block ID " + to_string(*bbID.begin()));
+            throw CyclebiteException("Could not find a node that maps to basic block ID " + to_string(bbID));
         }
     }
     else
     {
-        if (deadCode.find(block) == deadCode.end())
+        if (context.deadCode.insert(block).second)
         {
             spdlog::warn("BB" + to_string(Cyclebite::Util::GetBlockID(block)) + " is dead.");
-            deadCode.insert(block);
         }
         return nullptr;
     }
@@ -317,9 +316,6 @@ void Cyclebite::Graph::Checks(const ControlGraph &transformed, string step, bool
     }
 }
 
-// This is a map to memoize the result of SubgraphBFS
-// It maps an entrance node + exit nodes to a graph it should map to
-std::map<std::set<std::shared_ptr<ControlNode>, p_GNCompare>, Graph> subgraphMemo;
 /// @brief This method finds all nodes in a subgraph spanning from entrance to the exits passed in the arguments
 ///
 /// Note: this function assumes that the subgraph to be found exists entirely between a unique entrance node (unique as in it cannot also be an exit) and a set of unique exit nodes
@@ -538,7 +534,7 @@ void removeUnreachableNodes(ControlGraph &funcGraph, const shared_ptr<CallEdge>
 #endif
 }
 
-ControlGraph SimpleFunctionBFS(const std::shared_ptr<CallEdge> &entrance)
+ControlGraph SimpleFunctionBFS(const ProfileContext &context, const std::shared_ptr<CallEdge> &entrance)
 {
     // we find all possible function entrances/exits and pass them to the subgraph finder
     // the input calledge only contains one entrance/exit(s) pair, we need them all to distinctly find the boundaries of the function
@@ -582,7 +578,7 @@ ControlGraph SimpleFunctionBFS(const std::shared_ptr<CallEdge> &entrance)
     auto exitsCopy = funcExits;
     for (const auto &ex : exitsCopy)
     {
-        if (EdgeToVE.find(ex) != EdgeToVE.end())
+        if (context.EdgeToVE.find(ex) != context.EdgeToVE.end())
         {
             funcExits.erase(ex);
         }
@@ -590,7 +586,7 @@ ControlGraph SimpleFunctionBFS(const std::shared_ptr<CallEdge> &entrance)
     return SubgraphBFS(entrance->getWeightedSnk(), funcExits);
 }
 
-ControlGraph DirectRecursionFunctionBFS(const std::shared_ptr<CallEdge> &entrance)
+ControlGraph DirectRecursionFunctionBFS(const ProfileContext &context, const std::shared_ptr<CallEdge> &entrance)
 {
     // the call edge passed to us can be any entrance to the recursive function (either an entrance from outside the function, or a recursive entrance)
     // we need to find the calledge that comes from outside the function in order to find the right exits
@@ -616,7 +612,7 @@ ControlGraph DirectRecursionFunctionBFS(const std::shared_ptr<CallEdge> &entranc
     auto exitCopy = recursionExits;
     for (const auto &ex : recursionExits)
     {
-        if (EdgeToVE.find(ex) != EdgeToVE.end())
+        if (context.EdgeToVE.find(ex) != context.EdgeToVE.end())
         {
             recursionExits.erase(ex);
         }
@@ -688,7 +684,7 @@ ControlGraph IndirectRecursionFunctionBFS(const std::shared_ptr<CallEdge> &entra
     return SubgraphBFS(entrance->getWeightedSnk(), indirectExits);
 }
 
-void Cyclebite::Graph::VirtualizeSubgraph(Graph &graph, std::shared_ptr<VirtualNode> &VN, const ControlGraph &subgraph)
+void Cyclebite::Graph::VirtualizeSubgraph(ProfileContext &context, Graph &graph, std::shared_ptr<VirtualNode> &VN, const ControlGraph &subgraph)
 {
     if( subgraph.getNodes().empty() || subgraph.getEdges().empty() )
     {
@@ -696,10 +692,6 @@ void Cyclebite::Graph::VirtualizeSubgraph(Graph &graph, std::shared_ptr<VirtualN
     }
     VN->addNodes(subgraph.getControlNodes());
     VN->addEdges(subgraph.getControlEdges());
-    for (const auto &n : subgraph.getControlNodes())
-    {
-        NodeToVN[n].insert(VN);
-    }
     // first we virtualize the edges of our entrance preds and exit succs
     set<std::shared_ptr<ControlNode>, p_GNCompare> entNodes;
     for (auto ent : VN->getEntrances())
@@ -749,7 +741,7 @@ void Cyclebite::Graph::VirtualizeSubgraph(Graph &graph, std::shared_ptr<VirtualN
         }
         for (const auto &e : VNEdges)
         {
-            EdgeToVE[e].insert(newEdge);
+            context.EdgeToVE[e].insert(newEdge);
         }
         newEdge->setWeight(totalFreq);
         for (auto edge : VNEdges)
@@ -774,7 +766,7 @@ void Cyclebite::Graph::VirtualizeSubgraph(Graph &graph, std::shared_ptr<VirtualN
         set<shared_ptr<UnconditionalEdge>, GECompare> replaceEdges;
         replaceEdges.insert(ex);
         auto newEdge = make_shared<VirtualEdge>(ex->getFreq(), VN, ex->getWeightedSnk(), replaceEdges);
-        EdgeToVE[ex].insert(newEdge);
+        context.EdgeToVE[ex].insert(newEdge);
         newEdge->setWeight((uint64_t)((float)ex->getFreq() / ex->getWeight()));
         graph.removeEdge(ex);
         graph.addEdge(newEdge);
@@ -806,7 +798,7 @@ void Cyclebite::Graph::VirtualizeSubgraph(Graph &graph, std::shared_ptr<VirtualN
 /// @param subgraph All nodes that describe the function to be virtualized. This may include any virtualized functions within the subgraph.
 /// @param entrance ControlNode whose underlying basic block is the caller block. This node is not virtualized
 /// @param exits    Set of edges which point to nodes that can be reached after a call to this function from the entrance parameter. The exit snk nodes are not virtualized.
-set<std::shared_ptr<VirtualEdge>, GECompare> VirtualizeFunctionSubgraph(Graph &graph, const ControlGraph &funcGraph, const std::shared_ptr<CallEdge> &entrance, const set<std::shared_ptr<UnconditionalEdge>, GECompare> &exits)
+set<std::shared_ptr<VirtualEdge>, GECompare> VirtualizeFunctionSubgraph(ProfileContext &context, Graph &graph, const ControlGraph &funcGraph, const std::shared_ptr<CallEdge> &entrance, const set<std::shared_ptr<UnconditionalEdge>, GECompare> &exits)
 {
     // each node in the subgraph has to be virtualized and given only the entrances and exits provided in the arguments to this function
     // two reasons:
@@ -820,7 +812,6 @@ set<std::shared_ptr<VirtualEdge>, GECompare> VirtualizeFunctionSubgraph(Graph &g
         newSubVN = make_shared<VirtualNode>();
         newSubVN->addNode(s);
         add.insert(newSubVN);
-        NodeToVN[s].insert(newSubVN);
     }
     for (auto s : add)
     {
@@ -854,7 +845,7 @@ set<std::shared_ptr<VirtualEdge>, GECompare> VirtualizeFunctionSubgraph(Graph &g
                 throw CyclebiteException("Could not find a virtual node that represents a node in the function subgraph!");
             }
             auto newEdge = make_shared<VirtualEdge>(e->getFreq(), VNpred, VNsucc, replaceEdges);
-            EdgeToVE[e].insert(newEdge);
+            context.EdgeToVE[e].insert(newEdge);
             addEdge.insert(newEdge);
             s->addPredecessor(newEdge);
             VNpred->addSuccessor(newEdge);
@@ -884,7 +875,7 @@ set<std::shared_ptr<VirtualEdge>, GECompare> VirtualizeFunctionSubgraph(Graph &g
                         throw CyclebiteException("Could not find a virtual node that represents a node in the function subgraph!");
                     }
                     auto newEdge = make_shared<VirtualEdge>(p->getFreq(), VNpred, s, replaceEdges);
-                    EdgeToVE[p].insert(newEdge);
+                    context.EdgeToVE[p].insert(newEdge);
                     addEdge.insert(newEdge);
                     s->addPredecessor(newEdge);
                     VNpred->addSuccessor(newEdge);
@@ -899,7 +890,7 @@ set<std::shared_ptr<VirtualEdge>, GECompare> VirtualizeFunctionSubgraph(Graph &g
                 replaceEdges.insert(p);
                 auto newEdge = make_shared<VirtualEdge>(p->getFreq(), p->getWeightedSrc(), s, replaceEdges);
                 newEdge->setWeight((uint64_t)((float)p->getFreq() / p->getWeight()));
-                EdgeToVE[p].insert(newEdge);
+                context.EdgeToVE[p].insert(newEdge);
                 addEdge.insert(newEdge);
                 s->addPredecessor(newEdge);
                 p->getWeightedSrc()->addSuccessor(newEdge);
@@ -948,7 +939,7 @@ set<std::shared_ptr<VirtualEdge>, GECompare> VirtualizeFunctionSubgraph(Graph &g
                     }
                     outgoingFreq += succ->getFreq();
                     auto newEdge = make_shared<VirtualEdge>(succ->getFreq(), s, VNsucc, replaceEdges);
-                    EdgeToVE[succ].insert(newEdge);
+                    context.EdgeToVE[succ].insert(newEdge);
                     addEdge.insert(newEdge);
                     newEdge->setWeight(succ->getFreq());
                     s->addSuccessor(newEdge);
@@ -963,7 +954,7 @@ set<std::shared_ptr<VirtualEdge>, GECompare> VirtualizeFunctionSubgraph(Graph &g
                     set<shared_ptr<UnconditionalEdge>, GECompare> replaceEdges;
                     replaceEdges.insert(succ);
                     auto newEdge = make_shared<VirtualEdge>(succ->getFreq(), s, succ->getWeightedSnk(), replaceEdges);
-                    EdgeToVE[succ].insert(newEdge);
+                    context.EdgeToVE[succ].insert(newEdge);
                     addEdge.insert(newEdge);
                     s->addSuccessor(newEdge);
                     succ->getWeightedSnk()->addPredecessor(newEdge);
@@ -1587,49 +1578,22 @@ bool hasDirectRecursion(const std::shared_ptr<ControlNode> &node, const std::map
     }
 }
 
-bool Cyclebite::Graph::hasIndirectRecursion(const Cyclebite::Graph::CallGraph &graph, const shared_ptr<Cyclebite::Graph::CallGraphNode> &node)
+bool Cyclebite::Graph::hasIndirectRecursion(const CallGraphSCC &scc, const shared_ptr<Cyclebite::Graph::CallGraphNode> &node)
 {
-    auto cycle = Dijkstras(graph, node->NID, node->NID);
-    if (cycle.size() > 1)
-    {
-        // the loop had more than one node in it, so it must be indirect recursion
-        return true;
-    }
-    else if (cycle.size() == 1)
-    {
-        // this function is direct recursive and might be indirect recursive
-        // we have to take the direct recursion edge out and redo the analysis
-        auto copy = graph;
-        auto finderEdge = make_shared<UnconditionalEdge>(0, node, node);
-        copy.removeEdge(finderEdge);
-        auto cycle2 = Dijkstras(copy, node->NID, node->NID);
-        if (cycle2.size() > 1)
-        {
-            return true;
-        }
-        else
-        {
-            return false;
-        }
-    }
-    else
-    {
-        return false;
-    }
+    return scc.hasIndirectRecursion(node);
 }
 
 /// Returns true if this function has direct recursion and false otherwise. If the input function is indirect and direct recursive, the return value will be true
 bool Cyclebite::Graph::hasDirectRecursion(const Cyclebite::Graph::CallGraph &graph, const shared_ptr<Cyclebite::Graph::CallGraphNode> &src)
 {
-    auto cycle = Dijkstras(graph, src->NID, src->NID);
-    if (cycle.size() == 1)
+    for (const auto &child : src->getChildren())
     {
-        return true;
-    }
-    else
-    {
-        return false;
+        if (child->getChild() == src)
+        {
+            return true;
+        }
     }
+    return false;
 }
 
 /// Carries out a depth-first search of the callgraph
@@ -1686,245 +1650,18 @@ bool hasIndirectRecursion(const std::shared_ptr<ControlNode> &node, const std::m
     }
 }
 
-set<shared_ptr<CallGraphNode>, p_GNCompare> getIndirectRecursionCycle(const Cyclebite::Graph::CallGraph &graph, const shared_ptr<Cyclebite::Graph::CallGraphNode> &CGN)
-{
-    /* john 6/29/22
-     * the analysis should have to make it back to the original parent, so put a check in the cycles involved in a new child 
-     * if i am capturing a recursive of a subgraph in the call graph
-     *  - all paths must lead back to the current node through the new child node
-     *  - if this is not true, this likely indicates that a higher level of recursion exists, and that higher level should be the inline candidate
-     * In a call graph, if you start jumping above the caller context, things go wrong
-     * 
-     * Watermark approach (comes from Plato's cave)
-     *  - 0: My dependencies are currently met ("easy" case... a depends on a)
-     *  - 1: I am allowed to merge all current dependencies once, then ask: if I evaluate this set, do I meet all dependencies for each member in the set?
-     *  -> then keep recursing through this until all dependencies are met (number represents the number of set unions that would be required to find all dependencies)
-     *  -> threshold should probably be around 10, because an example that embeds 10 callgraph cycles together is interesting
-     */
-    set<shared_ptr<CallGraphNode>, p_GNCompare> cycle;
-    // do a BFS of the subgraph in the CGN
-    // for each node in the BFS, do Dijkstras
-    // if Dijkstra returns a cycle keep the node
-    // else its not part of "the" cycle
-    set<shared_ptr<CallEdge>, GECompare> embeddedFunctions;
-    set<shared_ptr<Cyclebite::Graph::CallGraphNode>> covered;
-    deque<shared_ptr<Cyclebite::Graph::CallGraphNode>> Q;
-    Q.push_front(CGN);
-    // this copy has direct recursion edges removed from it as the analysis progresses
-    // this prevents the case where a function that is both direct and indirect recursive is erroneously categorized by Dijkstra as direct recursive only
-    auto graphCopy = graph;
-    while (!Q.empty())
-    {
-        for (const auto &child : Q.front()->getChildren())
-        {
-            if (covered.find(child->getChild()) == covered.end())
-            {
-                // recursion entrances are not children
-                if (child->getChild() != Q.front())
-                {
-                    // see if this node is part of a cycle
-                    auto childCycle = Dijkstras(graphCopy, child->getChild()->NID, child->getChild()->NID);
-                    if (childCycle.size() > 1)
-                    {
-                        cycle.insert(static_pointer_cast<CallGraphNode>(graphCopy.getOriginalNode(child->getChild()->NID)));
-                        Q.push_back(child->getChild());
-                        covered.insert(child->getChild());
-                    }
-                    else if (childCycle.size() == 1)
-                    {
-                        auto copy = graphCopy;
-                        auto finderEdge = make_shared<UnconditionalEdge>(0, child->getChild(), child->getChild());
-                        copy.removeEdge(finderEdge);
-                        auto childCycle2 = Dijkstras(copy, child->getChild()->NID, child->getChild()->NID);
-                        if (childCycle2.size() > 1)
-                        {
-                            cycle.insert(static_pointer_cast<CallGraphNode>(graphCopy.getOriginalNode(child->getChild()->NID)));
-                            Q.push_back(child->getChild());
-                            covered.insert(child->getChild());
-                            graphCopy = copy;
-                        }
-                    }
-                }
-            }
-        }
-        Q.pop_front();
-    }
-    return cycle;
-}
-
-/// @brief Returns all entrance edges to a cycle in the callgraph
+/// @brief Orders the inlines of shared functions bottom-up in the call graph
 ///
-/// This function will find a cycle in the callgraph that is entered into by CGN and get all edges that go into the cycle but whose source node cannot be returned to by the cycle
-/// @param graph    Callgraph that contains CGN
-/// @param CGN      CallGraphNode in question. This node should be part of a cycle in the callgraph. This method assumes this parameter is already known to be part of a cycle
-/// @retval         All edges that can enter the cycle but are not themselves part of the cycle
-set<shared_ptr<CallGraphEdge>, GECompare> getIndirectRecursionEntrances(const Cyclebite::Graph::CallGraph &graph, const shared_ptr<Cyclebite::Graph::CallGraphNode> &CGN)
-{
-    set<shared_ptr<CallGraphEdge>, GECompare> entrances;
-    auto cycle = getIndirectRecursionCycle(graph, CGN);
-    // now we look for all incoming edges into the cycle
-    for (const auto &node : cycle)
-    {
-        for (const auto &pred : node->getParents())
-        {
-            if (cycle.find(pred->getParent()) == cycle.end())
-            {
-                entrances.insert(pred);
-            }
-        }
-    }
-    return entrances;
-}
-
-set<shared_ptr<CallGraphEdge>, GECompare> getDirectRecursionEntrances(const shared_ptr<Cyclebite::Graph::CallGraphNode> &CGN)
-{
-    set<shared_ptr<CallGraphEdge>, GECompare> entrances;
-    // we are looking for calledges to this node that do not form a cycle
-    for (const auto &pred : CGN->getParents())
-    {
-        if (pred->getParent() != pred->getChild())
-        {
-            entrances.insert(pred);
-        }
-    }
-    return entrances;
-}
-
-set<shared_ptr<CallGraphEdge>, GECompare> FindEmbeddedFunctions(const Cyclebite::Graph::CallGraph &dynamicCG, const shared_ptr<Cyclebite::Graph::CallGraphNode> &CGN)
+/// Components of the SCC are numbered callees-first, so walking them in order inlines every embedded function of a function before the function itself
+/// The functions of an indirect recursive component share one function subgraph (and one set of entrances), so the component is scheduled once
+deque<set<shared_ptr<CallGraphEdge>, GECompare>> ScheduleInlineTransforms(const CallGraphSCC &scc, const map<shared_ptr<Cyclebite::Graph::CallGraphNode>, set<shared_ptr<Cyclebite::Graph::CallGraphEdge>, GECompare>, p_GNCompare> &InlineCalls)
 {
-    set<shared_ptr<CallGraphEdge>, GECompare> embeddedFunctions;
-    // there are two cases here
-    // 1. the input function is indirect recursive. In this case we want the functions that do not belong on the cycle
-    // 2. the input function is not indirect recursive. In this case we do a BFS of the children of the function, ignoring any possible direct recursion edges
-    if (hasIndirectRecursion(dynamicCG, CGN))
-    {
-        auto idrCycle = getIndirectRecursionCycle(dynamicCG, CGN);
-        for (const auto &node : idrCycle)
-        {
-            // bfs the function and add any children not in the cycle
-            set<shared_ptr<Cyclebite::Graph::CallGraphNode>> covered;
-            deque<shared_ptr<Cyclebite::Graph::CallGraphNode>> Q;
-            Q.push_front(node);
-            while (!Q.empty())
-            {
-                for (const auto &child : Q.front()->getChildren())
-                {
-                    if (covered.find(child->getChild()) == covered.end())
-                    {
-                        // recursion entrances are not children
-                        if (child->getChild() != Q.front())
-                        {
-                            if (idrCycle.find(child->getChild()) == idrCycle.end())
-                            {
-                                embeddedFunctions.insert(child);
-                                Q.push_back(child->getChild());
-                                covered.insert(child->getChild());
-                            }
-                        }
-                    }
-                }
-                Q.pop_front();
-            }
-        }
-    }
-    else
-    {
-        set<shared_ptr<Cyclebite::Graph::CallGraphNode>> covered;
-        deque<shared_ptr<Cyclebite::Graph::CallGraphNode>> Q;
-        Q.push_front(CGN);
-        while (!Q.empty())
-        {
-            for (const auto &child : Q.front()->getChildren())
-            {
-                // recursion entrances are not embedded function edges
-                if (child->getChild() != Q.front())
-                {
-                    // indirect recursive function edges are not embedded function edges
-                    if (hasIndirectRecursion(dynamicCG, child->getChild()))
-                    {
-                        auto entrances = getIndirectRecursionEntrances(dynamicCG, child->getChild());
-                        if (entrances.find(child) != entrances.end())
-                        {
-                            embeddedFunctions.insert(child);
-                        }
-                    }
-                    else
-                    {
-                        embeddedFunctions.insert(child);
-                    }
-                }
-                if (covered.find(child->getChild()) == covered.end())
-                {
-                    Q.push_back(child->getChild());
-                    covered.insert(child->getChild());
-                }
-            }
-            Q.pop_front();
-        }
-    }
-    return embeddedFunctions;
-}
-
-deque<set<shared_ptr<CallGraphEdge>, GECompare>> ScheduleInlineTransforms(const Cyclebite::Graph::CallGraph &dynamicCG, const map<shared_ptr<Cyclebite::Graph::CallGraphNode>, set<shared_ptr<CallGraphEdge>, GECompare>, p_GNCompare> &embFunctions, const map<shared_ptr<Cyclebite::Graph::CallGraphNode>, set<shared_ptr<Cyclebite::Graph::CallGraphEdge>, GECompare>, p_GNCompare> &InlineCalls)
-{
-    /*
-     * John 6/29/22
-     * building the "who has no dependencies" pass is helpful, you just need to detect the deadlock case and handle it
-     * You are trying to solve two problems as once
-     *  - you are trying to schedule things in the right dependency order
-     *  - you are also trying to detect the deadlock case, and this infusion is making the evaluation of the easy case harder
-    */
-    // now order the transforms such that each function has as many embedded functions inlined as possible before it is inlined
     deque<set<shared_ptr<CallGraphEdge>, GECompare>> InlineTransformQ;
-    deque<shared_ptr<CallGraphNode>> Q;
-    set<shared_ptr<CallGraphNode>> covered;
-    Q.push_front(dynamicCG.getMainNode());
-    // walk the callgraph where the inline candidates are
-    uint32_t schedulingIterations = 0;
-    while (!Q.empty())
+    for (uint32_t c = 0; c < scc.size(); c++)
     {
-        if (covered.find(Q.back()) != covered.end())
-        {
-            Q.pop_back();
-            continue;
-        }
-        bool allCovered = true;
-        auto currentDependencies = embFunctions.at(Q.back());
-        for (const auto &child : currentDependencies)
+        for (const auto &node : scc[c])
         {
-            if ((covered.find(child->getChild()) == covered.end())) // && (accountedFor.find(child->getChild()) == accountedFor.end()) )
-            {
-                allCovered = false;
-                break;
-            }
-        }
-
-        if (allCovered)
-        {
-#ifdef DEBUG
-            // sanity check. If it is time to push this to the Q, then all embedded functions should already be in the Q
-            for (const auto &emb : currentDependencies)
-            {
-                bool found = false;
-                auto inlineEntry = InlineCalls.find(emb->getChild());
-                if (inlineEntry != InlineCalls.end())
-                {
-                    for (const auto &entry : InlineTransformQ)
-                    {
-                        if (entry.find(emb) != entry.end())
-                        {
-                            found = true;
-                            break;
-                        }
-                    }
-                    if (!found)
-                    {
-                        throw CyclebiteException("Inlinable embedded function edge " + string(emb->getParent()->getFunction()->getName()) + " -> " + string(emb->getChild()->getFunction()->getName()) + " has not been scheduled yet for parent " + string(Q.back()->getFunction()->getName()) + "!");
-                    }
-                }
-            }
-#endif
-            auto entry = InlineCalls.find(Q.back());
+            auto entry = InlineCalls.find(node);
             if (entry != InlineCalls.end())
             {
 #ifdef DEBUG
@@ -1933,65 +1670,15 @@ deque<set<shared_ptr<CallGraphEdge>, GECompare>> ScheduleInlineTransforms(const
                 {
                     callGraphEdgeString += string(edge->getParent()->getFunction()->getName()) + " -> " + string(edge->getChild()->getFunction()->getName()) + ",";
                 }
+                spdlog::info("Scheduling edges " + callGraphEdgeString + " to the inline queue for inlinable function " + string(node->getFunction()->getName()));
 #endif
-                // now combine indirect recursive subgraph edges into one entry in the schedule (the earliest one)
-                // since the evaluation is called-function-centric, when the indirect recursive functions are scheduled, they get different entries in the schedule
-                // but when evaluated for inlining, they will all get the same function subgraph (all functions involved in the indirect recursion)
-                // when the inliner completes an inline, it will delete all the original nodes in the graph, ruining future inlines of the same indirect recursive function subgraph
-                // to prevent this from happening, 
-                if (hasIndirectRecursion(dynamicCG, Q.back()))
-                {
-                    bool found = false;
-                    for (const auto &s : InlineTransformQ)
-                    {
-                        if (s == entry->second)
-                        {
-                            found = true;
-                            break;
-                        }
-                    }
-                    if (!found)
-                    {
-#ifdef DEBUG
-                        spdlog::info("Scheduling edges " + callGraphEdgeString + " to the inline queue for inlinable indirect-recursive function " + string(Q.back()->getFunction()->getName()));
-#endif
-                        InlineTransformQ.push_back(entry->second);
-                    }
-                }
-                else
+                InlineTransformQ.push_back(entry->second);
+                if (scc.hasIndirectRecursion(node))
                 {
-#ifdef DEBUG
-                    spdlog::info("Scheduling edges " + callGraphEdgeString + " to the inline queue for inlinable function " + string(Q.back()->getFunction()->getName()));
-#endif
-                    InlineTransformQ.push_back(entry->second);
-                }
-                covered.insert(Q.back());
-                Q.pop_back();
-            }
-            else
-            {
-                covered.insert(Q.back());
-            }
-        }
-        else
-        {
-            for (const auto &dep : currentDependencies)
-            {
-                if ((covered.find(dep->getChild()) == covered.end()))
-                {
-                    if (std::find(Q.begin(), Q.end(), dep->getChild()) == Q.end())
-                    {
-                        // the one-child-at-a-time push makes the search depth-first
-                        Q.push_back(dep->getChild());
-                        break;
-                    }
+                    break;
                 }
             }
         }
-        if (++schedulingIterations > 100000)
-        {
-            throw CyclebiteException("Inline scheduling algorithm iteration is greater than 100,000 with function " + string(Q.back()->getFunction()->getName()) + " at the back!");
-        }
     }
 #ifdef DEBUG
     // check to see if we terminated after everything was done
@@ -2019,42 +1706,22 @@ deque<set<shared_ptr<CallGraphEdge>, GECompare>> ScheduleInlineTransforms(const
     return InlineTransformQ;
 }
 
-void Cyclebite::Graph::VirtualizeSharedFunctions(ControlGraph &graph, const Cyclebite::Graph::CallGraph &dynamicCG)
+void Cyclebite::Graph::VirtualizeSharedFunctions(ProfileContext &context, ControlGraph &graph, const Cyclebite::Graph::CallGraph &dynamicCG)
 {
-    map<shared_ptr<Cyclebite::Graph::CallGraphNode>, set<shared_ptr<CallGraphEdge>, GECompare>, p_GNCompare> embFunctions;
     // set of nodes that are virtualized during the function inlining process
     // these nodes are removed after all function inlining is done
     set<shared_ptr<VirtualEdge>, GECompare> virtualizedEdges;
-    // order transforms such that we do indirect recursion, then direct recursion, then ascending order of embedded function call count
-    map<int, set<ControlNode *>> orderScore;
     // for some unknown reason, if this data structure uses shared pointers in its template, it breaks the c++ debugger
     map<shared_ptr<Cyclebite::Graph::CallGraphNode>, set<shared_ptr<Cyclebite::Graph::CallGraphEdge>, GECompare>, p_GNCompare> InlineCalls;
 
+    // recursion is answered by the strongly connected components of the callgraph, which also give the order of the inlines (transform is bottom-up in the callgraph, thus children go first [special case: indirect recursion])
+    CallGraphSCC scc(dynamicCG);
     // for each function (a node in the dynamic callgraph is a function known to have been exercised by the program)
     for (const auto &node : dynamicCG.getCallNodes())
     {
-        // find the child function calls of this function, it will be used later to order function inlines (transform is bottom-up in the callgraph, thus children go first [special case: indirect recursion])
-        embFunctions[node] = FindEmbeddedFunctions(dynamicCG, node);
-        
         // count number of function calls to this node
         // when counting entrances, we are only interested in calls from outsiders (ie no recursive entrances)
-        set<shared_ptr<CallGraphEdge>, GECompare> entrances;
-        if (hasIndirectRecursion(dynamicCG, node))
-        {
-            entrances = getIndirectRecursionEntrances(dynamicCG, node);
-        }
-        else if (hasDirectRecursion(dynamicCG, node))
-        {
-            // only take the edges that enter from outside the recursive function
-            entrances = getDirectRecursionEntrances(node);
-        }
-        else
-        {
-            for (const auto &parent : node->getParents())
-            {
-                entrances.insert(parent);
-            }
-        }
+        const auto &entrances = scc.getEntrances(node);
         // counts function callsites
         int entranceEdges = 0;
         for (const auto &e : entrances)
@@ -2073,7 +1740,7 @@ void Cyclebite::Graph::VirtualizeSharedFunctions(ControlGraph &graph, const Cycl
         return;
     }
 
-    auto InlineTransformQ = ScheduleInlineTransforms(dynamicCG, embFunctions, InlineCalls);
+    auto InlineTransformQ = ScheduleInlineTransforms(scc, InlineCalls);
     // for each set of callsites [each set is all callsites of a single function], generate a function subgraph using a random entry from the callsites set, prune that graph (according to what is possible at that callsite), and inline it
     for (const auto &cs : InlineTransformQ)
     {
@@ -2087,17 +1754,17 @@ void Cyclebite::Graph::VirtualizeSharedFunctions(ControlGraph &graph, const Cycl
         auto tokenEdge = *cs.begin();
         // generate a subgraph for this function that includes all child functions within it that have already been inlined
         ControlGraph funcGraph;
-        if (hasIndirectRecursion(dynamicCG, tokenEdge->getChild()))
+        if (scc.hasIndirectRecursion(tokenEdge->getChild()))
         {
             funcGraph = IndirectRecursionFunctionBFS(*tokenEdge->getCallEdges().begin());
         }
-        else if (hasDirectRecursion(dynamicCG, tokenEdge->getChild()))
+        else if (scc.hasDirectRecursion(tokenEdge->getChild()))
         {
-            funcGraph = DirectRecursionFunctionBFS(*tokenEdge->getCallEdges().begin());
+            funcGraph = DirectRecursionFunctionBFS(context, *tokenEdge->getCallEdges().begin());
         }
         else
         {
-            funcGraph = SimpleFunctionBFS(*tokenEdge->getCallEdges().begin());
+            funcGraph = SimpleFunctionBFS(context, *tokenEdge->getCallEdges().begin());
         }
         // now inline the function at each of its entrances
         for (const auto &fe : cs)
@@ -2112,7 +1779,7 @@ void Cyclebite::Graph::VirtualizeSharedFunctions(ControlGraph &graph, const Cycl
 #endif
                 // remove the parts of the graph that are unreachable at this particular callsite
                 removeUnreachableNodes(funcGraph, ce);
-                auto virtEdges = VirtualizeFunctionSubgraph(graph, funcGraph, ce, ce->rets.dynamicRets);
+                auto virtEdges = VirtualizeFunctionSubgraph(context, graph, funcGraph, ce, ce->rets.dynamicRets);
                 virtualizedEdges.insert(virtEdges.begin(), virtEdges.end());
             }
         }
@@ -2161,36 +1828,34 @@ void Cyclebite::Graph::VirtualizeSharedFunctions(ControlGraph &graph, const Cycl
                 graph.removeNode(node);
             }
         }
-#ifdef DEBUG
-        ofstream LastTransform("LastFunctionInlineTransform.dot");
-        auto LastTransformGraph = GenerateDot(graph);
-        LastTransform << LastTransformGraph << "\n";
-        LastTransform.close();
-#endif
+        if( Tracing(TraceLevel::Dot) )
+        {
+            ofstream LastTransform("LastFunctionInlineTransform.dot");
+            GenerateDot(LastTransform, graph, false, context.markovOrder);
+            LastTransform << "\n";
+        }
         Checks(graph, "FunctionInlineTransform");
     }
 
-#ifdef DEBUG
-    ofstream LastTransform("FinalFunctionInlineTransform.dot");
-    auto LastTransformGraph = GenerateDot(graph);
-    LastTransform << LastTransformGraph << "\n";
-    LastTransform.close();
-#endif
+    if( Tracing(TraceLevel::Dot) )
+    {
+        ofstream LastTransform("FinalFunctionInlineTransform.dot");
+        GenerateDot(LastTransform, graph, false, context.markovOrder);
+        LastTransform << "\n";
+    }
 }
 
-std::vector<shared_ptr<MLCycle>> Cyclebite::Graph::VirtualizeKernels(std::set<shared_ptr<MLCycle>, KCompare> &newKernels, ControlGraph &graph)
+std::vector<shared_ptr<MLCycle>> Cyclebite::Graph::VirtualizeKernels(ProfileContext &context, std::set<shared_ptr<MLCycle>, KCompare> &newKernels, ControlGraph &graph)
 {
     vector<shared_ptr<MLCycle>> newPointers;
     for (const auto &kernel : newKernels)
     {
         auto VN = static_pointer_cast<VirtualNode>(kernel);
         auto subgraph = ControlGraph( kernel->getSubgraph(), kernel->getSubgraphEdges(), (*(kernel->getEntrances().begin()))->getWeightedSnk() );
-        
-#ifdef DEBUG
-        auto subgraphString  = GenerateDot(subgraph);
-        auto beforeTransform = GenerateDot(graph);
-#endif
-        VirtualizeSubgraph(graph, VN, subgraph);
+        {
+            TransformScope trace(context, "KernelVirtualization", graph, &subgraph, "LastVirtualizationTransform.dot");
+            VirtualizeSubgraph(context, graph, VN, subgraph);
+        }
         // now balance the probabilities that come out of the node
         uint64_t totalFreq = 0;
         for( const auto& succ : VN->getSuccessors() )
@@ -2206,11 +1871,6 @@ std::vector<shared_ptr<MLCycle>> Cyclebite::Graph::VirtualizeKernels(std::set<sh
         }
         newPointers.push_back(kernel);
 #ifdef DEBUG
-        ofstream LastTransform("LastVirtualizationTransform.dot");
-        auto LastTransformGraph = GenerateDot(graph);
-        string output = "# Kernel Virtualization\n# Kernel Subgraph\n" + subgraphString + "\n# Old Graph\n" + beforeTransform + "\n# New Graph\n" + LastTransformGraph;
-        LastTransform << output << "\n";
-        LastTransform.close();
         Checks(graph, "Kernel Virtualization", true);
 #endif
     }
@@ -2524,7 +2184,7 @@ const std::shared_ptr<ControlNode> Cyclebite::Graph::FindNewSubgraph(ControlGrap
     return nullptr;
 }
 
-void LowFrequencyLoopTransform(ControlGraph& graph)
+void LowFrequencyLoopTransform(ProfileContext &context, ControlGraph& graph)
 {
     // John [9/30/2022]
     // be careful allowing lf loops to have multiple entrances/exits
@@ -2595,16 +2255,11 @@ void LowFrequencyLoopTransform(ControlGraph& graph)
         for( const auto& l : newCycles )
         {
             ControlGraph c(l->getSubgraph(), l->getSubgraphEdges(), (*(l->getEntrances().begin()))->getWeightedSnk());
-#ifdef DEBUG
-            ofstream LastTransform("LastLowFrequencyLoopTransform.dot");
-            string DotString = "# LowFrequencyLoop\n\n# Subgraph\n";
-            DotString += GenerateDot(c);
-            DotString += "\n# Old Graph\n";
-            DotString += GenerateDot(graph);
-            DotString += "\n# New Graph\n";
-#endif
             auto VN = make_shared<VirtualNode>();
-            VirtualizeSubgraph(graph, VN, c);
+            {
+                TransformScope trace(context, "LowFrequencyLoop", graph, &c, "LastLowFrequencyLoopTransform.dot");
+                VirtualizeSubgraph(context, graph, VN, c);
+            }
 #ifdef DEBUG
             // normalize exit edge to 1, if necessary
             if( VN->getSuccessors().size() == 1 )
@@ -2618,9 +2273,6 @@ void LowFrequencyLoopTransform(ControlGraph& graph)
                     }
                 }
             }
-            DotString += GenerateDot(graph);
-            LastTransform << DotString << "\n";
-            LastTransform.close();
             Checks(graph, "Low Frequency Loop Transform", true);
 #endif
         }
@@ -2680,16 +2332,27 @@ bool KCLTransform(ControlGraph& graph)
     return didChange;
 }
 
-void Cyclebite::Graph::ApplyCFGTransforms(ControlGraph &graph, const Cyclebite::Graph::CallGraph &dynamicCG, bool segmentations)
+/// Logs the entropy of the graph after a transform phase when transforms are traced, each solve warm-starts from the phase before it
+void TraceEntropy(const char *phase, const ControlGraph &graph, StationaryDistribution &stationary)
+{
+    if( Tracing(TraceLevel::Counters) )
+    {
+        auto rate = stationary.solve(graph.getControlNodes());
+        spdlog::info("TRANSFORMENTROPY: " + string(phase) + " rate=" + to_string(rate) + " total=" + to_string(stationary.totalEntropy()) + " iterations=" + to_string(stationary.iterations()));
+    }
+}
+
+void Cyclebite::Graph::ApplyCFGTransforms(ProfileContext &context, ControlGraph &graph, const Cyclebite::Graph::CallGraph &dynamicCG, bool segmentations)
 {
     if(!segmentations)
     {
-        #ifdef DEBUG
+        if( Tracing(TraceLevel::Dot) )
+        {
             ofstream debugStream2("MarkovControlGraph.dot");
-            auto staticGraph = GenerateDot(graph);
-            debugStream2 << staticGraph << "\n";
+            GenerateDot(debugStream2, graph, false, context.markovOrder);
+            debugStream2 << "\n";
             debugStream2.close();
-        #endif
+        }
     }
     // if segmentations is true, sum to one checks are not done
     try
@@ -2697,18 +2360,18 @@ void Cyclebite::Graph::ApplyCFGTransforms(ControlGraph &graph, const Cyclebite::
         auto graphSize = graph.size();
         timespec start, end, trivial_start, trivial_end, fifo_start, fifo_end, lfLoop_start, lfLoop_end;
         double totalTime;
-        string DotString;
+        StationaryDistribution stationary;
         if (!segmentations)
         {
             // Inline all the shared functions in the graph
             // this must be done before any transforms are applied to the graph (function call edges can be covered up by virtual nodes when they are part of a transform)
-            DotString = "# SharedFunction\n\n# Subgraph\n";
-            DotString += "\n# Old Graph\n";
-            DotString += GenerateDot(graph);
             while (clock_gettime(CLOCK_MONOTONIC, &start))
             {
             }
-            VirtualizeSharedFunctions(graph, dynamicCG);
+            {
+                TransformScope trace(context, "SharedFunction", graph);
+                VirtualizeSharedFunctions(context, graph, dynamicCG);
+            }
             // after virtualizing functions we attempt to balance out any discrepancies in the frequency flow of the graph, through the Kirkhoff's Current Law transform (flow out of a node must equal flow into that node)
             KCLTransform(graph); 
             while (clock_gettime(CLOCK_MONOTONIC, &end))
@@ -2716,6 +2379,7 @@ void Cyclebite::Graph::ApplyCFGTransforms(ControlGraph &graph, const Cyclebite::
             }
             totalTime = CalculateTime(&start, &end);
             spdlog::info("SHAREDFUNCTIONTRANSFORMTIME: " + to_string(totalTime));
+            TraceEntropy("SharedFunction", graph, stationary);
         }
 
         while (clock_gettime(CLOCK_MONOTONIC, &start))
@@ -2724,11 +2388,6 @@ void Cyclebite::Graph::ApplyCFGTransforms(ControlGraph &graph, const Cyclebite::
 #ifdef DEBUG
         if (graphSize != graph.size())
         {
-            DotString += "\n# New Graph\n";
-            ofstream LastTransform("LastTransform.dot");
-            DotString += GenerateDot(graph);
-            LastTransform << DotString << "\n";
-            LastTransform.close();
             if (!segmentations)
             {
                 SumToOne(graph.getNodes());
@@ -2754,20 +2413,12 @@ void Cyclebite::Graph::ApplyCFGTransforms(ControlGraph &graph, const Cyclebite::
             auto sub = TrivialTransforms(Q.front());
             if (!sub.empty())
             {
-#ifdef DEBUG
-                ofstream LastTransform("LastTransform.dot");
-                string DotString = "# Trivial Transform\n\n# Subgraph\n";
-                DotString += GenerateDot(sub);
-                DotString += "\n# Old Graph\n";
-                DotString += GenerateDot(graph);
-                DotString += "\n# New Graph\n";
-#endif
                 auto VN = make_shared<VirtualNode>();
-                VirtualizeSubgraph(graph, VN, sub);
+                {
+                    TransformScope trace(context, "TrivialTransform", graph, &sub);
+                    VirtualizeSubgraph(context, graph, VN, sub);
+                }
 #ifdef DEBUG
-                DotString += GenerateDot(graph);
-                LastTransform << DotString << "\n";
-                LastTransform.close();
                 if (!segmentations)
                 {
                     SumToOne(graph.getNodes());
@@ -2783,20 +2434,12 @@ void Cyclebite::Graph::ApplyCFGTransforms(ControlGraph &graph, const Cyclebite::
             sub = BranchToSelectTransforms(graph, Q.front());
             if (!sub.empty())
             {
-#ifdef DEBUG
-                ofstream LastTransform("LastTransform.dot");
-                string DotString = "# BranchToSelect\n\n# Subgraph\n";
-                DotString += GenerateDot(sub);
-                DotString += "\n# Old Graph\n";
-                DotString += GenerateDot(graph);
-                DotString += "\n# New Graph\n";
-#endif
                 auto VN = make_shared<VirtualNode>();
-                VirtualizeSubgraph(graph, VN, sub);
+                {
+                    TransformScope trace(context, "BranchToSelect", graph, &sub);
+                    VirtualizeSubgraph(context, graph, VN, sub);
+                }
 #ifdef DEBUG
-                DotString += GenerateDot(graph);
-                LastTransform << DotString << "\n";
-                LastTransform.close();
                 if (!segmentations)
                 {
                     SumToOne(graph.getNodes());
@@ -2820,6 +2463,10 @@ void Cyclebite::Graph::ApplyCFGTransforms(ControlGraph &graph, const Cyclebite::
         while( clock_gettime(CLOCK_MONOTONIC, &trivial_end) ){}
         totalTime = CalculateTime(&trivial_start, &trivial_end);
         spdlog::info("CFGSIMPLETRANSFORMTIME: " + to_string(totalTime));
+        if (!segmentations)
+        {
+            TraceEntropy("Simple", graph, stationary);
+        }
 
         // this is a global while loop that allows all transforms to transform the graph with each pass, each time possibly opening new opportunities for transform in the next iteration
         // the algorithm terminates when an iteration results in no changes to the size of the graph (where size of the graph is nodes+edges)
@@ -2842,20 +2489,12 @@ void Cyclebite::Graph::ApplyCFGTransforms(ControlGraph &graph, const Cyclebite::
                 auto sub = TrivialTransforms(Q.front());
                 if (!sub.empty())
                 {
-#ifdef DEBUG
-                    ofstream LastTransform("LastTransform.dot");
-                    string DotString = "# Trivial Transform\n\n# Subgraph\n";
-                    DotString += GenerateDot(sub);
-                    DotString += "\n# Old Graph\n";
-                    DotString += GenerateDot(graph);
-                    DotString += "\n# New Graph\n";
-#endif
                     auto VN = make_shared<VirtualNode>();
-                    VirtualizeSubgraph(graph, VN, sub);
+                    {
+                        TransformScope trace(context, "TrivialTransform", graph, &sub);
+                        VirtualizeSubgraph(context, graph, VN, sub);
+                    }
 #ifdef DEBUG
-                    DotString += GenerateDot(graph);
-                    LastTransform << DotString << "\n";
-                    LastTransform.close();
                     if (!segmentations)
                     {
                         SumToOne(graph.getNodes());
@@ -2871,20 +2510,12 @@ void Cyclebite::Graph::ApplyCFGTransforms(ControlGraph &graph, const Cyclebite::
                 sub = BranchToSelectTransforms(graph, Q.front());
                 if (!sub.empty())
                 {
-#ifdef DEBUG
-                    ofstream LastTransform("LastTransform.dot");
-                    string DotString = "# BranchToSelect\n\n# Subgraph\n";
-                    DotString += GenerateDot(sub);
-                    DotString += "\n# Old Graph\n";
-                    DotString += GenerateDot(graph);
-                    DotString += "\n# New Graph\n";
-#endif
                     auto VN = make_shared<VirtualNode>();
-                    VirtualizeSubgraph(graph, VN, sub);
+                    {
+                        TransformScope trace(context, "BranchToSelect", graph, &sub);
+                        VirtualizeSubgraph(context, graph, VN, sub);
+                    }
 #ifdef DEBUG
-                    DotString += GenerateDot(graph);
-                    LastTransform << DotString << "\n";
-                    LastTransform.close();
                     if (!segmentations)
                     {
                         SumToOne(graph.getNodes());
@@ -2899,20 +2530,12 @@ void Cyclebite::Graph::ApplyCFGTransforms(ControlGraph &graph, const Cyclebite::
                 auto sink = FindNewSubgraph(newSub, Q.front());
                 if (!newSub.empty())
                 {
-#ifdef DEBUG
-                    ofstream LastTransform("LastTransform.dot");
-                    string DotString = "# Complex Transform\n\n# Subgraph\n";
-                    DotString += GenerateDot(newSub);
-                    DotString += "\n# Old Graph\n";
-                    DotString += GenerateDot(graph);
-                    DotString += "\n# New Graph\n";
-#endif
                     auto VN = make_shared<VirtualNode>();
-                    VirtualizeSubgraph(graph, VN, newSub);
+                    {
+                        TransformScope trace(context, "ComplexTransform", graph, &newSub);
+                        VirtualizeSubgraph(context, graph, VN, newSub);
+                    }
 #ifdef DEBUG
-                    DotString += GenerateDot(graph);
-                    LastTransform << DotString << "\n";
-                    LastTransform.close();
                     if (!segmentations)
                     {
                         SumToOne(graph.getNodes());
@@ -2926,20 +2549,12 @@ void Cyclebite::Graph::ApplyCFGTransforms(ControlGraph &graph, const Cyclebite::
                 // Transform bottlenecks to avoid multiple entrance/multiple exit kernels
                 if (FanInFanOutTransform(newSub, Q.front(), sink))
                 {
-#ifdef DEBUG
-                    ofstream LastTransform("LastTransform.dot");
-                    string DotString = "# FanInFanOut\n\n# Subgraph\n";
-                    DotString += GenerateDot(sub);
-                    DotString += "\n# Old Graph\n";
-                    DotString += GenerateDot(graph);
-                    DotString += "\n# New Graph\n";
-#endif
                     auto VN = make_shared<VirtualNode>();
-                    VirtualizeSubgraph(graph, VN, newSub);
+                    {
+                        TransformScope trace(context, "FanInFanOut", graph, &newSub);
+                        VirtualizeSubgraph(context, graph, VN, newSub);
+                    }
 #ifdef DEBUG
-                    DotString += GenerateDot(graph);
-                    LastTransform << DotString << "\n";
-                    LastTransform.close();
                     if (!segmentations)
                     {
                         SumToOne(graph.getNodes());
@@ -2964,13 +2579,21 @@ void Cyclebite::Graph::ApplyCFGTransforms(ControlGraph &graph, const Cyclebite::
             while( clock_gettime(CLOCK_MONOTONIC, &fifo_end) ){}
             totalTime = CalculateTime(&fifo_start, &fifo_end);
             spdlog::info("CFGCOMPLEXTRANSFORMTIME: " + to_string(totalTime));
+            if (!segmentations)
+            {
+                TraceEntropy("Complex", graph, stationary);
+            }
 
             // get rid of low-frequency loops before kernel analysis
             while( clock_gettime(CLOCK_MONOTONIC, &lfLoop_start) ){}
-            LowFrequencyLoopTransform(graph);
+            LowFrequencyLoopTransform(context, graph);
             while( clock_gettime(CLOCK_MONOTONIC, &lfLoop_end) ) {}
             totalTime = CalculateTime(&lfLoop_start, &lfLoop_end);
             spdlog::info("LOWFREQUENCYLOOPTRANFORMTIME: " + to_string(totalTime));        
+            if (!segmentations)
+            {
+                TraceEntropy("LowFrequencyLoop", graph, stationary);
+            }
             
             // transform edge frequencies
             auto didChange = KCLTransform(graph);
@@ -2997,16 +2620,19 @@ void Cyclebite::Graph::ApplyCFGTransforms(ControlGraph &graph, const Cyclebite::
         spdlog::critical(e.what());
         exit(EXIT_FAILURE);
     }
-#ifdef DEBUG
     if( !segmentations )
     {
-        spdlog::info("Transformed Graph:");
-        ofstream debugStream3("simplifiedMarkovControlGraph.dot");
-        auto transformedStaticGraph = GenerateDot(graph);
-        debugStream3 << transformedStaticGraph << "\n";
-        debugStream3.close();
+        // counters are reported once per top-level call, segmentations call back into this function many times
+        ReportTransforms(context.transforms);
+        if( Tracing(TraceLevel::Dot) )
+        {
+            spdlog::info("Transformed Graph:");
+            ofstream debugStream3("simplifiedMarkovControlGraph.dot");
+            GenerateDot(debugStream3, graph, false, context.markovOrder);
+            debugStream3 << "\n";
+            debugStream3.close();
+        }
     }
-#endif
 }
 
 void reverse_cycle_transform(ControlGraph& graph, const set<shared_ptr<MLCycle>, p_GNCompare>& toRemove)
@@ -3097,7 +2723,7 @@ void reverse_cycle_transform(ControlGraph& graph, const set<shared_ptr<MLCycle>,
     graph = newGraph;
 }
 
-set<shared_ptr<MLCycle>, KCompare> Cyclebite::Graph::FindMLCycles(ControlGraph &graph, const Cyclebite::Graph::CallGraph &dynamicCG, bool applyTransforms)
+set<shared_ptr<MLCycle>, KCompare> Cyclebite::Graph::FindMLCycles(ProfileContext &context, ControlGraph &graph, const Cyclebite::Graph::CallGraph &dynamicCG, bool applyTransforms)
 {
     // master set of kernels, holds all valid kernels parsed from the CFG
     // each kernel in here is represented in the call graph by a virtual kernel node
@@ -3265,10 +2891,10 @@ set<shared_ptr<MLCycle>, KCompare> Cyclebite::Graph::FindMLCycles(ControlGraph &
         {
             newKernels.erase(r);
         }
-        auto newPointers = VirtualizeKernels(newKernels, graph);
+        auto newPointers = VirtualizeKernels(context, newKernels, graph);
         if (FindCycles(graph) && applyTransforms)
         {
-            ApplyCFGTransforms(graph, dynamicCG, true);
+            ApplyCFGTransforms(context, graph, dynamicCG, true);
         }
         for (const auto &p : newPointers)
         {
@@ -3279,7 +2905,7 @@ set<shared_ptr<MLCycle>, KCompare> Cyclebite::Graph::FindMLCycles(ControlGraph &
         spdlog::info("Transformed Graph after " + to_string(iterator) + " iterations:");
         // PrintGraph(graph.nodes);
         ofstream debugStream2("TransformedMarkovControlGraph_" + to_string(iterator) + ".dot");
-        auto transformedStaticGraph = GenerateDot(graph);
+        auto transformedStaticGraph = GenerateDot(graph, false, context.markovOrder);
         debugStream2 << transformedStaticGraph << "\n";
         debugStream2.close();
 #endif
@@ -3354,14 +2980,14 @@ set<shared_ptr<MLCycle>, KCompare> Cyclebite::Graph::FindMLCycles(ControlGraph &
         spdlog::info("Transformed Graph after " + to_string(iterator) + " iterations:");
         // PrintGraph(graph.nodes);
         ofstream debugStream2("FinalTransformedGraph.dot");
-        auto transformedStaticGraph = GenerateDot(graph);
+        auto transformedStaticGraph = GenerateDot(graph, false, context.markovOrder);
         debugStream2 << transformedStaticGraph << "\n";
         debugStream2.close();
 #endif
     return kernels;
 }
 
-void Cyclebite::Graph::FindAllRecursiveFunctions(const llvm::CallGraph &CG, const Graph &graph, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock)
+void Cyclebite::Graph::FindAllRecursiveFunctions(ProfileContext &context, const llvm::CallGraph &CG, const Graph &graph, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock)
 {
     uint32_t CGsize = 0;
     uint32_t totalFunctions = 0;
@@ -3384,7 +3010,7 @@ void Cyclebite::Graph::FindAllRecursiveFunctions(const llvm::CallGraph &CG, cons
         {
             for (auto fi = it->second->getFunction()->begin(); fi != it->second->getFunction()->end(); fi++)
             {
-                auto node = BlockToNode(graph, IDToBlock.at(Cyclebite::Util::GetBlockID(llvm::cast<llvm::BasicBlock>(fi))), NIDMap);
+                auto node = BlockToNode(context, graph, IDToBlock.at(Cyclebite::Util::GetBlockID(llvm::cast<llvm::BasicBlock>(fi))));
                 if (node != nullptr)
                 {
                     totalLiveFunctions++;
@@ -3425,31 +3051,32 @@ void Cyclebite::Graph::FindAllRecursiveFunctions(const llvm::CallGraph &CG, cons
     spdlog::info("DIRECT RECURSION FUNCTIONS: " + to_string(DR));
 }
 
-void Cyclebite::Graph::FindAllRecursiveFunctions(const Cyclebite::Graph::CallGraph &CG, const Graph &graph, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock)
+void Cyclebite::Graph::FindAllRecursiveFunctions(ProfileContext &context, const Cyclebite::Graph::CallGraph &CG, const Graph &graph, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock)
 {
     uint32_t CGsize = 0;
     uint32_t totalFunctions = 0;
     uint32_t totalLiveFunctions = 0;
     uint32_t IDR = 0;
     uint32_t DR = 0;
+    CallGraphSCC scc(CG);
     for (const auto &node : CG.getCallNodes())
     {
         CGsize++;
         totalFunctions++;
         for (auto fi = node->getFunction()->begin(); fi != node->getFunction()->end(); fi++)
         {
-            auto node = BlockToNode(graph, IDToBlock.at(Cyclebite::Util::GetBlockID(llvm::cast<llvm::BasicBlock>(fi))), NIDMap);
+            auto node = BlockToNode(context, graph, IDToBlock.at(Cyclebite::Util::GetBlockID(llvm::cast<llvm::BasicBlock>(fi))));
             if (node != nullptr)
             {
                 totalLiveFunctions++;
                 break;
             }
         }
-        if (hasIndirectRecursion(CG, node))
+        if (scc.hasIndirectRecursion(node))
         {
             IDR++;
         }
-        else if (hasDirectRecursion(CG, node))
+        else if (scc.hasDirectRecursion(node))
         {
             DR++;
         }
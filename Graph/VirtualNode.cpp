@@ -18,7 +18,7 @@ VirtualNode::VirtualNode() : ControlNode()
 bool VirtualNode::addNode(const std::shared_ptr<ControlNode> &newNode)
 {
     auto i = subgraph.insert(newNode);
-    blocks.insert(newNode->blocks.begin(), newNode->blocks.end());
+    blocks |= newNode->blocks;
     return i.second;
 }
 
@@ -33,7 +33,7 @@ void VirtualNode::addNodes(const set<std::shared_ptr<ControlNode>, p_GNCompare>
     subgraph.insert(newNodes.begin(), newNodes.end());
     for (const auto &node : newNodes)
     {
-        blocks.insert(node->blocks.begin(), node->blocks.end());
+        blocks |= node->blocks;
     }
 }
 
@@ -0,0 +1,33 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <utility>
+
+namespace Cyclebite::Graph
+{
+    class ControlNode;
+    class UnconditionalEdge;
+    /// @brief Memoized map from (virtual) graph objects to the profile block IDs they were built from
+    ///
+    /// Virtual edges and nodes are flattened once, the result of each level of the hierarchy is reused by every object that contains it
+    /// One index can be shared by every kernel file written for a graph, even across transforms, because results are keyed by object and objects are kept alive by the index
+    /// Throws CyclebiteException when an object bottoms out in a node that has no original blocks
+    class BlockIDIndex
+    {
+    public:
+        /// Returns the (source block, sink block) pairs of the original profile edges that underlie edge
+        const std::set<std::pair<int64_t, int64_t>> &getEdgeBlocks(const std::shared_ptr<UnconditionalEdge> &edge);
+        /// Returns the original blocks that underlie node
+        const std::set<int64_t> &getNodeBlocks(const std::shared_ptr<ControlNode> &node);
+
+    private:
+        std::map<std::shared_ptr<UnconditionalEdge>, std::set<std::pair<int64_t, int64_t>>> edgeBlocks;
+        std::map<std::shared_ptr<ControlNode>, std::set<int64_t>> nodeBlocks;
+    };
+} // namespace Cyclebite::Graph
@@ -16,6 +16,8 @@ namespace Cyclebite::Graph
         CallGraphEdge();
         CallGraphEdge(std::shared_ptr<CallGraphNode> sou, std::shared_ptr<CallGraphNode> sin, std::set<std::shared_ptr<CallEdge>, GECompare> calls);
         const std::set<std::shared_ptr<CallEdge>, GECompare> &getCallEdges() const;
+        /// Adds another call between the same parent and child to this edge
+        void addCallEdge(const std::shared_ptr<CallEdge> &call);
         const std::shared_ptr<CallGraphNode> getChild() const;
         const std::shared_ptr<CallGraphNode> getParent() const;
 
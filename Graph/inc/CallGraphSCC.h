@@ -0,0 +1,50 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#pragma once
+#include "CallGraphEdge.h"
+#include "CallGraphNode.h"
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace Cyclebite::Graph
+{
+    class CallGraph;
+    /// @brief Strongly connected components of a call graph, computed once with Tarjan's algorithm
+    ///
+    /// Answers the recursion questions about a function in constant time: its component, whether it is direct or indirect recursive, which functions share its cycle and which edges enter that cycle
+    /// Components are numbered in reverse topological order of the condensation, so every component comes after all the components it calls
+    /// The call graph must not change while its SCC is in use
+    class CallGraphSCC
+    {
+    public:
+        CallGraphSCC(const CallGraph &graph);
+        /// Returns the number of components
+        uint32_t size() const;
+        /// Returns the functions in a component
+        const std::set<std::shared_ptr<CallGraphNode>, p_GNCompare> &operator[](uint32_t component) const;
+        /// Returns the component of node, throws CyclebiteException if node is not in the call graph
+        uint32_t getComponent(const std::shared_ptr<CallGraphNode> &node) const;
+        /// True if node calls itself
+        bool hasDirectRecursion(const std::shared_ptr<CallGraphNode> &node) const;
+        /// True if node is on a cycle with other functions
+        bool hasIndirectRecursion(const std::shared_ptr<CallGraphNode> &node) const;
+        /// Returns every function on the cycle(s) of node, which is just node when it isn't indirect recursive
+        const std::set<std::shared_ptr<CallGraphNode>, p_GNCompare> &getCycle(const std::shared_ptr<CallGraphNode> &node) const;
+        /// Returns the edges that call into the cycle of node from outside of it (recursive calls are not entrances)
+        const std::set<std::shared_ptr<CallGraphEdge>, GECompare> &getEntrances(const std::shared_ptr<CallGraphNode> &node) const;
+
+    private:
+        /// Maps the NID of each function to its position in the vectors below
+        std::unordered_map<uint64_t, uint32_t> index;
+        std::vector<uint32_t> component;
+        std::vector<bool> selfCall;
+        std::vector<std::set<std::shared_ptr<CallGraphNode>, p_GNCompare>> members;
+        std::vector<std::set<std::shared_ptr<CallGraphEdge>, GECompare>> entrances;
+        uint32_t position(const std::shared_ptr<CallGraphNode> &node) const;
+    };
+} // namespace Cyclebite::Graph
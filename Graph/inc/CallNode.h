@@ -16,6 +16,8 @@ namespace Cyclebite::Graph
         CallNode( const Inst *upgrade, const std::set<std::shared_ptr<ControlBlock>, p_GNCompare>& dests );
         /// Returns the control block destinations possible from this call instrution
         const std::set<std::shared_ptr<ControlBlock>, p_GNCompare>& getDestinations() const;
+        /// Adds a control block this call can go to
+        void addDestination(const std::shared_ptr<ControlBlock>& dest);
         /// Returns the first non-debug, non-phi instruction in the destination blocks
         const std::set<std::shared_ptr<Inst>> getDestinationFirstInsts() const;
     private:
@@ -4,6 +4,7 @@
 //==------------------------------==//
 #pragma once
 #include "GraphNode.h"
+#include "Util/BlockSet.h"
 
 namespace Cyclebite::Graph
 {
@@ -17,7 +18,7 @@ namespace Cyclebite::Graph
         /// BBIDs from the source bitcode that are represented by this node
         /// Each key is a member BBID and its value is the basic block its unconditional edge points to
         /// If a key maps to itself, there is no edge attached to this block
-        std::set<int64_t> blocks;
+        Cyclebite::Util::BlockSet blocks;
         ControlNode();
         /// Meant to be constructed from a new block description in the input binary file
         ~ControlNode() = default;
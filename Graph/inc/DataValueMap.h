@@ -0,0 +1,46 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace llvm
+{
+    class Value;
+} // namespace llvm
+
+namespace Cyclebite::Graph
+{
+    class DataValue;
+    /// @brief Maps llvm values to the DataValue nodes that were built for them
+    ///
+    /// Values are indexed by their ValueID annotation (Util/Annotate.h:GetValueID), which makes the map a dense vector
+    /// Values without an ID (or with an ID beyond the reserved range) fall back to an ordered map
+    /// Different values may be written from different threads at once as long as their IDs are below reserve()
+    class DataValueMap
+    {
+    public:
+        /// Makes room for every value ID below count
+        void reserve(uint64_t count);
+        /// Returns true if the ID is inside the dense range, ie it can be written concurrently
+        bool dense(int64_t ID) const;
+        bool contains(const llvm::Value *v) const;
+        bool contains(const llvm::Value *v, int64_t ID) const;
+        /// Throws CyclebiteException if v has not been mapped
+        const std::shared_ptr<DataValue> &at(const llvm::Value *v) const;
+        const std::shared_ptr<DataValue> &at(const llvm::Value *v, int64_t ID) const;
+        /// Maps v to node, replacing the node that was there
+        void insert(const llvm::Value *v, const std::shared_ptr<DataValue> &node);
+        /// Same as insert(v, node) for callers that already have the ValueID of v
+        void insert(const llvm::Value *v, int64_t ID, const std::shared_ptr<DataValue> &node);
+        void clear();
+
+    private:
+        std::vector<std::shared_ptr<DataValue>> byID;
+        std::map<const llvm::Value *, std::shared_ptr<DataValue>> unnumbered;
+    };
+} // namespace Cyclebite::Graph
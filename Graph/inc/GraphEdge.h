@@ -3,6 +3,7 @@
 // SPDX-License-Identifier: Apache-2.0
 //==------------------------------==//
 #pragma once
+#include <atomic>
 #include <cstdint>
 #include <memory>
 
@@ -27,7 +28,8 @@ namespace Cyclebite::Graph
         float weight;
         std::shared_ptr<GraphNode> src;
         std::shared_ptr<GraphNode> snk;
-        static uint64_t nextEID;
+        // atomic because data flow graphs are built on several threads at once (see BuildDFG)
+        static std::atomic<uint64_t> nextEID;
         static uint64_t getNextEID();
     };
     /// Allows for us to search a set of GraphEdges using an EID
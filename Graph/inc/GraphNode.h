@@ -4,6 +4,7 @@
 //==------------------------------==//
 #pragma once
 #include "GraphEdge.h"
+#include <atomic>
 #include <cstdint>
 #include <map>
 #include <set>
@@ -27,12 +28,20 @@ namespace Cyclebite::Graph
         void removePredecessor(std::shared_ptr<GraphEdge> oldEdge);
         void addSuccessor(std::shared_ptr<GraphEdge> newEdge);
         void removeSuccessor(std::shared_ptr<GraphEdge> oldEdge);
+        /// Takes count NIDs off of the shared counter and returns the first one
+        /// The counter is shared by every thread, so graphs built at the same time on different threads still have unique NIDs
+        static uint64_t reserveNIDs(uint64_t count);
+        /// Nodes constructed on the calling thread take their NIDs from base onwards (a range from reserveNIDs()), NO_NID hands them back to the shared counter
+        /// Lets graphs be built on several threads and still get the NIDs of a serial build
+        static void useNIDs(uint64_t base);
+        static constexpr uint64_t NO_NID = UINT64_MAX;
 
     protected:
         GraphNode();
         std::set<std::shared_ptr<GraphEdge>, GECompare> successors;
         std::set<std::shared_ptr<GraphEdge>, GECompare> predecessors;
-        static uint64_t nextNID;
+        static std::atomic<uint64_t> nextNID;
+        static thread_local uint64_t threadNID;
         static uint64_t getNextNID();
     };
 
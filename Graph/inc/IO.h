@@ -3,12 +3,16 @@
 // SPDX-License-Identifier: Apache-2.0
 //==------------------------------==//
 #pragma once
+#include "DataValueMap.h"
+#include "ProfileContext.h"
 #include <llvm/Analysis/CallGraph.h>
 #include <llvm/IR/BasicBlock.h>
 #include <map>
 #include <nlohmann/json.hpp>
+#include <ostream>
 #include <set>
 #include <string>
+#include <vector>
 
 namespace Cyclebite::Graph
 {
@@ -23,22 +27,21 @@ namespace Cyclebite::Graph
     class ControlGraph;
     class DataGraph;
     class CallGraph;
+    class BlockIDIndex;
+    class StationaryDistribution;
+    class MarkovProfile;
+    class ProfileContainer;
     struct GNCompare;
     struct p_GNCompare;
     struct KCompare;
     struct GECompare;
     // maps the dynamic pass IDs to their LLVM objects
+    // these only depend on the bitcode, so they are shared by every profile and must not change after InitializeIDMaps()
+    // dynamic info from the markov profile lives in the ProfileContext of that profile
     extern std::map<int64_t, const llvm::BasicBlock *> IDToBlock;
     extern std::map<int64_t, const llvm::Value *> IDToValue;
-    // dynamic info from the markov profile
-    extern std::map<int64_t, std::vector<int64_t>> blockCallers;
-    extern std::map<int64_t, std::map<std::string, int64_t>> blockLabels;
-    extern std::set<int64_t> threadStarts;
-    // maps a block ID list (that represents the markov chain state, which could have arbitrary order number) to an llvm::BasicBlock ID which the node represents
-    // instantiated in cartographer/new/IO.cpp
-    extern std::map<std::vector<uint32_t>, uint64_t> NIDMap;
-    // maps an llvm instruction to its corresponding libGraph datanode, initialized in Graph/IO.cpp:BuildDFG()
-    extern std::map<const llvm::Value*, const std::shared_ptr<DataValue>> DNIDMap;
+    // maps an llvm instruction or argument to its corresponding libGraph datanode, indexed by ValueID, initialized in Graph/IO.cpp:BuildDFG()
+    extern DataValueMap DNIDMap;
     // maps an llvm basic block to its corresponding libGraph controlnode, initialized in Graph/IO.cpp:BuildDFG()
     extern std::map<const llvm::BasicBlock*, const std::shared_ptr<ControlBlock>> BBCBMap;
     struct EntropyInfo
@@ -53,13 +56,19 @@ namespace Cyclebite::Graph
         uint32_t end_edge_count;
     };
     void InitializeIDMaps(llvm::Module *M);
-    void ReadBlockInfo(const std::string &BlockInfo);
+    void ReadBlockInfo(ProfileContext &context, const std::string &BlockInfo);
+    void ReadBlockInfo(ProfileContext &context, const ProfileContainer &container);
     double TotalEntropy(const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &nodes);
     double EntropyCalculation(const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &nodes);
-    void getDynamicInformation(Cyclebite::Graph::ControlGraph& cg, Cyclebite::Graph::CallGraph& dynamicCG, const std::string& filePath, const std::unique_ptr<llvm::Module>& SourceBitcode, const llvm::CallGraph& staticCG, const std::map<int64_t, std::vector<int64_t>>& blockCallers, const std::set<int64_t>& threadStarts, const std::map<int64_t, const llvm::BasicBlock*>& IDToBlock, bool HotCodeDetection);
-    int BuildCFG(Graph &graph, const std::string &filename, bool HotCodeDetection);
-    const Cyclebite::Graph::CallGraph getDynamicCallGraph(llvm::Module *mod, const Graph &graph, const std::map<int64_t, std::vector<int64_t>> &blockCallers, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock);
-    void CallGraphChecks(const llvm::CallGraph &SCG, const Cyclebite::Graph::CallGraph &DCG, const Graph &dynamicGraph, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock);
+    /// Entropy rate of the graph, warm-started from the last solution of stationary (so repeated calls across transforms converge quickly)
+    double EntropyCalculation(const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &nodes, StationaryDistribution &stationary);
+    void getDynamicInformation(ProfileContext &context, Cyclebite::Graph::ControlGraph& cg, Cyclebite::Graph::CallGraph& dynamicCG, const std::string& filePath, const std::unique_ptr<llvm::Module>& SourceBitcode, const llvm::CallGraph& staticCG, const std::map<int64_t, const llvm::BasicBlock*>& IDToBlock);
+    void getDynamicInformation(ProfileContext &context, Cyclebite::Graph::ControlGraph& cg, Cyclebite::Graph::CallGraph& dynamicCG, const MarkovProfile& profile, const std::unique_ptr<llvm::Module>& SourceBitcode, const llvm::CallGraph& staticCG, const std::map<int64_t, const llvm::BasicBlock*>& IDToBlock);
+    void BuildCFG(ProfileContext &context, Graph &graph, const std::string &filename);
+    void BuildCFG(ProfileContext &context, Graph &graph, const ProfileContainer &container);
+    void BuildCFG(ProfileContext &context, Graph &graph, const MarkovProfile &profile);
+    const Cyclebite::Graph::CallGraph getDynamicCallGraph(ProfileContext &context, llvm::Module *mod, const Graph &graph, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock);
+    void CallGraphChecks(ProfileContext &context, const llvm::CallGraph &SCG, const Cyclebite::Graph::CallGraph &DCG, const Graph &dynamicGraph, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock);
     void BuildDFG( std::set<std::shared_ptr<ControlBlock>, p_GNCompare> &programFlow, 
                    DataGraph &graph, 
                    const std::unique_ptr<llvm::Module>& SourceBitcode, 
@@ -69,10 +78,13 @@ namespace Cyclebite::Graph
     std::map<std::string, std::map<std::string, std::map<std::string, int>>> ProfileKernels(const std::map<std::string, std::set<int64_t>> &kernels, llvm::Module *M, const std::map<int64_t, uint64_t> &blockCounts);
     std::set<std::pair<int64_t, int64_t>> findOriginalBlockIDs(const std::shared_ptr<UnconditionalEdge>& edge);
     void WriteKernelFile(const ControlGraph &graph, const std::set<std::shared_ptr<MLCycle>, KCompare> &kernels, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock, const std::map<int64_t, std::vector<int64_t>> &blockCallers, const EntropyInfo &info, const std::string &OutputFileName, bool hotCode = false);
-    std::string GenerateDot(const Graph &graph, bool original = false);
-    std::string GenerateCoverageDot(const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &coveredNodes, const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &uncoveredNodes);
+    void WriteKernelFile(const ControlGraph &graph, const std::set<std::shared_ptr<MLCycle>, KCompare> &kernels, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock, const std::map<int64_t, std::vector<int64_t>> &blockCallers, const EntropyInfo &info, const std::string &OutputFileName, bool hotCode, BlockIDIndex &index);
+    std::string GenerateDot(const Graph &graph, bool original = false, uint32_t markovOrder = 1);
+    /// Streams the dot of graph to dot, without building the whole string first
+    void GenerateDot(std::ostream &dot, const Graph &graph, bool original = false, uint32_t markovOrder = 1);
+    std::string GenerateCoverageDot(const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &coveredNodes, const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &uncoveredNodes, uint32_t markovOrder);
     std::string GenerateTransformedSegmentedDot(const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &nodes, const std::set<std::shared_ptr<MLCycle>, KCompare> &kernels, int markovOrder);
-    void GenerateDynamicCoverage(const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &dynamicNodes, const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &staticNodes);
+    void GenerateDynamicCoverage(const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &dynamicNodes, const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &staticNodes, uint32_t markovOrder);
     ControlGraph GenerateStaticCFG(llvm::Module *M);
     std::string GenerateDataDot(const std::set<std::shared_ptr<DataValue>, p_GNCompare> &nodes);
     std::string GenerateBBSubgraphDot(const std::set<std::shared_ptr<ControlBlock>, p_GNCompare> &BBs);
@@ -4,6 +4,7 @@
 //==------------------------------==//
 #pragma once
 #include "VirtualNode.h"
+#include <atomic>
 #include <deque>
 #include <string>
 #include <vector>
@@ -41,7 +42,7 @@ namespace Cyclebite::Graph
         /// set of KIDs that point to child kernels of this kernel
         std::set<std::shared_ptr<MLCycle>, p_GNCompare> childKernels;
         std::set<std::shared_ptr<MLCycle>, p_GNCompare> parentKernels;
-        static uint32_t nextKID;
+        static std::atomic<uint32_t> nextKID;
         static uint32_t getNextKID();
         void addParentKernel(std::shared_ptr<MLCycle> parent);
     };
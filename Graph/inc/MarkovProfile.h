@@ -0,0 +1,77 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace Cyclebite::Graph
+{
+    /// @brief On-disk layout of a single edge in a markov order 1 profile
+    ///
+    /// Matches the records written by __TA_WriteEdgeHashTable(): source block ID, sink block ID, then the edge frequency
+    /// Records start right after the 12-byte header, so the frequency field is not naturally aligned and the struct must be packed
+    struct __attribute__((packed)) ProfileEdge
+    {
+        uint32_t src;
+        uint32_t snk;
+        uint64_t frequency;
+    };
+
+    /// @brief Read-only, zero-copy view of a markov.bin profile
+    ///
+    /// The file is memory-mapped and its records are handed out in place, nothing is copied or parsed per-record
+    /// Each record is the markov order + 1 block IDs of a path, oldest first, then its frequency. In a markov order 1 profile the records are the edges of the control flow graph
+    /// Throws CyclebiteException when the file cannot be opened, is truncated or has markov order 0
+    class MarkovProfile
+    {
+    public:
+        MarkovProfile(const std::string &filename);
+        /// Views a profile that is already in memory (e.g. the edge section of a ProfileContainer). The caller keeps data alive
+        MarkovProfile(const uint8_t *data, size_t length);
+        ~MarkovProfile();
+        MarkovProfile(const MarkovProfile &) = delete;
+        MarkovProfile &operator=(const MarkovProfile &) = delete;
+        uint32_t getMarkovOrder() const;
+        /// Total number of blocks in the profiled program, every block ID in the profile is less than this number
+        uint32_t getBlockCount() const;
+        /// Number of records in the profile, the edges of a markov order 1 profile or the paths of a higher order one
+        uint32_t getEdgeCount() const;
+        /// @brief The edge array of a markov order 1 profile
+        ///
+        /// Throws CyclebiteException when the profile has a higher order, use getBlocks() and getFrequency() for those
+        const ProfileEdge *begin() const;
+        const ProfileEdge *end() const;
+        /// Edge i of a markov order 1 profile, not checked
+        const ProfileEdge &operator[](uint32_t i) const;
+        /// The markov order + 1 block IDs of record i, oldest first and the sink last
+        std::span<const uint32_t> getBlocks(uint32_t i) const;
+        /// The frequency of record i
+        uint64_t getFrequency(uint32_t i) const;
+        /// @brief The profile of each thread that follows the last edge (MARKOV_THREADS), empty when the profile has none
+        ///
+        /// Each view is a whole markov.bin profile of its own and points into this profile, so this object has to outlive them
+        std::vector<std::span<const uint8_t>> getThreadProfiles() const;
+        /// @brief Splits a thread count followed by that many markov.bin profiles (the THREAD_EDGES section of a profile container) into one view per profile
+        ///
+        /// Throws CyclebiteException when a profile runs past the end of payload
+        static std::vector<std::span<const uint8_t>> splitThreadProfiles(std::span<const uint8_t> payload);
+
+    private:
+        const uint8_t *base;
+        size_t length;
+        /// true when base is a mapping this object has to release
+        bool mapped;
+        uint32_t markovOrder;
+        uint32_t blockCount;
+        uint32_t edgeCount;
+        /// bytes in each record: markov order + 1 block IDs and the frequency
+        size_t recordSize;
+        const uint8_t *records;
+        void parseHeader(const std::string &name);
+    };
+} // namespace Cyclebite::Graph
@@ -99,7 +99,6 @@ namespace Cyclebite::Graph
         // default case
         nop
     };
-    void initOpToString();
     extern std::map<Operation, const char *> OperationToString;
     Operation GetOp(unsigned int op);
 } // namespace Cyclebite:Graph
\ No newline at end of file
@@ -0,0 +1,46 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#pragma once
+#include "ProfileFormat.h"
+#include <cstdint>
+#include <map>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace Cyclebite::Graph
+{
+    /// @brief Reader for a profile container (see Profile/Backend/HashTable/inc/ProfileFormat.h)
+    ///
+    /// Opening a container maps the file and reads its section table, nothing else
+    /// Each section is loaded on first access: uncompressed sections are handed out in place, compressed sections are inflated once and cached
+    /// Every section is checked against its checksum the first time it is loaded
+    /// Throws CyclebiteException when the file is not a container of a supported version or a section is corrupt
+    class ProfileContainer
+    {
+    public:
+        ProfileContainer(const std::string &filename);
+        ~ProfileContainer();
+        ProfileContainer(const ProfileContainer &) = delete;
+        ProfileContainer &operator=(const ProfileContainer &) = delete;
+        /// Returns true if the file at filename starts with the container magic
+        static bool isContainer(const std::string &filename);
+        uint32_t getVersion() const;
+        bool hasSection(__TA_ProfileSectionType type) const;
+        /// Returns the decompressed payload of a section, empty if the container doesn't have it
+        std::span<const uint8_t> getSection(__TA_ProfileSectionType type) const;
+
+    private:
+        std::string name;
+        const uint8_t *base;
+        size_t length;
+        uint32_t version;
+        std::map<uint32_t, __TA_ProfileSection> sections;
+        /// sections that have already been loaded (and verified)
+        mutable std::map<uint32_t, std::span<const uint8_t>> loaded;
+        /// holds the inflated payloads of compressed sections
+        mutable std::map<uint32_t, std::vector<uint8_t>> inflated;
+    };
+} // namespace Cyclebite::Graph
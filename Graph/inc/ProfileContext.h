@@ -0,0 +1,52 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#pragma once
+#include "GraphEdge.h"
+#include "TransformTrace.h"
+#include <cstdint>
+#include <limits>
+#include <llvm/IR/BasicBlock.h>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace Cyclebite::Graph
+{
+    class UnconditionalEdge;
+    class VirtualEdge;
+
+    /// Marks a block ID in ProfileContext::NIDMap that was not observed in the profile
+    constexpr uint64_t UNMAPPED_NID = std::numeric_limits<uint64_t>::max();
+
+    /// @brief Everything the graph library learns from one profile
+    ///
+    /// Each profile is read, transformed and segmented with a context of its own, which is passed to every function that reads or writes this state
+    /// So several profiles of the same bitcode can be segmented at once, on any thread
+    /// What only depends on the bitcode (IDToBlock and IDToValue in IO.h) is shared by every context and must not change after InitializeIDMaps()
+    struct ProfileContext
+    {
+        /// Markov order of the profile, set by BuildCFG()
+        uint32_t markovOrder = 1;
+        /// Maps a calling block ID to the blocks its calls were observed to enter, set by ReadBlockInfo()
+        std::map<int64_t, std::vector<int64_t>> blockCallers;
+        /// Maps a block ID to the frequency of each label it was observed with, set by ReadBlockInfo()
+        std::map<int64_t, std::map<std::string, int64_t>> blockLabels;
+        /// Blocks that start a program thread, set by ReadBlockInfo()
+        std::set<int64_t> threadStarts;
+        /// Maps a block ID to the NID of the node that represents it (at markov order 1 each node is exactly one block, above it the first node whose path ends in the block)
+        /// Sized by the block count in the profile header, blocks that are not in the profile stay UNMAPPED_NID, set by BuildCFG()
+        std::vector<uint64_t> NIDMap;
+        /// Maps the block path of a node (oldest block first) to its NID when the profile is above markov order 1, set by BuildCFG()
+        std::map<std::vector<uint32_t>, uint64_t> PathNIDMap;
+        /// Blocks that were looked up and not found in the profile, each is only reported once
+        std::set<const llvm::BasicBlock *> deadCode;
+        /// Maps an edge of the profile to the virtual edges that replaced it when its nodes were virtualized
+        std::map<std::shared_ptr<UnconditionalEdge>, std::set<std::shared_ptr<VirtualEdge>, GECompare>, GECompare> EdgeToVE;
+        /// Counters of the transforms applied to the graph of the profile (see TransformScope)
+        std::map<std::string, TransformCounters> transforms;
+    };
+} // namespace Cyclebite::Graph
@@ -0,0 +1,67 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#pragma once
+#include "GraphNode.h"
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace Cyclebite::Graph
+{
+    class ControlNode;
+    /// @brief Solves x = xP for the stationary distribution of the Markov chain described by a set of control nodes
+    ///
+    /// P is stored as a CSR snapshot of the graph, transposed so each row holds the edges that enter a node; rows are split across threads and each thread only writes its own rows
+    /// Power iteration runs on the lazy chain (I+P)/2, which has the same stationary distribution as P but cannot oscillate on periodic graphs
+    /// Probability that leaves the node set (program exit, edges into nodes outside of the set) restarts at the nodes that have no predecessors in the set
+    /// Each solve is warm-started from the previous one: nodes are matched by NID, and virtual nodes that didn't exist before start with the mass of their subgraphs
+    class StationaryDistribution
+    {
+    public:
+        /// @param tol          Iteration stops when the L1 distance between two successive iterates drops below this
+        /// @param maxIter      Iteration stops here even if the tolerance has not been met (with a warning)
+        /// @param threadCount  Number of threads to split rows across, 0 picks the hardware concurrency
+        StationaryDistribution(double tol = 1e-10, uint32_t maxIter = 100000, unsigned threadCount = 0);
+        /// Solves for the stationary distribution of nodes, returns the entropy rate of the chain
+        double solve(const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &nodes);
+        /// Entropy rate (bits per transition) of the last solve
+        double entropyRate() const;
+        /// Sum of the entropies of every node in the last solve, independent of the stationary distribution
+        double totalEntropy() const;
+        /// Number of iterations the last solve took
+        uint32_t iterations() const;
+        /// Returns the stationary probability of a node in the last solve, 0 if it wasn't in the set
+        double operator[](uint64_t NID) const;
+
+    private:
+        double tolerance;
+        uint32_t maxIterations;
+        unsigned threads;
+        uint32_t lastIterations;
+        /// First entry of each row in cols/probs
+        std::vector<uint64_t> rowStart;
+        /// Index of the predecessor node of each entry
+        std::vector<uint32_t> cols;
+        /// Transition probability of each entry
+        std::vector<double> probs;
+        /// Probability that leaves the node set from each node
+        std::vector<double> leak;
+        /// Share of the leaked probability that re-enters at each node
+        std::vector<double> restart;
+        /// -sum(p*log2(p)) over the successors of each node
+        std::vector<double> nodeEntropy;
+        /// NID of each row
+        std::vector<uint64_t> NIDs;
+        /// Current solution, one entry per row
+        std::vector<double> x;
+        /// Solution of the last solve, keyed by NID, warm-starts the next one
+        std::unordered_map<uint64_t, double> previous;
+        void snapshot(const std::set<std::shared_ptr<ControlNode>, p_GNCompare> &nodes);
+        double warmStart(const std::shared_ptr<ControlNode> &node) const;
+        void iterate();
+    };
+} // namespace Cyclebite::Graph
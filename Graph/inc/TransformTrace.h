@@ -0,0 +1,89 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#pragma once
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <string>
+
+// compile-time ceiling of the transform trace level (see TraceLevel)
+// levels above the ceiling compile to nothing, release builds keep counters so they can still be turned on at runtime
+#ifndef CYCLEBITE_TRACE_LEVEL
+#ifdef DEBUG
+#define CYCLEBITE_TRACE_LEVEL 2
+#else
+#define CYCLEBITE_TRACE_LEVEL 1
+#endif
+#endif
+
+namespace Cyclebite::Graph
+{
+    class Graph;
+    struct ProfileContext;
+
+    /// @brief How much diagnostic output the graph transforms produce
+    ///
+    /// Off      - nothing
+    /// Counters - per-transform application counts, nodes collapsed, edges rewritten and time, reported when the transforms finish
+    /// Dot      - counters, and a dot file of every transform (subgraph, graph before, graph after)
+    /// Set at runtime with the CYCLEBITE_TRACE environment variable (off, counters or dot), debug builds default to dot and release builds to off
+    enum class TraceLevel
+    {
+        Off = 0,
+        Counters = 1,
+        Dot = 2
+    };
+
+    /// Returns the runtime trace level, clamped to CYCLEBITE_TRACE_LEVEL
+    TraceLevel GetTraceLevel();
+
+    /// Returns true when level is both compiled in and enabled at runtime
+    inline bool Tracing(TraceLevel level)
+    {
+        return ((int)level <= CYCLEBITE_TRACE_LEVEL) && (GetTraceLevel() >= level);
+    }
+
+    /// Counters of one transform
+    struct TransformCounters
+    {
+        uint64_t applications = 0;
+        uint64_t nodesCollapsed = 0;
+        uint64_t edgesRewritten = 0;
+        double seconds = 0.0;
+    };
+
+    /// Adds an application of a transform to the counters of a profile
+    void CountTransform(std::map<std::string, TransformCounters> &counters, const std::string &transform, uint64_t nodesCollapsed, uint64_t edgesRewritten, double seconds);
+
+    /// Logs the counters of every transform seen since the last report, then clears them
+    void ReportTransforms(std::map<std::string, TransformCounters> &counters);
+
+    /// @brief Traces one application of a transform for its lifetime
+    ///
+    /// Counts the nodes and edges that disappear from the graph while the scope is alive and times the transform
+    /// At TraceLevel::Dot the subgraph and the graph before and after the transform are streamed to dotFile
+    /// Does nothing (not even look at the graph) when tracing is off
+    /// The application is counted in the transforms of context
+    class TransformScope
+    {
+    public:
+        TransformScope(ProfileContext &context, const char *transform, const Graph &graph, const Graph *subgraph = nullptr, const char *dotFile = "LastTransform.dot");
+        ~TransformScope();
+        /// Adds edges that were rewritten in place, these don't show up in the edge count of the graph
+        void rewrote(uint64_t count);
+
+    private:
+        ProfileContext &context;
+        const char *transform;
+        const Graph &graph;
+        bool active;
+        uint64_t nodes;
+        uint64_t edges;
+        uint64_t rewritten;
+        struct timespec start;
+        std::ofstream dot;
+    };
+} // namespace Cyclebite::Graph
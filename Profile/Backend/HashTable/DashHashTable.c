@@ -3,11 +3,14 @@
 // SPDX-License-Identifier: Apache-2.0
 //==------------------------------==//
 #include "DashHashTable.h"
+#include "ProfileFormat.h"
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <zlib.h>
 #ifdef DEBUG
 #include <unistd.h>
 #endif
@@ -337,6 +340,175 @@ extern "C"
         printf("\nHASHTABLEPRINTTIME: %f\n", totalTime);
     }
 
+    uint8_t *__TA_SerializeEdgeHashTable(__TA_HashTable *a, uint32_t blockCount, uint64_t *size)
+    {
+        uint32_t edges = 0;
+        for (uint32_t i = 0; i < a->getFullSize(a); i++)
+        {
+            edges += a->array[i].popCount;
+        }
+        // same layout as __TA_WriteEdgeHashTable(): markov order, block count, edge count, then the edges
+        uint64_t recordSize = (MARKOV_ORDER + 1) * sizeof(uint32_t) + sizeof(uint64_t);
+        *size = 3 * sizeof(uint32_t) + (uint64_t)edges * recordSize;
+        uint8_t *buffer = (uint8_t *)malloc(*size);
+        if (!buffer)
+        {
+            printf("Malloc failed!");
+            *size = 0;
+            return NULL;
+        }
+        uint8_t *w = buffer;
+        uint32_t MO = MARKOV_ORDER;
+        memcpy(w, &MO, sizeof(uint32_t));
+        w += sizeof(uint32_t);
+        memcpy(w, &blockCount, sizeof(uint32_t));
+        w += sizeof(uint32_t);
+        memcpy(w, &edges, sizeof(uint32_t));
+        w += sizeof(uint32_t);
+        for (uint32_t i = 0; i < a->getFullSize(a); i++)
+        {
+            for (uint32_t j = 0; j < a->array[i].popCount; j++)
+            {
+                memcpy(w, &(a->array[i].tuple[j].edge.blocks), (MARKOV_ORDER + 1) * sizeof(uint32_t));
+                w += (MARKOV_ORDER + 1) * sizeof(uint32_t);
+                memcpy(w, &(a->array[i].tuple[j].edge.frequency), sizeof(uint64_t));
+                w += sizeof(uint64_t);
+            }
+        }
+        return buffer;
+    }
+
+    // pads the file with zeros until its position is a multiple of 8
+    static uint64_t __TA_alignContainer(FILE *f)
+    {
+        uint64_t pos = (uint64_t)ftell(f);
+        const uint8_t zeros[8] = {0};
+        if (pos % 8)
+        {
+            fwrite(zeros, 1, 8 - (pos % 8), f);
+            pos += 8 - (pos % 8);
+        }
+        return pos;
+    }
+
+    // writes the payload of a section at the current (aligned) position of f and fills out its table entry
+    static uint8_t __TA_writeSection(FILE *f, const __TA_ProfileSectionData *data, __TA_ProfileSection *entry)
+    {
+        entry->type = data->type;
+        entry->compression = __TA_COMPRESSION_NONE;
+        entry->offset = __TA_alignContainer(f);
+        entry->size = data->size;
+        entry->storedSize = data->size;
+        entry->reserved = 0;
+        // crc32() takes a 32-bit length, so large payloads are checksummed in chunks
+        uLong crc = crc32(0L, Z_NULL, 0);
+        const Bytef *c = (const Bytef *)data->data;
+        uint64_t remaining = data->size;
+        while (remaining)
+        {
+            uInt chunk = remaining > 0x40000000UL ? 0x40000000U : (uInt)remaining;
+            crc = crc32(crc, c, chunk);
+            c += chunk;
+            remaining -= chunk;
+        }
+        entry->checksum = (uint32_t)crc;
+        if (data->compression == __TA_COMPRESSION_ZLIB)
+        {
+            uLongf bound = compressBound((uLong)data->size);
+            Bytef *compressed = (Bytef *)malloc(bound);
+            if (compressed && (compress2(compressed, &bound, (const Bytef *)data->data, (uLong)data->size, Z_DEFAULT_COMPRESSION) == Z_OK) && (bound < data->size))
+            {
+                entry->compression = __TA_COMPRESSION_ZLIB;
+                entry->storedSize = bound;
+                fwrite(compressed, 1, bound, f);
+                free(compressed);
+                return 0;
+            }
+            free(compressed);
+        }
+        if (data->size && (fwrite(data->data, 1, data->size, f) != data->size))
+        {
+            return 1;
+        }
+        return 0;
+    }
+
+    uint8_t __TA_WriteProfileContainer(const char *path, const __TA_ProfileSectionData *sections, uint32_t count)
+    {
+        FILE *f = fopen(path, "wb");
+        if (!f)
+        {
+            printf("Could not open profile container %s\n", path);
+            return 1;
+        }
+        // the header is written twice: once to reserve its space and again once the section table offset is known
+        __TA_ProfileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, PROFILE_CONTAINER_MAGIC, sizeof(PROFILE_CONTAINER_MAGIC));
+        header.version = PROFILE_CONTAINER_VERSION;
+        header.sectionCount = count;
+        fwrite(&header, sizeof(header), 1, f);
+        __TA_ProfileSection *table = (__TA_ProfileSection *)calloc(count ? count : 1, sizeof(__TA_ProfileSection));
+        uint8_t err = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            err |= __TA_writeSection(f, &sections[i], &table[i]);
+        }
+        header.tableOffset = __TA_alignContainer(f);
+        fwrite(table, sizeof(__TA_ProfileSection), count, f);
+        fseek(f, 0, SEEK_SET);
+        fwrite(&header, sizeof(header), 1, f);
+        fclose(f);
+        free(table);
+        return err;
+    }
+
+    uint8_t __TA_AppendProfileSection(const char *path, const __TA_ProfileSectionData *section)
+    {
+        FILE *f = fopen(path, "r+b");
+        if (!f)
+        {
+            printf("Could not open profile container %s\n", path);
+            return 1;
+        }
+        __TA_ProfileHeader header;
+        if ((fread(&header, sizeof(header), 1, f) != 1) || memcmp(header.magic, PROFILE_CONTAINER_MAGIC, sizeof(PROFILE_CONTAINER_MAGIC)) || (header.version != PROFILE_CONTAINER_VERSION))
+        {
+            printf("%s is not a version %d profile container\n", path, PROFILE_CONTAINER_VERSION);
+            fclose(f);
+            return 1;
+        }
+        // the old table is dropped from the file, so keep a copy of it with room for the new entry
+        __TA_ProfileSection *table = (__TA_ProfileSection *)calloc(header.sectionCount + 1, sizeof(__TA_ProfileSection));
+        fseek(f, (long)header.tableOffset, SEEK_SET);
+        if (fread(table, sizeof(__TA_ProfileSection), header.sectionCount, f) != header.sectionCount)
+        {
+            printf("Section table of %s is truncated\n", path);
+            free(table);
+            fclose(f);
+            return 1;
+        }
+        // a replaced section is dropped from the table, its old payload simply becomes dead space in the file
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < header.sectionCount; i++)
+        {
+            if (table[i].type != section->type)
+            {
+                table[count++] = table[i];
+            }
+        }
+        fseek(f, (long)header.tableOffset, SEEK_SET);
+        uint8_t err = __TA_writeSection(f, section, &table[count++]);
+        header.sectionCount = count;
+        header.tableOffset = __TA_alignContainer(f);
+        fwrite(table, sizeof(__TA_ProfileSection), count, f);
+        fseek(f, 0, SEEK_SET);
+        fwrite(&header, sizeof(header), 1, f);
+        fclose(f);
+        free(table);
+        return err;
+    }
+
     // this function is not built to handle markov orders above 1
     void __TA_ReadEdgeHashTable(__TA_HashTable *a, char *path)
     {
@@ -11,8 +11,7 @@
 #define TUPLE_SIZE 15
 
 // This number is only allowed to be 1
-// It used to be used to show what happens when the profile increases the dimension of the transition table
-// But it turns out that doesn't help our analysis, and makes transformations and processing more complicated
+// The edge hash table is always an order 1 profile, higher orders are profiled by the path tables of MarkovPaths.h when the MARKOV_ORDER environment variable asks for them
 #define MARKOV_ORDER 1
 
 // output binary file name
@@ -154,6 +153,12 @@ extern "C"
     /// For a custom name, set the MARKOV_FILE environment variable
     void __TA_WriteEdgeHashTable(__TA_HashTable *a, uint32_t blockCount);
 
+    /// @brief Serializes the edge hash table
+    ///
+    /// The returned buffer holds exactly the bytes __TA_WriteEdgeHashTable() would put in a file
+    /// It is allocated with malloc and its length is written to size
+    uint8_t *__TA_SerializeEdgeHashTable(__TA_HashTable *a, uint32_t blockCount, uint64_t *size);
+
     /// Read the hash table from the file in path to the hash table a
     /// The file in path must be written in the same format and semantic as described in __TA_WriteHashTable()
     void __TA_ReadEdgeHashTable(__TA_HashTable *a, char *path);
@@ -0,0 +1,105 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#ifndef PROFILEFORMAT_H
+#define PROFILEFORMAT_H
+
+#include <stdint.h>
+
+// first 8 bytes of every profile container
+#define PROFILE_CONTAINER_MAGIC "CYBPROF"
+// bumped whenever the header, the section table or a section payload changes layout
+#define PROFILE_CONTAINER_VERSION 1
+
+// set the PROFILE_CONTAINER environment variable to a file name to have the backends write a profile container instead of markov.bin and BlockInfo.json
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /// @brief Payload kinds that can live in a profile container
+    ///
+    /// Each type appears at most once in a container. Payload layouts (all little-endian, records packed back-to-back):
+    /// EDGES            - exactly the bytes of a markov.bin file (markov order, block count, edge count, then the edge records)
+    /// LABELS           - { uint32_t block; uint32_t length; uint64_t frequency; char label[length]; }
+    /// CALLERS          - { uint32_t caller; uint32_t callee; uint32_t position; } position is the index of the call within its original (unsplit) block
+    /// THREAD_LAUNCHERS - uint32_t block IDs that launch a thread
+    /// THREAD_ENTRANCES - uint32_t block IDs that are the entrance to a spawned thread
+    /// LOOPS            - json text in the format of Loopinfo.json
+    /// MEMORY_EPOCHS    - json text in the format of instance.json
+    /// THREAD_EDGES     - uint32_t thread count, then the bytes of a markov.bin file for each thread (MARKOV_THREADS), a markov.bin file carries the same bytes after its last edge
+    typedef enum ProfileSectionType
+    {
+        __TA_SECTION_EDGES = 0,
+        __TA_SECTION_LABELS = 1,
+        __TA_SECTION_CALLERS = 2,
+        __TA_SECTION_THREAD_LAUNCHERS = 3,
+        __TA_SECTION_THREAD_ENTRANCES = 4,
+        __TA_SECTION_LOOPS = 5,
+        __TA_SECTION_MEMORY_EPOCHS = 6,
+        __TA_SECTION_THREAD_EDGES = 7,
+        __TA_SECTION_COUNT
+    } __TA_ProfileSectionType;
+
+    typedef enum ProfileCompression
+    {
+        __TA_COMPRESSION_NONE = 0,
+        __TA_COMPRESSION_ZLIB = 1,
+        // reserved, this build does not link zstd so sections are never written with it
+        __TA_COMPRESSION_ZSTD = 2
+    } __TA_ProfileCompression;
+
+    typedef struct ProfileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t sectionCount;
+        // byte offset of the section table (sectionCount __TA_ProfileSection entries)
+        uint64_t tableOffset;
+    } __TA_ProfileHeader;
+
+    typedef struct ProfileSection
+    {
+        uint32_t type;
+        uint32_t compression;
+        // byte offset of the payload, always a multiple of 8 so uncompressed payloads can be used in place
+        uint64_t offset;
+        // number of bytes the payload occupies in the file
+        uint64_t storedSize;
+        // number of bytes of the payload once decompressed
+        uint64_t size;
+        // crc32 of the decompressed payload
+        uint32_t checksum;
+        uint32_t reserved;
+    } __TA_ProfileSection;
+
+    /// @brief Describes a section to be written to a profile container
+    ///
+    /// If compression is requested but doesn't make the payload smaller, the payload is stored uncompressed
+    typedef struct ProfileSectionData
+    {
+        uint32_t type;
+        uint32_t compression;
+        const void *data;
+        uint64_t size;
+    } __TA_ProfileSectionData;
+
+    /// @brief Writes a new profile container to path
+    ///
+    /// Returns 0 on success
+    uint8_t __TA_WriteProfileContainer(const char *path, const __TA_ProfileSectionData *sections, uint32_t count);
+
+    /// @brief Adds a section to an existing profile container
+    ///
+    /// The new payload overwrites the old section table, then a new table is written behind it
+    /// If a section of the same type already exists, it is replaced
+    /// Returns 0 on success
+    uint8_t __TA_AppendProfileSection(const char *path, const __TA_ProfileSectionData *section);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
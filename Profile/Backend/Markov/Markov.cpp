@@ -3,9 +3,13 @@
 // SPDX-License-Identifier: Apache-2.0
 //==------------------------------==//
 #include "DashHashTable.h"
+#include "EdgeCounters.h"
+#include "MarkovPaths.h"
+#include "ProfileFormat.h"
 #include "ThreadSafeQueue.h"
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <fstream>
 #include <iomanip>
@@ -14,6 +18,9 @@
 #include <string>
 #include <thread>
 #include <set>
+#include <deque>
+#include <map>
+#include <vector>
 
 #define STACK_SIZE 0xff
 
@@ -103,8 +110,10 @@ namespace Cyclebite::Markov
 
     // holds the count of all blocks in the bitcode source file
     uint64_t totalBlocks;
-    // Circular buffer of the previous MARKOV_ORDER blocks seen
-    uint64_t b[MARKOV_ORDER];
+    // paths of each thread when the MARKOV_ORDER environment variable asks for a profile above order 1, nullptr when the edge hash table is the profile
+    std::unique_ptr<PathProfile> paths;
+    // order 1 edges of each thread when the MARKOV_THREADS environment variable is set, the edge hash table still holds the merged profile
+    std::unique_ptr<PathProfile> threadEdges;
     // Flag indicating whether the program is actively being profiled
     bool markovActive = false;
     // Hash table for the edges of the control flow graph
@@ -140,6 +149,28 @@ namespace Cyclebite::Markov
     // atomic to keep track of how many threads are currently using the backend
     std::atomic<uint32_t> miners = 0;
 
+    /// @brief Counts the edges around a call site
+    ///
+    /// Profiled binaries keep their calls inside their original blocks (see Join() in Util/Split.h), so the block Split() gave to a call is never entered through MarkovIncrement
+    /// The edge into a call block always comes from the same block, so it is counted here and written to the edge table when the profile is done
+    struct CallSite
+    {
+        // times the call was reached
+        std::atomic<uint64_t> count;
+        // block that precedes the call block
+        std::atomic<uint32_t> src;
+        // times the call fell through to the block after it without entering profiled code
+        std::atomic<uint64_t> fallthrough;
+        // block that follows the call block
+        std::atomic<uint32_t> post;
+    };
+    // indexed by the block ID of a call
+    CallSite *callSites;
+    // edge counters of functions the pass placed on the edges outside of a spanning tree (-markov-placement=spanning-tree), see CounterPlacement.h in the pass
+    const uint64_t *edgeCounters = nullptr;
+    const int64_t *edgeTable = nullptr;
+    uint64_t edgeTableSize = 0;
+
     void __TA_WriteJsonFiles(__TA_HashTable *labelHashTable, __TA_HashTable *callerHashTable, const std::set<uint64_t>& launchers, const std::set<uint64_t>& threadStarts )
     {
         // construct BlockInfo json output
@@ -175,7 +206,7 @@ namespace Cyclebite::Markov
         // representing the caller-callee data is a 2D problem
         // x -> multiple function calls for a given basic block (ie multiple callees for one caller)
         // y -> multiple functions for a given call inst (function pointers can go to different places)
-        // we do away with X by splitting basic blocks at function calls (therefore, the "position" member in callee.position is not used... it is always 0)
+        // we do away with X because every call has its own block ID (therefore, the "position" member in callee.position is not needed here... it only records where the call sits in its original block)
         // we still have to deal with y
         for (auto caller : callerMap)
         {
@@ -209,6 +240,178 @@ namespace Cyclebite::Markov
         file << setw(4) << blockInfo;
         file.close();
     }
+
+    /// Adds an event to the task of the calling thread, and pushes the task to the queue when it is full
+    template <typename T>
+    void pushEvent(const T &inc)
+    {
+        auto t = TB.getPtr(inc);
+        if( !taskBuffer.at(std::this_thread::get_id()).addEvent( t ) )
+        {
+            if( !Q.push(taskBuffer.at(std::this_thread::get_id()), true) )
+            {
+#ifdef DEBUG
+                printf("Task queue push returned error code\n");
+#endif
+            }
+            taskBuffer.at(std::this_thread::get_id()).reset();
+            taskBuffer.at(std::this_thread::get_id()).addEvent( t );
+        }
+    }
+
+    /// Records the current label for a block that is not entered through MarkovIncrement
+    void pushLabel(uint64_t a)
+    {
+        if (stackCount > 0)
+        {
+            labelInc.at(std::this_thread::get_id()).label = readLabelStack();
+            labelInc.at(std::this_thread::get_id()).snk = a;
+            pushEvent(labelInc.at(std::this_thread::get_id()));
+        }
+    }
+
+    /// Moves the calling thread to block a in the path tables, the edge hash table is fed through the task queue instead
+    void enterPath(uint64_t a)
+    {
+        if (paths)
+        {
+            paths->Enter((uint32_t)a);
+        }
+        if (threadEdges)
+        {
+            threadEdges->Enter((uint32_t)a);
+        }
+    }
+
+    /// Adds freq to the edge src->snk in an edge hash table, for edges that were counted outside of the hash table
+    void __TA_AddEdge(__TA_HashTable *edgeHashTable, uint32_t src, uint32_t snk, uint64_t freq)
+    {
+        __TA_element e;
+        e.edge.blocks[0] = src;
+        e.edge.blocks[1] = snk;
+        e.edge.frequency = freq;
+        if (auto existing = __TA_HashTable_read(edgeHashTable, &e))
+        {
+            e.edge.frequency += existing->edge.frequency;
+        }
+        while (__TA_HashTable_write(edgeHashTable, &e))
+        {
+            __TA_resolveClash(edgeHashTable, edgeHashTable->size + 1);
+        }
+    }
+
+    /// Writes the edges counted at call sites to the edge hash table
+    void __TA_FlushCallSites(__TA_HashTable *edgeHashTable, CallSite *callSites, uint64_t blockCount)
+    {
+        for (uint64_t i = 0; i < blockCount; i++)
+        {
+            if (callSites[i].count)
+            {
+                __TA_AddEdge(edgeHashTable, callSites[i].src, (uint32_t)i, callSites[i].count);
+            }
+            if (callSites[i].fallthrough)
+            {
+                __TA_AddEdge(edgeHashTable, (uint32_t)i, callSites[i].post, callSites[i].fallthrough);
+            }
+        }
+    }
+
+    /// @brief Writes the edges of the counted functions to the edge hash table, see SolveEdgeCounters() in EdgeCounters.h
+    void __TA_FlushCounters(__TA_HashTable *edgeHashTable, const uint64_t *counters, const int64_t *table, uint64_t tableSize)
+    {
+        SolveEdgeCounters(counters, table, tableSize, [&](uint32_t src, uint32_t snk, uint64_t count) {
+            __TA_AddEdge(edgeHashTable, src, snk, count);
+        });
+    }
+
+    /// Appends the raw bytes of val to buf
+    template <typename T>
+    void appendBytes(vector<uint8_t> &buf, const T &val)
+    {
+        auto p = reinterpret_cast<const uint8_t *>(&val);
+        buf.insert(buf.end(), p, p + sizeof(T));
+    }
+
+    /// Writes the edges, labels, caller map and thread sets into a single profile container (see ProfileFormat.h for the section layouts)
+    /// The edge section is the serialized markov.bin of the profile, whatever its order. threads holds the tables of each thread, it is left out of the container when empty
+    void __TA_WriteContainer(const char *path, const uint8_t *edges, uint64_t edgeSize, const vector<uint8_t> &threads, __TA_HashTable *labelHashTable, __TA_HashTable *callerHashTable, const std::set<uint64_t> &launchers, const std::set<uint64_t> &threadStarts)
+    {
+        vector<uint8_t> labels;
+        for (uint32_t i = 0; i < labelHashTable->getFullSize(labelHashTable); i++)
+        {
+            for (uint32_t j = 0; j < labelHashTable->array[i].popCount; j++)
+            {
+                const auto &entry = labelHashTable->array[i].tuple[j].label;
+                auto length = (uint32_t)strlen(entry.label);
+                appendBytes(labels, entry.blocks[0]);
+                appendBytes(labels, length);
+                appendBytes(labels, entry.frequency);
+                labels.insert(labels.end(), entry.label, entry.label + length);
+            }
+        }
+        vector<uint8_t> callers;
+        for (uint32_t i = 0; i < callerHashTable->getFullSize(callerHashTable); i++)
+        {
+            for (uint32_t j = 0; j < callerHashTable->array[i].popCount; j++)
+            {
+                const auto &entry = callerHashTable->array[i].tuple[j].callee;
+                appendBytes(callers, entry.blocks[0]);
+                appendBytes(callers, entry.blocks[1]);
+                appendBytes(callers, entry.position);
+            }
+        }
+        vector<uint32_t> launch(launchers.begin(), launchers.end());
+        vector<uint32_t> starts(threadStarts.begin(), threadStarts.end());
+        // edges are left uncompressed so readers can use them in place
+        vector<__TA_ProfileSectionData> sections = {
+            {__TA_SECTION_EDGES, __TA_COMPRESSION_NONE, edges, edgeSize},
+            {__TA_SECTION_LABELS, __TA_COMPRESSION_ZLIB, labels.data(), labels.size()},
+            {__TA_SECTION_CALLERS, __TA_COMPRESSION_ZLIB, callers.data(), callers.size()},
+            {__TA_SECTION_THREAD_LAUNCHERS, __TA_COMPRESSION_NONE, launch.data(), launch.size() * sizeof(uint32_t)},
+            {__TA_SECTION_THREAD_ENTRANCES, __TA_COMPRESSION_NONE, starts.data(), starts.size() * sizeof(uint32_t)}};
+        if (!threads.empty())
+        {
+            sections.push_back({__TA_SECTION_THREAD_EDGES, __TA_COMPRESSION_NONE, threads.data(), threads.size()});
+        }
+        if (__TA_WriteProfileContainer(path, sections.data(), (uint32_t)sections.size()))
+        {
+            printf("Failed to write profile container %s\n", path);
+        }
+    }
+
+    /// Writes a profile above order 1 to the markov.bin file, see __TA_WriteEdgeHashTable() for the order 1 one
+    void __TA_WritePathProfile(const vector<uint8_t> &profile)
+    {
+        char *p = getenv("MARKOV_FILE");
+        FILE *f = fopen(p ? p : MARKOV_FILE, "wb");
+        if (!f)
+        {
+            printf("Could not open profile file %s\n", p ? p : MARKOV_FILE);
+            return;
+        }
+        fwrite(profile.data(), 1, profile.size(), f);
+        fclose(f);
+        auto header = (const uint32_t *)profile.data();
+        printf("\nHASHTABLENODES: %d\n", header[1]);
+        printf("\nHASHTABLEPATHS: %d\n", header[2]);
+    }
+
+    /// @brief Appends the tables of each thread to the markov.bin file
+    ///
+    /// Readers of the merged profile stop after its last edge, so the file stays a valid profile for them
+    void __TA_AppendThreadProfiles(const vector<uint8_t> &threads)
+    {
+        char *p = getenv("MARKOV_FILE");
+        FILE *f = fopen(p ? p : MARKOV_FILE, "ab");
+        if (!f)
+        {
+            printf("Could not open profile file %s\n", p ? p : MARKOV_FILE);
+            return;
+        }
+        fwrite(threads.data(), 1, threads.size(), f);
+        fclose(f);
+        printf("\nHASHTABLETHREADS: %d\n", *(const uint32_t *)threads.data());
+    }
 } // namespace Cyclebite::Markov
 
 extern "C"
@@ -247,6 +450,7 @@ extern "C"
         // circular buffer initializations
         Cyclebite::Markov::edgeInc[std::this_thread::get_id()].snk = ID;
         Cyclebite::Markov::callInc[std::this_thread::get_id()] = Cyclebite::Profile::Backend::CallInc();
+        Cyclebite::Markov::callInc.at(std::this_thread::get_id()).position = 0;
         Cyclebite::Markov::labelInc[std::this_thread::get_id()] = Cyclebite::Profile::Backend::LabelEvent();        
         // edge hash table
         Cyclebite::Markov::edgeHashTable = (__TA_HashTable *)malloc(sizeof(__TA_HashTable));
@@ -269,6 +473,31 @@ extern "C"
         Cyclebite::Markov::callerHashTable->array = (__TA_arrayElem *)calloc(Cyclebite::Markov::callerHashTable->getFullSize(Cyclebite::Markov::callerHashTable), sizeof(__TA_arrayElem));
         Cyclebite::Markov::callerHashTable->miners = 0;
         Cyclebite::Markov::callerHashTable->newMine = 0;
+        // call sites
+        Cyclebite::Markov::callSites = new Cyclebite::Markov::CallSite[blockCount]();
+        // higher order profiles
+        if (char *order = getenv("MARKOV_ORDER"))
+        {
+            auto o = (uint32_t)strtoul(order, nullptr, 10);
+            if (o > MARKOV_ORDER)
+            {
+                Cyclebite::Markov::paths = Cyclebite::Markov::MakePathProfile(o, blockCount);
+                if (Cyclebite::Markov::paths)
+                {
+                    Cyclebite::Markov::paths->Enter((uint32_t)ID);
+                }
+                else
+                {
+                    printf("MARKOV_ORDER %s is not supported (at most %d), profiling markov order %d\n", order, MARKOV_MAX_ORDER, MARKOV_ORDER);
+                }
+            }
+        }
+        // a higher order profile already keeps a table for each thread
+        if (getenv("MARKOV_THREADS") && !Cyclebite::Markov::paths)
+        {
+            Cyclebite::Markov::threadEdges = Cyclebite::Markov::MakePathProfile(1, blockCount);
+            Cyclebite::Markov::threadEdges->Enter((uint32_t)ID);
+        }
 
         Cyclebite::Markov::totalBlocks = blockCount;
         Cyclebite::Markov::markovActive = true;
@@ -305,12 +534,63 @@ extern "C"
         // wait for the reader to finish its work
         Cyclebite::Markov::reader->join();
         delete Cyclebite::Markov::reader;
+        // call sites and edge counters only hold the edges of an order 1 profile, paths go through the call blocks themselves
+        if (!Cyclebite::Markov::paths)
+        {
+            Cyclebite::Markov::__TA_FlushCallSites(Cyclebite::Markov::edgeHashTable, Cyclebite::Markov::callSites, Cyclebite::Markov::totalBlocks);
+            if (Cyclebite::Markov::edgeTable)
+            {
+                Cyclebite::Markov::__TA_FlushCounters(Cyclebite::Markov::edgeHashTable, Cyclebite::Markov::edgeCounters, Cyclebite::Markov::edgeTable, Cyclebite::Markov::edgeTableSize);
+            }
+        }
+        if (Cyclebite::Markov::edgeTable && (Cyclebite::Markov::paths || Cyclebite::Markov::threadEdges))
+        {
+            printf("Functions with edge counters are only seen at their entrances and returns in the tables of each thread and in profiles above markov order 1, use -markov-placement=blocks\n");
+        }
+        // the tables of each thread, when MARKOV_THREADS asks for them
+        vector<uint8_t> threads;
+        if (getenv("MARKOV_THREADS"))
+        {
+            auto perThread = Cyclebite::Markov::paths ? Cyclebite::Markov::paths.get() : Cyclebite::Markov::threadEdges.get();
+            threads = perThread->SerializeThreads((uint32_t)Cyclebite::Markov::totalBlocks);
+        }
 
-        // print profile bin file
-        __TA_WriteEdgeHashTable(Cyclebite::Markov::edgeHashTable, (uint32_t)Cyclebite::Markov::totalBlocks);
+        char *containerName = getenv("PROFILE_CONTAINER");
+        if (containerName)
+        {
+            // everything goes into one profile container
+            if (Cyclebite::Markov::paths)
+            {
+                auto edges = Cyclebite::Markov::paths->Serialize((uint32_t)Cyclebite::Markov::totalBlocks);
+                Cyclebite::Markov::__TA_WriteContainer(containerName, edges.data(), edges.size(), threads, Cyclebite::Markov::labelHashTable, Cyclebite::Markov::callerHashTable, Cyclebite::Markov::launchers, Cyclebite::Markov::threadSpawns);
+            }
+            else
+            {
+                uint64_t edgeSize = 0;
+                auto edges = __TA_SerializeEdgeHashTable(Cyclebite::Markov::edgeHashTable, (uint32_t)Cyclebite::Markov::totalBlocks, &edgeSize);
+                Cyclebite::Markov::__TA_WriteContainer(containerName, edges, edgeSize, threads, Cyclebite::Markov::labelHashTable, Cyclebite::Markov::callerHashTable, Cyclebite::Markov::launchers, Cyclebite::Markov::threadSpawns);
+                free(edges);
+            }
+        }
+        else
+        {
+            // print profile bin file
+            if (Cyclebite::Markov::paths)
+            {
+                Cyclebite::Markov::__TA_WritePathProfile(Cyclebite::Markov::paths->Serialize((uint32_t)Cyclebite::Markov::totalBlocks));
+            }
+            else
+            {
+                __TA_WriteEdgeHashTable(Cyclebite::Markov::edgeHashTable, (uint32_t)Cyclebite::Markov::totalBlocks);
+            }
+            if (!threads.empty())
+            {
+                Cyclebite::Markov::__TA_AppendThreadProfiles(threads);
+            }
 
-        // write json files
-        Cyclebite::Markov::__TA_WriteJsonFiles(Cyclebite::Markov::labelHashTable, Cyclebite::Markov::callerHashTable, Cyclebite::Markov::launchers, Cyclebite::Markov::threadSpawns);
+            // write json files
+            Cyclebite::Markov::__TA_WriteJsonFiles(Cyclebite::Markov::labelHashTable, Cyclebite::Markov::callerHashTable, Cyclebite::Markov::launchers, Cyclebite::Markov::threadSpawns);
+        }
 
         // free everything
         free(Cyclebite::Markov::edgeHashTable->array);
@@ -319,6 +599,9 @@ extern "C"
         free(Cyclebite::Markov::labelHashTable);
         free(Cyclebite::Markov::callerHashTable->array);
         free(Cyclebite::Markov::callerHashTable);
+        delete[] Cyclebite::Markov::callSites;
+        Cyclebite::Markov::paths.reset();
+        Cyclebite::Markov::threadEdges.reset();
     }
     void MarkovIncrement(uint64_t a, bool funcEntrance)
     {
@@ -358,6 +641,8 @@ extern "C"
             }
             // we just forked from a parent thread, get the src node from that ID
             Cyclebite::Markov::threadSpawns.insert(a);
+            // the paths of the new thread start at the block that launched it
+            Cyclebite::Markov::enterPath(Cyclebite::Markov::lastLauncher);
             // edgeinc update
             Cyclebite::Markov::taskBuffer[std::this_thread::get_id()] = Cyclebite::Profile::Backend::Task();
             Cyclebite::Markov::edgeInc[std::this_thread::get_id()].src = Cyclebite::Markov::lastLauncher;
@@ -367,6 +652,7 @@ extern "C"
             // callinc update
             Cyclebite::Markov::callInc[std::this_thread::get_id()].src = Cyclebite::Markov::lastLauncher;
             Cyclebite::Markov::callInc.at(std::this_thread::get_id()).snk = a;
+            Cyclebite::Markov::callInc.at(std::this_thread::get_id()).position = 0;
             Cyclebite::Markov::newThread--;
             Cyclebite::Markov::miners++;
         }
@@ -377,20 +663,12 @@ extern "C"
             Cyclebite::Markov::miners++;
         }
 
-        // edge hash table
-        auto t = Cyclebite::Markov::TB.getPtr( Cyclebite::Markov::edgeInc.at(std::this_thread::get_id()) );
-        if( !Cyclebite::Markov::taskBuffer.at(std::this_thread::get_id()).addEvent( t ) )
+        // edge hash table, unless the profile is of a higher order
+        if (!Cyclebite::Markov::paths)
         {
-            // we need to push the current task and add our event to a new task
-            if( !Cyclebite::Markov::Q.push(Cyclebite::Markov::taskBuffer.at(std::this_thread::get_id()), true) )
-            {
-#ifdef DEBUG
-                printf("Task queue push returned error code\n");
-#endif
-            }
-            Cyclebite::Markov::taskBuffer.at(std::this_thread::get_id()).reset();
-            Cyclebite::Markov::taskBuffer.at(std::this_thread::get_id()).addEvent( t );
+            Cyclebite::Markov::pushEvent(Cyclebite::Markov::edgeInc.at(std::this_thread::get_id()));
         }
+        Cyclebite::Markov::enterPath(a);
 
         // label hash table
         if (Cyclebite::Markov::stackCount > 0)
@@ -416,7 +694,6 @@ extern "C"
         // caller hash table
         if (funcEntrance)
         {
-            Cyclebite::Markov::callInc.at(std::this_thread::get_id()).position = 0;
             if( Cyclebite::Markov::threadSpawns.find(a) != Cyclebite::Markov::threadSpawns.end() )
             {
                 // the src of this caller edge is the last launcher
@@ -442,9 +719,96 @@ extern "C"
                 Cyclebite::Markov::taskBuffer.at(std::this_thread::get_id()).reset();
                 Cyclebite::Markov::taskBuffer.at(std::this_thread::get_id()).addEvent( t );
             }
+            // the next entrance may come from a call the pass didn't see
+            Cyclebite::Markov::callInc.at(std::this_thread::get_id()).position = 0;
+        }
+        Cyclebite::Markov::miners--;
+    }
+    void MarkovCall(uint64_t src, uint64_t a, uint32_t position)
+    {
+        // a is the block ID of a call that sits in the middle of its original block, src is the block that comes right before it
+        // only the thread state is touched here, the edge src->a is counted in callSites
+        if (!Cyclebite::Markov::markovActive)
+        {
+            return;
+        }
+        while( Cyclebite::Markov::newThread )
+        {
+            // spin
+        }
+        auto edge = Cyclebite::Markov::edgeInc.find(std::this_thread::get_id());
+        if( edge == Cyclebite::Markov::edgeInc.end() )
+        {
+            // this thread has not entered profiled code yet
+            return;
+        }
+        Cyclebite::Markov::miners++;
+        Cyclebite::Markov::callSites[a].count.fetch_add(1, std::memory_order_relaxed);
+        Cyclebite::Markov::callSites[a].src.store((uint32_t)src, std::memory_order_relaxed);
+        edge->second.snk = a;
+        Cyclebite::Markov::enterPath(a);
+        Cyclebite::Markov::callInc.at(std::this_thread::get_id()).position = position;
+        Cyclebite::Markov::pushLabel(a);
+        Cyclebite::Markov::miners--;
+    }
+    void MarkovIntrinsic(uint64_t src, uint64_t a, uint64_t post)
+    {
+        // a is the block ID of a call that can't reach profiled code (an intrinsic), so control goes straight from src through a to post
+        if (!Cyclebite::Markov::markovActive)
+        {
+            return;
+        }
+        while( Cyclebite::Markov::newThread )
+        {
+            // spin
+        }
+        auto edge = Cyclebite::Markov::edgeInc.find(std::this_thread::get_id());
+        if( edge == Cyclebite::Markov::edgeInc.end() )
+        {
+            return;
         }
+        Cyclebite::Markov::miners++;
+        Cyclebite::Markov::callSites[a].count.fetch_add(1, std::memory_order_relaxed);
+        Cyclebite::Markov::callSites[a].src.store((uint32_t)src, std::memory_order_relaxed);
+        Cyclebite::Markov::callSites[a].fallthrough.fetch_add(1, std::memory_order_relaxed);
+        Cyclebite::Markov::callSites[a].post.store((uint32_t)post, std::memory_order_relaxed);
+        edge->second.snk = post;
+        Cyclebite::Markov::enterPath(a);
+        Cyclebite::Markov::enterPath(post);
+        Cyclebite::Markov::pushLabel(a);
+        Cyclebite::Markov::pushLabel(post);
         Cyclebite::Markov::miners--;
     }
+    void MarkovReturn(uint64_t a)
+    {
+        // a is the block a function with edge counters returns from
+        // no edge is recorded, the edge from a to the block after the call is recorded when the caller gets control back
+        // a higher order profile does put a in the path, it is the last block the callee ran
+        if (!Cyclebite::Markov::markovActive)
+        {
+            return;
+        }
+        while( Cyclebite::Markov::newThread )
+        {
+            // spin
+        }
+        auto edge = Cyclebite::Markov::edgeInc.find(std::this_thread::get_id());
+        if( edge == Cyclebite::Markov::edgeInc.end() )
+        {
+            return;
+        }
+        Cyclebite::Markov::miners++;
+        edge->second.snk = a;
+        Cyclebite::Markov::enterPath(a);
+        Cyclebite::Markov::miners--;
+    }
+    void MarkovCounters(const uint64_t *counters, const int64_t *table, uint64_t tableSize)
+    {
+        // the counters are incremented by the profiled binary itself, the backend only reads them when the profile is done
+        Cyclebite::Markov::edgeCounters = counters;
+        Cyclebite::Markov::edgeTable = table;
+        Cyclebite::Markov::edgeTableSize = tableSize;
+    }
     void MarkovLaunch(uint64_t a)
     {
         // stores the block that is about to launch a thread
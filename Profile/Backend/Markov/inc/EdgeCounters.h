@@ -0,0 +1,110 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+
+namespace Cyclebite::Markov
+{
+    /// @brief Solves the edge counts of the functions the pass placed counters in (-markov-placement=spanning-tree)
+    ///
+    /// Each function of the table is {edge count, entry block} followed by {src, snk, counter, profile src} for each edge, see AppendEdgeTable() in the pass
+    /// The edges without a counter form a spanning tree of the CFG, with a virtual edge from the exit of the function (-1) back to its entry
+    /// The edges of the tree are solved from the leaves in: the one unknown edge of a block is what it takes to make its in and out flow equal
+    /// Frames that are still active when the profile ends (and calls that never return) don't conserve flow, the edges they are on can be off by the number of those frames
+    /// @param addEdge  Called as addEdge(profile src, snk, count) for each edge with a profile src, a sink inside the function and a positive count
+    template <typename AddEdge>
+    void SolveEdgeCounters(const uint64_t *counters, const int64_t *table, uint64_t tableSize, AddEdge &&addEdge)
+    {
+        uint64_t i = 0;
+        while (i + 2 <= tableSize)
+        {
+            auto edgeCount = (uint64_t)table[i];
+            auto entry = table[i + 1];
+            const int64_t *edges = table + i + 2;
+            i += 2 + 4 * edgeCount;
+            // edge edgeCount is the virtual edge, -1 is the exit of the function
+            auto src = [&](uint64_t e) { return e == edgeCount ? -1 : edges[4 * e]; };
+            auto snk = [&](uint64_t e) { return e == edgeCount ? entry : edges[4 * e + 1]; };
+            std::vector<int64_t> count(edgeCount + 1, 0);
+            std::vector<bool> known(edgeCount + 1, false);
+            std::map<int64_t, std::vector<uint64_t>> incident;
+            std::map<int64_t, uint32_t> unknown;
+            for (uint64_t e = 0; e <= edgeCount; e++)
+            {
+                if ((e < edgeCount) && (edges[4 * e + 2] >= 0))
+                {
+                    known[e] = true;
+                    count[e] = (int64_t)counters[edges[4 * e + 2]];
+                }
+                // self loops always hold a counter and their flow in and out cancels
+                if (src(e) == snk(e))
+                {
+                    continue;
+                }
+                incident[src(e)].push_back(e);
+                incident[snk(e)].push_back(e);
+                if (!known[e])
+                {
+                    unknown[src(e)]++;
+                    unknown[snk(e)]++;
+                }
+            }
+            std::deque<int64_t> leaves;
+            for (const auto &block : unknown)
+            {
+                if (block.second == 1)
+                {
+                    leaves.push_back(block.first);
+                }
+            }
+            while (!leaves.empty())
+            {
+                auto block = leaves.front();
+                leaves.pop_front();
+                if (unknown[block] != 1)
+                {
+                    continue;
+                }
+                int64_t in = 0;
+                int64_t out = 0;
+                uint64_t missing = 0;
+                for (const auto &e : incident[block])
+                {
+                    if (!known[e])
+                    {
+                        missing = e;
+                    }
+                    else if (snk(e) == block)
+                    {
+                        in += count[e];
+                    }
+                    else
+                    {
+                        out += count[e];
+                    }
+                }
+                count[missing] = snk(missing) == block ? out - in : in - out;
+                known[missing] = true;
+                auto other = snk(missing) == block ? src(missing) : snk(missing);
+                unknown[block]--;
+                if (--unknown[other] == 1)
+                {
+                    leaves.push_back(other);
+                }
+            }
+            for (uint64_t e = 0; e < edgeCount; e++)
+            {
+                // edges with no profile src are written by the backend itself (the edges calls return on), edges to -1 leave the function
+                if ((edges[4 * e + 3] >= 0) && (snk(e) >= 0) && (count[e] > 0))
+                {
+                    addEdge((uint32_t)edges[4 * e + 3], (uint32_t)snk(e), (uint64_t)count[e]);
+                }
+            }
+        }
+    }
+} // namespace Cyclebite::Markov
@@ -0,0 +1,354 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// highest markov order the backend has a prebuilt path profile for
+#define MARKOV_MAX_ORDER 4
+
+namespace Cyclebite::Markov
+{
+    /// @brief The blocks of one path in a profile of order Order, oldest first and the sink last
+    ///
+    /// Same layout as the block words of a markov.bin record, so keys are written out as they are
+    template <uint32_t Order>
+    struct PathKey
+    {
+        uint32_t blocks[Order + 1];
+        bool operator==(const PathKey &other) const
+        {
+            return memcmp(blocks, other.blocks, sizeof(blocks)) == 0;
+        }
+    };
+
+    /// 64-bit finalizer of murmur3
+    inline uint64_t MixPath(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    /// @brief Hashes a path key one block at a time
+    ///
+    /// The trip count is a constant, so the loop is unrolled for each order
+    template <uint32_t Order>
+    struct PathHash
+    {
+        uint64_t operator()(const PathKey<Order> &key) const
+        {
+            uint64_t h = Order;
+            for (uint32_t i = 0; i < Order + 1; i++)
+            {
+                h = (h ^ key.blocks[i]) * 0x9e3779b97f4a7c15ULL;
+            }
+            return MixPath(h);
+        }
+    };
+
+    /// Order 1 keys are one 64-bit word
+    template <>
+    struct PathHash<1>
+    {
+        uint64_t operator()(const PathKey<1> &key) const
+        {
+            return MixPath(((uint64_t)key.blocks[0] << 32) | key.blocks[1]);
+        }
+    };
+
+    /// Order 3 keys are two 64-bit words
+    template <>
+    struct PathHash<3>
+    {
+        uint64_t operator()(const PathKey<3> &key) const
+        {
+            auto lo = ((uint64_t)key.blocks[0] << 32) | key.blocks[1];
+            auto hi = ((uint64_t)key.blocks[2] << 32) | key.blocks[3];
+            return MixPath(lo ^ MixPath(hi));
+        }
+    };
+
+    /// @brief Open addressing hash table from the paths of one thread to their counts
+    ///
+    /// Only the thread that owns the table writes to it while the program runs
+    /// Counts are atomic so a writer can read them while the owner keeps counting, inserting a path or growing the table is left to the caller to guard
+    /// Counter is the width of the counts kept while profiling, a narrower counter makes the table smaller but wraps sooner
+    template <uint32_t Order, typename Counter>
+    class PathTable
+    {
+    public:
+        struct Slot
+        {
+            PathKey<Order> key;
+            // 0 marks an empty slot
+            std::atomic<Counter> count;
+            /// @brief Adds freq to the count of a live slot
+            ///
+            /// Only the owner of the table writes counts, so this is a load and a store instead of a locked add
+            void Add(Counter freq)
+            {
+                count.store(count.load(std::memory_order_relaxed) + freq, std::memory_order_relaxed);
+            }
+            Counter Count() const
+            {
+                return count.load(std::memory_order_relaxed);
+            }
+        };
+        explicit PathTable(uint64_t sizeHint)
+        {
+            uint64_t capacity = 64;
+            while (capacity < 2 * sizeHint)
+            {
+                capacity <<= 1;
+            }
+            slots = std::vector<Slot>(capacity);
+        }
+        /// Returns the slot of key, nullptr if the table has not seen it yet
+        Slot *Lookup(const PathKey<Order> &key)
+        {
+            auto &slot = Find(key);
+            return slot.Count() ? &slot : nullptr;
+        }
+        /// Adds freq to the count of key, inserting it first if the table has not seen it yet
+        void Increment(const PathKey<Order> &key, Counter freq = 1)
+        {
+            // at most three quarters full, so probes stay short
+            if ((live + 1) * 4 > slots.size() * 3)
+            {
+                Grow();
+            }
+            auto &slot = Find(key);
+            if (slot.Count() == 0)
+            {
+                slot.key = key;
+                live++;
+            }
+            slot.Add(freq);
+        }
+        uint64_t Size() const
+        {
+            return live;
+        }
+        const std::vector<Slot> &Slots() const
+        {
+            return slots;
+        }
+
+    private:
+        std::vector<Slot> slots;
+        uint64_t live = 0;
+        Slot &Find(const PathKey<Order> &key)
+        {
+            auto mask = slots.size() - 1;
+            auto i = PathHash<Order>{}(key) & mask;
+            while (slots[i].Count() && !(slots[i].key == key))
+            {
+                i = (i + 1) & mask;
+            }
+            return slots[i];
+        }
+        void Grow()
+        {
+            std::vector<Slot> old(slots.size() * 2);
+            old.swap(slots);
+            live = 0;
+            for (const auto &slot : old)
+            {
+                if (slot.Count())
+                {
+                    Increment(slot.key, slot.Count());
+                }
+            }
+        }
+    };
+
+    /// @brief Counts the paths of Order+1 blocks the program takes
+    ///
+    /// The backend picks one of these in MarkovInit when the MARKOV_ORDER environment variable asks for an order above 1, or an order 1 one when MARKOV_THREADS asks for the edges of each thread
+    /// Each thread keeps its own history and table, and the tables are merged when the profile is written
+    /// A path the thread has taken before is counted without a lock, only a new path takes the lock of the thread's table, so threads that have not exited yet can keep counting while the profile is written
+    class PathProfile
+    {
+    public:
+        virtual ~PathProfile() = default;
+        virtual uint32_t GetOrder() const = 0;
+        /// @brief Moves the calling thread to block
+        ///
+        /// The path that ends at block is counted once the thread has seen Order blocks before it
+        virtual void Enter(uint32_t block) = 0;
+        /// @brief Merges the tables of all threads into the layout of markov.bin
+        ///
+        /// Markov order, block count and path count, then each path as Order+1 block IDs and a 64-bit frequency
+        virtual std::vector<uint8_t> Serialize(uint32_t blockCount) = 0;
+        /// @brief Writes the table of each thread on its own
+        ///
+        /// The number of threads, then the markov.bin layout of each thread's table, in the order the threads first entered a block
+        virtual std::vector<uint8_t> SerializeThreads(uint32_t blockCount) = 0;
+    };
+
+    template <uint32_t Order, typename Counter = uint64_t>
+    class OrderedPathProfile : public PathProfile
+    {
+    public:
+        explicit OrderedPathProfile(uint64_t sizeHint) : id(nextID.fetch_add(1) + 1), sizeHint(sizeHint) {}
+        uint32_t GetOrder() const override
+        {
+            return Order;
+        }
+        void Enter(uint32_t block) override
+        {
+            // the shard of a profile that was destroyed is never touched, so only the ID it was made for is compared
+            auto s = shard;
+            if (shardProfile != id)
+            {
+                s = NewShard();
+            }
+            if (s->seen == Order)
+            {
+                PathKey<Order> key;
+                memcpy(key.blocks, s->history, sizeof(s->history));
+                key.blocks[Order] = block;
+                // the table only changes shape under its lock, so looking up a key needs none
+                if (auto slot = s->table.Lookup(key))
+                {
+                    slot->Add(1);
+                }
+                else
+                {
+                    // only contended when the profile is written while this thread still runs
+                    std::lock_guard<std::mutex> shardGuard(s->lock);
+                    s->table.Increment(key);
+                }
+            }
+            else
+            {
+                s->seen++;
+            }
+            // Order is at most MARKOV_MAX_ORDER, shifting the history is cheaper than a circular index
+            memmove(s->history, s->history + 1, (Order - 1) * sizeof(uint32_t));
+            s->history[Order - 1] = block;
+        }
+        std::vector<uint8_t> Serialize(uint32_t blockCount) override
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            // a path taken by many threads is in many tables
+            PathTable<Order, uint64_t> merged(sizeHint);
+            for (const auto &s : shards)
+            {
+                // other threads may still be counting into their tables while the profile is written, the lock keeps them from inserting or growing
+                std::lock_guard<std::mutex> shardGuard(s->lock);
+                for (const auto &slot : s->table.Slots())
+                {
+                    if (auto count = slot.Count())
+                    {
+                        merged.Increment(slot.key, (uint64_t)count);
+                    }
+                }
+            }
+            std::vector<uint8_t> buffer;
+            Append(buffer, merged, blockCount);
+            return buffer;
+        }
+        std::vector<uint8_t> SerializeThreads(uint32_t blockCount) override
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            auto threads = (uint32_t)shards.size();
+            std::vector<uint8_t> buffer(sizeof(threads));
+            memcpy(buffer.data(), &threads, sizeof(threads));
+            for (const auto &s : shards)
+            {
+                std::lock_guard<std::mutex> shardGuard(s->lock);
+                Append(buffer, s->table, blockCount);
+            }
+            return buffer;
+        }
+
+    private:
+        struct Shard
+        {
+            /// Held by the owning thread while it inserts a path and by the writer while it reads the table
+            std::mutex lock;
+            uint32_t history[Order];
+            uint32_t seen;
+            PathTable<Order, Counter> table;
+            Shard(uint64_t sizeHint) : history{}, seen(0), table(sizeHint) {}
+        };
+        /// Unique to each profile of this order for the life of the program, unlike its address
+        const uint64_t id;
+        uint64_t sizeHint;
+        std::mutex lock;
+        std::vector<std::unique_ptr<Shard>> shards;
+        static std::atomic<uint64_t> nextID;
+        /// Shard of the calling thread and the ID of the profile it belongs to
+        static thread_local Shard *shard;
+        static thread_local uint64_t shardProfile;
+        /// Appends the markov.bin layout of table to buffer, counts are widened to 64 bits
+        template <typename C>
+        static void Append(std::vector<uint8_t> &buffer, const PathTable<Order, C> &table, uint32_t blockCount)
+        {
+            uint32_t header[3] = {Order, blockCount, (uint32_t)table.Size()};
+            auto start = buffer.size();
+            buffer.resize(start + sizeof(header) + table.Size() * (sizeof(PathKey<Order>) + sizeof(uint64_t)));
+            auto w = buffer.data() + start;
+            memcpy(w, header, sizeof(header));
+            w += sizeof(header);
+            for (const auto &slot : table.Slots())
+            {
+                if (uint64_t count = slot.Count())
+                {
+                    memcpy(w, slot.key.blocks, sizeof(PathKey<Order>));
+                    w += sizeof(PathKey<Order>);
+                    memcpy(w, &count, sizeof(uint64_t));
+                    w += sizeof(uint64_t);
+                }
+            }
+        }
+        Shard *NewShard()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            shards.push_back(std::make_unique<Shard>(sizeHint));
+            shard = shards.back().get();
+            shardProfile = id;
+            return shard;
+        }
+    };
+
+    template <uint32_t Order, typename Counter>
+    thread_local typename OrderedPathProfile<Order, Counter>::Shard *OrderedPathProfile<Order, Counter>::shard = nullptr;
+
+    template <uint32_t Order, typename Counter>
+    thread_local uint64_t OrderedPathProfile<Order, Counter>::shardProfile = 0;
+
+    template <uint32_t Order, typename Counter>
+    std::atomic<uint64_t> OrderedPathProfile<Order, Counter>::nextID = 0;
+
+    /// @brief Builds the path profile of the given order, nullptr if there is no prebuilt one
+    ///
+    /// The backend only builds order 1 for the tables of each thread, the edge hash table of DashHashTable.h is the merged order 1 profile
+    inline std::unique_ptr<PathProfile> MakePathProfile(uint32_t order, uint64_t sizeHint)
+    {
+        switch (order)
+        {
+            case 1:
+                return std::make_unique<OrderedPathProfile<1>>(sizeHint);
+            case 2:
+                return std::make_unique<OrderedPathProfile<2>>(sizeHint);
+            case 3:
+                return std::make_unique<OrderedPathProfile<3>>(sizeHint);
+            case 4:
+                return std::make_unique<OrderedPathProfile<4>>(sizeHint);
+            default:
+                return nullptr;
+        }
+    }
+} // namespace Cyclebite::Markov
@@ -7,7 +7,7 @@
 using namespace std;
 using namespace Cyclebite::Profile::Backend::Memory;
 
-CodeSection::CodeSection(set<int64_t> b, map<int64_t, set<int64_t>> ent, map<int64_t, set<int64_t>> ex) : UniqueID(), blocks(b), entrances(ent), exits(ex) {}
+CodeSection::CodeSection(set<int64_t> b, map<int64_t, set<int64_t>> ent, map<int64_t, set<int64_t>> ex) : UniqueID(), blocks(b.begin(), b.end()), entrances(ent), exits(ex) {}
 
 CodeSection::CodeSection(pair<int64_t, int64_t> entranceEdge) : UniqueID()
 {
@@ -4,6 +4,7 @@
 //==------------------------------==//
 #include "IO.h"
 #include "Memory.h"
+#include "ProfileFormat.h"
 #include <cstdlib>
 #include <fstream>
 #include "Util/Exceptions.h"
@@ -12,6 +13,7 @@
 #include "Epoch.h"
 #include "Processing.h"
 #include "Kernel.h"
+#include "PerfCounters.h"
 #include <deque>
 #include <iomanip>
 
@@ -173,11 +175,7 @@ namespace Cyclebite::Profile::Backend::Memory
                 }
                 else
                 {
-                    set<int64_t> overlap;
-                    set<int64_t> un;
-                    set_intersection(k->blocks.begin(), k->blocks.end(), ok->blocks.begin(), ok->blocks.end(), std::inserter(overlap, overlap.begin()));
-                    set_union(k->blocks.begin(), k->blocks.end(), ok->blocks.begin(), ok->blocks.end(), std::inserter(un, un.begin()));
-                    if( (overlap.size() == un.size()) && !(k->blocks.empty()) )
+                    if( (k->blocks == ok->blocks) && !(k->blocks.empty()) )
                     {
                         // these kernels have the same block set
                         sectionToKernel[k].insert(ok);
@@ -212,11 +210,7 @@ namespace Cyclebite::Profile::Backend::Memory
                 {
                     continue;
                 }
-                set<int64_t> overlap;
-                set<int64_t> un;
-                set_intersection(bs->blocks.begin(), bs->blocks.end(), other->blocks.begin(), other->blocks.end(), std::inserter(overlap, overlap.begin()));
-                set_union(bs->blocks.begin(), bs->blocks.end(), other->blocks.begin(), other->blocks.end(), std::inserter(un, un.begin()));
-                if( (overlap.size() == un.size()) && !(bs->blocks.empty()) )
+                if( (bs->blocks == other->blocks) && !(bs->blocks.empty()) )
                 {
                     spdlog::critical("Found a block set that has exactly the same blocks as another block set!");
                     std::exit(EXIT_FAILURE);
@@ -237,14 +231,14 @@ namespace Cyclebite::Profile::Backend::Memory
             if( kern->contextLevel == 0 )
             {
                 // collect all of its child kernel basic blocks into a single set
-                set<int64_t> epochBlocks;
+                Cyclebite::Util::BlockSet epochBlocks;
                 deque<shared_ptr<Kernel>> Q;
                 set<shared_ptr<Kernel>, UIDCompare> covered;
                 Q.push_front(kern);
                 covered.insert(kern);
                 while( !Q.empty() )
                 {
-                    epochBlocks.insert(Q.front()->blocks.begin(), Q.front()->blocks.end());
+                    epochBlocks |= Q.front()->blocks;
                     for( const auto& child : Q.front()->children )
                     {
                         if( covered.find(child) == covered.end() )
@@ -467,6 +461,30 @@ namespace Cyclebite::Profile::Backend::Memory
         dotOutput.close();
     }
 
+    /// Events no thread could count are left out, so a missing counter can't be mistaken for a zero
+    json DescribeCounters(const CounterSample& sample)
+    {
+        json counters;
+        if( HasCycles() )
+        {
+            counters["Cycles"] = sample.cycles;
+        }
+        if( HasInstructions() )
+        {
+            counters["Instructions"] = sample.instructions;
+        }
+        if( HasLLCMisses() )
+        {
+            counters["LLC Misses"] = sample.llcMisses;
+        }
+        if( HasBranchMisses() )
+        {
+            counters["Branch Misses"] = sample.branchMisses;
+        }
+        counters["Time (ns)"] = sample.nanoseconds;
+        return counters;
+    }
+
     void OutputKernelInstances()
     {
         // take the kernels that were "locally" hot, get the entries from the input kernel file that match those kernels and output them in a new "kernel instance" json
@@ -518,16 +536,66 @@ namespace Cyclebite::Profile::Backend::Memory
         output["BlockCallers"] = input["BlockCallers"];
         output["NonKernelBlocks"] = input["NonKernelBlocks"];
         output["ValidBlocks"] = input["ValidBlocks"];
+        // elided accesses touch the same bytes as the access they repeat
+        set<int64_t> significant;
         for( const auto& value : instToTuple )
         {
-            output["Instruction Tuples"].push_back(value.first);
-            /*
-            for( const auto& tuple : value.second )
+            significant.insert(value.first);
+        }
+        for( const auto& dup : duplicateAccesses )
+        {
+            if( instToTuple.find(dup.second) != instToTuple.end() )
             {
-                output["Instruction Tuples"].[to_string(value.first)].push_back( pair(tuple.base, tuple.base+tuple.offset) );
-            }*/
+                significant.insert(dup.first);
+            }
         }
+        for( const auto& value : significant )
+        {
+            output["Instruction Tuples"].push_back(value);
+        }
+        // one sample of the hardware counters for each kernel instance, and their sum over the instances of each kernel
+        // "Counters" is "none" when no event could be counted, the samples then only carry the clock_gettime time
+        output["Counters"] = CounterSource();
+        output["Instance Counters"] = json::array();
+        map<int, CounterSample> kernelCounters;
+        map<int, uint64_t> kernelInstances;
+        CounterSample nonKernelCounters;
+        for( const auto& epoch : epochs )
+        {
+            if( !epoch->kernel )
+            {
+                nonKernelCounters += epoch->counters;
+                continue;
+            }
+            auto instance = DescribeCounters(epoch->counters);
+            instance["Instance"] = epoch->IID;
+            instance["Kernel"] = epoch->kernel->kid;
+            if( !epoch->kernel->label.empty() )
+            {
+                instance["Label"] = epoch->kernel->label;
+            }
+            output["Instance Counters"].push_back(instance);
+            kernelCounters[epoch->kernel->kid] += epoch->counters;
+            kernelInstances[epoch->kernel->kid]++;
+        }
+        for( const auto& [kid, counters] : kernelCounters )
+        {
+            output["Kernel Counters"][to_string(kid)] = DescribeCounters(counters);
+            output["Kernel Counters"][to_string(kid)]["Instances"] = kernelInstances.at(kid);
+        }
+        output["NonKernel Counters"] = DescribeCounters(nonKernelCounters);
 
+        if( getenv("PROFILE_CONTAINER") )
+        {
+            // the epochs go into the profile container the markov backend made
+            auto text = output.dump();
+            __TA_ProfileSectionData section = { __TA_SECTION_MEMORY_EPOCHS, __TA_COMPRESSION_ZLIB, text.data(), text.size() };
+            if( __TA_AppendProfileSection(getenv("PROFILE_CONTAINER"), &section) )
+            {
+                throw CyclebiteException("Couldn't add memory epochs to profile container: " + string(getenv("PROFILE_CONTAINER")));
+            }
+            return;
+        }
         string OutputFileName = "instance.json";
         if( getenv("INSTANCE_FILE") )
         {
@@ -9,6 +9,7 @@
 #include "CodeInstance.h"
 #include "IO.h"
 #include "Processing.h"
+#include "PerfCounters.h"
 
 using namespace std;
 using json = nlohmann::json;
@@ -26,10 +27,13 @@ namespace Cyclebite::Profile::Backend::Memory
     /// holds all epochs that have been observed
     set<shared_ptr<Epoch>, UIDCompare> epochs;
     /// holds all sets of basic blocks that should be observed in an epoch at some point in the profile
-    map<uint64_t, set<int64_t>> taskCandidates;
+    map<uint64_t, Cyclebite::Util::BlockSet> taskCandidates;
     /// Maps instructions to their working set tuples
     /// These mappings are used in the grammar tool to figure out which load instructions are touching critical pieces of memory
     map<int64_t, set<MemTuple, MTCompare>> instToTuple;
+    /// Maps the value ID of a load or store the pass didn't instrument to the ID of the access in its block that touches the same bytes
+    /// The elided access goes wherever the other one shows up in instToTuple
+    map<int64_t, int64_t> duplicateAccesses;
 
     /// Holds all CodeSections
     /// A code section is a unique set of basic block IDs ie a codesection may map to multiple kernels
@@ -52,6 +56,41 @@ namespace Cyclebite::Profile::Backend::Memory
     bool memoryActive = false;
     /// Counter tracking how much memory has been consumed by the profiler
     uint64_t bytesBitten;
+    /// Running totals of the calling thread's hardware counters when it last went back to the program
+    thread_local CounterSample programStart;
+    /// False until the calling thread has left the backend once, before that it has no program work to charge
+    thread_local bool programStarted = false;
+    /// A counter group only counts the thread that opened it, so each thread that calls the backend opens its own the first time
+    thread_local bool countersTried = false;
+
+    /// @brief Keeps the backend's own work out of the hardware counters of the epochs
+    ///
+    /// Every entry point of the backend starts with one
+    /// What the program did since the thread last left the backend is charged to the current epoch when the scope starts, and the counters are read again when it ends, so the tuple merging in between is never charged
+    struct BackendScope
+    {
+        BackendScope()
+        {
+            if( memoryActive && programStarted && currentEpoch )
+            {
+                currentEpoch->counters += ReadCounters() - programStart;
+            }
+        }
+        ~BackendScope()
+        {
+            if( !memoryActive )
+            {
+                return;
+            }
+            if( !countersTried )
+            {
+                countersTried = true;
+                OpenCounters();
+            }
+            programStart = ReadCounters();
+            programStarted = true;
+        }
+    };
 
     void updateBittenBytes()
     {
@@ -80,11 +119,43 @@ namespace Cyclebite::Profile::Backend::Memory
         }
     }
 
+    /// @brief Records count accesses of one instruction that start at base and are stride bytes apart
+    ///
+    /// The pass reports the affine loads and stores of a loop this way on the edge out of the loop
+    /// The whole range goes into the epoch and the instruction's tuples in one merge each, and the profiler's memory is only measured once
+    void recordRange(__TA_MemType type, set<MemTuple, MTCompare>& tuples, uint64_t base, int64_t valueID, uint64_t datasize, int64_t stride, uint64_t count)
+    {
+        if( count == 0 )
+        {
+            return;
+        }
+        if( stride == 0 )
+        {
+            count = 1;
+        }
+        else if( stride < 0 )
+        {
+            // walk the range from its lowest address
+            base -= (uint64_t)(-stride) * (count-1);
+            stride = -stride;
+        }
+        MemTuple mt;
+        mt.type = type;
+        mt.base = base;
+        mt.offset = (uint32_t)datasize;
+        mt.refCount = 0;
+        merge_tuple_range(tuples, mt, (uint64_t)stride, count);
+        merge_tuple_range(instToTuple[valueID], mt, (uint64_t)stride, count);
+        updateBittenBytes();
+    }
+
     extern "C"
     {
         void __Cyclebite__Profile__Backend__MemoryDestroy()
         {
+            BackendScope scope;
             clock_gettime(CLOCK_MONOTONIC, &end);
+            CloseCounters();
             epochs.insert(currentEpoch);
             updateBittenBytes();
             spdlog::info( "MEMORYPROFILETIME: "+to_string(CalculateTime(&start, &end))+"s");
@@ -100,6 +171,7 @@ namespace Cyclebite::Profile::Backend::Memory
 
         void __Cyclebite__Profile__Backend__MemoryIncrement(uint64_t a)
         {
+            BackendScope scope;
             // if the profile is not active, we return
             if (!memoryActive)
             {
@@ -127,6 +199,7 @@ namespace Cyclebite::Profile::Backend::Memory
 
         void __Cyclebite__Profile__Backend__MemoryStore(void *address, int64_t valueID, uint64_t datasize)
         {
+            BackendScope scope;
             static MemTuple mt;
             mt.type = __TA_MemType::Writer;
             if (!memoryActive)
@@ -158,6 +231,7 @@ namespace Cyclebite::Profile::Backend::Memory
 
         void __Cyclebite__Profile__Backend__MemoryLoad(void *address, int64_t valueID, uint64_t datasize)
         {
+            BackendScope scope;
             static MemTuple mt;
             mt.type = __TA_MemType::Reader;
             if (!memoryActive)
@@ -187,6 +261,35 @@ namespace Cyclebite::Profile::Backend::Memory
             updateBittenBytes();
         }
 
+        void __Cyclebite__Profile__Backend__MemoryStoreRange(void *base, int64_t valueID, uint64_t datasize, int64_t stride, uint64_t count)
+        {
+            BackendScope scope;
+            if( !memoryActive || !currentEpoch )
+            {
+                return;
+            }
+            recordRange(__TA_MemType::Writer, currentEpoch->memoryData.wTuples, (uint64_t)base, valueID, datasize, stride, count);
+        }
+
+        void __Cyclebite__Profile__Backend__MemoryLoadRange(void *base, int64_t valueID, uint64_t datasize, int64_t stride, uint64_t count)
+        {
+            BackendScope scope;
+            if( !memoryActive || !currentEpoch )
+            {
+                return;
+            }
+            recordRange(__TA_MemType::Reader, currentEpoch->memoryData.rTuples, (uint64_t)base, valueID, datasize, stride, count);
+        }
+
+        void __Cyclebite__Profile__Backend__MemoryDuplicates(const int64_t* pairs, uint64_t count)
+        {
+            BackendScope scope;
+            for( uint64_t i = 0; i < count; i++ )
+            {
+                duplicateAccesses[pairs[2*i]] = pairs[2*i+1];
+            }
+        }
+
         void __Cyclebite__Profile__Backend__MemoryInit(uint64_t a)
         {
             bytesBitten = 0;
@@ -203,14 +306,22 @@ namespace Cyclebite::Profile::Backend::Memory
             currentEpoch = make_shared<Epoch>();
             currentEpoch->updateBlocks((int64_t)a);
             currentEpoch->entrances[(int64_t)a].insert((int64_t)a);
+            countersTried = true;
+            if( !OpenCounters() )
+            {
+                spdlog::warn("Hardware counters are not available (see /proc/sys/kernel/perf_event_paranoid), kernel instances are only timed");
+            }
 
             while( clock_gettime(CLOCK_MONOTONIC, &start) ) {}
             memoryActive = true;
             lastBlock = (int64_t)a;
+            // the program starts counting when the backend hands it back
+            BackendScope scope;
         }
 
         void __Cyclebite__Profile__Backend__MemoryCpy(void* ptr_src, void* ptr_snk, uint64_t dataSize)
         {
+            BackendScope scope;
             MemTuple mt;
             mt.type = __TA_MemType::Memcpy;
             mt.base = (uint64_t)ptr_src;
@@ -230,6 +341,7 @@ namespace Cyclebite::Profile::Backend::Memory
 
         void __Cyclebite__Profile__Backend__MemoryMov(void* ptr_src, void* ptr_snk, uint64_t dataSize)
         {
+            BackendScope scope;
             MemTuple mt;
             mt.type = __TA_MemType::Memmov;
             mt.base = (uint64_t)ptr_src;
@@ -249,6 +361,7 @@ namespace Cyclebite::Profile::Backend::Memory
 
         void __Cyclebite__Profile__Backend__MemorySet(void* ptr, uint64_t dataSize)
         {
+            BackendScope scope;
             MemTuple mt;
             mt.type = __TA_MemType::Memset;
             mt.base = (uint64_t)ptr;
@@ -263,6 +376,7 @@ namespace Cyclebite::Profile::Backend::Memory
 
         void __Cyclebite__Profile__Backend__MemoryMalloc(void* ptr, uint64_t offset)
         {
+            BackendScope scope;
             if( currentEpoch )
             {
                 MemTuple mt;
@@ -276,6 +390,7 @@ namespace Cyclebite::Profile::Backend::Memory
 
         void __Cyclebite__Profile__Backend__MemoryFree(void* ptr)
         {
+            BackendScope scope;
             if( currentEpoch )
             {
                 currentEpoch->free_ptrs.insert((int64_t)ptr);
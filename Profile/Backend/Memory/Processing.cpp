@@ -47,16 +47,9 @@ namespace Cyclebite::Profile::Backend::Memory
             // match the epoch to a kernel
             for( const auto& epoch : taskCandidates )
             {
-                set<int64_t> overlap;
-                for( const auto& block : instance->blocks )
-                {
-                    if( epoch.second.find(block) != epoch.second.end() )
-                    {
-                        overlap.insert(block);
-                    }
-                }
                 // overlap must be 50% or more
-                if( ((float)overlap.size() / (float)instance->blocks.size()) > EPOCH_KERNEL_OVERLAP )
+                auto overlap = instance->blocks.intersectionSize(epoch.second);
+                if( ((float)overlap / (float)instance->blocks.size()) > EPOCH_KERNEL_OVERLAP )
                 {
                     instance->kernel = *kernels.find((int)epoch.first);
                     break;
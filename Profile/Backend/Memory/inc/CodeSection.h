@@ -4,6 +4,7 @@
 //==------------------------------==//
 #pragma once
 #include "UniqueID.h"
+#include "Util/BlockSet.h"
 #include <map>
 #include <set>
 #include <vector>
@@ -14,7 +15,7 @@ namespace Cyclebite::Profile::Backend::Memory
     class CodeSection : public UniqueID
     {
     public:
-        std::set<int64_t> blocks;
+        Cyclebite::Util::BlockSet blocks;
         std::map<int64_t, std::set<int64_t>> entrances;
         std::map<int64_t, std::set<int64_t>> exits;
         // this is not set at construction time, it must be set after all kernels are read
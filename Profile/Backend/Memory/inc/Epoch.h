@@ -5,6 +5,8 @@
 #pragma once
 #include "UniqueID.h"
 #include "Iteration.h"
+#include "PerfCounters.h"
+#include "Util/BlockSet.h"
 #include <set>
 #include <map>
 
@@ -16,7 +18,7 @@ namespace Cyclebite::Profile::Backend::Memory
     {
     public:
         // code section information
-        std::set<int64_t> blocks;
+        Cyclebite::Util::BlockSet blocks;
         std::map<int64_t, std::set<int64_t>> entrances;
         std::map<int64_t, std::set<int64_t>> exits;
         // instance information
@@ -25,6 +27,8 @@ namespace Cyclebite::Profile::Backend::Memory
         std::shared_ptr<Kernel> kernel;
         std::set<MemTuple, MTCompare> malloc_ptrs;
         std::set<int64_t> free_ptrs;
+        /// hardware events and time the program spent in the epoch, without the backend's own work (see BackendScope in Memory.cpp)
+        CounterSample counters;
         Epoch();
         void updateBlocks(int64_t id);
         uint64_t getMaxFreq();
@@ -10,6 +10,7 @@
 #include <memory>
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Value.h"
+#include "Util/BlockSet.h"
 
 namespace Cyclebite::Profile::Backend::Memory
 {
@@ -40,10 +41,13 @@ namespace Cyclebite::Profile::Backend::Memory
     /// holds all epochs that have been observed
     extern std::set<std::shared_ptr<Epoch>, UIDCompare> epochs;
     /// holds all sets of basic blocks that should be observed in an epoch at some point in the profile
-    extern std::map<uint64_t, std::set<int64_t>> taskCandidates;
+    extern std::map<uint64_t, Cyclebite::Util::BlockSet> taskCandidates;
     /// Maps instructions to their working set tuples
     /// These mappings are used in the grammar tool to figure out which load instructions are touching critical pieces of memory
     extern std::map<int64_t, std::set<MemTuple, MTCompare>> instToTuple;
+    /// Maps the value ID of a load or store the pass didn't instrument to the ID of the access in its block that touches the same bytes
+    /// The elided access goes wherever the other one shows up in instToTuple
+    extern std::map<int64_t, int64_t> duplicateAccesses;
 
     /// Holds all CodeSections
     /// A code section is a unique set of basic block IDs ie a codesection may map to multiple kernels
@@ -5,6 +5,7 @@
 #pragma once
 #include <cstdint>
 #include <set>
+#include <vector>
 #include <spdlog/spdlog.h>
 
 namespace Cyclebite::Profile::Backend::Memory
@@ -329,6 +330,33 @@ namespace Cyclebite::Profile::Backend::Memory
         return exclusiveRegions;
     }
 
+    /// @brief Determines the temporal access pattern of a tuple that is about to be merged with a newer access
+    ///
+    /// The existing tuple contains observations that we have made in past time, so the order of the two accesses is known
+    /// @param existing Tuple already in the set. Its access pattern is set if it didn't have one yet
+    /// @param incoming The access that overlaps it
+    inline void observe_access(MemTuple& existing, const MemTuple& incoming)
+    {
+        if( existing.AP == __TA_TemporalAccess::NA )
+        {
+            if( existing.type == __TA_MemType::Reader || existing.type == __TA_MemType::Memcpy )
+            {
+                if( incoming.type == __TA_MemType::Writer || incoming.type == __TA_MemType::Memset )
+                {
+                    existing.AP = __TA_TemporalAccess::ReadThenWrite;
+                }
+            }
+            else if( existing.type == __TA_MemType::Writer || existing.type == __TA_MemType::Memset )
+            {
+                if( incoming.type == __TA_MemType::Reader || incoming.type == __TA_MemType::Memcpy )
+                {
+                    existing.AP = __TA_TemporalAccess::WriteThenRead;
+                }
+            }
+            // no case yet for __TA_TemporalAccess::Random
+        }
+    }
+
     /// @brief This is a tail-recursive algorithm to merge a new tuple into an array of existing tuples
     ///
     /// When many tuples exist in an array, it is possible for a new tuple entry to connect a large number of them at once
@@ -346,25 +374,7 @@ namespace Cyclebite::Profile::Backend::Memory
             // combine the existing tuple and re-enter it
             auto existingTuple = *match;
             array.erase(existingTuple);
-            // the existing tuple contains observations that we have made in past time, thus we determine temporal access patterns here
-            if( existingTuple.AP == __TA_TemporalAccess::NA )
-            {
-                if( existingTuple.type == __TA_MemType::Reader || existingTuple.type == __TA_MemType::Memcpy )
-                {
-                    if( tuple.type == __TA_MemType::Writer || tuple.type == __TA_MemType::Memset )
-                    {
-                        existingTuple.AP = __TA_TemporalAccess::ReadThenWrite;
-                    }
-                }
-                else if( existingTuple.type == __TA_MemType::Writer || existingTuple.type == __TA_MemType::Memset )
-                {
-                    if( tuple.type == __TA_MemType::Reader || tuple.type == __TA_MemType::Memcpy )
-                    {
-                        existingTuple.AP = __TA_TemporalAccess::WriteThenRead;
-                    }
-                }
-                // no case yet for __TA_TemporalAccess::Random
-            }
+            observe_access(existingTuple, tuple);
             newTuple = merge_tuples(existingTuple, newTuple);
             match = array.find(newTuple);
         }
@@ -378,6 +388,90 @@ namespace Cyclebite::Profile::Backend::Memory
 #endif
     }
 
+    /// @brief Merges count copies of a tuple, each stride bytes after the last, into an array of existing tuples
+    ///
+    /// The result is the same as calling merge_tuple_set once for each copy, but the array is only searched once
+    /// When the copies overlap (stride <= tuple.offset) they are a single tuple. Otherwise the tuples the range touches are pulled out and swept together with the copies in address order
+    /// @param  array   Set of MemTuple structures to push the range into
+    /// @param  tuple   First access of the range
+    /// @param  stride  Distance in bytes between the bases of two consecutive copies
+    /// @param  count   Number of copies
+    inline void merge_tuple_range(std::set<MemTuple, MTCompare>& array, const MemTuple& tuple, uint64_t stride, uint64_t count)
+    {
+        if( count == 0 )
+        {
+            return;
+        }
+        if( (count == 1) || (stride <= (uint64_t)tuple.offset) )
+        {
+            auto whole = tuple;
+            whole.offset = (uint32_t)((uint64_t)tuple.offset + stride*(count-1));
+            merge_tuple_set(array, whole);
+            return;
+        }
+        uint64_t last = tuple.base + stride*(count-1) + (uint64_t)tuple.offset;
+        // every tuple that ends at or after the first copy and starts at or before the end of the last copy
+        MemTuple first;
+        first.base = tuple.base;
+        auto begin = array.lower_bound(first);
+        auto stop = begin;
+        std::vector<MemTuple> existing;
+        while( (stop != array.end()) && (stop->base <= last) )
+        {
+            existing.push_back(*stop);
+            stop++;
+        }
+        array.erase(begin, stop);
+        std::vector<MemTuple> swept;
+        // the last swept tuple is an existing one that no copy has touched yet
+        bool untouched = false;
+        auto add = [&](const MemTuple& next, bool isCopy) {
+            if( swept.empty() || (next.base > swept.back().base+(uint64_t)swept.back().offset) )
+            {
+                swept.push_back(next);
+                untouched = !isCopy;
+                return;
+            }
+            // existing tuples never overlap each other, so one of the two is a copy and the existing one is older
+            if( isCopy )
+            {
+                if( untouched )
+                {
+                    observe_access(swept.back(), tuple);
+                }
+                swept.back() = merge_tuples(swept.back(), next);
+            }
+            else
+            {
+                auto older = next;
+                observe_access(older, tuple);
+                swept.back() = merge_tuples(older, swept.back());
+            }
+            untouched = false;
+        };
+        auto copy = tuple;
+        uint64_t i = 0;
+        for( const auto& e : existing )
+        {
+            while( (i < count) && (tuple.base + stride*i < e.base) )
+            {
+                copy.base = tuple.base + stride*i++;
+                add(copy, true);
+            }
+            add(e, false);
+        }
+        while( i < count )
+        {
+            copy.base = tuple.base + stride*i++;
+            add(copy, true);
+        }
+        // the copies and tuples that didn't merge are in address order and all go right before stop
+        for( const auto& t : swept )
+        {
+            array.insert(stop, t);
+        }
+    }
+
     /// @brief Removes the memory ranges in "tuple" that may be present in "array"
     /// 
     /// @param array    Set of MemTuples to remove from
@@ -10,6 +10,7 @@
 #include "IO.h"
 #include "Processing.h"
 #include "Memory.h"
+#include <bit>
 
 using namespace std;
 using json = nlohmann::json;
@@ -30,88 +31,79 @@ namespace Cyclebite::Profile::Backend::Precision
     shared_ptr<Cyclebite::Profile::Backend::Memory::Epoch> currentEpoch;
     /// holds all epochs that have been observed
     set<shared_ptr<Cyclebite::Profile::Backend::Memory::Epoch>, Cyclebite::Profile::Backend::Memory::UIDCompare> epochs;
-    uint16_t getExponent(uint64_t val, const PrecisionValue& v)
+    /// Histogram of the current epoch, so the load/store hooks don't have to look it up
+    ValueHistogram *currentHist;
+
+    /// Returns the histogram bin of an integer magnitude: floor(log2(mag)) + PRECISION_BIAS, or 0 for 0
+    inline uint32_t integerBin(uint64_t mag)
+    {
+        return mag ? (uint32_t)(PRECISION_BIAS + 63 - countl_zero(mag)) : 0;
+    }
+
+    /// Returns the magnitude of the low bits of val, interpreted as a signed integer of type T
+    template <typename T>
+    inline uint64_t signedMagnitude(uint64_t val)
     {
-        switch(v.t)
+        auto i = (int64_t)(T)val;
+        // negate in unsigned space so the most negative value doesn't overflow
+        return i < 0 ? 0 - (uint64_t)i : (uint64_t)i;
+    }
+
+    /// @brief Returns the histogram bin of a value, which is its base-2 exponent plus PRECISION_BIAS
+    ///
+    /// Floating point exponents are read straight out of the IEEE bits, integer exponents come from counting leading zeros
+    /// Zeros land in bin 0, infinities and NaNs in the last bin
+    inline uint32_t getExponentBin(uint64_t val, PrecisionType t)
+    {
+        switch(t)
         {
             case PrecisionType::float128:
                 throw CyclebiteException("Cannot support a 128-bit float value! The passed value is only 8 bytes.");
-            
+
             case PrecisionType::float80:
                 throw CyclebiteException("Cannot support an 80-bit float on this target!");
 
             case PrecisionType::float64:
-                {
-                    auto f = *(double*)&val;
-                    return (uint16_t)log2( abs(f) );
-                }
+                // the biased exponent of a double is already a bin
+                return (uint32_t)((val >> 52) & 0x7FF);
             case PrecisionType::float32:
                 {
-                    auto f = *(float*)&val;
-                    return (uint16_t)log2( abs(f) );
+                    auto bits = (uint32_t)val;
+                    auto e = (bits >> 23) & 0xFF;
+                    auto m = bits & 0x7FFFFF;
+                    if (e == 0xFF)
+                    {
+                        return PRECISION_BINS - 1;
+                    }
+                    else if (e == 0)
+                    {
+                        // subnormals are m * 2^-149
+                        return m ? (uint32_t)(PRECISION_BIAS - 149 + 31 - countl_zero(m)) : 0;
+                    }
+                    // rebias from float to double
+                    return e - 127 + PRECISION_BIAS;
                 }
             case PrecisionType::float16:
                 throw CyclebiteException("Cannot support a 16-bit float on this target!");
 
             case PrecisionType::uint64_t:
-                {
-                    auto i = *(uint64_t*)&val;
-                    return (uint16_t)log2( i );
-                }
+                return integerBin(val);
             case PrecisionType::int64_t:
-                {
-                    auto i = *(int64_t*)&val;
-                    return (uint16_t)log2( abs(i) );
-                }
+                return integerBin(signedMagnitude<int64_t>(val));
             case PrecisionType::uint32_t:
-                {
-                    auto i = *(uint32_t*)&val;
-                    return (uint16_t)log2(i);
-                }
+                return integerBin((uint32_t)val);
             case PrecisionType::int32_t:
-                {
-                    auto i = *(int32_t*)&val;
-                    return (uint16_t)log2(i);
-                }
+                return integerBin(signedMagnitude<int32_t>(val));
             case PrecisionType::uint16_t:
-                {
-                    auto i = *(uint16_t*)&val;
-                    return (uint16_t)log2(i);
-                }
+                return integerBin((uint16_t)val);
             case PrecisionType::int16_t:
-                {
-                    auto i = *(int16_t*)&val;
-                    return (uint16_t)log2( abs(i) );
-                }
+                return integerBin(signedMagnitude<int16_t>(val));
             case PrecisionType::uint8_t:
-                {
-                    auto i = *(uint8_t*)&val;
-                    return (uint16_t)log2(i);
-                }
+                return integerBin((uint8_t)val);
             case PrecisionType::int8_t:
-                {
-                    auto i = *(int8_t*)&val;
-                    return (uint16_t)log2( abs(i) );
-                }
-            case PrecisionType::uint1_t:
-                {
-                    return 0;
-                }
-            case PrecisionType::int1_t:
-                {
-                    return 0;
-                }
-            case PrecisionType::vector:
-                {
-                    // don't care, return 0
-                    return 0;
-                }
-            case PrecisionType::void_t:
-                {
-                    // don't care, return 0
-                    return 0;
-                }
+                return integerBin(signedMagnitude<int8_t>(val));
             default:
+                // booleans, vectors and void don't care, bin 0
                 return 0;
         }
     }
@@ -124,23 +116,24 @@ namespace Cyclebite::Profile::Backend::Precision
         // each row has a task ID in the first column
         
         // make the first row
+        // columns span every bin that was observed in any task, each column is labeled by its base-2 exponent (the first bin holds zeros)
         string csvString = "TaskID";
+        uint32_t minBin = PRECISION_BINS;
         uint32_t maxBin = 0;
-        // stencilChain/Naive seems to break this
-        // either that or a value's exponent is not being interpreted correctly... which could have to do with signed-ness or some kind of bad cast
         for( const auto& task : hist )
         {
-            for( const auto& bin : task.second.exp )
+            for( uint32_t i = 0; i < PRECISION_BINS; i++ )
             {
-                if( bin.first > maxBin )
+                if( task.second.find(i) )
                 {
-                    maxBin = bin.first;
+                    minBin = min(minBin, i);
+                    maxBin = max(maxBin, i);
                 }
             }
         }
-        for( unsigned i = 0; i < maxBin; i++ )
+        for( uint32_t i = minBin; i <= maxBin; i++ )
         {
-            csvString += ","+to_string(i);
+            csvString += ","+(i ? to_string((int32_t)i - PRECISION_BIAS) : string("zero"));
         }
         csvString += "\n";
 
@@ -148,25 +141,11 @@ namespace Cyclebite::Profile::Backend::Precision
         for( const auto& epoch : hist )
         {
             // ID first, if the epoch is a task it gets the task ID, else it gets the epoch ID
-            /*if( epoch.first->kernel )
-            {
-                csvString += to_string(epoch.first->kernel->kid);
-            }
-            else
-            {*/
-                csvString += to_string(epoch.first->IID);
-            //}
+            csvString += to_string(epoch.first->IID);
             // print each magnitude in the row
-            for( unsigned i = 0; i < maxBin; i++ )
+            for( uint32_t i = minBin; i <= maxBin; i++ )
             {
-                if( epoch.second.find(i) )
-                {
-                    csvString += ","+to_string(epoch.second[i]);
-                }
-                else
-                {
-                    csvString += ",0";
-                }
+                csvString += ","+to_string(epoch.second[i]);
             }
             csvString += "\n";
         }
@@ -207,7 +186,7 @@ namespace Cyclebite::Profile::Backend::Precision
                 currentEpoch = make_shared<Cyclebite::Profile::Backend::Memory::Epoch>();
                 currentEpoch->updateBlocks((int64_t)a);
                 currentEpoch->entrances[lastBlock].insert((int64_t)a);
-                hist[currentEpoch] = ValueHistogram();
+                currentHist = &hist[currentEpoch];
             }
             else
             {
@@ -224,13 +203,7 @@ namespace Cyclebite::Profile::Backend::Precision
             {
                 return;
             }
-            static PrecisionValue v;
-            v.bb  = (uint32_t)bbID;
-            v.iid = instructionID;
-            v.t   = static_cast<PrecisionType>(type);
-            v.op  = PrecisionMemOp::Store;
-            v.exp = getExponent(value, v); // some function that can find the exponent of any value
-            hist.at(currentEpoch).inc(v.exp);
+            currentHist->inc(getExponentBin(value, static_cast<PrecisionType>(type)));
         }
         void __Cyclebite__Profile__Backend__PrecisionLoad(uint64_t value, uint64_t bbID, uint32_t instructionID, uint8_t type)
         {
@@ -238,13 +211,7 @@ namespace Cyclebite::Profile::Backend::Precision
             {
                 return;
             }
-            static PrecisionValue v;
-            v.bb  = (uint32_t)bbID;
-            v.iid = instructionID;
-            v.t   = static_cast<PrecisionType>(type);
-            v.op  = PrecisionMemOp::Load;
-            v.exp = getExponent(value, v); // some function that can find the exponent of any value
-            hist.at(currentEpoch).inc(v.exp);
+            currentHist->inc(getExponentBin(value, static_cast<PrecisionType>(type)));
         }
         void __Cyclebite__Profile__Backend__PrecisionInit(uint64_t a)
         {
@@ -261,7 +228,7 @@ namespace Cyclebite::Profile::Backend::Precision
             currentEpoch = make_shared<Cyclebite::Profile::Backend::Memory::Epoch>();
             currentEpoch->updateBlocks((int64_t)a);
             currentEpoch->entrances[(int64_t)a].insert((int64_t)a);
-            hist[currentEpoch] = ValueHistogram();
+            currentHist = &hist[currentEpoch];
 
             while( clock_gettime(CLOCK_MONOTONIC, &start) ) {}
             precisionActive = true;
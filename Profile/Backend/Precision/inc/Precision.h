@@ -5,6 +5,7 @@
 #pragma once
 #include "Util/Exceptions.h"
 #include "Epoch.h"
+#include <array>
 #include <ctime>
 #include <cstdint>
 #include <set>
@@ -53,21 +54,31 @@ namespace Cyclebite::Profile::Backend::Precision
         PrecisionType t;
         PrecisionMemOp op;
     };
+    /// Number of exponent bins in a histogram, one for every biased exponent of a double
+    constexpr uint32_t PRECISION_BINS = 2048;
+    /// Bias of a double exponent. Every observed value is binned by its exponent plus this bias, bin 0 holds zeros (and double subnormals)
+    constexpr int32_t PRECISION_BIAS = 1023;
     /// @brief Holds information gathered from an application's loads or stores
+    ///
+    /// The bins are allocated on the first observed value, so epochs that never touch memory stay small
     struct ValueHistogram
     {
-        std::map<uint32_t, uint64_t> exp;
-        void inc(uint32_t key)
+        std::unique_ptr<std::array<uint64_t, PRECISION_BINS>> exp;
+        void inc(uint32_t bin)
         {
-            exp[key]++;
+            if (!exp)
+            {
+                exp = std::make_unique<std::array<uint64_t, PRECISION_BINS>>();
+            }
+            (*exp)[bin]++;
         }
-        uint64_t operator[](uint32_t key) const
+        uint64_t operator[](uint32_t bin) const
         {
-            return exp.at(key);
+            return exp ? (*exp)[bin] : 0;
         }
-        bool find(uint32_t key) const
+        bool find(uint32_t bin) const
         {
-            return exp.find(key) != exp.end();
+            return exp && (*exp)[bin];
         }
     };
     /// Timing information
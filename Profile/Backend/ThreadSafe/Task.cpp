@@ -102,7 +102,7 @@ int pushCallInc( __TA_HashTable* t, const CallInc* call )
     __TA_callerTuple caller;
     caller.blocks[0] = (uint32_t)call->src;
     caller.blocks[1] = (uint32_t)call->snk;
-    caller.position = 0;
+    caller.position = (uint32_t)call->position;
     __TA_element e;
     e.callee = caller;
     while (__TA_HashTable_increment(t, &e))
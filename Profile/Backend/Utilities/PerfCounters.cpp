@@ -0,0 +1,281 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "PerfCounters.h"
+#include <atomic>
+#include <cstring>
+#include <ctime>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+namespace Cyclebite::Profile::Backend
+{
+    namespace
+    {
+        enum CounterEvent
+        {
+            Cycles,
+            Instructions,
+            LLCMisses,
+            BranchMisses,
+            EventCount
+        };
+        /// @brief The perf_event_open group of one thread
+        ///
+        /// A group only counts the thread that opened it, so every thread keeps its own and closes it when it exits
+        struct CounterGroup
+        {
+            /// file descriptor of each event, -1 if it isn't open
+            int fds[EventCount] = {-1, -1, -1, -1};
+            /// kernel ID of each event, the group read lists its values by ID
+            uint64_t ids[EventCount];
+#ifdef __linux__
+            /// page the kernel keeps up to date for each event, nullptr if it couldn't be mapped
+            perf_event_mmap_page *pages[EventCount] = {nullptr, nullptr, nullptr, nullptr};
+#endif
+            int leader = -1;
+            ~CounterGroup()
+            {
+                CloseCounters();
+            }
+        };
+        thread_local CounterGroup group;
+        /// Bit of each event some thread's group opened, the output is written by one thread but has to cover the events of all of them
+        atomic<uint32_t> openedEvents = 0;
+
+        uint64_t Now()
+        {
+            struct timespec now;
+            while( clock_gettime(CLOCK_MONOTONIC, &now) ) {}
+            return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+        }
+
+#ifdef __linux__
+        int OpenEvent(uint64_t config, int group)
+        {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = config;
+            // the group is enabled at once when all its members are in
+            attr.disabled = group == -1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+        }
+
+        /// @brief Reads one event without a system call
+        ///
+        /// rdpmc reads the counter the event is on, the page says which one and what the kernel has already saved off it
+        /// @retval False if the event has to be read with read(): no rdpmc (off x86, or /sys/bus/event_source/devices/cpu/rdpmc is 0), the event isn't on a counter right now, or it has been multiplexed so its count would need scaling
+        bool ReadUserCounter(const perf_event_mmap_page *page, uint64_t &value)
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            if( !page )
+            {
+                return false;
+            }
+            uint32_t seq;
+            do
+            {
+                // the kernel bumps lock around every update of the page
+                seq = page->lock;
+                atomic_signal_fence(memory_order_seq_cst);
+                if( !page->cap_user_rdpmc || !page->index || (page->time_enabled != page->time_running) )
+                {
+                    return false;
+                }
+                // the counter is pmc_width bits wide, sign extend it
+                auto count = (int64_t)__rdpmc((int)page->index - 1);
+                count = (int64_t)((uint64_t)count << (64 - page->pmc_width)) >> (64 - page->pmc_width);
+                value = (uint64_t)(page->offset + count);
+                atomic_signal_fence(memory_order_seq_cst);
+            } while( page->lock != seq );
+            return true;
+#else
+            return false;
+#endif
+        }
+#endif
+    } // namespace
+
+    CounterSample &CounterSample::operator+=(const CounterSample &rhs)
+    {
+        cycles += rhs.cycles;
+        instructions += rhs.instructions;
+        llcMisses += rhs.llcMisses;
+        branchMisses += rhs.branchMisses;
+        nanoseconds += rhs.nanoseconds;
+        return *this;
+    }
+
+    CounterSample CounterSample::operator-(const CounterSample &rhs) const
+    {
+        // scaled totals of a multiplexed group can step back a little, a difference is never negative
+        auto diff = [](uint64_t later, uint64_t earlier) { return later > earlier ? later - earlier : 0; };
+        CounterSample sample;
+        sample.cycles = diff(cycles, rhs.cycles);
+        sample.instructions = diff(instructions, rhs.instructions);
+        sample.llcMisses = diff(llcMisses, rhs.llcMisses);
+        sample.branchMisses = diff(branchMisses, rhs.branchMisses);
+        sample.nanoseconds = diff(nanoseconds, rhs.nanoseconds);
+        return sample;
+    }
+
+    bool OpenCounters()
+    {
+#ifdef __linux__
+        if( group.leader != -1 )
+        {
+            return true;
+        }
+        const uint64_t configs[EventCount] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+        for( int i = 0; i < EventCount; i++ )
+        {
+            // the first event that opens leads the group, a virtual machine may not have all of them
+            group.fds[i] = OpenEvent(configs[i], group.leader == -1 ? -1 : group.fds[group.leader]);
+            if( group.fds[i] == -1 )
+            {
+                continue;
+            }
+            if( ioctl(group.fds[i], PERF_EVENT_IOC_ID, &group.ids[i]) )
+            {
+                close(group.fds[i]);
+                group.fds[i] = -1;
+                continue;
+            }
+            // without the page the event is still read with read()
+            auto page = mmap(nullptr, (size_t)sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, group.fds[i], 0);
+            group.pages[i] = page == MAP_FAILED ? nullptr : (perf_event_mmap_page *)page;
+            if( group.leader == -1 )
+            {
+                group.leader = i;
+            }
+            openedEvents.fetch_or(1U << i, memory_order_relaxed);
+        }
+        if( group.leader == -1 )
+        {
+            return false;
+        }
+        ioctl(group.fds[group.leader], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(group.fds[group.leader], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void CloseCounters()
+    {
+#ifdef __linux__
+        for( int i = 0; i < EventCount; i++ )
+        {
+            if( group.pages[i] )
+            {
+                munmap(group.pages[i], (size_t)sysconf(_SC_PAGESIZE));
+                group.pages[i] = nullptr;
+            }
+            if( group.fds[i] != -1 )
+            {
+                close(group.fds[i]);
+                group.fds[i] = -1;
+            }
+        }
+#endif
+        group.leader = -1;
+    }
+
+    const char *CounterSource()
+    {
+        return openedEvents.load(memory_order_relaxed) ? "perf_event" : "none";
+    }
+
+    bool HasCycles()
+    {
+        return openedEvents.load(memory_order_relaxed) & (1U << Cycles);
+    }
+
+    bool HasInstructions()
+    {
+        return openedEvents.load(memory_order_relaxed) & (1U << Instructions);
+    }
+
+    bool HasLLCMisses()
+    {
+        return openedEvents.load(memory_order_relaxed) & (1U << LLCMisses);
+    }
+
+    bool HasBranchMisses()
+    {
+        return openedEvents.load(memory_order_relaxed) & (1U << BranchMisses);
+    }
+
+    CounterSample ReadCounters()
+    {
+        CounterSample sample;
+        sample.nanoseconds = Now();
+#ifdef __linux__
+        if( group.leader == -1 )
+        {
+            return sample;
+        }
+        uint64_t values[EventCount] = {0, 0, 0, 0};
+        bool user = true;
+        for( int i = 0; user && (i < EventCount); i++ )
+        {
+            user = (group.fds[i] == -1) || ReadUserCounter(group.pages[i], values[i]);
+        }
+        if( user )
+        {
+            sample.cycles = values[Cycles];
+            sample.instructions = values[Instructions];
+            sample.llcMisses = values[LLCMisses];
+            sample.branchMisses = values[BranchMisses];
+            return sample;
+        }
+        // {nr, time enabled, time running, {value, id} x nr}
+        uint64_t data[3 + 2 * EventCount];
+        if( read(group.fds[group.leader], data, sizeof(data)) < (ssize_t)(3 * sizeof(uint64_t)) )
+        {
+            return sample;
+        }
+        auto enabled = data[1];
+        auto running = data[2];
+        memset(values, 0, sizeof(values));
+        for( uint64_t i = 0; (i < data[0]) && (i < EventCount); i++ )
+        {
+            auto value = data[3 + 2 * i];
+            if( running && (running < enabled) )
+            {
+                // the PMU was shared with another group for part of the time
+                value = (uint64_t)((double)value * (double)enabled / (double)running);
+            }
+            for( int j = 0; j < EventCount; j++ )
+            {
+                if( (group.fds[j] != -1) && (group.ids[j] == data[4 + 2 * i]) )
+                {
+                    values[j] = value;
+                }
+            }
+        }
+        sample.cycles = values[Cycles];
+        sample.instructions = values[Instructions];
+        sample.llcMisses = values[LLCMisses];
+        sample.branchMisses = values[BranchMisses];
+#endif
+        return sample;
+    }
+} // namespace Cyclebite::Profile::Backend
@@ -2,14 +2,114 @@
 // Copyright 2023 Benjamin Willis
 // SPDX-License-Identifier: Apache-2.0
 //==------------------------------==//
+#include <atomic>
+#include <bit>
 #include <cmath>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <nlohmann/json.hpp>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+using json = nlohmann::json;
 
 // start and end points to specifically time the profiles
 struct timespec __TA_Timing_start;
 struct timespec __TA_Timing_end;
 
+namespace Cyclebite::Profile::Backend::Timing
+{
+    /// Invocations are binned by the bit width of their length in ticks, bin i holds lengths in [2^(i-1), 2^i)
+    constexpr uint32_t HISTOGRAM_BINS = 65;
+
+    /// @brief Invocations of one kernel of the kernel file, shared by all threads
+    struct KernelTime
+    {
+        atomic<uint64_t> invocations;
+        atomic<uint64_t> ticks;
+        atomic<uint64_t> minTicks;
+        atomic<uint64_t> maxTicks;
+        atomic<uint64_t> histogram[HISTOGRAM_BINS];
+    };
+    /// @brief Where the calling thread is in one kernel
+    ///
+    /// Recursion and nested calls enter a kernel that is already running, only the outermost entrance and its exit are timed
+    struct KernelClock
+    {
+        uint32_t depth = 0;
+        uint64_t start = 0;
+    };
+
+    /// kernel ID of each probe index, from the kernel file the pass was given
+    const int64_t *kernelIDs = nullptr;
+    uint64_t kernelCount = 0;
+    KernelTime *kernelTimes = nullptr;
+    thread_local vector<KernelClock> clocks;
+    /// ticks when the timer started, the tick rate is measured over the whole run
+    uint64_t startTicks;
+    bool written = false;
+
+    /// @brief A cheap timestamp for the probes
+    ///
+    /// The time stamp counter on x86 (constant rate on every core since Nehalem), the monotonic clock everywhere else
+    inline uint64_t Ticks()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+#endif
+    }
+
+    void WriteKernelTimes(double nsPerTick)
+    {
+        json output;
+        output["Nanoseconds Per Tick"] = nsPerTick;
+        for( uint64_t i = 0; i < kernelCount; i++ )
+        {
+            const auto& k = kernelTimes[i];
+            json kernel;
+            kernel["Invocations"] = k.invocations.load();
+            kernel["Total (ns)"] = (double)k.ticks.load() * nsPerTick;
+            if( k.invocations )
+            {
+                kernel["Min (ns)"] = (double)k.minTicks.load() * nsPerTick;
+                kernel["Max (ns)"] = (double)k.maxTicks.load() * nsPerTick;
+                kernel["Mean (ns)"] = (double)k.ticks.load() * nsPerTick / (double)k.invocations.load();
+            }
+            kernel["Histogram"] = json::array();
+            for( uint32_t bin = 0; bin < HISTOGRAM_BINS; bin++ )
+            {
+                if( k.histogram[bin] )
+                {
+                    json entry;
+                    entry["Upper Bound (ns)"] = ldexp(1.0, (int)bin) * nsPerTick;
+                    entry["Invocations"] = k.histogram[bin].load();
+                    kernel["Histogram"].push_back(entry);
+                }
+            }
+            output["Kernels"][to_string(kernelIDs[i])] = kernel;
+        }
+        string OutputFileName = "timing.json";
+        if( getenv("TIMING_FILE") )
+        {
+            OutputFileName = string(getenv("TIMING_FILE"));
+        }
+        ofstream oStream(OutputFileName);
+        oStream << setw(2) << output;
+        oStream.close();
+    }
+} // namespace Cyclebite::Profile::Backend::Timing
+
 extern "C"
 {
     void TimingInit()
@@ -17,6 +117,53 @@ extern "C"
         while (clock_gettime(CLOCK_MONOTONIC, &__TA_Timing_start))
         {
         }
+        Cyclebite::Profile::Backend::Timing::startTicks = Cyclebite::Profile::Backend::Timing::Ticks();
+    }
+    void TimingKernels(const int64_t *kids, uint64_t count)
+    {
+        Cyclebite::Profile::Backend::Timing::kernelIDs = kids;
+        Cyclebite::Profile::Backend::Timing::kernelCount = count;
+        Cyclebite::Profile::Backend::Timing::kernelTimes = new Cyclebite::Profile::Backend::Timing::KernelTime[count]();
+        for( uint64_t i = 0; i < count; i++ )
+        {
+            Cyclebite::Profile::Backend::Timing::kernelTimes[i].minTicks = UINT64_MAX;
+        }
+    }
+    void TimingKernelEnter(uint64_t index)
+    {
+        if( index >= Cyclebite::Profile::Backend::Timing::kernelCount )
+        {
+            // static constructors run before main gives the backend its kernels
+            return;
+        }
+        auto& clocks = Cyclebite::Profile::Backend::Timing::clocks;
+        if( clocks.size() <= index )
+        {
+            clocks.resize(Cyclebite::Profile::Backend::Timing::kernelCount);
+        }
+        if( clocks[index].depth++ == 0 )
+        {
+            clocks[index].start = Cyclebite::Profile::Backend::Timing::Ticks();
+        }
+    }
+    void TimingKernelExit(uint64_t index)
+    {
+        auto now = Cyclebite::Profile::Backend::Timing::Ticks();
+        auto& clocks = Cyclebite::Profile::Backend::Timing::clocks;
+        // an exit with no entrance comes from a kernel entered on an edge the pass couldn't instrument
+        if( (clocks.size() <= index) || (clocks[index].depth == 0) || (--clocks[index].depth > 0) )
+        {
+            return;
+        }
+        auto length = now - clocks[index].start;
+        auto& k = Cyclebite::Profile::Backend::Timing::kernelTimes[index];
+        k.invocations.fetch_add(1, memory_order_relaxed);
+        k.ticks.fetch_add(length, memory_order_relaxed);
+        k.histogram[bit_width(length)].fetch_add(1, memory_order_relaxed);
+        auto least = k.minTicks.load(memory_order_relaxed);
+        while( (length < least) && !k.minTicks.compare_exchange_weak(least, length, memory_order_relaxed) ) {}
+        auto most = k.maxTicks.load(memory_order_relaxed);
+        while( (length > most) && !k.maxTicks.compare_exchange_weak(most, length, memory_order_relaxed) ) {}
     }
     void TimingDestroy()
     {
@@ -24,9 +171,17 @@ extern "C"
         while (clock_gettime(CLOCK_MONOTONIC, &__TA_Timing_end))
         {
         }
+        auto endTicks = Cyclebite::Profile::Backend::Timing::Ticks();
         double time_s = (double)__TA_Timing_end.tv_sec - (double)__TA_Timing_start.tv_sec;
         double time_ns = ((double)__TA_Timing_end.tv_nsec - (double)__TA_Timing_start.tv_nsec) * pow(10.0, -9.0);
         auto totalTime = time_s + time_ns;
         printf("\nNATIVETIME: %f\n", totalTime);
+        if( Cyclebite::Profile::Backend::Timing::kernelTimes && !Cyclebite::Profile::Backend::Timing::written )
+        {
+            // kernels still running when the program ends are not counted
+            double nsPerTick = endTicks > Cyclebite::Profile::Backend::Timing::startTicks ? totalTime * 1e9 / (double)(endTicks - Cyclebite::Profile::Backend::Timing::startTicks) : 1.0;
+            Cyclebite::Profile::Backend::Timing::WriteKernelTimes(nsPerTick);
+            Cyclebite::Profile::Backend::Timing::written = true;
+        }
     }
-}
\ No newline at end of file
+}
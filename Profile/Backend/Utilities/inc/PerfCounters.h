@@ -0,0 +1,43 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#pragma once
+#include <cstdint>
+
+namespace Cyclebite::Profile::Backend
+{
+    /// @brief Hardware events and wall time of one thread, either a running total or the difference between two totals
+    struct CounterSample
+    {
+        uint64_t cycles = 0;
+        uint64_t instructions = 0;
+        uint64_t llcMisses = 0;
+        uint64_t branchMisses = 0;
+        /// CLOCK_MONOTONIC, always available
+        uint64_t nanoseconds = 0;
+        CounterSample &operator+=(const CounterSample &rhs);
+        CounterSample operator-(const CounterSample &rhs) const;
+    };
+
+    /// @brief Opens one perf_event_open group for the calling thread (user space only, so perf_event_paranoid=2 still allows it)
+    ///
+    /// The group only counts the thread that opened it, OpenCounters, CloseCounters and ReadCounters work on the group of the calling thread and a thread's group is closed when it exits
+    /// The first event that opens leads the group (cycles, when the PMU has them), events the PMU doesn't have are left out
+    /// @retval False if no hardware event could be opened, samples only carry the time then
+    bool OpenCounters();
+    /// Closes the group of the calling thread, later samples only carry the time
+    void CloseCounters();
+    /// Where the hardware events of the samples come from, "perf_event" once any thread opened a group and "none" while every sample only carries the clock_gettime time
+    const char *CounterSource();
+    /// True if the group of any thread opened the event, the field of a missing event is always 0
+    bool HasCycles();
+    bool HasInstructions();
+    bool HasLLCMisses();
+    bool HasBranchMisses();
+    /// @brief Reads the running totals of the group of the calling thread
+    ///
+    /// Each event is read with rdpmc when the kernel allows it, so a read costs no system call and can bracket every call into a backend
+    /// Otherwise (and once the group has been multiplexed) it is one read() of the whole group, so the events stay consistent with each other
+    CounterSample ReadCounters();
+} // namespace Cyclebite::Profile::Backend
@@ -0,0 +1,300 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "inc/CounterPlacement.h"
+#include "Util/Annotate.h"
+#include "Util/Exceptions.h"
+#include "Util/Split.h"
+#include <llvm/Analysis/CFG.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <set>
+
+using namespace llvm;
+using namespace std;
+using namespace Cyclebite::Profile::Passes;
+
+namespace
+{
+    /// Disjoint sets of the blocks of a function, the spanning tree only takes edges that join two of them
+    class Components
+    {
+    public:
+        Components(uint32_t size) : parent(size)
+        {
+            iota(parent.begin(), parent.end(), 0);
+        }
+        uint32_t find(uint32_t x)
+        {
+            while (parent[x] != x)
+            {
+                parent[x] = parent[parent[x]];
+                x = parent[x];
+            }
+            return x;
+        }
+        /// Returns false if a and b were already in the same set
+        bool join(uint32_t a, uint32_t b)
+        {
+            a = find(a);
+            b = find(b);
+            if (a == b)
+            {
+                return false;
+            }
+            parent[b] = a;
+            return true;
+        }
+
+    private:
+        vector<uint32_t> parent;
+    };
+
+    bool HasInsertionPoint(const BasicBlock *BB)
+    {
+        return BB->getFirstInsertionPt() != BB->end();
+    }
+
+    /// @brief True if e is a critical edge SplitCriticalEdge can split
+    ///
+    /// An edge that isn't critical has no block of its own to make, its counter belongs at either end of it
+    bool CanSplit(const FlowEdge &e)
+    {
+        auto term = e.src->getTerminator();
+        // critical edges into EH pads and out of indirect branches can't be split
+        if (e.snk->isEHPad() || isa<IndirectBrInst, CallBrInst>(term))
+        {
+            return false;
+        }
+        for (unsigned i = 0; i < term->getNumSuccessors(); i++)
+        {
+            if (term->getSuccessor(i) == e.snk)
+            {
+                // PlaceCounters merges identical edges when it splits
+                return isCriticalEdge(term, i, true);
+            }
+        }
+        return false;
+    }
+
+    /// Finds a place for the counter of e, None if it has none
+    CounterSite FindSite(const FlowEdge &e)
+    {
+        if (e.returns)
+        {
+            // the increment has to come after the call, so it goes at the end of a block that falls through or on the normal edge of an invoke
+            if (isa<BranchInst>(e.src->getTerminator()))
+            {
+                return CounterSite::SrcEnd;
+            }
+            if (e.snk->getUniquePredecessor() && HasInsertionPoint(e.snk))
+            {
+                return CounterSite::SnkTop;
+            }
+            return CanSplit(e) ? CounterSite::Split : CounterSite::None;
+        }
+        if ((succ_empty(e.src) || e.src->getUniqueSuccessor()) && HasInsertionPoint(e.src))
+        {
+            return CounterSite::SrcTop;
+        }
+        if (!e.snk)
+        {
+            return CounterSite::None;
+        }
+        if (e.snk->getUniquePredecessor() && HasInsertionPoint(e.snk))
+        {
+            return CounterSite::SnkTop;
+        }
+        return CanSplit(e) ? CounterSite::Split : CounterSite::None;
+    }
+} // namespace
+
+bool Cyclebite::Profile::Passes::PlanCounters(Function &F, CounterPlan &plan, uint64_t &nextCounter)
+{
+    plan.F = &F;
+    plan.entry = Cyclebite::Util::GetBlockID(&F.getEntryBlock());
+    plan.edges.clear();
+    if (plan.entry < 0)
+    {
+        return false;
+    }
+    DominatorTree DT(F);
+    LoopInfo LI(DT);
+    map<const BasicBlock *, uint32_t> node;
+    for (auto &BB : F)
+    {
+        auto id = Cyclebite::Util::GetBlockID(&BB);
+        if (id < 0)
+        {
+            return false;
+        }
+        node[&BB] = (uint32_t)node.size();
+        // the profile leaves a block from the fragment after its last call
+        // a call with no fragment after it ends its block, control comes back from the callee on the edge out of the block
+        int64_t last = id;
+        const CallBase *trailing = nullptr;
+        for (auto &inst : BB)
+        {
+            if (auto call = dyn_cast<CallBase>(&inst))
+            {
+                auto ids = GetCallBlockIDs(call);
+                if (ids.first >= 0)
+                {
+                    last = ids.second >= 0 ? ids.second : ids.first;
+                    trailing = ids.second >= 0 ? nullptr : call;
+                }
+            }
+        }
+        if (succ_empty(&BB))
+        {
+            plan.edges.push_back(FlowEdge{&BB, nullptr, id, -1, -1, false, LI.getLoopDepth(&BB)});
+            continue;
+        }
+        set<const BasicBlock *> seen;
+        for (auto succ : successors(&BB))
+        {
+            if (!seen.insert(succ).second)
+            {
+                continue;
+            }
+            auto snkID = Cyclebite::Util::GetBlockID(succ);
+            if (snkID < 0)
+            {
+                return false;
+            }
+            bool returns = false;
+            if (auto invoke = dyn_cast_or_null<InvokeInst>(trailing))
+            {
+                returns = succ == invoke->getNormalDest();
+            }
+            else if (trailing)
+            {
+                returns = trailing->getNextNode() == BB.getTerminator();
+            }
+            // edges a call returns on are written by the MarkovIncrement on them
+            plan.edges.push_back(FlowEdge{&BB, succ, id, snkID, returns ? -1 : last, returns, LI.getLoopDepth(&BB)});
+        }
+    }
+    // the virtual edge from the exit to the entry can't hold a counter, so it is the first edge of the tree
+    auto exitNode = (uint32_t)node.size();
+    Components tree(exitNode + 1);
+    tree.join(exitNode, node.at(&F.getEntryBlock()));
+    vector<CounterSite> sites;
+    vector<size_t> order;
+    for (size_t i = 0; i < plan.edges.size(); i++)
+    {
+        sites.push_back(FindSite(plan.edges[i]));
+        if (plan.edges[i].returns)
+        {
+            // counted anyway, so they are never in the tree, and an edge a call returns on with nowhere to count it leaves the function to per-block placement
+            if (sites.back() == CounterSite::None)
+            {
+                return false;
+            }
+            plan.edges[i].site = sites.back();
+        }
+        else
+        {
+            order.push_back(i);
+        }
+    }
+    // edges that can't hold a counter go in first, then the edges deepest in loops (the hottest edges are the ones left uncounted)
+    stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+        bool lhsFixed = sites[lhs] == CounterSite::None;
+        bool rhsFixed = sites[rhs] == CounterSite::None;
+        if (lhsFixed != rhsFixed)
+        {
+            return lhsFixed;
+        }
+        return plan.edges[lhs].depth > plan.edges[rhs].depth;
+    });
+    for (const auto &i : order)
+    {
+        auto &e = plan.edges[i];
+        if (tree.join(node.at(e.src), e.snk ? node.at(e.snk) : exitNode))
+        {
+            continue;
+        }
+        if (sites[i] == CounterSite::None)
+        {
+            return false;
+        }
+        e.site = sites[i];
+    }
+    for (auto &e : plan.edges)
+    {
+        if (e.site != CounterSite::None)
+        {
+            e.counter = (int64_t)nextCounter++;
+        }
+    }
+    return true;
+}
+
+void Cyclebite::Profile::Passes::PlaceCounters(const CounterPlan &plan, GlobalVariable *counters, Function *increment)
+{
+    for (const auto &e : plan.edges)
+    {
+        Instruction *at = nullptr;
+        switch (e.site)
+        {
+            case CounterSite::SrcTop:
+                at = &*e.src->getFirstInsertionPt();
+                break;
+            case CounterSite::SrcEnd:
+                at = e.src->getTerminator();
+                break;
+            case CounterSite::SnkTop:
+                at = &*e.snk->getFirstInsertionPt();
+                break;
+            case CounterSite::Split:
+            {
+                auto term = e.src->getTerminator();
+                unsigned succ = 0;
+                while (term->getSuccessor(succ) != e.snk)
+                {
+                    succ++;
+                }
+                auto edgeBlock = SplitCriticalEdge(term, succ, CriticalEdgeSplittingOptions().setMergeIdenticalEdges());
+                if (!edgeBlock)
+                {
+                    throw CyclebiteException("Could not split the edge of a counter in function " + plan.F->getName().str() + "!");
+                }
+                at = &*edgeBlock->getFirstInsertionPt();
+                break;
+            }
+            case CounterSite::None:
+                continue;
+        }
+        IRBuilder<> builder(at);
+        auto slot = builder.CreateConstInBoundsGEP2_64(counters->getValueType(), counters, 0, (uint64_t)e.counter);
+        builder.CreateAtomicRMW(AtomicRMWInst::Add, slot, builder.getInt64(1), MaybeAlign(8), AtomicOrdering::Monotonic);
+        if (e.returns)
+        {
+            // the backend has to see the block the callee returned to
+            auto call = builder.CreateCall(increment, {builder.getInt64((uint64_t)e.snkID), builder.getInt1(false)});
+            call->setDebugLoc(NULL);
+        }
+    }
+}
+
+void Cyclebite::Profile::Passes::AppendEdgeTable(const CounterPlan &plan, vector<uint64_t> &table)
+{
+    table.push_back(plan.edges.size());
+    table.push_back((uint64_t)plan.entry);
+    for (const auto &e : plan.edges)
+    {
+        table.push_back((uint64_t)e.srcID);
+        table.push_back((uint64_t)e.snkID);
+        table.push_back((uint64_t)e.counter);
+        table.push_back((uint64_t)e.profileSrc);
+    }
+}
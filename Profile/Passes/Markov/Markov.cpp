@@ -257,37 +257,178 @@ namespace Cyclebite::Profile::Passes
 } // namespace Cyclebite::Profile::Passes
 */
 #include "inc/Markov.h"
+#include "inc/CounterPlacement.h"
 #include "Functions.h"
+#include "PassRegistration.h"
+#include "Selection.h"
 #include "Util/Annotate.h"
 #include "Util/Format.h"
+#include "Util/Split.h"
 #include <llvm/IR/IRBuilder.h>
 #include <spdlog/spdlog.h>
 #include <deque>
 
 using namespace llvm;
 
+namespace
+{
+    /// How the Markov profiler counts the edges inside of a function
+    enum class Placement
+    {
+        /// every block tells the backend it was entered
+        Blocks,
+        /// only the edges outside of a spanning tree of each function are counted, the backend derives the rest when the profile is done
+        SpanningTree
+    };
+    cl::opt<Cyclebite::Profile::Passes::ExtensionPoint> MarkovEP("markov-ep", cl::desc("Where to schedule Markov instrumentation in the default pipelines"), cl::init(Cyclebite::Profile::Passes::ExtensionPoint::None), Cyclebite::Profile::Passes::ExtensionPointValues());
+    cl::opt<std::string> MarkovBitcode("markov-bitcode", cl::desc("Write the bitcode the Markov profiler is injected into to this file"), cl::value_desc("bitcode filename"));
+    cl::opt<Placement> MarkovPlacement("markov-placement", cl::desc("Where the Markov profiler counts the edges inside of functions"), cl::init(Placement::Blocks),
+        cl::values(
+            clEnumValN(Placement::Blocks, "blocks", "Report every block to the backend"),
+            clEnumValN(Placement::SpanningTree, "spanning-tree", "Count only the edges outside of a maximum spanning tree of each function")));
+    cl::list<std::string> MarkovAllow("markov-allow", cl::desc("Only profile the blocks of functions whose name or source file matches this regex (may be repeated)"), cl::value_desc("regex"));
+    cl::list<std::string> MarkovDeny("markov-deny", cl::desc("Don't profile the blocks of functions whose name or source file matches this regex (may be repeated)"), cl::value_desc("regex"));
+    cl::opt<std::string> MarkovKernels("markov-kernels", cl::desc("Only profile the blocks of functions that hold a block of a kernel in this kernel or hotcode file"), cl::value_desc("kernel filename"));
+} // namespace
+
 llvm::PreservedAnalyses Cyclebite::Profile::Passes::Markov::run(llvm::Module& M, llvm::ModuleAnalysisManager& )
 {
     MarkovInit = cast<Function>(M.getOrInsertFunction("MarkovInit", Type::getVoidTy(M.getContext()), Type::getInt64Ty(M.getContext()), Type::getInt64Ty(M.getContext())).getCallee());
     MarkovDestroy = cast<Function>(M.getOrInsertFunction("MarkovDestroy", Type::getVoidTy(M.getContext())).getCallee());
     MarkovIncrement = cast<Function>(M.getOrInsertFunction("MarkovIncrement", Type::getVoidTy(M.getContext()), Type::getInt64Ty(M.getContext()), Type::getInt1Ty(M.getContext())).getCallee());
     MarkovLaunch = cast<Function>(M.getOrInsertFunction("MarkovLaunch", Type::getVoidTy(M.getContext()), Type::getInt64Ty(M.getContext())).getCallee());
+    MarkovCall = cast<Function>(M.getOrInsertFunction("MarkovCall", Type::getVoidTy(M.getContext()), Type::getInt64Ty(M.getContext()), Type::getInt64Ty(M.getContext()), Type::getInt32Ty(M.getContext())).getCallee());
+    MarkovIntrinsic = cast<Function>(M.getOrInsertFunction("MarkovIntrinsic", Type::getVoidTy(M.getContext()), Type::getInt64Ty(M.getContext()), Type::getInt64Ty(M.getContext()), Type::getInt64Ty(M.getContext())).getCallee());
+    MarkovReturn = cast<Function>(M.getOrInsertFunction("MarkovReturn", Type::getVoidTy(M.getContext()), Type::getInt64Ty(M.getContext())).getCallee());
+    MarkovCounters = cast<Function>(M.getOrInsertFunction("MarkovCounters", Type::getVoidTy(M.getContext()), Type::getInt64PtrTy(M.getContext()), Type::getInt64PtrTy(M.getContext()), Type::getInt64Ty(M.getContext())).getCallee());
     uint64_t blockCount = Util::GetBlockCount(M);
     ConstantInt *i = ConstantInt::get(Type::getInt64Ty(M.getContext()), blockCount);
     new GlobalVariable(M, i->getType(), false, llvm::GlobalValue::LinkageTypes::ExternalLinkage, i, "MarkovBlockCount");
     Util::Format(M);
+    // block IDs are given out to the split module, so the ID space has to be counted before the calls are joined back into their blocks
+    uint64_t idCount = Util::GetBlockCount(M);
+    // functions left out of the profile only report their entrance, the rest of their blocks stay cold
+    auto selected = SelectFunctions(M, SelectionRules{{MarkovAllow.begin(), MarkovAllow.end()}, {MarkovDeny.begin(), MarkovDeny.end()}, MarkovKernels});
+    if (!MarkovAllow.empty() || !MarkovDeny.empty() || !MarkovKernels.empty())
+    {
+        spdlog::info("Profiling the blocks of " + std::to_string(selected.size()) + " functions, the others are collapsed into their entry blocks");
+    }
+    // the profiled binary keeps its original blocks, each call site tells the backend which split block it stands for
+    Join(M);
+    // spanning tree placement is planned up front, block IDs can't be read once the blocks are instrumented
+    std::vector<CounterPlan> plans;
+    std::set<Function *> counted;
+    uint64_t counterCount = 0;
+    if (MarkovPlacement == Placement::SpanningTree)
+    {
+        for (auto &F : M)
+        {
+            if (F.empty() || !selected.contains(&F))
+            {
+                continue;
+            }
+            CounterPlan plan;
+            if (PlanCounters(F, plan, counterCount))
+            {
+                counted.insert(&F);
+                plans.push_back(std::move(plan));
+            }
+            else
+            {
+                spdlog::warn("Function " + F.getName().str() + " has an edge that can't hold a counter, its blocks will be reported one by one");
+            }
+        }
+    }
+    GlobalVariable *counters = nullptr;
+    GlobalVariable *edgeTable = nullptr;
+    std::vector<uint64_t> table;
+    if (!plans.empty())
+    {
+        for (const auto &plan : plans)
+        {
+            AppendEdgeTable(plan, table);
+        }
+        auto counterType = ArrayType::get(Type::getInt64Ty(M.getContext()), std::max(counterCount, (uint64_t)1));
+        counters = new GlobalVariable(M, counterType, false, llvm::GlobalValue::LinkageTypes::InternalLinkage, ConstantAggregateZero::get(counterType), "MarkovEdgeCounters");
+        auto tableInit = ConstantDataArray::get(M.getContext(), table);
+        edgeTable = new GlobalVariable(M, tableInit->getType(), true, llvm::GlobalValue::LinkageTypes::InternalLinkage, tableInit, "MarkovEdgeTable");
+    }
     for( auto& F : M )
     {
+        bool opaque = !selected.contains(&F);
+        int64_t entryID = F.empty() ? -1 : Cyclebite::Util::GetBlockID(&F.getEntryBlock());
         for (auto fi = F.begin(); fi != F.end(); fi++)
         {
             auto *BB = cast<BasicBlock>(fi);
             int64_t id = Cyclebite::Util::GetBlockID(BB);
+
+            // call sites
+            // the backend is in the block itself or in the block after the previous call when a call is reached
+            // a collapsed function never says where it is, control comes back to the profile on the next reported block
+            std::vector<CallBase *> calls;
+            for (auto &inst : *BB)
+            {
+                if (auto call = dyn_cast<CallBase>(&inst); call && !opaque)
+                {
+                    if (GetCallBlockIDs(call).first >= 0)
+                    {
+                        calls.push_back(call);
+                    }
+                }
+            }
+            int64_t segment = id;
+            uint32_t position = 0;
+            for (auto call : calls)
+            {
+                auto ids = GetCallBlockIDs(call);
+                IRBuilder<> callBuilder(call);
+                if (call->getCalledFunction() && call->getCalledFunction()->isIntrinsic() && (ids.second >= 0))
+                {
+                    // intrinsics never reach profiled code, so the backend can go straight to the block after the call
+                    std::vector<Value *> args;
+                    args.push_back(ConstantInt::get(Type::getInt64Ty(BB->getContext()), (uint64_t)segment));
+                    args.push_back(ConstantInt::get(Type::getInt64Ty(BB->getContext()), (uint64_t)ids.first));
+                    args.push_back(ConstantInt::get(Type::getInt64Ty(BB->getContext()), (uint64_t)ids.second));
+                    auto hook = callBuilder.CreateCall(MarkovIntrinsic, args);
+                    hook->setDebugLoc(NULL);
+                }
+                else
+                {
+                    std::vector<Value *> args;
+                    args.push_back(ConstantInt::get(Type::getInt64Ty(BB->getContext()), (uint64_t)segment));
+                    args.push_back(ConstantInt::get(Type::getInt64Ty(BB->getContext()), (uint64_t)ids.first));
+                    args.push_back(ConstantInt::get(Type::getInt32Ty(BB->getContext()), position));
+                    auto hook = callBuilder.CreateCall(MarkovCall, args);
+                    hook->setDebugLoc(NULL);
+                    if (ids.second >= 0)
+                    {
+                        // the return from the callee is a real edge into the block after the call
+                        IRBuilder<> returnBuilder(call->getNextNode());
+                        std::vector<Value *> retArgs;
+                        retArgs.push_back(ConstantInt::get(Type::getInt64Ty(BB->getContext()), (uint64_t)ids.second));
+                        retArgs.push_back(ConstantInt::get(Type::getInt1Ty(BB->getContext()), false));
+                        auto ret = returnBuilder.CreateCall(MarkovIncrement, retArgs);
+                        ret->setDebugLoc(NULL);
+                    }
+                }
+                segment = ids.second;
+                position++;
+            }
+            if (counted.contains(&F) && isa<ReturnInst>(BB->getTerminator()) && (F.getName() != "main") && (segment >= 0))
+            {
+                // no block in between reports itself, so the backend is told which block the function returns from
+                IRBuilder<> returnBuilder(BB->getTerminator());
+                auto call = returnBuilder.CreateCall(MarkovReturn, {ConstantInt::get(Type::getInt64Ty(BB->getContext()), (uint64_t)segment)});
+                call->setDebugLoc(NULL);
+            }
+
             auto firstInsertion = cast<Instruction>(BB->getFirstInsertionPt());
             IRBuilder<> firstBuilder(firstInsertion);
 
             // insert MarkovIncrement
             // skip this if we are in the first block of main
-            if (!((F.getName() == "main") && (fi == F.begin())))
+            // functions with edge counters only report their entrance
+            if (!((F.getName() == "main") && (fi == F.begin())) && ((!counted.contains(&F) && !opaque) || (fi == F.begin())))
             {
                 // if we are at the first block of a function, mark this as a function entrance increment
                 std::vector<Value *> args;
@@ -318,14 +459,19 @@ llvm::PreservedAnalyses Cyclebite::Profile::Passes::Markov::run(llvm::Module& M,
                     std::vector<Value *> args;
                     // get blockCount and make it a value in the LLVM Module
                     IRBuilder<> initBuilder(firstInsertion);
-                    uint64_t blockCount = Cyclebite::Util::GetBlockCount(M);
-                    Value *countValue = ConstantInt::get(Type::getInt64Ty(BB->getContext()), blockCount);
+                    Value *countValue = ConstantInt::get(Type::getInt64Ty(BB->getContext()), idCount);
                     args.push_back(countValue);
                     // get the BBID and make it a value in the LLVM Module
                     Value *blockID = ConstantInt::get(Type::getInt64Ty(BB->getContext()), (uint64_t)id);
                     args.push_back(blockID);
                     auto call = initBuilder.CreateCall(MarkovInit, args);
                     call->setDebugLoc(NULL);
+                    if (counters)
+                    {
+                        auto i64Ptr = Type::getInt64PtrTy(BB->getContext());
+                        auto tableCall = initBuilder.CreateCall(MarkovCounters, {initBuilder.CreatePointerCast(counters, i64Ptr), initBuilder.CreatePointerCast(edgeTable, i64Ptr), initBuilder.getInt64(table.size())});
+                        tableCall->setDebugLoc(NULL);
+                    }
                 }
                 // MarkovDestroy
                 // Place this before any return from main
@@ -466,8 +612,11 @@ llvm::PreservedAnalyses Cyclebite::Profile::Passes::Markov::run(llvm::Module& M,
                 if( t == InjectType::Launcher )
                 {
                     // inject launcher function before the launch occurs
+                    // the launcher is the block of the call itself
+                    // a collapsed function launches from its entry block, the only one of its blocks in the profile
+                    auto launcher = opaque ? entryID : GetCallBlockIDs(llvm::cast<CallBase>(bi)).first;
                     std::vector<Value *> args;
-                    Value *blockID = ConstantInt::get(Type::getInt64Ty(BB->getContext()), (uint64_t)id);
+                    Value *blockID = ConstantInt::get(Type::getInt64Ty(BB->getContext()), (uint64_t)(launcher >= 0 ? launcher : id));
                     args.push_back(blockID);
                     IRBuilder<> launchInserter(llvm::cast<Instruction>(bi));
                     auto insert = launchInserter.CreateCall(MarkovLaunch, args);
@@ -490,25 +639,20 @@ llvm::PreservedAnalyses Cyclebite::Profile::Passes::Markov::run(llvm::Module& M,
             }
         } // for fi in F
     } // for F in M
+    for (const auto &plan : plans)
+    {
+        PlaceCounters(plan, counters, MarkovIncrement);
+    }
     return PreservedAnalyses::none();
 }
 
 // new pass manager registration
-llvm::PassPluginLibraryInfo getMarkovPluginInfo() 
+PassPluginLibraryInfo getMarkovPluginInfo() 
 {
     return {LLVM_PLUGIN_API_VERSION, "Markov", LLVM_VERSION_STRING, 
         [](PassBuilder &PB) 
         {
-            PB.registerPipelineParsingCallback( 
-                [](StringRef Name, ModulePassManager& FPM, ArrayRef<PassBuilder::PipelineElement>) 
-                {
-                    if (Name == "Markov") {
-                        FPM.addPass(Cyclebite::Profile::Passes::Markov());
-                        return true;
-                    }
-                    return false;
-                }
-            );
+            Cyclebite::Profile::Passes::RegisterInstrumentation<Cyclebite::Profile::Passes::Markov>(PB, "Markov", MarkovEP, MarkovBitcode);
         }
     };
 }
@@ -0,0 +1,69 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#pragma once
+#include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <cstdint>
+#include <vector>
+
+namespace Cyclebite::Profile::Passes
+{
+    /// Where the counter of an edge is incremented
+    enum class CounterSite
+    {
+        /// the edge is in the spanning tree, its count follows from the others
+        None,
+        /// top of the source block, which has no other successor
+        SrcTop,
+        /// right before the terminator of the source block, after the call the edge returns from
+        SrcEnd,
+        /// top of the sink block, which has no other predecessor
+        SnkTop,
+        /// a new block on the edge
+        Split
+    };
+
+    /// @brief An edge between two original blocks of a function (after Join()), or from a block to the exit of the function
+    struct FlowEdge
+    {
+        llvm::BasicBlock *src;
+        /// nullptr is the exit of the function
+        llvm::BasicBlock *snk;
+        int64_t srcID;
+        /// -1 is the exit of the function
+        int64_t snkID;
+        /// block the edge leaves from in the profile (the fragment after the last call in src), -1 if the edge is not written by the backend
+        int64_t profileSrc;
+        /// the edge is where a call returns to when its block has no post-call fragment, it needs a MarkovIncrement and a counter no matter what
+        bool returns;
+        /// loop depth of src, the deeper the edge the more it should stay in the spanning tree
+        unsigned depth;
+        CounterSite site = CounterSite::None;
+        int64_t counter = -1;
+    };
+
+    /// @brief Counters of one function, placed on the edges that are not in a maximum spanning tree of its CFG (Knuth, "Optimal measurement points for program frequency counts")
+    ///
+    /// The CFG gets a virtual edge from its exit back to its entry, so every tree edge is the sum and difference of counted edges by flow conservation
+    struct CounterPlan
+    {
+        llvm::Function *F;
+        int64_t entry;
+        std::vector<FlowEdge> edges;
+    };
+
+    /// @brief Finds the edges of F that need a counter and where each counter goes
+    ///
+    /// Must run before the module is instrumented, while the block IDs are still readable
+    /// @param nextCounter  Index of the next free counter in the module, advanced past the counters of F
+    /// @retval             False if an edge outside the spanning tree, or an edge a call returns on, can't hold a counter, F has to be profiled block by block then
+    bool PlanCounters(llvm::Function &F, CounterPlan &plan, uint64_t &nextCounter);
+    /// Inserts the counter increments of the plan, counters is the [n x i64] array of the module
+    void PlaceCounters(const CounterPlan &plan, llvm::GlobalVariable *counters, llvm::Function *increment);
+    /// @brief Appends the plan to the edge table the backend solves when the profile is done
+    ///
+    /// Each function is {edge count, entry block} followed by {src, snk, counter, profile src} for each edge, -1 stands for "exit", "no counter" and "not in the profile"
+    void AppendEdgeTable(const CounterPlan &plan, std::vector<uint64_t> &table);
+} // namespace Cyclebite::Profile::Passes
@@ -0,0 +1,217 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "inc/AccessElision.h"
+#include "Util/Annotate.h"
+#include <llvm/Analysis/AliasAnalysis.h>
+#include <llvm/Analysis/CaptureTracking.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Analysis/MemoryLocation.h>
+#include <llvm/Analysis/ScalarEvolution.h>
+#include <llvm/Analysis/ScalarEvolutionExpressions.h>
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <map>
+
+using namespace llvm;
+using namespace std;
+using namespace Cyclebite::Profile::Passes;
+
+namespace
+{
+    uint64_t AccessSize(const Instruction *inst, const DataLayout &DL)
+    {
+        if (auto load = dyn_cast<LoadInst>(inst))
+        {
+            return DL.getTypeAllocSize(load->getType());
+        }
+        return DL.getTypeAllocSize(cast<StoreInst>(inst)->getValueOperand()->getType());
+    }
+
+    /// Slots that are small enough to never make a tuple and whose address never leaves the function
+    bool IsPrivateSlot(const Value *ptr, const DataLayout &DL, map<const AllocaInst *, bool> &slots)
+    {
+        auto slot = dyn_cast<AllocaInst>(getUnderlyingObject(ptr));
+        if (!slot)
+        {
+            return false;
+        }
+        if (slots.find(slot) == slots.end())
+        {
+            auto bits = slot->getAllocationSizeInBits(DL);
+            slots[slot] = bits && !bits->isScalable() && (bits->getFixedValue() <= MAX_PRIVATE_SLOT * 8) && !PointerMayBeCaptured(slot, true, true);
+        }
+        return slots.at(slot);
+    }
+
+    /// Loops whose accesses can be summarized: every iteration leaves through the latch and nothing outside the loop runs until it exits
+    bool IsSummarizable(const Loop *L)
+    {
+        auto latch = L->getLoopLatch();
+        if (!latch || (L->getExitingBlock() != latch) || !L->getExitBlock() || !isa<BranchInst>(latch->getTerminator()))
+        {
+            return false;
+        }
+        if (L->getExitBlock()->isEHPad())
+        {
+            return false;
+        }
+        // a callee may start another epoch in the middle of the loop
+        for (auto BB : L->blocks())
+        {
+            for (auto &inst : *BB)
+            {
+                if (isa<CallBase>(inst) && !isa<IntrinsicInst>(inst))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+} // namespace
+
+void Cyclebite::Profile::Passes::PlanElision(Function &F, FunctionAnalysisManager &FAM, bool loopRanges, ElisionPlan &plan)
+{
+    const auto &DL = F.getParent()->getDataLayout();
+    auto &AA = FAM.getResult<AAManager>(F);
+    map<const AllocaInst *, bool> slots;
+    // the frame lays its slots out next to each other, so one instrumented slot could merge with the tuples of a small one in the backend
+    bool privateFrame = true;
+    for (auto &inst : instructions(F))
+    {
+        if (isa<AllocaInst>(inst) && !IsPrivateSlot(&inst, DL, slots))
+        {
+            privateFrame = false;
+            break;
+        }
+    }
+    for (auto &BB : F)
+    {
+        // accesses of the block that still report to the backend, loads and stores are kept apart because they go to different tuple sets
+        vector<const Instruction *> reported;
+        for (auto &inst : BB)
+        {
+            if (!isa<LoadInst, StoreInst>(inst))
+            {
+                continue;
+            }
+            if (privateFrame && IsPrivateSlot(getLoadStorePointerOperand(&inst), DL, slots))
+            {
+                plan.elided.insert(&inst);
+                continue;
+            }
+            const Instruction *same = nullptr;
+            for (const auto &prior : reported)
+            {
+                if ((prior->getOpcode() == inst.getOpcode()) && (AccessSize(prior, DL) == AccessSize(&inst, DL)) && AA.isMustAlias(MemoryLocation::get(prior), MemoryLocation::get(&inst)))
+                {
+                    same = prior;
+                    break;
+                }
+            }
+            if (same)
+            {
+                plan.elided.insert(&inst);
+                plan.duplicates.push_back(pair(Cyclebite::Util::GetValueID(&inst), Cyclebite::Util::GetValueID(same)));
+                continue;
+            }
+            reported.push_back(&inst);
+        }
+    }
+    if (!loopRanges)
+    {
+        return;
+    }
+    auto &LI = FAM.getResult<LoopAnalysis>(F);
+    auto &SE = FAM.getResult<ScalarEvolutionAnalysis>(F);
+    auto &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+    for (auto L : LI.getLoopsInPreorder())
+    {
+        if (!IsSummarizable(L))
+        {
+            continue;
+        }
+        auto latch = L->getLoopLatch();
+        for (auto BB : L->blocks())
+        {
+            // only blocks of this loop (not its subloops) that run exactly once per iteration
+            if ((LI.getLoopFor(BB) != L) || !DT.dominates(BB, latch))
+            {
+                continue;
+            }
+            for (auto &inst : *BB)
+            {
+                if (!isa<LoadInst, StoreInst>(inst) || plan.elided.contains(&inst))
+                {
+                    continue;
+                }
+                auto addr = SE.getSCEV(getLoadStorePointerOperand(&inst));
+                int64_t stride = 0;
+                if (!SE.isLoopInvariant(addr, L))
+                {
+                    auto rec = dyn_cast<SCEVAddRecExpr>(addr);
+                    if (!rec || (rec->getLoop() != L) || !rec->isAffine())
+                    {
+                        continue;
+                    }
+                    auto step = dyn_cast<SCEVConstant>(rec->getStepRecurrence(SE));
+                    if (!step)
+                    {
+                        continue;
+                    }
+                    stride = step->getAPInt().getSExtValue();
+                }
+                plan.elided.insert(&inst);
+                plan.ranges.push_back(AccessRange{&inst, L->getHeader(), latch, L->getExitBlock(), stride});
+            }
+        }
+    }
+}
+
+void Cyclebite::Profile::Passes::PlaceRanges(const ElisionPlan &plan, Function *loadRange, Function *storeRange)
+{
+    map<BasicBlock *, vector<const AccessRange *>> loops;
+    for (const auto &range : plan.ranges)
+    {
+        loops[range.latch].push_back(&range);
+    }
+    for (const auto &[latch, ranges] : loops)
+    {
+        auto header = ranges.front()->header;
+        auto exit = ranges.front()->exit;
+        // iterations done so far, the addresses of the last iteration are still live on the way out
+        IRBuilder<> headerBuilder(&header->front());
+        auto trips = headerBuilder.CreatePHI(headerBuilder.getInt64Ty(), 2, "memory.trips");
+        IRBuilder<> latchBuilder(latch->getTerminator());
+        auto next = cast<Instruction>(latchBuilder.CreateAdd(trips, latchBuilder.getInt64(1), "memory.trips.next"));
+        if (&*latch->getFirstInsertionPt() == next)
+        {
+            // the block ID lives on the first instruction that isn't a phi
+            next->setMetadata("BlockID", latch->getTerminator()->getMetadata("BlockID"));
+        }
+        for (auto pred : predecessors(header))
+        {
+            trips->addIncoming(pred == latch ? (Value *)next : (Value *)headerBuilder.getInt64(0), pred);
+        }
+        auto edge = BasicBlock::Create(header->getContext(), "memory.ranges", header->getParent(), exit);
+        latch->getTerminator()->replaceSuccessorWith(exit, edge);
+        exit->replacePhiUsesWith(latch, edge);
+        IRBuilder<> builder(edge);
+        for (const auto &range : ranges)
+        {
+            // walk backwards from the last address, so the range needs nothing that isn't available in the loop
+            auto ptr = getLoadStorePointerOperand(range->access);
+            auto last = builder.CreatePointerCast(ptr, builder.getInt8PtrTy());
+            auto size = AccessSize(range->access, range->access->getModule()->getDataLayout());
+            auto call = builder.CreateCall(isa<LoadInst>(range->access) ? loadRange : storeRange, {last, builder.getInt64((uint64_t)Cyclebite::Util::GetValueID(range->access)), builder.getInt64(size), builder.getInt64((uint64_t)-range->stride), next});
+            call->setDebugLoc(NULL);
+        }
+        builder.CreateBr(exit);
+    }
+}
@@ -377,15 +377,30 @@ namespace Cyclebite::Profile::Passes
 } // namespace Cyclebite::Profile::Passes
 */
 #include "inc/Memory.h"
+#include "inc/AccessElision.h"
 #include "Functions.h"
+#include "PassRegistration.h"
+#include "Selection.h"
 #include "Util/Annotate.h"
 #include "Util/Format.h"
 #include <llvm/IR/IRBuilder.h>
 #include <spdlog/spdlog.h>
+#include <map>
 
 using namespace llvm;
 
-llvm::PreservedAnalyses Cyclebite::Profile::Passes::Memory::run(llvm::Module& M, llvm::ModuleAnalysisManager& )
+namespace
+{
+    cl::opt<Cyclebite::Profile::Passes::ExtensionPoint> MemoryEP("memory-ep", cl::desc("Where to schedule Memory instrumentation in the default pipelines"), cl::init(Cyclebite::Profile::Passes::ExtensionPoint::None), Cyclebite::Profile::Passes::ExtensionPointValues());
+    cl::opt<std::string> MemoryBitcode("memory-bitcode", cl::desc("Write the bitcode the Memory profiler is injected into to this file"), cl::value_desc("bitcode filename"));
+    cl::opt<bool> MemoryElide("memory-elide", cl::desc("Skip loads and stores whose backend calls carry no information (small private stack slots, must-alias repeats in a block)"), cl::init(true));
+    cl::opt<bool> MemoryLoopRanges("memory-loop-ranges", cl::desc("Report affine loads and stores of call-free loops once per loop exit instead of once per iteration (needs -memory-elide)"), cl::init(true));
+    cl::list<std::string> MemoryAllow("memory-allow", cl::desc("Only profile the memory of functions whose name or source file matches this regex (may be repeated)"), cl::value_desc("regex"));
+    cl::list<std::string> MemoryDeny("memory-deny", cl::desc("Don't profile the memory of functions whose name or source file matches this regex (may be repeated)"), cl::value_desc("regex"));
+    cl::opt<std::string> MemoryKernels("memory-kernels", cl::desc("Only profile the memory of functions that hold a block of a kernel in this kernel or hotcode file"), cl::value_desc("kernel filename"));
+} // namespace
+
+llvm::PreservedAnalyses Cyclebite::Profile::Passes::Memory::run(llvm::Module& M, llvm::ModuleAnalysisManager& MAM)
 {
     MemoryLoad      = cast<Function>(M.getOrInsertFunction("__Cyclebite__Profile__Backend__MemoryLoad", Type::getVoidTy(M.getContext()), Type::getIntNPtrTy(M.getContext(), 8), Type::getInt64Ty(M.getContext()), Type::getInt64Ty(M.getContext())).getCallee());
     MemoryStore     = cast<Function>(M.getOrInsertFunction("__Cyclebite__Profile__Backend__MemoryStore", Type::getVoidTy(M.getContext()), Type::getIntNPtrTy(M.getContext(), 8), Type::getInt64Ty(M.getContext()),  Type::getInt64Ty(M.getContext())).getCallee());
@@ -397,23 +412,71 @@ llvm::PreservedAnalyses Cyclebite::Profile::Passes::Memory::run(llvm::Module& M,
     MemorySet       = cast<Function>(M.getOrInsertFunction("__Cyclebite__Profile__Backend__MemorySet", Type::getVoidTy(M.getContext()), Type::getIntNPtrTy(M.getContext(), 8), Type::getInt64Ty(M.getContext())).getCallee());
     MemoryMalloc    = cast<Function>(M.getOrInsertFunction("__Cyclebite__Profile__Backend__MemoryMalloc", Type::getVoidTy(M.getContext()), Type::getIntNPtrTy(M.getContext(), 8), Type::getInt64Ty(M.getContext())).getCallee());
     MemoryFree      = cast<Function>(M.getOrInsertFunction("__Cyclebite__Profile__Backend__MemoryFree", Type::getVoidTy(M.getContext()), Type::getIntNPtrTy(M.getContext(), 8)).getCallee());
+    auto MemoryLoadRange  = cast<Function>(M.getOrInsertFunction("__Cyclebite__Profile__Backend__MemoryLoadRange", Type::getVoidTy(M.getContext()), Type::getIntNPtrTy(M.getContext(), 8), Type::getInt64Ty(M.getContext()), Type::getInt64Ty(M.getContext()), Type::getInt64Ty(M.getContext()), Type::getInt64Ty(M.getContext())).getCallee());
+    auto MemoryStoreRange = cast<Function>(M.getOrInsertFunction("__Cyclebite__Profile__Backend__MemoryStoreRange", Type::getVoidTy(M.getContext()), Type::getIntNPtrTy(M.getContext(), 8), Type::getInt64Ty(M.getContext()), Type::getInt64Ty(M.getContext()), Type::getInt64Ty(M.getContext()), Type::getInt64Ty(M.getContext())).getCallee());
+    auto MemoryDuplicates = cast<Function>(M.getOrInsertFunction("__Cyclebite__Profile__Backend__MemoryDuplicates", Type::getVoidTy(M.getContext()), Type::getInt64PtrTy(M.getContext()), Type::getInt64Ty(M.getContext())).getCallee());
     uint64_t blockCount = Util::GetBlockCount(M);
     ConstantInt *i = ConstantInt::get(Type::getInt64Ty(M.getContext()), blockCount);
     new GlobalVariable(M, i->getType(), false, llvm::GlobalValue::LinkageTypes::ExternalLinkage, i, "MarkovBlockCount");
     Util::Format(M);
+    // functions left out of the profile only report their entrance, their loads and stores are not seen
+    auto selected = SelectFunctions(M, SelectionRules{{MemoryAllow.begin(), MemoryAllow.end()}, {MemoryDeny.begin(), MemoryDeny.end()}, MemoryKernels});
+    if( !MemoryAllow.empty() || !MemoryDeny.empty() || !MemoryKernels.empty() )
+    {
+        spdlog::info("Profiling the memory of " + std::to_string(selected.size()) + " functions, the others are collapsed into their entry blocks");
+    }
+    // all analyses have to be done before the first function is touched
+    std::map<Function*, ElisionPlan> plans;
+    std::vector<uint64_t> duplicates;
+    if( MemoryElide )
+    {
+        auto& FAM = MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+        for( auto& F : M )
+        {
+            if( F.isDeclaration() || !selected.contains(&F) )
+            {
+                continue;
+            }
+            // Format() changed the function after anything was cached
+            FAM.invalidate(F, PreservedAnalyses::none());
+            PlanElision(F, FAM, MemoryLoopRanges, plans[&F]);
+            for( const auto& dup : plans[&F].duplicates )
+            {
+                duplicates.push_back((uint64_t)dup.first);
+                duplicates.push_back((uint64_t)dup.second);
+            }
+        }
+        for( const auto& [F, plan] : plans )
+        {
+            PlaceRanges(plan, MemoryLoadRange, MemoryStoreRange);
+        }
+    }
+    GlobalVariable* duplicateTable = nullptr;
+    if( !duplicates.empty() )
+    {
+        auto table = ConstantDataArray::get(M.getContext(), duplicates);
+        duplicateTable = new GlobalVariable(M, table->getType(), true, llvm::GlobalValue::LinkageTypes::PrivateLinkage, table, "MemoryDuplicates");
+    }
     for( auto& F : M )
     {
         auto dl = F.getParent()->getDataLayout();
+        bool opaque = !selected.contains(&F);
         for (auto fi = F.begin(); fi != F.end(); fi++)
         {
             auto BB = cast<BasicBlock>(fi);
             int64_t blockId = Cyclebite::Util::GetBlockID(BB);
+            if( blockId < 0 )
+            {
+                // blocks that hold the loop ranges
+                continue;
+            }
             auto firstInsertion = BB->getFirstInsertionPt();
             auto *firstInst = cast<Instruction>(firstInsertion);
             IRBuilder<> firstBuilder(firstInst);
 
             // skip this if we are in the first block of main
-            if (!((F.getName() == "main") && (fi == F.begin())))
+            // a collapsed function only reports its entry block
+            if (!((F.getName() == "main") && (fi == F.begin())) && (!opaque || (fi == F.begin())))
             {
                 Value *idValue = ConstantInt::get(Type::getInt64Ty(BB->getContext()), (uint64_t)blockId);
                 std::vector<Value *> args;
@@ -440,6 +503,13 @@ llvm::PreservedAnalyses Cyclebite::Profile::Passes::Memory::run(llvm::Module& M,
                     args.push_back(blockID);
                     auto call = initBuilder.CreateCall(MemoryInit, args);
                     call->setDebugLoc(NULL);
+                    if( duplicateTable )
+                    {
+                        // the backend reports an elided access wherever the access it repeats shows up
+                        auto table = initBuilder.CreateConstInBoundsGEP2_64(duplicateTable->getValueType(), duplicateTable, 0, 0);
+                        auto dups = initBuilder.CreateCall(MemoryDuplicates, {table, initBuilder.getInt64(duplicates.size() / 2)});
+                        dups->setDebugLoc(NULL);
+                    }
                 }
                 // MemoryDestroy
                 // Place this before any return from main
@@ -496,6 +566,10 @@ llvm::PreservedAnalyses Cyclebite::Profile::Passes::Memory::run(llvm::Module& M,
             {
                 auto *CI = dyn_cast<Instruction>(BI);
                 std::vector<Value *> values;
+                if( opaque || (plans.find(&F) != plans.end() && plans.at(&F).elided.contains(CI)) )
+                {
+                    continue;
+                }
                 if (auto *load = dyn_cast<LoadInst>(CI))
                 {
                     IRBuilder<> builder(load);
@@ -538,6 +612,11 @@ llvm::PreservedAnalyses Cyclebite::Profile::Passes::Memory::run(llvm::Module& M,
             // now inject MemoryMove, MemoryCpy, MemorySet, MemoryMalloc, MemoryFree
             for (BasicBlock::iterator BI = fi->begin(), BE = fi->end(); BI != BE; ++BI)
             {
+                // a collapsed function still reports its allocations, the profiled functions may touch the memory it hands out
+                if( opaque && !(isa<CallBase>(BI) && (Cyclebite::Util::isAllocatingFunction(cast<CallBase>(BI)) || Cyclebite::Util::isFreeingFunction(cast<CallBase>(BI)))) )
+                {
+                    continue;
+                }
                 if( auto cpy  = llvm::dyn_cast<AnyMemCpyInst>(BI) )
                 {
                     IRBuilder<> builder(cpy);
@@ -759,7 +838,7 @@ llvm::PreservedAnalyses Cyclebite::Profile::Passes::Memory::run(llvm::Module& M,
             }
         }
     }
-    return PreservedAnalyses::all();
+    return PreservedAnalyses::none();
 }
 
 // new pass manager registration
@@ -768,16 +847,7 @@ PassPluginLibraryInfo getMemoryPluginInfo()
     return {LLVM_PLUGIN_API_VERSION, "Memory", LLVM_VERSION_STRING, 
         [](PassBuilder &PB) 
         {
-            PB.registerPipelineParsingCallback( 
-                [](StringRef Name, ModulePassManager& FPM, ArrayRef<PassBuilder::PipelineElement>) 
-                {
-                    if (Name == "Memory") {
-                        FPM.addPass(Cyclebite::Profile::Passes::Memory());
-                        return true;
-                    }
-                    return false;
-                }
-            );
+            Cyclebite::Profile::Passes::RegisterInstrumentation<Cyclebite::Profile::Passes::Memory>(PB, "Memory", MemoryEP, MemoryBitcode);
         }
     };
 }
@@ -0,0 +1,55 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#pragma once
+#include <llvm/IR/Function.h>
+#include <llvm/IR/PassManager.h>
+#include <cstdint>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace Cyclebite::Profile::Passes
+{
+    /// @brief Largest stack slot (in bytes) whose accesses may go uninstrumented
+    ///
+    /// The memory backend merges tuples that touch (MTCompare), so a slot this small only stays under MIN_TUPLE_OFFSET while no instrumented memory lies next to it
+    /// Its accesses are only elided when every slot of the frame is this small and private, other frames are kept apart by the return address
+    constexpr uint64_t MAX_PRIVATE_SLOT = 32;
+
+    /// @brief A load or store whose address moves by a constant stride each iteration of its loop, reported once on the edge out of the loop
+    struct AccessRange
+    {
+        llvm::Instruction *access;
+        llvm::BasicBlock *header;
+        /// the only exiting block of the loop
+        llvm::BasicBlock *latch;
+        llvm::BasicBlock *exit;
+        /// bytes between the addresses of two consecutive iterations, 0 when the address is loop-invariant
+        int64_t stride;
+    };
+
+    /// @brief Loads and stores of a function the Memory pass doesn't instrument one by one
+    struct ElisionPlan
+    {
+        /// accesses that get no MemoryLoad/MemoryStore
+        std::set<const llvm::Instruction *> elided;
+        /// {value ID of an elided access, value ID of the access in the same block that touches the same bytes}
+        std::vector<std::pair<int64_t, int64_t>> duplicates;
+        /// elided accesses that are summarized on the exits of their loops
+        std::vector<AccessRange> ranges;
+    };
+
+    /// @brief Finds the loads and stores of F whose backend calls carry no information
+    ///
+    /// - accesses to stack slots that don't escape and are at most MAX_PRIVATE_SLOT bytes, when every stack slot of F is like that
+    /// - accesses that must alias an earlier access of the same kind and size in their block (epochs only change at the top of a block, and Format() leaves no calls inside one)
+    /// - with loopRanges, accesses that run once per iteration of a call-free loop and whose address is affine in the iteration (ScalarEvolution)
+    /// Must run after Format() and before the function is instrumented
+    void PlanElision(llvm::Function &F, llvm::FunctionAnalysisManager &FAM, bool loopRanges, ElisionPlan &plan);
+    /// @brief Puts a MemoryLoadRange/MemoryStoreRange for each range of the plan on a new block between the latch and the exit of its loop
+    ///
+    /// The new blocks have no block ID, the instrumentation has to skip them
+    void PlaceRanges(const ElisionPlan &plan, llvm::Function *loadRange, llvm::Function *storeRange);
+} // namespace Cyclebite::Profile::Passes
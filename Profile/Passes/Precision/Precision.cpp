@@ -2,12 +2,13 @@
 // Copyright 2023 Benjamin Willis
 // SPDX-License-Identifier: Apache-2.0
 //==------------------------------==//
-#include "Precision.h"
+#include "inc/Precision.h"
 #include "Backend/Precision/inc/Precision.h"
-#include "Annotate.h"
 #include "Util/Annotate.h"
+#include "Util/Format.h"
 #include "Util/Print.h"
 #include "Functions.h"
+#include "PassRegistration.h"
 #include "llvm/IR/DataLayout.h"
 #include <fstream>
 #include <llvm/IR/Function.h>
@@ -16,7 +17,6 @@
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/OperandTraits.h>
 #include <llvm/IR/Type.h>
-#include <llvm/Pass.h>
 #include <llvm/Support/raw_ostream.h>
 #include <map>
 #include <spdlog/spdlog.h>
@@ -27,8 +27,8 @@
 
 using namespace llvm;
 using namespace std;
-/*
-namespace Cyclebite::Profile::Passes
+
+namespace
 {
     void PassToBackend(llvm::IRBuilder<>& builder, llvm::Value* val, llvm::Function* fi, uint64_t blockId, uint32_t idx)
     {
@@ -85,10 +85,23 @@ namespace Cyclebite::Profile::Passes
         // data type
         Value *dataType = ConstantInt::get( Type::getInt8Ty(fi->getContext()), static_cast<uint8_t>( Cyclebite::Profile::Backend::Precision::LLVMTy2PrecisionTy(val->getType()) ));
         values.push_back(dataType);
-        auto call = builder.CreateCall(PrecisionLoad, values);
+        auto call = builder.CreateCall(Cyclebite::Profile::Passes::PrecisionLoad, values);
         call->setDebugLoc(NULL);
     }
-    bool Precision::runOnFunction(Function &F)
+
+    cl::opt<Cyclebite::Profile::Passes::ExtensionPoint> PrecisionEP("precision-ep", cl::desc("Where to schedule Precision instrumentation in the default pipelines"), cl::init(Cyclebite::Profile::Passes::ExtensionPoint::None), Cyclebite::Profile::Passes::ExtensionPointValues());
+    cl::opt<std::string> PrecisionBitcode("precision-bitcode", cl::desc("Write the bitcode the Precision profiler is injected into to this file"), cl::value_desc("bitcode filename"));
+} // namespace
+
+llvm::PreservedAnalyses Cyclebite::Profile::Passes::Precision::run(llvm::Module& M, llvm::ModuleAnalysisManager& )
+{
+    PrecisionIncrement = cast<Function>(M.getOrInsertFunction("__Cyclebite__Profile__Backend__PrecisionIncrement", Type::getVoidTy(M.getContext()), Type::getInt64Ty(M.getContext())).getCallee());
+    PrecisionLoad      = cast<Function>(M.getOrInsertFunction("__Cyclebite__Profile__Backend__PrecisionLoad", Type::getVoidTy(M.getContext()), Type::getInt64Ty(M.getContext()), Type::getInt64Ty(M.getContext()), Type::getInt32Ty(M.getContext()), Type::getInt8Ty(M.getContext())).getCallee());
+    PrecisionStore     = cast<Function>(M.getOrInsertFunction("__Cyclebite__Profile__Backend__PrecisionStore", Type::getVoidTy(M.getContext()), Type::getInt64Ty(M.getContext()), Type::getInt64Ty(M.getContext()), Type::getInt32Ty(M.getContext()), Type::getInt8Ty(M.getContext())).getCallee());
+    PrecisionInit      = cast<Function>(M.getOrInsertFunction("__Cyclebite__Profile__Backend__PrecisionInit", Type::getVoidTy(M.getContext()), Type::getInt64Ty(M.getContext())).getCallee());
+    PrecisionDestroy   = cast<Function>(M.getOrInsertFunction("__Cyclebite__Profile__Backend__PrecisionDestroy", Type::getVoidTy(M.getContext())).getCallee());
+    Util::Format(M);
+    for( auto& F : M )
     {
         for (auto fi = F.begin(); fi != F.end(); fi++)
         {
@@ -122,8 +135,8 @@ namespace Cyclebite::Profile::Passes
                     firstInst = cast<Instruction>(firstInsertion);
                     IRBuilder<> initBuilder(firstInst);
                     // get the BBID and make it a value in the LLVM Module
-                    //Value *blockID = ConstantInt::get(Type::getInt64Ty(BB->getContext()), (uint64_t)blockId);
-                    //args.push_back(blockID);
+                    Value *blockID = ConstantInt::get(Type::getInt64Ty(BB->getContext()), (uint64_t)blockId);
+                    args.push_back(blockID);
                     auto call = initBuilder.CreateCall(PrecisionInit, args);
                     call->setDebugLoc(NULL);
                 }
@@ -192,12 +205,12 @@ namespace Cyclebite::Profile::Passes
                         for( unsigned i = 0; i < vt->getElementCount().getFixedValue(); i++ )
                         {
                             auto extracted = builder.CreateExtractElement(intercept, i);
-                            PassToBackend(builder, extracted, llvm::cast<llvm::Function>(fi), (uint64_t)blockId, ldInstructionIndex);
+                            PassToBackend(builder, extracted, &F, (uint64_t)blockId, ldInstructionIndex);
                         }
                     }
                     else
                     {
-                        PassToBackend(builder, intercept, llvm::cast<llvm::Function>(fi), (uint64_t)blockId, ldInstructionIndex);
+                        PassToBackend(builder, intercept, &F, (uint64_t)blockId, ldInstructionIndex);
                     }
                     ldInstructionIndex++;
                 }
@@ -210,57 +223,28 @@ namespace Cyclebite::Profile::Passes
                         for( unsigned i = 0; i < vt->getElementCount().getFixedValue(); i++ )
                         {
                             auto extracted = builder.CreateExtractElement(stVal, i);
-                            PassToBackend(builder, extracted, llvm::cast<llvm::Function>(fi), (uint64_t)blockId, stInstructionIndex);
+                            PassToBackend(builder, extracted, &F, (uint64_t)blockId, stInstructionIndex);
                         }
                     }
                     else
                     {
-                        PassToBackend(builder, stVal, llvm::cast<llvm::Function>(fi), (uint64_t)blockId, stInstructionIndex);
+                        PassToBackend(builder, stVal, &F, (uint64_t)blockId, stInstructionIndex);
                     }
                     stInstructionIndex++;
                 }
             }
         }
-        return true;
-    }
-
-    bool Precision::doInitialization(Module &M)
-    {
-        PrecisionIncrement = cast<Function>(M.getOrInsertFunction("__Cyclebite__Profile__Backend__PrecisionIncrement", Type::getVoidTy(M.getContext()), Type::getInt64Ty(M.getContext())).getCallee());
-        //PrecisionLoad      = cast<Function>(M.getOrInsertFunction("__Cyclebite__Profile__Backend__PrecisionLoad", Type::getVoidTy(M.getContext()), Type::getIntNPtrTy(M.getContext(), 8), Type::getInt64Ty(M.getContext()), Type::getInt32Ty(M.getContext()), Type::getInt8Ty(M.getContext())).getCallee());
-        //PrecisionStore     = cast<Function>(M.getOrInsertFunction("__Cyclebite__Profile__Backend__PrecisionStore", Type::getVoidTy(M.getContext()), Type::getIntNPtrTy(M.getContext(), 8), Type::getInt64Ty(M.getContext()), Type::getInt32Ty(M.getContext()), Type::getInt8Ty(M.getContext())).getCallee());
-        PrecisionLoad      = cast<Function>(M.getOrInsertFunction("__Cyclebite__Profile__Backend__PrecisionLoad", Type::getVoidTy(M.getContext()), Type::getInt64Ty(M.getContext()), Type::getInt64Ty(M.getContext()), Type::getInt32Ty(M.getContext()), Type::getInt8Ty(M.getContext())).getCallee());
-        PrecisionStore     = cast<Function>(M.getOrInsertFunction("__Cyclebite__Profile__Backend__PrecisionStore", Type::getVoidTy(M.getContext()), Type::getInt64Ty(M.getContext()), Type::getInt64Ty(M.getContext()), Type::getInt32Ty(M.getContext()), Type::getInt8Ty(M.getContext())).getCallee());
-        PrecisionInit      = cast<Function>(M.getOrInsertFunction("__Cyclebite__Profile__Backend__PrecisionInit", Type::getVoidTy(M.getContext())).getCallee());
-        PrecisionDestroy   = cast<Function>(M.getOrInsertFunction("__Cyclebite__Profile__Backend__PrecisionDestroy", Type::getVoidTy(M.getContext())).getCallee());
-        return false;
-    }
-
-    void Precision::getAnalysisUsage(AnalysisUsage &AU) const
-    {
-        AU.addRequired<Cyclebite::Profile::Passes::Annotate>();
     }
+    return PreservedAnalyses::none();
+}
 
-    char Precision::ID = 0;
-    static RegisterPass<Precision> Y("Precision", "Injects Precision profiling to the binary", true, false);
-} // namespace Cyclebite::Profile::Passes
-*/
 // new pass manager registration
 llvm::PassPluginLibraryInfo getPrecisionPluginInfo() 
 {
-    return {LLVM_PLUGIN_API_VERSION, "Precisioin", LLVM_VERSION_STRING, 
+    return {LLVM_PLUGIN_API_VERSION, "Precision", LLVM_VERSION_STRING, 
         [](PassBuilder &PB) 
         {
-            PB.registerPipelineParsingCallback( 
-                [](StringRef Name, FunctionPassManager& FPM, ArrayRef<PassBuilder::PipelineElement>) 
-                {
-                    if (Name == "Precisioin") {
-                        FPM.addPass(Cyclebite::Profile::Passes::Precision());
-                        return true;
-                    }
-                    return false;
-                }
-            );
+            Cyclebite::Profile::Passes::RegisterInstrumentation<Cyclebite::Profile::Passes::Precision>(PB, "Precision", PrecisionEP, PrecisionBitcode);
         }
     };
 }
@@ -269,4 +253,4 @@ llvm::PassPluginLibraryInfo getPrecisionPluginInfo()
 extern "C" LLVM_ATTRIBUTE_WEAK ::llvm::PassPluginLibraryInfo llvmGetPassPluginInfo() 
 {
     return getPrecisionPluginInfo();
-}
\ No newline at end of file
+}
@@ -24,8 +24,8 @@ namespace Cyclebite::Profile::Passes
 {
     struct Precision : llvm::PassInfoMixin<Precision> 
     {
-        llvm::PreservedAnalyses run(llvm::Function& M, llvm::FunctionAnalysisManager& );
+        llvm::PreservedAnalyses run(llvm::Module& M, llvm::ModuleAnalysisManager& );
         // without setting this to true, all modules with "optnone" attribute are skipped
-        static bool isRequired();
+        static bool isRequired() { return true; }
     };
 } // namespace Cyclebite::Profile::Passes
\ No newline at end of file
@@ -0,0 +1,215 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "inc/KernelProbes.h"
+#include "Util/Annotate.h"
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <tuple>
+
+using namespace llvm;
+using namespace std;
+using json = nlohmann::json;
+using namespace Cyclebite::Profile::Passes;
+
+namespace
+{
+    /// The call Split() left alone in BB, nullptr if BB has none
+    const CallBase *GetCall(const BasicBlock *BB)
+    {
+        for (const auto &inst : *BB)
+        {
+            if (auto call = dyn_cast<CallBase>(&inst))
+            {
+                if (!isa<DbgInfoIntrinsic>(call))
+                {
+                    return call;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    bool HasInsertionPoint(const BasicBlock *BB)
+    {
+        return BB->getFirstInsertionPt() != BB->end();
+    }
+
+    /// Finds the instruction the probes of the CFG edge src->snk go in front of, splits the edge if it has to
+    Instruction *EdgeInsertionPoint(BasicBlock *src, BasicBlock *snk)
+    {
+        if (src->getUniqueSuccessor() == snk)
+        {
+            return src->getTerminator();
+        }
+        if ((snk->getUniquePredecessor() == src) && HasInsertionPoint(snk))
+        {
+            return &*snk->getFirstInsertionPt();
+        }
+        // critical edges into EH pads and out of indirect branches can't be split
+        if (snk->isEHPad() || isa<IndirectBrInst, CallBrInst>(src->getTerminator()))
+        {
+            return nullptr;
+        }
+        auto term = src->getTerminator();
+        unsigned succ = 0;
+        while (term->getSuccessor(succ) != snk)
+        {
+            succ++;
+        }
+        auto edgeBlock = SplitCriticalEdge(term, succ, CriticalEdgeSplittingOptions().setMergeIdenticalEdges());
+        return edgeBlock ? &*edgeBlock->getFirstInsertionPt() : nullptr;
+    }
+} // namespace
+
+vector<KernelBorders> Cyclebite::Profile::Passes::ReadKernelBorders(const string &file)
+{
+    vector<KernelBorders> kernels;
+    json j;
+    try
+    {
+        ifstream input(file);
+        input >> j;
+    }
+    catch (std::exception &e)
+    {
+        spdlog::critical("Couldn't open kernel file " + file + ": " + string(e.what()));
+        return kernels;
+    }
+    if (j.find("Kernels") == j.end())
+    {
+        return kernels;
+    }
+    for (const auto &[kid, kernel] : j["Kernels"].items())
+    {
+        KernelBorders borders;
+        borders.kid = stol(kid);
+        for (const auto &[src, snks] : kernel["Entrances"].items())
+        {
+            for (const auto &snk : snks.get<vector<string>>())
+            {
+                borders.entrances.insert(pair(stol(src), stol(snk)));
+            }
+        }
+        for (const auto &[src, snks] : kernel["Exits"].items())
+        {
+            for (const auto &snk : snks.get<vector<string>>())
+            {
+                borders.exits.insert(pair(stol(src), stol(snk)));
+            }
+        }
+        kernels.push_back(borders);
+    }
+    return kernels;
+}
+
+uint64_t Cyclebite::Profile::Passes::PlanProbes(Module &M, const vector<KernelBorders> &kernels, vector<KernelProbe> &probes)
+{
+    map<int64_t, BasicBlock *> IDToBlock;
+    for (auto &F : M)
+    {
+        for (auto &BB : F)
+        {
+            auto id = Cyclebite::Util::GetBlockID(&BB);
+            if (id >= 0)
+            {
+                IDToBlock[id] = &BB;
+            }
+        }
+    }
+    uint64_t missing = 0;
+    // an edge out of a function with many returns maps to the same call edge for each of them
+    set<tuple<BasicBlock *, BasicBlock *, CallBase *, uint64_t, bool>> planned;
+    auto plan = [&](const pair<int64_t, int64_t> &edge, uint64_t index, bool enter) {
+        if ((IDToBlock.find(edge.first) == IDToBlock.end()) || (IDToBlock.find(edge.second) == IDToBlock.end()))
+        {
+            missing++;
+            return;
+        }
+        auto src = IDToBlock.at(edge.first);
+        auto snk = IDToBlock.at(edge.second);
+        KernelProbe probe{nullptr, nullptr, nullptr, index, enter};
+        if (is_contained(successors(src), snk))
+        {
+            probe.src = src;
+            probe.snk = snk;
+        }
+        else if (snk->isEntryBlock())
+        {
+            // into a function: the call in src has to go there
+            auto call = const_cast<CallBase *>(GetCall(src));
+            if (!call || (call->getCalledFunction() != snk->getParent()))
+            {
+                missing++;
+                return;
+            }
+            probe.call = call;
+        }
+        else if (isa<ReturnInst>(src->getTerminator()) && snk->getUniquePredecessor() && GetCall(snk->getUniquePredecessor()))
+        {
+            // out of a function: the code after the call is only reached when the callee returns
+            probe.src = snk->getUniquePredecessor();
+            probe.snk = snk;
+        }
+        else
+        {
+            missing++;
+            return;
+        }
+        if (planned.insert(tuple(probe.src, probe.snk, probe.call, probe.index, probe.enter)).second)
+        {
+            probes.push_back(probe);
+        }
+    };
+    for (uint64_t i = 0; i < kernels.size(); i++)
+    {
+        for (const auto &edge : kernels[i].entrances)
+        {
+            plan(edge, i, true);
+        }
+        for (const auto &edge : kernels[i].exits)
+        {
+            plan(edge, i, false);
+        }
+    }
+    return missing;
+}
+
+uint64_t Cyclebite::Profile::Passes::PlaceProbes(const vector<KernelProbe> &probes, Function *enter, Function *exit)
+{
+    // probes that go on the same edge or call share one insertion point
+    map<tuple<BasicBlock *, BasicBlock *, CallBase *>, vector<const KernelProbe *>> sites;
+    for (const auto &probe : probes)
+    {
+        sites[tuple(probe.src, probe.snk, probe.call)].push_back(&probe);
+    }
+    uint64_t unplaced = 0;
+    for (auto &[site, onSite] : sites)
+    {
+        auto &[src, snk, call] = site;
+        Instruction *at = call ? call : EdgeInsertionPoint(src, snk);
+        if (!at)
+        {
+            unplaced += onSite.size();
+            continue;
+        }
+        stable_sort(onSite.begin(), onSite.end(), [](const KernelProbe *lhs, const KernelProbe *rhs) {
+            return !lhs->enter && rhs->enter;
+        });
+        IRBuilder<> builder(at);
+        for (const auto &probe : onSite)
+        {
+            auto hook = builder.CreateCall(probe->enter ? enter : exit, {builder.getInt64(probe->index)});
+            hook->setDebugLoc(NULL);
+        }
+    }
+    return unplaced;
+}
@@ -116,16 +116,52 @@ namespace Cyclebite::Profile::Passes
 */
 
 #include "inc/Timing.h"
+#include "inc/KernelProbes.h"
 #include "../Utilities/inc/Functions.h"
+#include "Util/Format.h"
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/Support/CommandLine.h>
 #include <spdlog/spdlog.h>
 
 using namespace llvm;
 
+namespace
+{
+    cl::opt<std::string> TimingKernelFile("timing-kernels", cl::desc("Time each kernel of this kernel file (written by the cartographer) from its entrance to its exit edges"), cl::value_desc("kernel filename"));
+} // namespace
+
 llvm::PreservedAnalyses Cyclebite::Profile::Passes::Timing::run(llvm::Module& M, llvm::ModuleAnalysisManager& )
 {
     TimingInit = cast<Function>(M.getOrInsertFunction("TimingInit", Type::getVoidTy(M.getContext())).getCallee());
     TimingDestroy = cast<Function>(M.getOrInsertFunction("TimingDestroy", Type::getVoidTy(M.getContext())).getCallee());
+    // kernel borders are edges between blocks of the formatted module, the module has to get the IDs the cartographer saw
+    std::vector<KernelBorders> kernels;
+    std::vector<KernelProbe> probes;
+    GlobalVariable* kernelTable = nullptr;
+    if( !TimingKernelFile.empty() )
+    {
+        kernels = ReadKernelBorders(TimingKernelFile);
+    }
+    if( !kernels.empty() )
+    {
+        TimingKernels = cast<Function>(M.getOrInsertFunction("TimingKernels", Type::getVoidTy(M.getContext()), Type::getInt64PtrTy(M.getContext()), Type::getInt64Ty(M.getContext())).getCallee());
+        TimingKernelEnter = cast<Function>(M.getOrInsertFunction("TimingKernelEnter", Type::getVoidTy(M.getContext()), Type::getInt64Ty(M.getContext())).getCallee());
+        TimingKernelExit = cast<Function>(M.getOrInsertFunction("TimingKernelExit", Type::getVoidTy(M.getContext()), Type::getInt64Ty(M.getContext())).getCallee());
+        Util::Format(M);
+        auto missing = PlanProbes(M, kernels, probes);
+        if( missing )
+        {
+            spdlog::warn(std::to_string(missing)+" kernel entrance and exit edges of "+TimingKernelFile+" are not in this module (or go through indirect calls), their kernels may be timed from the wrong place");
+        }
+        // the backend gets the kernel ID of each probe index
+        std::vector<uint64_t> kids;
+        for( const auto& k : kernels )
+        {
+            kids.push_back((uint64_t)k.kid);
+        }
+        auto table = ConstantDataArray::get(M.getContext(), kids);
+        kernelTable = new GlobalVariable(M, table->getType(), true, llvm::GlobalValue::LinkageTypes::PrivateLinkage, table, "TimingKernelIDs");
+    }
     for( auto& F : M )
     {
         for (auto fi = F.begin(); fi != F.end(); fi++)
@@ -149,6 +185,12 @@ llvm::PreservedAnalyses Cyclebite::Profile::Passes::Timing::run(llvm::Module& M,
                     IRBuilder<> initBuilder(firstInst);
                     auto call = initBuilder.CreateCall(TimingInit);
                     call->setDebugLoc(NULL);
+                    if( kernelTable )
+                    {
+                        auto table = initBuilder.CreateConstInBoundsGEP2_64(kernelTable->getValueType(), kernelTable, 0, 0);
+                        auto kernelCall = initBuilder.CreateCall(TimingKernels, {table, initBuilder.getInt64(kernels.size())});
+                        kernelCall->setDebugLoc(NULL);
+                    }
                 }
                 // TimingDestroy
                 // Place this before any return from main
@@ -202,6 +244,14 @@ llvm::PreservedAnalyses Cyclebite::Profile::Passes::Timing::run(llvm::Module& M,
             }
         }
     }
+    if( !probes.empty() )
+    {
+        auto unplaced = PlaceProbes(probes, TimingKernelEnter, TimingKernelExit);
+        if( unplaced )
+        {
+            spdlog::warn(std::to_string(unplaced)+" kernel probes sit on critical edges that can't be split and were left out");
+        }
+    }
     return PreservedAnalyses::none();
 }
 
@@ -0,0 +1,53 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#pragma once
+#include <llvm/IR/Function.h>
+#include <llvm/IR/InstrTypes.h>
+#include <llvm/IR/Module.h>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Cyclebite::Profile::Passes
+{
+    /// @brief Entrance and exit edges of one kernel, as WriteKernelFile writes them ({src block ID, snk block ID})
+    struct KernelBorders
+    {
+        int64_t kid;
+        std::set<std::pair<int64_t, int64_t>> entrances;
+        std::set<std::pair<int64_t, int64_t>> exits;
+    };
+
+    /// @brief A call to TimingKernelEnter or TimingKernelExit on the place in the module a kernel border stands for
+    struct KernelProbe
+    {
+        /// edge of the CFG the probe goes on, nullptr if the probe goes right before call
+        llvm::BasicBlock *src;
+        llvm::BasicBlock *snk;
+        /// call into the function whose entry the border goes to
+        llvm::CallBase *call;
+        /// position of the kernel in the table the backend is given
+        uint64_t index;
+        bool enter;
+    };
+
+    /// @brief Reads the entrance and exit edges of every kernel in a kernel file
+    ///
+    /// Empty if the file can't be read
+    std::vector<KernelBorders> ReadKernelBorders(const std::string &file);
+    /// @brief Finds where each border edge of the kernels is in M
+    ///
+    /// Block IDs are the ones Format() gives out, so M must have been through Format() and not have been instrumented yet
+    /// An edge between two blocks of a function is a CFG edge, an edge into the entry of a function is the call that goes there, and an edge from a return goes on the edge from the call to the code after it
+    /// @retval Number of border edges that were not found in M
+    uint64_t PlanProbes(llvm::Module &M, const std::vector<KernelBorders> &kernels, std::vector<KernelProbe> &probes);
+    /// @brief Inserts the probes of the plan
+    ///
+    /// Exits go before entrances on the same edge, so an edge that leaves one kernel for another closes the first one before it opens the second
+    /// @retval Number of probes whose edge couldn't be split
+    uint64_t PlaceProbes(const std::vector<KernelProbe> &probes, llvm::Function *enter, llvm::Function *exit);
+} // namespace Cyclebite::Profile::Passes
@@ -26,9 +26,15 @@ namespace Cyclebite::Profile::Passes
     Function *MarkovReturn;
     Function *MarkovExit;
     Function *MarkovLaunch;
+    Function *MarkovCall;
+    Function *MarkovIntrinsic;
+    Function *MarkovCounters;
     // timing pass
     Function *TimingInit;
     Function *TimingDestroy;
+    Function *TimingKernels;
+    Function *TimingKernelEnter;
+    Function *TimingKernelExit;
     // instance pass
     Function *InstanceInit;
     Function *InstanceDestroy;
@@ -0,0 +1,138 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "Selection.h"
+#include "Util/Annotate.h"
+#include "Util/Exceptions.h"
+#include <llvm/Demangle/Demangle.h>
+#include <llvm/IR/DebugInfoMetadata.h>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+#include <fstream>
+#include <regex>
+
+using namespace llvm;
+using namespace std;
+using json = nlohmann::json;
+using namespace Cyclebite::Profile::Passes;
+
+namespace
+{
+    vector<regex> Compile(const vector<string> &patterns)
+    {
+        vector<regex> compiled;
+        for (const auto &pattern : patterns)
+        {
+            try
+            {
+                compiled.push_back(regex(pattern));
+            }
+            catch (regex_error &e)
+            {
+                spdlog::critical("Ignoring function pattern " + pattern + ": " + string(e.what()));
+            }
+        }
+        return compiled;
+    }
+
+    string SourceFile(const Function &F)
+    {
+        if (auto SP = F.getSubprogram())
+        {
+            if (SP->getDirectory().empty())
+            {
+                return SP->getFilename().str();
+            }
+            return SP->getDirectory().str() + "/" + SP->getFilename().str();
+        }
+        return F.getParent()->getSourceFileName();
+    }
+
+    bool Matches(const Function &F, const vector<regex> &patterns)
+    {
+        if (patterns.empty())
+        {
+            return false;
+        }
+        auto name = F.getName().str();
+        auto demangled = demangle(name);
+        auto file = SourceFile(F);
+        for (const auto &pattern : patterns)
+        {
+            if (regex_search(name, pattern) || regex_search(demangled, pattern) || regex_search(file, pattern))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// @brief Block IDs of every kernel in a kernel or hotcode file
+    ///
+    /// Throws when the file can't be read or has no kernels, a file that selects nothing would collapse every function
+    set<int64_t> ReadKernelBlocks(const string &file)
+    {
+        ifstream input(file);
+        if (!input.good())
+        {
+            throw CyclebiteException("Could not open kernel file " + file + " to select functions from");
+        }
+        json j;
+        try
+        {
+            input >> j;
+        }
+        catch (json::exception &e)
+        {
+            throw CyclebiteException("Could not parse kernel file " + file + ": " + string(e.what()));
+        }
+        if (!j.contains("Kernels") || !j["Kernels"].is_object())
+        {
+            throw CyclebiteException("Kernel file " + file + " has no kernels to select functions from");
+        }
+        set<int64_t> blocks;
+        for (const auto &[kid, kernel] : j["Kernels"].items())
+        {
+            if (!kernel.contains("Blocks"))
+            {
+                throw CyclebiteException("Kernel " + kid + " of kernel file " + file + " has no blocks");
+            }
+            for (const auto &block : kernel["Blocks"].get<vector<int64_t>>())
+            {
+                blocks.insert(block);
+            }
+        }
+        return blocks;
+    }
+} // namespace
+
+set<const Function *> Cyclebite::Profile::Passes::SelectFunctions(const Module &M, const SelectionRules &rules)
+{
+    auto allow = Compile(rules.allow);
+    auto deny = Compile(rules.deny);
+    set<int64_t> kernelBlocks;
+    if (!rules.kernelFile.empty())
+    {
+        kernelBlocks = ReadKernelBlocks(rules.kernelFile);
+    }
+    bool allowAll = rules.allow.empty() && rules.kernelFile.empty();
+    set<const Function *> selected;
+    for (const auto &F : M)
+    {
+        if (F.isDeclaration() || Matches(F, deny))
+        {
+            continue;
+        }
+        bool allowed = allowAll || Matches(F, allow);
+        for (auto it = F.begin(); !allowed && (it != F.end()); it++)
+        {
+            allowed = kernelBlocks.contains(Cyclebite::Util::GetBlockID(&*it));
+        }
+        if (allowed)
+        {
+            selected.insert(&F);
+        }
+    }
+    return selected;
+}
@@ -27,9 +27,15 @@ namespace Cyclebite::Profile::Passes
     extern Function *MarkovReturn;
     extern Function *MarkovExit;
     extern Function *MarkovLaunch;
+    extern Function *MarkovCall;
+    extern Function *MarkovIntrinsic;
+    extern Function *MarkovCounters;
     // Timing pass
     extern Function *TimingInit;
     extern Function *TimingDestroy;
+    extern Function *TimingKernels;
+    extern Function *TimingKernelEnter;
+    extern Function *TimingKernelExit;
     // Instance pass
     extern Function *InstanceInit;
     extern Function *InstanceDestroy;
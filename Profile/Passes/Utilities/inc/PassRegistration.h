@@ -0,0 +1,108 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#pragma once
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/PassPlugin.h"
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+#include <spdlog/spdlog.h>
+#include <string>
+
+namespace Cyclebite::Profile::Passes
+{
+    /// @brief Places in the default pipelines where an instrumentation pass can schedule itself
+    ///
+    /// Block IDs must be unique across the whole program, so the pass has to see the entire program at the chosen point
+    /// That means either the merged module of a full LTO link (FullLTOLast), or a module that is already linked (PipelineStart/OptimizerLast when running opt -O2 on the linked bitcode)
+    enum class ExtensionPoint
+    {
+        /// only runs when named in an explicit pipeline, e.g. opt --passes=Markov
+        None,
+        /// before any optimization, instruments the same IR as opt --passes=<pass>
+        PipelineStart,
+        /// after the optimizer's cleanups, so the backend calls sit on far fewer blocks and loads
+        OptimizerLast,
+        /// at the end of the full LTO pipeline, run by the linker after the whole program is merged
+        FullLTOLast
+    };
+
+    /// Lets a plugin choose its extension point with -<pass>-ep (through -mllvm or -Wl,-mllvm when loaded into clang or lld)
+    inline auto ExtensionPointValues()
+    {
+        return llvm::cl::values(
+            clEnumValN(ExtensionPoint::None, "none", "Only run when named in a pass pipeline"),
+            clEnumValN(ExtensionPoint::PipelineStart, "pipeline-start", "Instrument before the optimizer runs"),
+            clEnumValN(ExtensionPoint::OptimizerLast, "optimizer-last", "Instrument after the module optimization pipeline"),
+            clEnumValN(ExtensionPoint::FullLTOLast, "full-lto-last", "Instrument after the full LTO pipeline"));
+    }
+
+    /// @brief Writes the module to a bitcode file and leaves it untouched
+    ///
+    /// The cartographer has to see the exact IR the profiler was injected into (block IDs are given out in module order)
+    /// When the pass runs inside the optimizer that IR never hits the disk, so this saves it right before the instrumentation pass
+    struct WriteProfiledBitcode : llvm::PassInfoMixin<WriteProfiledBitcode>
+    {
+        std::string file;
+        WriteProfiledBitcode(std::string file) : file(std::move(file)) {}
+        llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &)
+        {
+            std::error_code EC;
+            llvm::raw_fd_ostream out(file, EC, llvm::sys::fs::OF_None);
+            if (EC)
+            {
+                spdlog::critical("Could not open " + file + " to write the profiled bitcode: " + EC.message());
+                return llvm::PreservedAnalyses::all();
+            }
+            llvm::WriteBitcodeToFile(M, out);
+            return llvm::PreservedAnalyses::all();
+        }
+        static bool isRequired() { return true; }
+    };
+
+    /// @brief Registers an instrumentation pass by name (for explicit pipelines) and at the extension point ep selects
+    ///
+    /// The options are read when the pipeline is built, so they may be parsed after the plugin is loaded
+    /// @param name     Name of the pass in a pipeline string, e.g. opt --passes=<name>
+    /// @param ep       Extension point to schedule the pass at in the default pipelines
+    /// @param bitcode  If not empty, the module is written to this file right before it is instrumented at ep
+    template <typename PassT>
+    void RegisterInstrumentation(llvm::PassBuilder &PB, llvm::StringRef name, const llvm::cl::opt<ExtensionPoint> &ep, const llvm::cl::opt<std::string> &bitcode)
+    {
+        PB.registerPipelineParsingCallback(
+            [name](llvm::StringRef Name, llvm::ModulePassManager &MPM, llvm::ArrayRef<llvm::PassBuilder::PipelineElement>) {
+                if (Name == name)
+                {
+                    MPM.addPass(PassT());
+                    return true;
+                }
+                return false;
+            });
+        auto schedule = [&ep, &bitcode](ExtensionPoint at, llvm::ModulePassManager &MPM) {
+            if (ep != at)
+            {
+                return;
+            }
+            if (!bitcode.empty())
+            {
+                MPM.addPass(WriteProfiledBitcode(bitcode));
+            }
+            MPM.addPass(PassT());
+        };
+        PB.registerPipelineStartEPCallback(
+            [schedule](llvm::ModulePassManager &MPM, llvm::OptimizationLevel) {
+                schedule(ExtensionPoint::PipelineStart, MPM);
+            });
+        PB.registerOptimizerLastEPCallback(
+            [schedule](llvm::ModulePassManager &MPM, llvm::OptimizationLevel) {
+                schedule(ExtensionPoint::OptimizerLast, MPM);
+            });
+        PB.registerFullLinkTimeOptimizationLastEPCallback(
+            [schedule](llvm::ModulePassManager &MPM, llvm::OptimizationLevel) {
+                schedule(ExtensionPoint::FullLTOLast, MPM);
+            });
+    }
+} // namespace Cyclebite::Profile::Passes
@@ -0,0 +1,33 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#pragma once
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace Cyclebite::Profile::Passes
+{
+    /// @brief Which functions of a module a profiling pass instruments block by block
+    ///
+    /// A function is selected when it matches no deny rule, and either there are no allow rules or it matches one of them
+    /// Functions that aren't selected are collapsed into their entry block: only the entrance of the function is reported, so the profile still sees a well-formed call into it and a return out of it, and nothing of what happens in between
+    struct SelectionRules
+    {
+        /// regular expressions (ECMAScript, partial match) for the names (mangled or demangled) or source files of the functions to instrument
+        std::vector<std::string> allow;
+        /// regular expressions for the names or source files of the functions to leave out, they win over allow and kernelFile
+        std::vector<std::string> deny;
+        /// kernel or hotcode file of an earlier run, every function with a block in one of its kernels is allowed
+        std::string kernelFile;
+    };
+
+    /// @brief Returns the defined functions of M the rules select, every defined function if the rules are empty
+    ///
+    /// Kernel files name blocks by ID, so M must have been through Format()
+    /// Throws CyclebiteException when the kernel file can't be read or has no kernels
+    std::set<const llvm::Function *> SelectFunctions(const llvm::Module &M, const SelectionRules &rules);
+} // namespace Cyclebite::Profile::Passes
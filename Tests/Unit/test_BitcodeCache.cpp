@@ -0,0 +1,132 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "Util/IO.h"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+
+using namespace std;
+
+// one module is read with the bitcode cache cold, then again with the entry the first read wrote
+// both reads have to give the same functions, the same bodies and the same block IDs, no matter which functions a profile would touch
+
+#define CACHE_DIR "test_BitcodeCache.cache"
+#define INPUT     "test_BitcodeCache.ll"
+
+// main calls a function with a loop and an external function, and never calls unused
+const char *source = R"(
+declare i32 @external(i32)
+
+define i32 @loop(i32 %n) {
+entry:
+  br label %header
+header:
+  %i = phi i32 [ 0, %entry ], [ %next, %body ]
+  %cond = icmp slt i32 %i, %n
+  br i1 %cond, label %body, label %exit
+body:
+  %next = add i32 %i, 1
+  br label %header
+exit:
+  ret i32 %i
+}
+
+define i32 @unused(i32 %x) {
+entry:
+  %y = mul i32 %x, 3
+  ret i32 %y
+}
+
+define i32 @main() {
+entry:
+  %a = call i32 @loop(i32 10)
+  %b = call i32 @external(i32 %a)
+  ret i32 %b
+}
+)";
+
+/// Each function of a module with its block IDs, or "declaration" when it has no body
+map<string, vector<int64_t>> shape(const llvm::Module &M, string &error)
+{
+    map<string, vector<int64_t>> functions;
+    for (const auto &F : M)
+    {
+        auto &blocks = functions[F.getName().str()];
+        if (F.isMaterializable())
+        {
+            error = F.getName().str() + " was not materialized";
+        }
+        if (F.isDeclaration())
+        {
+            blocks.push_back(-1);
+        }
+        for (const auto &BB : F)
+        {
+            blocks.push_back(Cyclebite::Util::GetBlockID(&BB));
+            if (blocks.back() < 0)
+            {
+                error = "a block of " + F.getName().str() + " has no ID";
+            }
+        }
+    }
+    return functions;
+}
+
+int main()
+{
+    filesystem::remove_all(CACHE_DIR);
+    ofstream(INPUT) << source;
+    setenv("CYCLEBITE_BITCODE_CACHE", CACHE_DIR, 1);
+    string error;
+    for (const auto clean : {true, false})
+    {
+        auto entry = Cyclebite::Util::BitcodeCacheEntry(INPUT, clean).string() + ".bc";
+        auto cold = ReadBitcode(INPUT, clean);
+        if (cold == nullptr)
+        {
+            error = "the input could not be read";
+            break;
+        }
+        if (!filesystem::exists(entry))
+        {
+            error = "the cold read wrote no cache entry";
+            break;
+        }
+        auto warm = ReadBitcode(INPUT, clean);
+        if (warm == nullptr)
+        {
+            error = "the cache entry could not be read";
+            break;
+        }
+        auto coldShape = shape(*cold, error);
+        auto warmShape = shape(*warm, error);
+        if (error.empty() && (coldShape != warmShape))
+        {
+            error = "cold and warm reads give different modules";
+        }
+        if (error.empty() && (coldShape.size() != 4))
+        {
+            error = "the module has " + to_string(coldShape.size()) + " functions";
+        }
+        if (!error.empty())
+        {
+            error += clean ? " (clean)" : "";
+            break;
+        }
+    }
+    filesystem::remove_all(CACHE_DIR);
+    filesystem::remove(INPUT);
+    if (!error.empty())
+    {
+        cout << error << endl;
+        return EXIT_FAILURE;
+    }
+    cout << "Cold and warm reads of the bitcode cache match" << endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,179 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "EdgeCounters.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace std;
+
+// the solver has to recover the count of every edge from the counters off of a spanning tree
+// hand written tables (an empty table, a single block, a straight line, a diamond, a function that never ran) are checked first, then random control flow graphs walked from their entry to their exit
+
+#define TRIALS      100
+#define FUNCTIONS   3
+#define MAX_BLOCKS  10
+#define WALKS       50
+
+struct Edge
+{
+    int64_t src;
+    int64_t snk;
+    bool profiled;
+};
+
+typedef map<pair<uint32_t, uint32_t>, uint64_t> Counts;
+
+Counts solve(const vector<uint64_t> &counters, const vector<int64_t> &table)
+{
+    Counts solved;
+    Cyclebite::Markov::SolveEdgeCounters(counters.data(), table.data(), table.size(), [&](uint32_t src, uint32_t snk, uint64_t count) {
+        solved[pair(src, snk)] += count;
+    });
+    return solved;
+}
+
+int64_t find(vector<int64_t> &parent, int64_t x)
+{
+    while (parent[(size_t)x] != x)
+    {
+        x = parent[(size_t)x] = parent[(size_t)parent[(size_t)x]];
+    }
+    return x;
+}
+
+int main()
+{
+    int failures = 0;
+    auto check = [&](const string &name, bool passed) {
+        if (!passed)
+        {
+            cout << name << " failed" << endl;
+            failures++;
+        }
+    };
+    // edge cases, each edge is {src, snk, counter, profile src}
+    check("empty table", solve({}, {}).empty());
+    // block 0 loops on itself 5 times, then leaves
+    check("single block", solve({5, 1}, {2, 0, 0, 0, 0, 0, 0, -1, 1, 0}) == Counts{{{0, 0}, 5}});
+    // 0 -> 1 -> 2 -> exit, only the way out has a counter
+    check("straight line", solve({7}, {3, 0, 0, 1, -1, 0, 1, 2, -1, 1, 2, -1, 0, 2}) == Counts{{{0, 1}, 7}, {{1, 2}, 7}});
+    // 0 -> 1 -> 3 three times and 0 -> 2 -> 3 five times, 1 -> 3 is written by the backend
+    vector<int64_t> diamond = {5, 0, 0, 1, -1, 0, 0, 2, 0, 0, 1, 3, -1, -1, 2, 3, -1, 2, 3, -1, 1, 3};
+    check("diamond", solve({5, 8}, diamond) == Counts{{{0, 1}, 3}, {{0, 2}, 5}, {{2, 3}, 5}});
+    check("function that never ran", solve({0, 0}, diamond).empty());
+    // a second function follows the first in the same table, its counters are numbered after the first's
+    auto twoFunctions = diamond;
+    twoFunctions.insert(twoFunctions.end(), {1, 10, 10, -1, 2, 10});
+    check("two functions", solve({5, 8, 4}, twoFunctions) == Counts{{{0, 1}, 3}, {{0, 2}, 5}, {{2, 3}, 5}});
+
+    // random control flow graphs
+    mt19937 rng(42);
+    for (int trial = 0; (trial < TRIALS) && !failures; trial++)
+    {
+        vector<int64_t> table;
+        vector<uint64_t> counters;
+        // reference: the count of each edge as it was walked
+        Counts expected;
+        int64_t nextBlock = 0;
+        for (int f = 0; f < FUNCTIONS; f++)
+        {
+            auto blocks = (int64_t)(rng() % MAX_BLOCKS) + 1;
+            auto first = nextBlock;
+            nextBlock += blocks;
+            // block k always goes on to k+1 and the last block leaves, so every walk can reach the exit
+            set<pair<int64_t, int64_t>> edgeSet;
+            for (int64_t k = 0; k < blocks; k++)
+            {
+                edgeSet.insert(pair(first + k, k + 1 < blocks ? first + k + 1 : -1));
+                for (uint32_t extra = rng() % 3; extra > 0; extra--)
+                {
+                    auto snk = (int64_t)(rng() % (uint64_t)(blocks + 1));
+                    edgeSet.insert(pair(first + k, snk == blocks ? -1 : first + snk));
+                }
+            }
+            vector<Edge> edges;
+            for (const auto &e : edgeSet)
+            {
+                // some edges are written by the backend itself (calls return on them)
+                edges.push_back(Edge{e.first, e.second, rng() % 5 != 0});
+            }
+            map<int64_t, vector<size_t>> succs;
+            for (size_t e = 0; e < edges.size(); e++)
+            {
+                succs[edges[e].src].push_back(e);
+            }
+            vector<uint64_t> walked(edges.size(), 0);
+            for (int w = 0; w < WALKS; w++)
+            {
+                auto block = first;
+                for (int step = 0; block != -1; step++)
+                {
+                    const auto &out = succs.at(block);
+                    // long walks take the way out
+                    auto e = step < 100 ? out[rng() % out.size()] : *find_if(out.begin(), out.end(), [&](size_t c) { return (edges[c].snk == -1) || (edges[c].snk == block + 1); });
+                    walked[e]++;
+                    block = edges[e].snk;
+                }
+            }
+            // spanning tree over the blocks and the exit (index blocks), the virtual edge from the exit to the entry goes in first
+            vector<int64_t> parent((size_t)blocks + 1);
+            iota(parent.begin(), parent.end(), 0);
+            auto node = [&](int64_t b) { return b == -1 ? blocks : b - first; };
+            parent[(size_t)find(parent, blocks)] = find(parent, 0);
+            vector<size_t> order(edges.size());
+            iota(order.begin(), order.end(), 0);
+            shuffle(order.begin(), order.end(), rng);
+            vector<int64_t> counter(edges.size(), -1);
+            for (const auto &e : order)
+            {
+                auto a = find(parent, node(edges[e].src));
+                auto b = find(parent, node(edges[e].snk));
+                if (a != b)
+                {
+                    parent[(size_t)b] = a;
+                    continue;
+                }
+                counter[e] = (int64_t)counters.size();
+                counters.push_back(walked[e]);
+            }
+            table.push_back((int64_t)edges.size());
+            table.push_back(first);
+            for (size_t e = 0; e < edges.size(); e++)
+            {
+                table.push_back(edges[e].src);
+                table.push_back(edges[e].snk);
+                table.push_back(counter[e]);
+                table.push_back(edges[e].profiled ? edges[e].src : -1);
+                if (edges[e].profiled && (edges[e].snk >= 0) && walked[e])
+                {
+                    expected[pair((uint32_t)edges[e].src, (uint32_t)edges[e].snk)] = walked[e];
+                }
+            }
+        }
+        auto solved = solve(counters, table);
+        if (solved != expected)
+        {
+            cout << "Trial " << trial << ": solved " << solved.size() << " edges, expected " << expected.size() << endl;
+            for (const auto &[edge, count] : expected)
+            {
+                auto got = solved.find(edge);
+                cout << "  " << edge.first << " -> " << edge.second << ": expected " << count << ", solved " << (got == solved.end() ? 0 : got->second) << endl;
+            }
+            failures++;
+        }
+    }
+    if (failures)
+    {
+        return EXIT_FAILURE;
+    }
+    cout << "Solved the edge counts of every edge case and " << TRIALS << " random trials" << endl;
+    return EXIT_SUCCESS;
+}
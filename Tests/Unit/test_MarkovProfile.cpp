@@ -0,0 +1,250 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "ControlNode.h"
+#include "Graph.h"
+#include "IO.h"
+#include "MarkovProfile.h"
+#include "Util/Exceptions.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace Cyclebite::Graph;
+
+// profiles of every markov order are written in the markov.bin layout and read back, from memory and from a file
+// the edge cases (empty profiles, a single record, the last block ID, a header cut short) are checked first, then random profiles
+// then a markov order 2 profile is built into a CFG, which has to have a node for each path and map each of its blocks to a node
+
+#define FILE_NAME   "test_MarkovProfile.bin"
+#define TRIALS      50
+#define MAX_RECORDS 64
+#define BLOCKS      1000
+
+/// One record of the reference: the blocks of a path, oldest first, and its frequency
+struct Record
+{
+    vector<uint32_t> blocks;
+    uint64_t frequency;
+};
+
+template <typename T>
+void append(vector<uint8_t> &buffer, const T &val)
+{
+    auto p = reinterpret_cast<const uint8_t *>(&val);
+    buffer.insert(buffer.end(), p, p + sizeof(T));
+}
+
+vector<uint8_t> write(uint32_t order, const vector<Record> &records)
+{
+    vector<uint8_t> buffer;
+    append(buffer, order);
+    append(buffer, (uint32_t)BLOCKS);
+    append(buffer, (uint32_t)records.size());
+    for (const auto &r : records)
+    {
+        for (const auto &b : r.blocks)
+        {
+            append(buffer, b);
+        }
+        append(buffer, r.frequency);
+    }
+    return buffer;
+}
+
+/// Returns an empty string when profile holds exactly the records of the reference
+string compare(const MarkovProfile &profile, uint32_t order, const vector<Record> &records)
+{
+    if ((profile.getMarkovOrder() != order) || (profile.getBlockCount() != BLOCKS) || (profile.getEdgeCount() != records.size()))
+    {
+        return "header";
+    }
+    for (uint32_t i = 0; i < records.size(); i++)
+    {
+        auto blocks = profile.getBlocks(i);
+        if (!equal(blocks.begin(), blocks.end(), records[i].blocks.begin(), records[i].blocks.end()) || (profile.getFrequency(i) != records[i].frequency))
+        {
+            return "record " + to_string(i);
+        }
+    }
+    if (order == 1)
+    {
+        uint32_t i = 0;
+        for (const auto &edge : profile)
+        {
+            if ((edge.src != records[i].blocks[0]) || (edge.snk != records[i].blocks[1]) || (edge.frequency != records[i].frequency) || (profile[i].frequency != records[i].frequency))
+            {
+                return "edge " + to_string(i);
+            }
+            i++;
+        }
+        if (i != records.size())
+        {
+            return "edge array";
+        }
+    }
+    else
+    {
+        try
+        {
+            profile.begin();
+            return "edge array of a markov order " + to_string(order) + " profile";
+        }
+        catch (CyclebiteException &e)
+        {
+        }
+    }
+    return "";
+}
+
+/// Returns an empty string when the CFG of a markov order 2 profile has the nodes and edges of its paths
+string buildPaths()
+{
+    // the paths 0 1, 1 2, 2 0 and 2 3, block 3 is only ever the newest block of a path and block 4 is never seen
+    vector<Record> records = {{{0, 1, 2}, 10}, {{1, 2, 0}, 10}, {{2, 0, 1}, 9}, {{1, 2, 3}, 1}};
+    auto buffer = write(2, records);
+    MarkovProfile profile(buffer.data(), buffer.size());
+    ProfileContext context;
+    Graph graph;
+    BuildCFG(context, graph, profile);
+    if ((context.markovOrder != 2) || (graph.node_count() != 4) || (graph.edge_count() != records.size()) || (context.PathNIDMap.size() != 4))
+    {
+        return "graph of " + to_string(graph.node_count()) + " nodes and " + to_string(graph.edge_count()) + " edges";
+    }
+    for (const auto &[path, NID] : context.PathNIDMap)
+    {
+        if (!graph.find_node(NID) || (static_pointer_cast<ControlNode>(graph.getOriginalNode(NID))->originalBlocks != path))
+        {
+            return "node of a path";
+        }
+    }
+    if ((context.NIDMap.size() != BLOCKS) || (context.NIDMap[4] != UNMAPPED_NID))
+    {
+        return "NIDMap";
+    }
+    for (uint32_t block = 0; block < 4; block++)
+    {
+        if ((context.NIDMap[block] == UNMAPPED_NID) || (static_pointer_cast<ControlNode>(graph.getOriginalNode(context.NIDMap[block]))->originalBlocks.back() != block))
+        {
+            return "node of block " + to_string(block);
+        }
+    }
+    return "";
+}
+
+bool throws(const vector<uint8_t> &buffer)
+{
+    try
+    {
+        MarkovProfile profile(buffer.data(), buffer.size());
+    }
+    catch (CyclebiteException &e)
+    {
+        return true;
+    }
+    return false;
+}
+
+/// Returns an empty string when the records read back the same from memory and from a file, and the profile cut one byte short is not read
+string roundTrip(uint32_t order, const vector<Record> &records)
+{
+    auto buffer = write(order, records);
+    auto error = compare(MarkovProfile(buffer.data(), buffer.size()), order, records);
+    if (error.empty())
+    {
+        ofstream out(FILE_NAME, ios::binary);
+        out.write((const char *)buffer.data(), (streamsize)buffer.size());
+        out.close();
+        error = compare(MarkovProfile(FILE_NAME), order, records);
+    }
+    if (error.empty() && !throws(vector<uint8_t>(buffer.begin(), buffer.end() - 1)))
+    {
+        error = "truncated profile was read";
+    }
+    return error;
+}
+
+/// Returns true when building the CFG of the records throws
+bool buildThrows(uint32_t order, const vector<Record> &records)
+{
+    auto buffer = write(order, records);
+    ProfileContext context;
+    Graph graph;
+    try
+    {
+        BuildCFG(context, graph, MarkovProfile(buffer.data(), buffer.size()));
+    }
+    catch (CyclebiteException &e)
+    {
+        return true;
+    }
+    return false;
+}
+
+
+int main()
+{
+    int failures = 0;
+    auto check = [&](const string &name, const string &error) {
+        if (!error.empty())
+        {
+            cout << name << ": " << error << " does not match" << endl;
+            failures++;
+        }
+    };
+    auto passed = [](bool p) { return p ? string() : string("result"); };
+    // edge cases
+    for (uint32_t order = 1; order <= 4; order++)
+    {
+        auto buffer = write(order, {});
+        check("empty markov order " + to_string(order) + " profile", compare(MarkovProfile(buffer.data(), buffer.size()), order, {}));
+        Record single{vector<uint32_t>(order + 1, BLOCKS - 1), UINT64_MAX};
+        check("single record on the last block, markov order " + to_string(order), roundTrip(order, {single}));
+        single.blocks.back() = BLOCKS;
+        check("block past the end of the BBID space, markov order " + to_string(order), passed(buildThrows(order, {single})));
+    }
+    {
+        auto buffer = write(1, {});
+        ProfileContext context;
+        Graph graph;
+        BuildCFG(context, graph, MarkovProfile(buffer.data(), buffer.size()));
+        check("CFG of an empty profile", passed(graph.empty() && (context.NIDMap.size() == BLOCKS)));
+    }
+    check("edge written twice", passed(buildThrows(1, {{{3, 4}, 1}, {{3, 4}, 2}})));
+    check("path written twice", passed(buildThrows(2, {{{3, 4, 5}, 1}, {{3, 4, 5}, 2}})));
+    check("markov order 0 profile", passed(throws(write(0, {}))));
+    auto header = write(1, {});
+    header.pop_back();
+    check("header cut short", passed(throws(header)));
+    check("markov order 2 CFG", buildPaths());
+
+    // random profiles
+    mt19937_64 rng(11);
+    for (int trial = 0; (trial < TRIALS) && !failures; trial++)
+    {
+        auto order = (uint32_t)(rng() % 4) + 1;
+        vector<Record> records(rng() % MAX_RECORDS + 1);
+        for (auto &r : records)
+        {
+            for (uint32_t b = 0; b <= order; b++)
+            {
+                r.blocks.push_back((uint32_t)(rng() % BLOCKS));
+            }
+            r.frequency = rng();
+        }
+        check("trial " + to_string(trial) + " (markov order " + to_string(order) + ", " + to_string(records.size()) + " records)", roundTrip(order, records));
+    }
+    remove(FILE_NAME);
+    if (failures)
+    {
+        return EXIT_FAILURE;
+    }
+    cout << "Read every edge case and " << TRIALS << " random profiles" << endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,211 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "MarkovPaths.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace Cyclebite::Markov;
+
+// walks through a path profile of every order, the merged profile and the profile of each thread have to count every path of Order+1 blocks the walks took
+// the edge cases (no walk, a walk shorter than a path, a single repeated block, the largest block ID) are walked on the main thread first
+// then threads walk random block sequences, the tables start small so they grow while the threads count, and the merged profile is written while the threads still run
+
+#define TRIALS      20
+#define MAX_THREADS 6
+#define MAX_WALK    5000
+#define BLOCKS      1000
+
+typedef map<vector<uint32_t>, uint64_t> Paths;
+
+/// Reads the paths of one markov.bin layout at offset, and moves offset past it
+Paths read(const vector<uint8_t> &buffer, size_t &offset, uint32_t order, string &error)
+{
+    uint32_t header[3];
+    memcpy(header, buffer.data() + offset, sizeof(header));
+    offset += sizeof(header);
+    if ((header[0] != order) || (header[1] != BLOCKS))
+    {
+        error = "header";
+        return Paths();
+    }
+    Paths paths;
+    for (uint32_t i = 0; i < header[2]; i++)
+    {
+        vector<uint32_t> blocks(order + 1);
+        memcpy(blocks.data(), buffer.data() + offset, blocks.size() * sizeof(uint32_t));
+        offset += blocks.size() * sizeof(uint32_t);
+        uint64_t frequency;
+        memcpy(&frequency, buffer.data() + offset, sizeof(frequency));
+        offset += sizeof(frequency);
+        if (paths.contains(blocks))
+        {
+            error = "path written twice";
+        }
+        paths[blocks] = frequency;
+    }
+    return paths;
+}
+
+/// Walks the blocks on this thread, returns the merged paths and sets threads to the thread count of the profile
+Paths walk(uint32_t order, const vector<uint32_t> &blocks, uint32_t &threads, string &error)
+{
+    auto profile = MakePathProfile(order, 1);
+    for (const auto &block : blocks)
+    {
+        profile->Enter(block);
+    }
+    auto buffer = profile->SerializeThreads(BLOCKS);
+    memcpy(&threads, buffer.data(), sizeof(threads));
+    size_t offset = 0;
+    buffer = profile->Serialize(BLOCKS);
+    auto paths = read(buffer, offset, order, error);
+    if (offset != buffer.size())
+    {
+        error = "size";
+    }
+    return paths;
+}
+
+int main()
+{
+    int failures = 0;
+    auto check = [&](const string &name, const Paths &paths, const Paths &expected, uint32_t threads, uint32_t expectedThreads, const string &error) {
+        if (!error.empty() || (paths != expected) || (threads != expectedThreads))
+        {
+            cout << name << " failed" << endl;
+            failures++;
+        }
+    };
+    // edge cases
+    for (uint32_t order = 1; order <= MARKOV_MAX_ORDER; order++)
+    {
+        auto name = " (markov order " + to_string(order) + ")";
+        string error;
+        uint32_t threads;
+        auto paths = walk(order, {}, threads, error);
+        check("no walk" + name, paths, {}, threads, 0, error);
+        vector<uint32_t> blocks(order);
+        iota(blocks.begin(), blocks.end(), 0);
+        paths = walk(order, blocks, threads, error);
+        check("walk one block shorter than a path" + name, paths, {}, threads, 1, error);
+        blocks.push_back(order);
+        paths = walk(order, blocks, threads, error);
+        check("walk of exactly one path" + name, paths, {{blocks, 1}}, threads, 1, error);
+        blocks.assign(order + 10, 7);
+        paths = walk(order, blocks, threads, error);
+        check("single repeated block" + name, paths, {{vector<uint32_t>(order + 1, 7), 10}}, threads, 1, error);
+        blocks.assign(order + 1, UINT32_MAX);
+        blocks.front() = 0;
+        paths = walk(order, blocks, threads, error);
+        check("largest block ID" + name, paths, {{blocks, 1}}, threads, 1, error);
+    }
+    if ((MakePathProfile(0, 1) != nullptr) || (MakePathProfile(MARKOV_MAX_ORDER + 1, 1) != nullptr))
+    {
+        cout << "profile of an order without a prebuilt one" << endl;
+        failures++;
+    }
+
+    // random walks
+    mt19937_64 rng(9);
+    for (int trial = 0; (trial < TRIALS) && !failures; trial++)
+    {
+        auto order = (uint32_t)(trial % MARKOV_MAX_ORDER) + 1;
+        // a small alphabet repeats paths, a large one grows the tables
+        auto alphabet = rng() % 2 ? 8 : BLOCKS;
+        auto profile = MakePathProfile(order, 1);
+        vector<vector<uint32_t>> walks(rng() % MAX_THREADS + 1);
+        for (auto &walk : walks)
+        {
+            walk.resize(rng() % MAX_WALK);
+            for (auto &block : walk)
+            {
+                block = (uint32_t)(rng() % alphabet);
+            }
+        }
+        // reference: the paths of each walk as a sliding window of Order+1 blocks
+        vector<Paths> expected(walks.size());
+        Paths merged;
+        for (size_t t = 0; t < walks.size(); t++)
+        {
+            for (size_t i = order; i < walks[t].size(); i++)
+            {
+                vector<uint32_t> path(walks[t].begin() + (long)(i - order), walks[t].begin() + (long)i + 1);
+                expected[t][path]++;
+                merged[path]++;
+            }
+        }
+        // each thread only touches the profile through its own shard, so every walk runs on a thread of its own
+        vector<thread> threads;
+        for (const auto &walk : walks)
+        {
+            threads.emplace_back([&profile, &walk]() {
+                for (const auto &block : walk)
+                {
+                    profile->Enter(block);
+                }
+            });
+        }
+        for (int i = 0; i < 4; i++)
+        {
+            profile->Serialize(BLOCKS);
+        }
+        for (auto &t : threads)
+        {
+            t.join();
+        }
+
+        string error;
+        size_t offset = 0;
+        auto buffer = profile->Serialize(BLOCKS);
+        if (read(buffer, offset, order, error) != merged)
+        {
+            error = "merged paths";
+        }
+        buffer = profile->SerializeThreads(BLOCKS);
+        // threads are written in the order they first entered a block, so the tables are compared without their order
+        uint32_t threadCount;
+        memcpy(&threadCount, buffer.data(), sizeof(threadCount));
+        offset = sizeof(threadCount);
+        vector<Paths> perThread;
+        for (uint32_t t = 0; error.empty() && (t < threadCount); t++)
+        {
+            perThread.push_back(read(buffer, offset, order, error));
+        }
+        // a walk with no blocks never makes a table
+        auto walked = (uint32_t)count_if(walks.begin(), walks.end(), [](const vector<uint32_t> &w) { return !w.empty(); });
+        sort(perThread.begin(), perThread.end());
+        vector<Paths> reference;
+        for (size_t t = 0; t < walks.size(); t++)
+        {
+            if (!walks[t].empty())
+            {
+                reference.push_back(expected[t]);
+            }
+        }
+        sort(reference.begin(), reference.end());
+        if (error.empty() && ((threadCount != walked) || (offset != buffer.size()) || (perThread != reference)))
+        {
+            error = "paths of each thread";
+        }
+        if (!error.empty())
+        {
+            cout << "Trial " << trial << " (markov order " << order << ", " << walks.size() << " threads): " << error << " do not match" << endl;
+            failures++;
+        }
+    }
+    if (failures)
+    {
+        return EXIT_FAILURE;
+    }
+    cout << "Profiled every edge case and " << TRIALS << " random walks" << endl;
+    return EXIT_SUCCESS;
+}
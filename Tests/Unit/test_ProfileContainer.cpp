@@ -0,0 +1,114 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "ProfileContainer.h"
+#include "Util/Exceptions.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <vector>
+#include <zlib.h>
+
+using namespace std;
+using namespace Cyclebite::Graph;
+
+// a container with one uncompressed section is corrupted one field at a time, each corruption has to be caught with a CyclebiteException instead of a read out of bounds
+
+#define FILE_NAME "test_ProfileContainer.bin"
+
+/// Header, then the payload at offset 24 (padded to 32), then the section table
+vector<uint8_t> container(const vector<uint8_t> &payload, const function<void(__TA_ProfileHeader &, __TA_ProfileSection &)> &corrupt)
+{
+    __TA_ProfileHeader header;
+    memcpy(header.magic, PROFILE_CONTAINER_MAGIC, sizeof(header.magic));
+    header.version = PROFILE_CONTAINER_VERSION;
+    header.sectionCount = 1;
+    __TA_ProfileSection section;
+    section.type = __TA_SECTION_EDGES;
+    section.compression = __TA_COMPRESSION_NONE;
+    section.offset = 32;
+    section.storedSize = payload.size();
+    section.size = payload.size();
+    section.checksum = (uint32_t)crc32(crc32(0L, Z_NULL, 0), payload.data(), (uInt)payload.size());
+    section.reserved = 0;
+    header.tableOffset = (section.offset + payload.size() + 7) / 8 * 8;
+    corrupt(header, section);
+    vector<uint8_t> bytes((size_t)((32 + payload.size() + 7) / 8 * 8 + sizeof(section)), 0);
+    memcpy(bytes.data(), &header, sizeof(header));
+    memcpy(bytes.data() + 32, payload.data(), payload.size());
+    memcpy(bytes.data() + (32 + payload.size() + 7) / 8 * 8, &section, sizeof(section));
+    return bytes;
+}
+
+/// Returns the payload of the section, throws what ProfileContainer throws
+vector<uint8_t> read(const vector<uint8_t> &bytes)
+{
+    ofstream out(FILE_NAME, ios::binary);
+    out.write((const char *)bytes.data(), (streamsize)bytes.size());
+    out.close();
+    ProfileContainer profile(FILE_NAME);
+    auto section = profile.getSection(__TA_SECTION_EDGES);
+    return vector<uint8_t>(section.begin(), section.end());
+}
+
+bool throws(const vector<uint8_t> &bytes)
+{
+    try
+    {
+        read(bytes);
+    }
+    catch (CyclebiteException &e)
+    {
+        return true;
+    }
+    return false;
+}
+
+int main()
+{
+    vector<uint8_t> payload(40);
+    for (size_t i = 0; i < payload.size(); i++)
+    {
+        payload[i] = (uint8_t)i;
+    }
+    auto none = [](__TA_ProfileHeader &, __TA_ProfileSection &) {};
+    int failures = 0;
+    auto check = [&](const string &name, bool passed) {
+        if (!passed)
+        {
+            cout << name << " failed" << endl;
+            failures++;
+        }
+    };
+    check("intact container", read(container(payload, none)) == payload);
+    check("empty section", read(container({}, none)).empty());
+    // the table
+    check("table past the end", throws(container(payload, [](__TA_ProfileHeader &h, __TA_ProfileSection &) { h.tableOffset += 8; })));
+    check("table offset that wraps", throws(container(payload, [](__TA_ProfileHeader &h, __TA_ProfileSection &) { h.tableOffset = UINT64_MAX - 8; })));
+    check("section count past the end", throws(container(payload, [](__TA_ProfileHeader &h, __TA_ProfileSection &) { h.sectionCount = 2; })));
+    check("section count that wraps", throws(container(payload, [](__TA_ProfileHeader &h, __TA_ProfileSection &) { h.sectionCount = UINT32_MAX; })));
+    // the section
+    check("payload past the end", throws(container(payload, [](__TA_ProfileHeader &, __TA_ProfileSection &s) { s.storedSize = s.size = 1 << 20; })));
+    check("payload offset that wraps", throws(container(payload, [](__TA_ProfileHeader &, __TA_ProfileSection &s) { s.offset = UINT64_MAX - 8; })));
+    check("uncompressed size larger than stored", throws(container(payload, [](__TA_ProfileHeader &, __TA_ProfileSection &s) { s.size = 1 << 20; })));
+    check("uncompressed size smaller than stored", throws(container(payload, [](__TA_ProfileHeader &, __TA_ProfileSection &s) { s.size--; })));
+    check("checksum", throws(container(payload, [](__TA_ProfileHeader &, __TA_ProfileSection &s) { s.checksum++; })));
+    check("compressed payload that doesn't inflate", throws(container(payload, [](__TA_ProfileHeader &, __TA_ProfileSection &s) { s.compression = __TA_COMPRESSION_ZLIB; })));
+    // the file itself
+    auto truncated = container(payload, none);
+    truncated.resize(truncated.size() - 1);
+    check("truncated file", throws(truncated));
+    truncated.resize(sizeof(__TA_ProfileHeader) - 1);
+    check("partial header", throws(truncated));
+    remove(FILE_NAME);
+    if (failures)
+    {
+        return EXIT_FAILURE;
+    }
+    cout << "Caught every corrupt container" << endl;
+    return EXIT_SUCCESS;
+}
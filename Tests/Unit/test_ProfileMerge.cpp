@@ -0,0 +1,191 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "ProfileFormat.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <zlib.h>
+
+using namespace std;
+using json = nlohmann::json;
+
+// cyclebite-merge (its path is the only argument) merges profile containers that carry labels, callers and thread blocks, the merged BlockInfo.json has to hold the weighted labels and the union of the rest
+// the containers are written by hand, one uncompressed section after another
+
+template <typename T>
+void append(vector<uint8_t> &buffer, const T &val)
+{
+    auto p = reinterpret_cast<const uint8_t *>(&val);
+    buffer.insert(buffer.end(), p, p + sizeof(T));
+}
+
+/// An order 1 profile in the markov.bin layout
+vector<uint8_t> edges(const vector<tuple<uint32_t, uint32_t, uint64_t>> &list)
+{
+    vector<uint8_t> buffer;
+    append(buffer, (uint32_t)1);
+    append(buffer, (uint32_t)16);
+    append(buffer, (uint32_t)list.size());
+    for (const auto &[src, snk, frequency] : list)
+    {
+        append(buffer, src);
+        append(buffer, snk);
+        append(buffer, frequency);
+    }
+    return buffer;
+}
+
+vector<uint8_t> labels(const vector<tuple<uint32_t, string, uint64_t>> &list)
+{
+    vector<uint8_t> buffer;
+    for (const auto &[block, label, frequency] : list)
+    {
+        append(buffer, block);
+        append(buffer, (uint32_t)label.size());
+        append(buffer, frequency);
+        buffer.insert(buffer.end(), label.begin(), label.end());
+    }
+    return buffer;
+}
+
+vector<uint8_t> ids(const vector<uint32_t> &list)
+{
+    vector<uint8_t> buffer;
+    for (const auto &id : list)
+    {
+        append(buffer, id);
+    }
+    return buffer;
+}
+
+void writeContainer(const string &file, const map<__TA_ProfileSectionType, vector<uint8_t>> &payloads)
+{
+    vector<uint8_t> bytes(sizeof(__TA_ProfileHeader), 0);
+    vector<__TA_ProfileSection> table;
+    for (const auto &[type, payload] : payloads)
+    {
+        bytes.resize((bytes.size() + 7) / 8 * 8, 0);
+        __TA_ProfileSection section;
+        section.type = type;
+        section.compression = __TA_COMPRESSION_NONE;
+        section.offset = bytes.size();
+        section.storedSize = payload.size();
+        section.size = payload.size();
+        section.checksum = (uint32_t)crc32(crc32(0L, Z_NULL, 0), payload.data(), (uInt)payload.size());
+        section.reserved = 0;
+        table.push_back(section);
+        bytes.insert(bytes.end(), payload.begin(), payload.end());
+    }
+    bytes.resize((bytes.size() + 7) / 8 * 8, 0);
+    __TA_ProfileHeader header;
+    memcpy(header.magic, PROFILE_CONTAINER_MAGIC, sizeof(header.magic));
+    header.version = PROFILE_CONTAINER_VERSION;
+    header.sectionCount = (uint32_t)table.size();
+    header.tableOffset = bytes.size();
+    memcpy(bytes.data(), &header, sizeof(header));
+    for (const auto &section : table)
+    {
+        append(bytes, section);
+    }
+    ofstream out(file, ios::binary);
+    out.write((const char *)bytes.data(), (streamsize)bytes.size());
+}
+
+/// Runs the merge, returns the merged BlockInfo.json or null when the tool failed or wrote none
+json merge(const string &tool, const string &args)
+{
+    remove("test_ProfileMerge.json");
+    if (system((tool + " " + args + " -o test_ProfileMerge.bin -ob test_ProfileMerge.json > /dev/null 2>&1").data()) != 0)
+    {
+        return json();
+    }
+    ifstream f("test_ProfileMerge.json");
+    return f.is_open() ? json::parse(f) : json();
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        cout << "Usage: " << argv[0] << " <cyclebite-merge>" << endl;
+        return EXIT_FAILURE;
+    }
+    string tool = argv[1];
+    int failures = 0;
+    auto check = [&](const string &name, bool passed) {
+        if (!passed)
+        {
+            cout << name << " failed" << endl;
+            failures++;
+        }
+    };
+    // block 3 is labelled in both runs, its frequencies are summed with the weights
+    writeContainer("test_ProfileMerge.0.bin", {{__TA_SECTION_EDGES, edges({{3, 4, 10}})},
+                                               {__TA_SECTION_LABELS, labels({{3, "GEMM", 10}, {5, "Stencil", 7}})},
+                                               {__TA_SECTION_CALLERS, ids({3, 8, 0, 5, 9, 2})},
+                                               {__TA_SECTION_THREAD_LAUNCHERS, ids({1})},
+                                               {__TA_SECTION_THREAD_ENTRANCES, ids({6})}});
+    writeContainer("test_ProfileMerge.1.bin", {{__TA_SECTION_EDGES, edges({{3, 4, 5}})},
+                                               {__TA_SECTION_LABELS, labels({{3, "GEMM", 4}, {3, "", 1}})},
+                                               {__TA_SECTION_CALLERS, ids({3, 11, 1})},
+                                               {__TA_SECTION_THREAD_ENTRANCES, ids({6, 7})}});
+    auto merged = merge(tool, "-i test_ProfileMerge.0.bin -i test_ProfileMerge.1.bin -w 1 -w 2");
+    json expected;
+    expected["3"]["Labels"]["GEMM"] = 18;
+    expected["3"]["Labels"][""] = 2;
+    expected["5"]["Labels"]["Stencil"] = 7;
+    expected["3"]["BlockCallers"] = vector<int64_t>{8, 11};
+    expected["5"]["BlockCallers"] = vector<int64_t>{9};
+    expected["ThreadLaunchers"] = vector<int64_t>{1};
+    expected["ThreadEntrances"] = vector<int64_t>{6, 7};
+    check("two labelled containers", merged == expected);
+
+    // a container next to a legacy profile: the container's own sections are used, its -bi entry is never opened
+    json legacy;
+    legacy["5"]["Labels"]["Stencil"] = 3;
+    legacy["5"]["BlockCallers"] = vector<int64_t>{12};
+    ofstream("test_ProfileMerge.legacy.json") << legacy;
+    auto legacyEdges = edges({{3, 4, 1}});
+    ofstream("test_ProfileMerge.legacy.bin", ios::binary).write((const char *)legacyEdges.data(), (streamsize)legacyEdges.size());
+    merged = merge(tool, "-i test_ProfileMerge.0.bin -i test_ProfileMerge.legacy.bin -bi missing.json -bi test_ProfileMerge.legacy.json");
+    expected = json();
+    expected["3"]["Labels"]["GEMM"] = 10;
+    expected["5"]["Labels"]["Stencil"] = 10;
+    expected["3"]["BlockCallers"] = vector<int64_t>{8};
+    expected["5"]["BlockCallers"] = vector<int64_t>{9, 12};
+    expected["ThreadLaunchers"] = vector<int64_t>{1};
+    expected["ThreadEntrances"] = vector<int64_t>{6};
+    check("a container and a legacy profile", merged == expected);
+
+    // a container with nothing but edges merges into no block information at all
+    writeContainer("test_ProfileMerge.2.bin", {{__TA_SECTION_EDGES, edges({})}});
+    check("containers without labels", merge(tool, "-i test_ProfileMerge.2.bin -i test_ProfileMerge.2.bin").is_null() && ifstream("test_ProfileMerge.json").good());
+
+    // a label that runs past the end of its section fails the merge
+    auto truncated = labels({{3, "GEMM", 10}});
+    truncated.pop_back();
+    writeContainer("test_ProfileMerge.2.bin", {{__TA_SECTION_EDGES, edges({})}, {__TA_SECTION_LABELS, truncated}});
+    merge(tool, "-i test_ProfileMerge.2.bin");
+    check("truncated label", !ifstream("test_ProfileMerge.json").good());
+
+    for (const auto &file : {"test_ProfileMerge.0.bin", "test_ProfileMerge.1.bin", "test_ProfileMerge.2.bin", "test_ProfileMerge.legacy.bin", "test_ProfileMerge.legacy.json", "test_ProfileMerge.bin", "test_ProfileMerge.json"})
+    {
+        remove(file);
+    }
+    if (failures)
+    {
+        return EXIT_FAILURE;
+    }
+    cout << "Merged the block information of every container" << endl;
+    return EXIT_SUCCESS;
+}
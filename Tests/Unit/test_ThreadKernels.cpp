@@ -0,0 +1,264 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "ThreadKernels.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace std;
+using namespace Cyclebite::Cartographer;
+using json = nlohmann::json;
+
+// each thread finds a random part of a pool of kernels, the unified kernel file has to hold each distinct kernel once with the union of what every thread saw
+// kernel IDs are renumbered by the unification, so kernels are compared by their blocks
+
+#define TRIALS      100
+#define MAX_THREADS 6
+#define POOL        16
+#define BLOCKS      100
+
+typedef set<int64_t> Blocks;
+
+/// What the threads saw of one kernel of the pool
+struct Expected
+{
+    set<uint32_t> threads;
+    set<string> labels;
+    map<string, set<string>> entrances;
+    map<string, set<string>> exits;
+    set<Blocks> children;
+    set<Blocks> parents;
+    set<Blocks> dominators;
+};
+
+map<string, set<string>> randomBorders(mt19937 &rng)
+{
+    map<string, set<string>> borders;
+    for (auto n = rng() % 3; n > 0; n--)
+    {
+        borders[to_string(rng() % BLOCKS)].insert(to_string(rng() % BLOCKS));
+    }
+    return borders;
+}
+
+json bordersToJson(const map<string, set<string>> &borders)
+{
+    json j = json::object();
+    for (const auto &[src, snks] : borders)
+    {
+        j[src] = vector<string>(snks.begin(), snks.end());
+    }
+    return j;
+}
+
+map<string, set<string>> bordersFromJson(const json &kernel, const string &name)
+{
+    map<string, set<string>> borders;
+    if (kernel.contains(name))
+    {
+        for (const auto &[src, snks] : kernel[name].items())
+        {
+            auto list = snks.get<vector<string>>();
+            borders[src].insert(list.begin(), list.end());
+        }
+    }
+    return borders;
+}
+
+int main()
+{
+    mt19937 rng(3);
+    const vector<string> labelPool = {"", "GEMM", "Stencil", "Reduction"};
+    for (int trial = 0; trial < TRIALS; trial++)
+    {
+        // the pool: kernels with distinct blocks
+        set<Blocks> distinct;
+        while (distinct.size() < POOL)
+        {
+            Blocks b;
+            for (auto n = rng() % 5 + 1; n > 0; n--)
+            {
+                b.insert((int64_t)(rng() % BLOCKS));
+            }
+            distinct.insert(b);
+        }
+        vector<Blocks> pool(distinct.begin(), distinct.end());
+        map<Blocks, Expected> expected;
+        set<int64_t> nonKernelBlocks;
+        vector<pair<uint32_t, string>> threadFiles;
+        auto threadCount = rng() % MAX_THREADS + 1;
+        for (uint32_t t = 0; t < threadCount; t++)
+        {
+            auto thread = 3 * t + (uint32_t)(rng() % 3);
+            vector<size_t> found(pool.size());
+            for (size_t k = 0; k < found.size(); k++)
+            {
+                found[k] = k;
+            }
+            shuffle(found.begin(), found.end(), rng);
+            found.resize(rng() % (pool.size() + 1));
+            json j;
+            j["ValidBlocks"] = vector<int64_t>{0, 1, 2};
+            j["Entropy"] = (double)t;
+            Blocks nkb;
+            for (auto n = rng() % 10; n > 0; n--)
+            {
+                nkb.insert((int64_t)(rng() % BLOCKS));
+            }
+            j["NonKernelBlocks"] = nkb;
+            nonKernelBlocks.insert(nkb.begin(), nkb.end());
+            // the kernel with local ID k is pool[found[k]]
+            j["Kernels"] = json::object();
+            for (size_t k = 0; k < found.size(); k++)
+            {
+                const auto &blocks = pool[found[k]];
+                auto &e = expected[blocks];
+                e.threads.insert(thread);
+                json kernel;
+                vector<int64_t> shuffled(blocks.begin(), blocks.end());
+                shuffle(shuffled.begin(), shuffled.end(), rng);
+                kernel["Blocks"] = shuffled;
+                kernel["Nodes"] = vector<uint32_t>(rng() % 4 + 1, 0);
+                set<string> labels = {labelPool[rng() % labelPool.size()]};
+                e.labels.insert(labels.begin(), labels.end());
+                kernel["Labels"] = labels;
+                auto entrances = randomBorders(rng);
+                auto exits = randomBorders(rng);
+                for (const auto &[src, snks] : entrances)
+                {
+                    e.entrances[src].insert(snks.begin(), snks.end());
+                }
+                for (const auto &[src, snks] : exits)
+                {
+                    e.exits[src].insert(snks.begin(), snks.end());
+                }
+                kernel["Entrances"] = bordersToJson(entrances);
+                kernel["Exits"] = bordersToJson(exits);
+                for (const auto &field : {"Children", "Parents", "Dominators"})
+                {
+                    set<uint32_t> ids;
+                    for (auto n = rng() % 3; (n > 0) && !found.empty(); n--)
+                    {
+                        auto other = (uint32_t)(rng() % found.size());
+                        ids.insert(other);
+                        auto &hierarchy = string(field) == "Children" ? e.children : string(field) == "Parents" ? e.parents : e.dominators;
+                        hierarchy.insert(pool[found[other]]);
+                    }
+                    kernel[field] = ids;
+                }
+                j["Kernels"][to_string(k)] = kernel;
+            }
+            auto file = "test_ThreadKernels." + to_string(t) + ".json";
+            ofstream(file) << j;
+            threadFiles.push_back(pair(thread, file));
+        }
+        for (const auto &[blocks, e] : expected)
+        {
+            for (const auto &b : blocks)
+            {
+                nonKernelBlocks.erase(b);
+            }
+        }
+
+        string output = "test_ThreadKernels.json";
+        UnifyThreadKernels(threadFiles, output);
+        json unified;
+        ifstream(output) >> unified;
+        for (const auto &[thread, file] : threadFiles)
+        {
+            remove(file.data());
+        }
+        remove(output.data());
+
+        string error;
+        if (unified["Kernels"].size() != expected.size())
+        {
+            error = to_string(unified["Kernels"].size()) + " kernels, expected " + to_string(expected.size());
+        }
+        // the blocks of each unified ID, the hierarchy refers to them
+        map<uint32_t, Blocks> idToBlocks;
+        for (size_t id = 0; error.empty() && (id < expected.size()); id++)
+        {
+            if (!unified["Kernels"].contains(to_string(id)))
+            {
+                error = "kernel " + to_string(id) + " is missing";
+                break;
+            }
+            idToBlocks[(uint32_t)id] = unified["Kernels"][to_string(id)]["Blocks"].get<Blocks>();
+        }
+        auto toBlocks = [&](const json &ids) {
+            set<Blocks> blocks;
+            for (const auto &id : ids.get<vector<uint32_t>>())
+            {
+                blocks.insert(idToBlocks.at(id));
+            }
+            return blocks;
+        };
+        for (const auto &[id, blocks] : idToBlocks)
+        {
+            if (!error.empty())
+            {
+                break;
+            }
+            const auto &kernel = unified["Kernels"][to_string(id)];
+            auto e = expected.find(blocks);
+            if (e == expected.end())
+            {
+                error = "kernel " + to_string(id) + " has blocks no thread found";
+                break;
+            }
+            auto labels = e->second.labels;
+            if (labels.size() > 1)
+            {
+                labels.erase("");
+            }
+            if (kernel["Threads"].get<set<uint32_t>>() != e->second.threads)
+            {
+                error = "threads";
+            }
+            else if (kernel["Labels"].get<set<string>>() != labels)
+            {
+                error = "labels";
+            }
+            else if ((bordersFromJson(kernel, "Entrances") != e->second.entrances) || (bordersFromJson(kernel, "Exits") != e->second.exits))
+            {
+                error = "entrances or exits";
+            }
+            else if ((toBlocks(kernel["Children"]) != e->second.children) || (toBlocks(kernel["Parents"]) != e->second.parents) || (toBlocks(kernel["Dominators"]) != e->second.dominators))
+            {
+                error = "hierarchy";
+            }
+            if (!error.empty())
+            {
+                error += " of kernel " + to_string(id) + " do not match";
+            }
+        }
+        if (error.empty() && (unified["NonKernelBlocks"].get<set<int64_t>>() != nonKernelBlocks))
+        {
+            error = "non-kernel blocks do not match";
+        }
+        for (uint32_t t = 0; error.empty() && (t < threadFiles.size()); t++)
+        {
+            if (unified["ThreadEntropy"][to_string(threadFiles[t].first)].get<double>() != (double)t)
+            {
+                error = "entropy of thread " + to_string(threadFiles[t].first) + " does not match";
+            }
+        }
+        if (!error.empty())
+        {
+            cout << "Trial " << trial << " (" << threadFiles.size() << " threads): " << error << endl;
+            return EXIT_FAILURE;
+        }
+    }
+    cout << "Unified the kernels of " << TRIALS << " random trials" << endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,181 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "MarkovProfile.h"
+#include "Util/Exceptions.h"
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace Cyclebite::Graph;
+
+// a merged profile is followed by a MARKOV_THREADS trailer of thread profiles of mixed markov orders, each thread has to come back byte for byte
+// the edge cases (no threads, threads without records, a trailer or thread header cut short, a header that promises too much) are checked first, then random trailers
+
+#define TRIALS      100
+#define MAX_THREADS 8
+#define MAX_RECORDS 32
+#define BLOCKS      1000
+
+template <typename T>
+void append(vector<uint8_t> &buffer, const T &val)
+{
+    auto p = reinterpret_cast<const uint8_t *>(&val);
+    buffer.insert(buffer.end(), p, p + sizeof(T));
+}
+
+/// Writes the header of a profile in the markov.bin layout, records are appended after it
+vector<uint8_t> header(uint32_t order, uint32_t records)
+{
+    vector<uint8_t> buffer;
+    append(buffer, order);
+    append(buffer, (uint32_t)BLOCKS);
+    append(buffer, records);
+    return buffer;
+}
+
+/// Appends a trailer of the threads to a merged profile
+vector<uint8_t> trailer(vector<uint8_t> buffer, const vector<vector<uint8_t>> &threads)
+{
+    append(buffer, (uint32_t)threads.size());
+    for (const auto &thread : threads)
+    {
+        buffer.insert(buffer.end(), thread.begin(), thread.end());
+    }
+    return buffer;
+}
+
+/// Returns true when the profile splits into exactly the threads
+bool splits(const vector<uint8_t> &buffer, const vector<vector<uint8_t>> &threads)
+{
+    auto split = MarkovProfile(buffer.data(), buffer.size()).getThreadProfiles();
+    if (split.size() != threads.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        if (!equal(split[i].begin(), split[i].end(), threads[i].begin(), threads[i].end()))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Writes a random profile in the markov.bin layout
+vector<uint8_t> randomProfile(mt19937_64 &rng)
+{
+    auto order = (uint32_t)(rng() % 4) + 1;
+    auto records = (uint32_t)(rng() % MAX_RECORDS);
+    auto buffer = header(order, records);
+    for (uint32_t i = 0; i < records; i++)
+    {
+        for (uint32_t b = 0; b <= order; b++)
+        {
+            append(buffer, (uint32_t)(rng() % BLOCKS));
+        }
+        append(buffer, (uint64_t)rng());
+    }
+    return buffer;
+}
+
+bool throws(const vector<uint8_t> &buffer)
+{
+    try
+    {
+        MarkovProfile(buffer.data(), buffer.size()).getThreadProfiles();
+    }
+    catch (CyclebiteException &e)
+    {
+        return true;
+    }
+    return false;
+}
+
+int main()
+{
+    int failures = 0;
+    auto check = [&](const string &name, bool passed) {
+        if (!passed)
+        {
+            cout << name << " failed" << endl;
+            failures++;
+        }
+    };
+    // edge cases
+    auto merged = header(1, 0);
+    check("profile without a trailer", splits(merged, {}));
+    check("trailer without threads", splits(trailer(merged, {}), {}));
+    check("threads without records", splits(trailer(merged, {header(1, 0), header(4, 0)}), {header(1, 0), header(4, 0)}));
+    auto cut = trailer(merged, {});
+    cut.pop_back();
+    check("thread count cut short", throws(cut));
+    cut = trailer(merged, {header(2, 0)});
+    cut.pop_back();
+    check("thread header cut short", throws(cut));
+    auto missing = trailer(merged, {header(2, 0)});
+    missing[merged.size()] = 2;
+    check("thread count past the end of the trailer", throws(missing));
+    check("thread that promises every record", throws(trailer(merged, {header(UINT32_MAX, UINT32_MAX)})));
+    // records of 2^34 bytes, 2^30 of them are 2^64 bytes, which wraps to nothing
+    check("thread whose size wraps", throws(trailer(merged, {header(UINT32_MAX - 2, 1U << 30)})));
+
+    // random trailers
+    mt19937_64 rng(5);
+    for (int trial = 0; (trial < TRIALS) && !failures; trial++)
+    {
+        auto buffer = randomProfile(rng);
+        string error;
+        if (!MarkovProfile(buffer.data(), buffer.size()).getThreadProfiles().empty())
+        {
+            error = "profile without a trailer has threads";
+        }
+        // reference: the bytes of each thread as they were written
+        vector<vector<uint8_t>> threads(rng() % MAX_THREADS);
+        append(buffer, (uint32_t)threads.size());
+        for (auto &thread : threads)
+        {
+            thread = randomProfile(rng);
+            buffer.insert(buffer.end(), thread.begin(), thread.end());
+        }
+        MarkovProfile profile(buffer.data(), buffer.size());
+        auto split = profile.getThreadProfiles();
+        if (error.empty() && (split.size() != threads.size()))
+        {
+            error = "split into " + to_string(split.size()) + " threads";
+        }
+        for (size_t i = 0; error.empty() && (i < threads.size()); i++)
+        {
+            if (!equal(split[i].begin(), split[i].end(), threads[i].begin(), threads[i].end()))
+            {
+                error = "thread " + to_string(i) + " does not match";
+                break;
+            }
+            // each thread is a profile of its own
+            MarkovProfile thread(split[i].data(), split[i].size());
+            if (split[i].size() != 3 * sizeof(uint32_t) + thread.getEdgeCount() * ((thread.getMarkovOrder() + 1) * sizeof(uint32_t) + sizeof(uint64_t)))
+            {
+                error = "thread " + to_string(i) + " has the wrong size";
+            }
+        }
+        if (error.empty() && !throws(vector<uint8_t>(buffer.begin(), buffer.end() - 1)))
+        {
+            error = "truncated trailer was split";
+        }
+        if (!error.empty())
+        {
+            cout << "Trial " << trial << " (" << threads.size() << " threads): " << error << endl;
+            failures++;
+        }
+    }
+    if (failures)
+    {
+        return EXIT_FAILURE;
+    }
+    cout << "Split every edge case and " << TRIALS << " random thread trailers" << endl;
+    return EXIT_SUCCESS;
+}
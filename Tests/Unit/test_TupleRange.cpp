@@ -0,0 +1,156 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "MemoryTuple.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace Cyclebite::Profile::Backend::Memory;
+
+// merge_tuple_range has to leave the same tuples behind as merging each copy of the range one at a time with merge_tuple_set
+// hand picked ranges (no copies, copies that share or just miss a byte, existing tuples on the first and last byte of the range) are checked against the tuples they have to leave first, then random ranges
+
+#define TRIALS      2000
+#define MAX_TUPLES  12
+#define ADDRESSES   512
+
+MemTuple randomTuple(mt19937 &rng, uint64_t maxOffset)
+{
+    MemTuple t;
+    t.type = rng() % 2 ? __TA_MemType::Reader : __TA_MemType::Writer;
+    t.base = 1 + rng() % ADDRESSES;
+    t.offset = (uint32_t)(rng() % (maxOffset + 1));
+    return t;
+}
+
+void print(const set<MemTuple, MTCompare> &tuples)
+{
+    for (const auto &t : tuples)
+    {
+        cout << "  [" << t.base << ", " << t.base + t.offset << "] type " << (int)t.type << " AP " << (int)t.AP << endl;
+    }
+}
+
+MemTuple reader(uint64_t base, uint64_t end)
+{
+    MemTuple t;
+    t.type = __TA_MemType::Reader;
+    t.base = base;
+    t.offset = (uint32_t)(end - base);
+    return t;
+}
+
+/// Returns true when merging the range leaves the same tuples as merging each copy, and prints what the two left when it doesn't
+bool matches(const set<MemTuple, MTCompare> &existing, const MemTuple &tuple, uint64_t stride, uint64_t count)
+{
+    auto range = existing;
+    merge_tuple_range(range, tuple, stride, count);
+    // reference: one copy at a time
+    auto reference = existing;
+    auto copy = tuple;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        copy.base = tuple.base + stride * i;
+        merge_tuple_set(reference, copy);
+    }
+    bool same = range.size() == reference.size();
+    for (auto r = range.begin(), e = reference.begin(); same && (r != range.end()); r++, e++)
+    {
+        // refCount counts merges, and a range that is one tuple is merged once
+        same = (r->base == e->base) && (r->offset == e->offset) && (r->type == e->type) && (r->AP == e->AP);
+    }
+    if (!same)
+    {
+        cout << "range base " << tuple.base << " offset " << tuple.offset << " stride " << stride << " count " << count << endl;
+        cout << "merge_tuple_range:" << endl;
+        print(range);
+        cout << "merge_tuple_set:" << endl;
+        print(reference);
+    }
+    return same;
+}
+
+/// Returns true when merging the range into the existing tuples matches merging each copy and leaves exactly the expected [base, end] ranges
+bool leaves(const vector<pair<uint64_t, uint64_t>> &existing, const MemTuple &tuple, uint64_t stride, uint64_t count, const vector<pair<uint64_t, uint64_t>> &expected)
+{
+    set<MemTuple, MTCompare> tuples;
+    for (const auto &[base, end] : existing)
+    {
+        merge_tuple_set(tuples, reader(base, end));
+    }
+    if (!matches(tuples, tuple, stride, count))
+    {
+        return false;
+    }
+    merge_tuple_range(tuples, tuple, stride, count);
+    vector<pair<uint64_t, uint64_t>> left;
+    for (const auto &t : tuples)
+    {
+        left.push_back(pair(t.base, t.base + t.offset));
+    }
+    if (left != expected)
+    {
+        print(tuples);
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    int failures = 0;
+    auto check = [&](const string &name, bool passed) {
+        if (!passed)
+        {
+            cout << name << " failed" << endl;
+            failures++;
+        }
+    };
+    // edge cases, the range is four bytes [100, 103] copied stride bytes apart
+    auto tuple = reader(100, 103);
+    check("no copies", leaves({{10, 20}}, tuple, 8, 0, {{10, 20}}));
+    check("no copies into an empty set", leaves({}, tuple, 8, 0, {}));
+    check("one copy", leaves({}, tuple, 8, 1, {{100, 103}}));
+    check("copies on top of each other", leaves({}, tuple, 0, 5, {{100, 103}}));
+    check("copies that share their last byte", leaves({}, tuple, 3, 3, {{100, 109}}));
+    check("copies that just miss each other", leaves({}, tuple, 4, 3, {{100, 103}, {104, 107}, {108, 111}}));
+    check("tuple that ends on the first byte", leaves({{90, 100}}, tuple, 8, 2, {{90, 103}, {108, 111}}));
+    check("tuple that ends right before the first byte", leaves({{90, 99}}, tuple, 8, 2, {{90, 99}, {100, 103}, {108, 111}}));
+    check("tuple that starts on the last byte", leaves({{111, 120}}, tuple, 8, 2, {{100, 103}, {108, 120}}));
+    check("tuple that starts right after the last byte", leaves({{112, 120}}, tuple, 8, 2, {{100, 103}, {108, 111}, {112, 120}}));
+    check("tuple in the gap between copies", leaves({{105, 106}}, tuple, 8, 2, {{100, 103}, {105, 106}, {108, 111}}));
+    check("tuple that bridges two copies", leaves({{103, 108}}, tuple, 8, 2, {{100, 111}}));
+    check("tuple that covers the range", leaves({{50, 150}}, tuple, 8, 4, {{50, 150}}));
+
+    // random ranges
+    mt19937 rng(7);
+    for (int trial = 0; (trial < TRIALS) && !failures; trial++)
+    {
+        set<MemTuple, MTCompare> existing;
+        for (auto n = rng() % MAX_TUPLES; n > 0; n--)
+        {
+            merge_tuple_set(existing, randomTuple(rng, 16));
+        }
+        auto tuple = randomTuple(rng, 8);
+        uint64_t stride = rng() % 24;
+        uint64_t count = rng() % 16;
+        if (!matches(existing, tuple, stride, count))
+        {
+            cout << "Trial " << trial << " failed" << endl;
+            failures++;
+        }
+    }
+    if (failures)
+    {
+        return EXIT_FAILURE;
+    }
+    cout << "Merged every edge case and " << TRIALS << " random ranges" << endl;
+    return EXIT_SUCCESS;
+}
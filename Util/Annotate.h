@@ -5,6 +5,7 @@
 #pragma once
 #include "Util/Exceptions.h"
 #include "Util/Print.h"
+#include <algorithm>
 #include <filesystem>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/DIBuilder.h>
@@ -17,7 +18,9 @@
 #include <map>
 #include <set>
 #include <spdlog/spdlog.h>
+#include <string>
 #include <unistd.h>
+#include <vector>
 
 namespace Cyclebite::Util
 {
@@ -264,6 +267,76 @@ namespace Cyclebite::Util
         return result;
     }
 
+    /// @brief Kinds of the ID metadata of a module
+    ///
+    /// Looking a kind up by name goes through LLVMContext::getMDKindID, which is not thread-safe, so threads that read IDs take these numbers from a lookup done before they start
+    struct IDKinds
+    {
+        unsigned blockID;
+        unsigned valueID;
+        /// Kind of "ArgId<i>" at index i, for as many arguments as the widest function of the module has
+        std::vector<unsigned> argIDs;
+        IDKinds(const llvm::Module &M)
+        {
+            auto &C = M.getContext();
+            blockID = C.getMDKindID("BlockID");
+            valueID = C.getMDKindID("ValueID");
+            size_t args = 0;
+            for (const auto &f : M)
+            {
+                args = std::max(args, f.arg_size());
+            }
+            for (size_t i = 0; i < args; i++)
+            {
+                argIDs.push_back(C.getMDKindID("ArgId" + std::to_string(i)));
+            }
+        }
+    };
+
+    /// Same as GetBlockID(BB), with the kind looked up beforehand
+    inline int64_t GetBlockID(const llvm::BasicBlock *BB, const IDKinds &kinds)
+    {
+        int64_t result = IDState::Uninitialized;
+        if (BB->empty())
+        {
+            return result;
+        }
+        auto *first = llvm::cast<llvm::Instruction>(BB->getFirstInsertionPt());
+        if (llvm::MDNode *node = first->getMetadata(kinds.blockID))
+        {
+            auto ci = llvm::cast<llvm::ConstantInt>(llvm::cast<llvm::ConstantAsMetadata>(node->getOperand(0))->getValue());
+            result = ci->getSExtValue();
+        }
+        return result;
+    }
+
+    /// Same as GetValueID(val), with the kinds looked up beforehand
+    inline int64_t GetValueID(const llvm::Value *val, const IDKinds &kinds)
+    {
+        llvm::MDNode *node = nullptr;
+        if (auto *first = llvm::dyn_cast<llvm::Instruction>(val))
+        {
+            node = first->getMetadata(kinds.valueID);
+        }
+        else if (auto second = llvm::dyn_cast<llvm::GlobalObject>(val))
+        {
+            node = second->getMetadata(kinds.valueID);
+        }
+        else if (auto third = llvm::dyn_cast<llvm::Argument>(val))
+        {
+            if (third->getArgNo() < kinds.argIDs.size())
+            {
+                node = third->getParent()->getMetadata(kinds.argIDs[third->getArgNo()]);
+            }
+        }
+        if (node)
+        {
+            auto ci = llvm::cast<llvm::ConstantInt>(llvm::cast<llvm::ConstantAsMetadata>(node->getOperand(0))->getValue());
+            return ci->getSExtValue();
+        }
+        return IDState::Uninitialized;
+    }
+
     inline bool isAllocatingFunction(const llvm::CallBase* call)
     {
         if( call->getCalledFunction() )
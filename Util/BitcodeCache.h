@@ -0,0 +1,82 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#pragma once
+#include "Util/Format.h"
+#include <filesystem>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/raw_ostream.h>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <unistd.h>
+
+namespace Cyclebite::Util
+{
+    // set the CYCLEBITE_BITCODE_CACHE environment variable to a directory to cache formatted bitcode there
+    // bump this whenever Format() changes what it does to a module, so stale cache entries are ignored
+    constexpr uint32_t BITCODE_CACHE_VERSION = 1;
+
+    /// @brief Returns the cache entry path (without extension) of a bitcode file, or an empty path when the cache is disabled
+    ///
+    /// Entries are keyed by a hash of the bitcode contents, so a rebuilt input never hits a stale entry
+    inline std::filesystem::path BitcodeCacheEntry(const std::string &path, bool clean)
+    {
+        auto cacheDir = getenv("CYCLEBITE_BITCODE_CACHE");
+        if (cacheDir == nullptr)
+        {
+            return std::filesystem::path();
+        }
+        auto buffer = llvm::MemoryBuffer::getFile(path);
+        if (!buffer)
+        {
+            return std::filesystem::path();
+        }
+        auto digest = llvm::SHA1::hash(llvm::ArrayRef<uint8_t>((const uint8_t *)(*buffer)->getBufferStart(), (*buffer)->getBufferSize()));
+        std::string hash = llvm::toHex(llvm::ArrayRef<uint8_t>(digest.data(), digest.size()), true);
+        std::string name = std::filesystem::path(path).stem().string() + "." + hash + ".v" + std::to_string(BITCODE_CACHE_VERSION) + (clean ? ".clean" : "");
+        return std::filesystem::path(cacheDir) / name;
+    }
+
+    /// @brief Writes a formatted module to the cache
+    ///
+    /// The file is written under a temporary name and renamed, so concurrent tools never read a partial entry
+    inline void WriteBitcodeCache(const llvm::Module &M, const std::filesystem::path &entry)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(entry.parent_path(), ec);
+        auto tmp = entry.string() + "." + std::to_string(getpid()) + ".bc";
+        {
+            llvm::raw_fd_ostream bc(tmp, ec);
+            if (ec)
+            {
+                spdlog::warn("Could not write bitcode cache entry " + entry.string() + ": " + ec.message());
+                return;
+            }
+            llvm::WriteBitcodeToFile(M, bc);
+        }
+        std::filesystem::rename(tmp, entry.string() + ".bc", ec);
+    }
+
+    /// @brief Loads a formatted module from the cache
+    ///
+    /// Every function is materialized, so a cached module is the same module a cache miss formats from the input
+    /// Returns nullptr when the entry does not exist or cannot be read
+    inline std::unique_ptr<llvm::Module> ReadBitcodeCache(const std::filesystem::path &entry, llvm::LLVMContext &context)
+    {
+        auto bcPath = entry.string() + ".bc";
+        if (!std::filesystem::exists(bcPath))
+        {
+            return nullptr;
+        }
+        llvm::SMDiagnostic err;
+        return llvm::parseIRFile(bcPath, err, context);
+    }
+} // namespace Cyclebite::Util
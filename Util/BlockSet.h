@@ -0,0 +1,303 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#pragma once
+#include "Util/Exceptions.h"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <vector>
+
+namespace Cyclebite::Util
+{
+    /// @brief Set of basic block IDs, iterated in ascending order like std::set<int64_t>
+    ///
+    /// Small sets are a sorted vector of IDs, a set switches to a dense bitset (bit i is block i) once the bitset is the smaller of the two or the vector gets long
+    /// Block IDs are dense in [0, block count of the module), so the bitset of even the biggest set is blockCount/8 bytes
+    /// Intersections and unions of two dense sets are word-wise AND/OR and popcount, which the compiler vectorizes
+    class BlockSet
+    {
+    public:
+        class const_iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = int64_t;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const int64_t *;
+            using reference = int64_t;
+            const_iterator() = default;
+            const_iterator(const BlockSet *set, uint64_t pos) : set(set), pos(pos) {}
+            int64_t operator*() const
+            {
+                return set->dense ? (int64_t)pos : set->sparse[pos];
+            }
+            const_iterator &operator++()
+            {
+                pos = set->dense ? set->nextBit(pos + 1) : pos + 1;
+                return *this;
+            }
+            const_iterator operator++(int)
+            {
+                auto old = *this;
+                ++(*this);
+                return old;
+            }
+            bool operator==(const const_iterator &rhs) const
+            {
+                return pos == rhs.pos;
+            }
+
+        private:
+            const BlockSet *set = nullptr;
+            /// index into the vector of a sparse set, block ID of a dense set
+            uint64_t pos = 0;
+        };
+        using iterator = const_iterator;
+        using value_type = int64_t;
+
+        BlockSet() = default;
+        template <typename It>
+        BlockSet(It first, It last)
+        {
+            insert(first, last);
+        }
+        BlockSet(std::initializer_list<int64_t> ids) : BlockSet(ids.begin(), ids.end()) {}
+
+        const_iterator begin() const
+        {
+            return const_iterator(this, dense ? nextBit(0) : 0);
+        }
+        const_iterator end() const
+        {
+            return const_iterator(this, dense ? words.size() * 64 : sparse.size());
+        }
+        size_t size() const
+        {
+            return count;
+        }
+        bool empty() const
+        {
+            return count == 0;
+        }
+        void clear()
+        {
+            sparse.clear();
+            words.clear();
+            dense = false;
+            count = 0;
+        }
+        bool contains(int64_t id) const
+        {
+            if (dense)
+            {
+                auto w = (uint64_t)id >> 6;
+                return (id >= 0) && (w < words.size()) && ((words[w] >> (id & 63)) & 1);
+            }
+            return std::binary_search(sparse.begin(), sparse.end(), id);
+        }
+        /// Returns true if id was not in the set yet
+        bool insert(int64_t id)
+        {
+            if (id < 0)
+            {
+                throw CyclebiteException("Block IDs cannot be negative!");
+            }
+            if (dense)
+            {
+                auto w = (uint64_t)id >> 6;
+                if (w >= words.size())
+                {
+                    words.resize(w + 1, 0);
+                }
+                auto bit = 1ULL << (id & 63);
+                if (words[w] & bit)
+                {
+                    return false;
+                }
+                words[w] |= bit;
+                count++;
+                return true;
+            }
+            auto it = std::lower_bound(sparse.begin(), sparse.end(), id);
+            if ((it != sparse.end()) && (*it == id))
+            {
+                return false;
+            }
+            sparse.insert(it, id);
+            count++;
+            densify();
+            return true;
+        }
+        template <typename It>
+        void insert(It first, It last)
+        {
+            for (; first != last; first++)
+            {
+                insert((int64_t)*first);
+            }
+        }
+        void erase(int64_t id)
+        {
+            if (dense)
+            {
+                if (contains(id))
+                {
+                    words[(uint64_t)id >> 6] &= ~(1ULL << (id & 63));
+                    count--;
+                }
+                return;
+            }
+            auto it = std::lower_bound(sparse.begin(), sparse.end(), id);
+            if ((it != sparse.end()) && (*it == id))
+            {
+                sparse.erase(it);
+                count--;
+            }
+        }
+        /// Number of blocks in both sets
+        size_t intersectionSize(const BlockSet &other) const
+        {
+            if (dense && other.dense)
+            {
+                size_t n = std::min(words.size(), other.words.size());
+                uint64_t shared = 0;
+                for (size_t i = 0; i < n; i++)
+                {
+                    shared += (uint64_t)std::popcount(words[i] & other.words[i]);
+                }
+                return (size_t)shared;
+            }
+            // walk the sparse set (or the smaller one) and look each block up in the other
+            const auto &walk = (!dense && (other.dense || (count <= other.count))) ? *this : other;
+            const auto &probe = (&walk == this) ? other : *this;
+            size_t shared = 0;
+            for (const auto &id : walk)
+            {
+                shared += probe.contains(id);
+            }
+            return shared;
+        }
+        /// Number of blocks in either set
+        size_t unionSize(const BlockSet &other) const
+        {
+            return count + other.count - intersectionSize(other);
+        }
+        BlockSet &operator|=(const BlockSet &other)
+        {
+            if (!other.dense)
+            {
+                insert(other.sparse.begin(), other.sparse.end());
+                return *this;
+            }
+            toDense();
+            if (words.size() < other.words.size())
+            {
+                words.resize(other.words.size(), 0);
+            }
+            uint64_t total = 0;
+            for (size_t i = 0; i < words.size(); i++)
+            {
+                if (i < other.words.size())
+                {
+                    words[i] |= other.words[i];
+                }
+                total += (uint64_t)std::popcount(words[i]);
+            }
+            count = (size_t)total;
+            return *this;
+        }
+        BlockSet &operator-=(const BlockSet &other)
+        {
+            if (dense && other.dense)
+            {
+                size_t n = std::min(words.size(), other.words.size());
+                uint64_t total = 0;
+                for (size_t i = 0; i < words.size(); i++)
+                {
+                    if (i < n)
+                    {
+                        words[i] &= ~other.words[i];
+                    }
+                    total += (uint64_t)std::popcount(words[i]);
+                }
+                count = (size_t)total;
+                return *this;
+            }
+            if (!dense)
+            {
+                std::erase_if(sparse, [&](int64_t id) { return other.contains(id); });
+                count = sparse.size();
+                return *this;
+            }
+            for (const auto &id : other)
+            {
+                erase(id);
+            }
+            return *this;
+        }
+        bool operator==(const BlockSet &rhs) const
+        {
+            if (count != rhs.count)
+            {
+                return false;
+            }
+            return intersectionSize(rhs) == count;
+        }
+
+    private:
+        /// A sparse set never grows past this many IDs, inserting into the middle of the vector gets too expensive
+        static constexpr size_t MAX_SPARSE = 4096;
+        bool dense = false;
+        size_t count = 0;
+        std::vector<int64_t> sparse;
+        std::vector<uint64_t> words;
+        /// Returns the first block ID at or after from, or the end position if there is none
+        uint64_t nextBit(uint64_t from) const
+        {
+            auto w = from >> 6;
+            if (w >= words.size())
+            {
+                return words.size() * 64;
+            }
+            auto bits = words[w] & (~0ULL << (from & 63));
+            while (!bits)
+            {
+                if (++w == words.size())
+                {
+                    return words.size() * 64;
+                }
+                bits = words[w];
+            }
+            return w * 64 + (uint64_t)std::countr_zero(bits);
+        }
+        /// Switches to the bitset once it is smaller than the vector
+        void densify()
+        {
+            auto bitsetWords = (uint64_t)sparse.back() / 64 + 1;
+            if ((sparse.size() >= bitsetWords) || (sparse.size() > MAX_SPARSE))
+            {
+                toDense();
+            }
+        }
+        void toDense()
+        {
+            if (dense)
+            {
+                return;
+            }
+            words.assign(sparse.empty() ? 0 : (uint64_t)sparse.back() / 64 + 1, 0);
+            for (const auto &id : sparse)
+            {
+                words[(uint64_t)id >> 6] |= 1ULL << (id & 63);
+            }
+            sparse.clear();
+            sparse.shrink_to_fit();
+            dense = true;
+        }
+    };
+} // namespace Cyclebite::Util
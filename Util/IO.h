@@ -3,6 +3,7 @@
 // SPDX-License-Identifier: Apache-2.0
 //==------------------------------==//
 #pragma once
+#include "Util/BitcodeCache.h"
 #include "Util/Format.h"
 #include "Util/Print.h"
 #include "llvm/Analysis/CallGraph.h"
@@ -22,14 +23,31 @@
 static llvm::LLVMContext context;
 static llvm::SMDiagnostic smerror;
 
-inline std::unique_ptr<llvm::Module> ReadBitcode(const std::string &InputFilename)
+/// @brief Reads and formats a bitcode file
+///
+/// When the bitcode cache is enabled (see Util/BitcodeCache.h) the formatted module is read from the cache if it is there, and written to it if it is not
+/// @param clean  Passed to Format()
+inline std::unique_ptr<llvm::Module> ReadBitcode(const std::string &InputFilename, bool clean = true)
 {
+    auto entry = Cyclebite::Util::BitcodeCacheEntry(InputFilename, clean);
+    if (!entry.empty())
+    {
+        if (auto cached = Cyclebite::Util::ReadBitcodeCache(entry, context))
+        {
+            return cached;
+        }
+    }
     std::unique_ptr<llvm::Module> SourceBitcode = parseIRFile(InputFilename, smerror, context);
     if (SourceBitcode.get() == nullptr)
     {
         spdlog::critical("Failed to open bitcode file: " + InputFilename);
+        return SourceBitcode;
+    }
+    Cyclebite::Util::Format(*SourceBitcode, clean);
+    if (!entry.empty())
+    {
+        Cyclebite::Util::WriteBitcodeCache(*SourceBitcode, entry);
     }
-    Cyclebite::Util::Format(*SourceBitcode);
     return SourceBitcode;
 }
 
@@ -43,7 +61,7 @@ inline std::vector<std::unique_ptr<llvm::Module>> LoadBitcodes(const std::vector
     return result;
 }
 
-inline llvm::CallGraph getCallGraph(llvm::Module *mod, std::map<int64_t, std::vector<int64_t>> &blockCallers, std::map<llvm::BasicBlock *, const llvm::Function *> &BlockToFPtr, std::map<int64_t, const llvm::BasicBlock *> &IDToBlock)
+inline llvm::CallGraph getCallGraph(llvm::Module *mod, const std::map<int64_t, std::vector<int64_t>> &blockCallers, std::map<llvm::BasicBlock *, const llvm::Function *> &BlockToFPtr, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock)
 {
     // this constructor does suboptimal things
     // when a function is declared and not intrinsic to the module, the constructor will put a nullptr in for the entry
@@ -74,7 +92,9 @@ inline llvm::CallGraph getCallGraph(llvm::Module *mod, std::map<int64_t, std::ve
                         {
                             for (auto entry : blockCallers.at(BBID))
                             {
-                                auto calleeBlock = IDToBlock[entry];
+                                // IDToBlock may be shared with other threads, so a missing ID is never inserted
+                                auto calleeIt = IDToBlock.find(entry);
+                                auto calleeBlock = calleeIt == IDToBlock.end() ? nullptr : calleeIt->second;
                                 if (calleeBlock != nullptr)
                                 {
                                     auto parentNode = CG.getOrInsertFunction(bb->getParent());
@@ -0,0 +1,117 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#pragma once
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Cyclebite::Util
+{
+    /// @brief Writes a json document straight to a stream, one token at a time
+    ///
+    /// Produces the same layout as nlohmann's pretty printer (std::setw(indent)) without building the document in memory first
+    /// Scalars are serialized by nlohmann, so escaping and number formatting match json::dump()
+    /// Object members are written in the order they are given, the caller is responsible for not repeating keys
+    class JsonStreamWriter
+    {
+    public:
+        JsonStreamWriter(std::ostream &out, unsigned indent = 4) : out(out), indent(indent) {}
+        void beginObject()
+        {
+            prefix();
+            out << "{";
+            scopes.push_back(Scope{false, true});
+        }
+        void endObject()
+        {
+            close('}');
+        }
+        void beginArray()
+        {
+            prefix();
+            out << "[";
+            scopes.push_back(Scope{true, true});
+        }
+        void endArray()
+        {
+            close(']');
+        }
+        void key(const std::string &k)
+        {
+            prefix();
+            out << nlohmann::json(k).dump() << ": ";
+            afterKey = true;
+        }
+        template <typename T>
+        void value(const T &v)
+        {
+            prefix();
+            out << nlohmann::json(v).dump();
+        }
+        template <typename T>
+        void field(const std::string &k, const T &v)
+        {
+            key(k);
+            value(v);
+        }
+        /// Writes any iterable of scalars as an array, element by element
+        template <typename T>
+        void array(const T &container)
+        {
+            beginArray();
+            for (const auto &v : container)
+            {
+                value(v);
+            }
+            endArray();
+        }
+
+    private:
+        struct Scope
+        {
+            bool array;
+            bool empty;
+        };
+        std::ostream &out;
+        unsigned indent;
+        std::vector<Scope> scopes;
+        bool afterKey = false;
+        void newline()
+        {
+            out << "\n" << std::string(scopes.size() * indent, ' ');
+        }
+        /// Separates the next token from the previous one
+        void prefix()
+        {
+            if (afterKey)
+            {
+                afterKey = false;
+                return;
+            }
+            if (scopes.empty())
+            {
+                return;
+            }
+            if (!scopes.back().empty)
+            {
+                out << ",";
+            }
+            scopes.back().empty = false;
+            newline();
+        }
+        void close(char c)
+        {
+            bool empty = scopes.back().empty;
+            scopes.pop_back();
+            if (!empty)
+            {
+                newline();
+            }
+            out << c;
+        }
+    };
+} // namespace Cyclebite::Util
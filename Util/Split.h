@@ -3,10 +3,13 @@
 // SPDX-License-Identifier: Apache-2.0
 //==------------------------------==//
 #pragma once
+#include "Util/Annotate.h"
 #include "Util/Print.h"
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/IntrinsicInst.h>
 #include <llvm/IR/Module.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <utility>
 
 inline void Split(llvm::Module& M)
 {
@@ -46,4 +49,85 @@ inline void Split(llvm::Module& M)
             bi++;
         }
     }
-}
\ No newline at end of file
+}
+
+/// @brief Returns the block IDs Split() gave to a call and to the code that follows it
+///
+/// Only calls that have been through Join() carry these IDs, every other call returns {-1, -1}
+/// Invokes terminate their block, so the second ID of an invoke is always -1
+inline std::pair<int64_t, int64_t> GetCallBlockIDs(const llvm::CallBase *call)
+{
+    if (auto node = call->getMetadata("CallBlockIDs"))
+    {
+        auto callID = llvm::cast<llvm::ConstantInt>(llvm::cast<llvm::ConstantAsMetadata>(node->getOperand(0))->getValue())->getSExtValue();
+        auto postID = llvm::cast<llvm::ConstantInt>(llvm::cast<llvm::ConstantAsMetadata>(node->getOperand(1))->getValue())->getSExtValue();
+        return std::pair(callID, postID);
+    }
+    return std::pair(-1, -1);
+}
+
+inline void SetCallBlockIDs(llvm::CallBase *call, int64_t callID, int64_t postID)
+{
+    auto i64 = llvm::Type::getInt64Ty(call->getContext());
+    call->setMetadata("CallBlockIDs", llvm::MDNode::get(call->getContext(), {llvm::ConstantAsMetadata::get(llvm::ConstantInt::get(i64, (uint64_t)callID)), llvm::ConstantAsMetadata::get(llvm::ConstantInt::get(i64, (uint64_t)postID))}));
+}
+
+/// @brief Undoes Split() on an annotated module
+///
+/// Each call is merged back into the block it came from, so the module gets its original block structure back
+/// The ID space stays the one Split() produced: every block keeps the ID of its first fragment and every call remembers the IDs of its own fragment and the fragment after it (see GetCallBlockIDs())
+/// Profilers use this to instrument call sites without paying for a block boundary at each of them, while still producing profiles in the split ID space the analysis tools expect
+inline void Join(llvm::Module &M)
+{
+    for (auto &F : M)
+    {
+        for (auto &BB : F)
+        {
+            auto blockID = Cyclebite::Util::GetBlockID(&BB);
+            bool merged = false;
+            while (auto br = llvm::dyn_cast<llvm::BranchInst>(BB.getTerminator()))
+            {
+                if (br->isConditional() || (br->getSuccessor(0) == &BB) || (br->getSuccessor(0)->getSinglePredecessor() != &BB))
+                {
+                    break;
+                }
+                auto next = br->getSuccessor(0);
+                // Split() puts every call at the front of its own fragment, so an original block never starts with a call
+                auto callFragment = llvm::dyn_cast<llvm::CallBase>(&next->front());
+                if (callFragment && llvm::isa<llvm::DbgInfoIntrinsic>(callFragment))
+                {
+                    callFragment = nullptr;
+                }
+                // the fragment after a call is the only successor of the call's fragment, and the call has not been given its ID yet
+                auto call = llvm::dyn_cast_or_null<llvm::CallInst>(br->getPrevNode());
+                bool postFragment = call && (GetCallBlockIDs(call).first >= 0) && (GetCallBlockIDs(call).second < 0);
+                if (postFragment)
+                {
+                    SetCallBlockIDs(call, GetCallBlockIDs(call).first, Cyclebite::Util::GetBlockID(next));
+                }
+                else if (callFragment)
+                {
+                    SetCallBlockIDs(callFragment, Cyclebite::Util::GetBlockID(next), -1);
+                }
+                else
+                {
+                    break;
+                }
+                if (!llvm::MergeBlockIntoPredecessor(next))
+                {
+                    throw CyclebiteException("Could not merge a call fragment back into its block!");
+                }
+                merged = true;
+            }
+            if (merged)
+            {
+                // the merged fragments brought their own block IDs with them
+                for (auto &inst : BB)
+                {
+                    inst.setMetadata("BlockID", nullptr);
+                }
+                Cyclebite::Util::SetBlockID(&BB, blockID);
+            }
+        }
+    }
+}
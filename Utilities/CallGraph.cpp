@@ -28,7 +28,8 @@ cl::opt<std::string> OutputFilename("o", cl::desc("Specify output json"), cl::va
 int main(int argc, char **argv)
 {
     cl::ParseCommandLineOptions(argc, argv);
-    Cyclebite::Graph::ReadBlockInfo(BlockInfo);
+    Cyclebite::Graph::ProfileContext context;
+    Cyclebite::Graph::ReadBlockInfo(context, BlockInfo);
     auto SourceBitcode = ReadBitcode(InputFilename);
     if (SourceBitcode == nullptr)
     {
@@ -44,7 +45,7 @@ int main(int argc, char **argv)
     Cyclebite::Graph::InitializeIDMaps(SourceBitcode.get());
 
     // Call graph, doesn't include function pointers
-    auto CG = getCallGraph(SourceBitcode.get(), Cyclebite::Graph::blockCallers, BlockToFPtr, Cyclebite::Graph::IDToBlock);
+    auto CG = getCallGraph(SourceBitcode.get(), context.blockCallers, BlockToFPtr, Cyclebite::Graph::IDToBlock);
 
     nlohmann::json outputJson;
     for (const auto &node : CG)
@@ -31,7 +31,8 @@ int main(int argc, char *argv[])
 {
     cl::ParseCommandLineOptions(argc, argv);
     // load dynamic source code information
-    Cyclebite::Graph::ReadBlockInfo(BlockInfoFilename);
+    ProfileContext profileContext;
+    Cyclebite::Graph::ReadBlockInfo(profileContext, BlockInfoFilename);
     // load bitcode
     LLVMContext context;
     SMDiagnostic smerror;
@@ -44,15 +45,21 @@ int main(int argc, char *argv[])
     // construct program control graph and call graph
     ControlGraph cg;
     Cyclebite::Graph::CallGraph dynamicCG;
-    getDynamicInformation(cg, dynamicCG, ProfileFileName, SourceBitcode, staticCG, blockCallers, threadStarts, Cyclebite::Graph::IDToBlock, false );
+    getDynamicInformation(profileContext, cg, dynamicCG, ProfileFileName, SourceBitcode, staticCG, Cyclebite::Graph::IDToBlock );
+    // the block to node mapping below needs one node per block
+    if (profileContext.markovOrder > 1)
+    {
+        spdlog::critical("The input profile must have markov order 1!");
+        return EXIT_FAILURE;
+    }
 
     // construct block ID to node ID mapping
     map<int64_t, shared_ptr<ControlNode>> blockToNode;
-    for (const auto &it : NIDMap)
+    for (uint64_t block = 0; block < profileContext.NIDMap.size(); block++)
     {
-        for (const auto &block : it.first)
+        if (profileContext.NIDMap[block] != UNMAPPED_NID)
         {
-            blockToNode[block] = cg.getNode(it.second);
+            blockToNode[(int64_t)block] = cg.getNode(profileContext.NIDMap[block]);
         }
     }
     // loop information
@@ -25,14 +25,11 @@ cl::opt<string> BitcodeFileName("b", cl::desc("Specify bitcode file"), cl::value
 cl::opt<string> BlockInfoFilename("bi", cl::desc("Specify BlockInfo.json file"), cl::value_desc(".json filename"), cl::Required);
 cl::opt<string> DotFile("o", cl::desc("Specify output dotfile name"), cl::value_desc("dot file"));
 
-extern uint32_t markovOrder;
-// maps a block ID list (that represents the markov chain state, which could have arbitrary order number) to an ID for that node
-//map<vector<uint32_t>, uint64_t> NIDMap;
-
 int main(int argc, char *argv[])
 {
     cl::ParseCommandLineOptions(argc, argv);
-    Cyclebite::Graph::ReadBlockInfo(BlockInfoFilename);
+    ProfileContext context;
+    Cyclebite::Graph::ReadBlockInfo(context, BlockInfoFilename);
     auto SourceBitcode = ReadBitcode(BitcodeFileName);
     if (SourceBitcode == nullptr)
     {
@@ -50,11 +47,7 @@ int main(int argc, char *argv[])
 
     try
     {
-        auto err = BuildCFG(graph, InputFilename, false);
-        if (err)
-        {
-            throw CyclebiteException("Failed to read input profile file!");
-        }
+        BuildCFG(context, graph, InputFilename);
         if (graph.empty())
         {
             throw CyclebiteException("No nodes could be read from the input profile!");
@@ -80,9 +73,9 @@ int main(int argc, char *argv[])
     }
 
     // Construct bitcode CallGraph
-    auto CG = getDynamicCallGraph(SourceBitcode.get(), graph, blockCallers, IDToBlock);
+    auto CG = getDynamicCallGraph(context, SourceBitcode.get(), graph, IDToBlock);
 
-    /*auto transformedGraph = Cyclebite::Graph::ReduceMO(graph.nodes, (int)markovOrder, 1);
+    /*auto transformedGraph = Cyclebite::Graph::ReduceMO(graph.nodes, (int)context.markovOrder, 1);
     try
     {
         TrivialTransforms(transformedGraph);
@@ -93,15 +86,15 @@ int main(int argc, char *argv[])
         spdlog::error(e.what());
     }*/
     // transform graph in an iterative manner until the size of the graph doesn't change
-    ApplyCFGTransforms(graph, CG);
+    ApplyCFGTransforms(context, graph, CG);
 
     auto staticNodes = GenerateStaticCFG(SourceBitcode.get());
 #ifdef DEBUG
     ofstream debugStream("StaticControlGraph.dot");
-    auto staticGraph = GenerateDot(graph);
+    auto staticGraph = GenerateDot(graph, false, context.markovOrder);
     debugStream << staticGraph << "\n";
     debugStream.close();
 #endif
-    GenerateDynamicCoverage(graph.getControlNodes(), staticNodes.getControlNodes());
+    GenerateDynamicCoverage(graph.getControlNodes(), staticNodes.getControlNodes(), context.markovOrder);
     return 0;
 }
\ No newline at end of file
@@ -2,20 +2,19 @@
 // Copyright 2023 Benjamin Willis
 // SPDX-License-Identifier: Apache-2.0
 //==------------------------------==//
-#include "Util/Format.h"
+#include "Util/IO.h"
 #include <fstream>
+#include <iomanip>
 #include <iostream>
-// new pass manager
+#include <llvm/Analysis/AssumptionCache.h>
 #include <llvm/Analysis/LoopInfo.h>
-#include <llvm/IR/PassManager.h>
-#include <llvm/Passes/PassBuilder.h>
-// legacy pass manager
-#include <llvm/Analysis/LoopPass.h>
-#include <llvm/IR/LegacyPassManager.h>
-
-#include <llvm/IRReader/IRReader.h>
+#include <llvm/Analysis/ScalarEvolution.h>
+#include <llvm/Analysis/ScalarEvolutionExpressions.h>
+#include <llvm/Analysis/TargetLibraryInfo.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/Instructions.h>
 #include <llvm/Support/CommandLine.h>
-#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/raw_ostream.h>
 #include <nlohmann/json.hpp>
 #include <string>
 
@@ -26,6 +25,131 @@ cl::opt<string> JsonFile("k", cl::desc("Specify input kernel json filename"), cl
 cl::opt<string> InputFile("b", cl::desc("Specify input bitcode filename"), cl::value_desc("bitcode filename"));
 cl::opt<string> OutputFile("o", cl::desc("Specify output json filename"), cl::value_desc("json filename"));
 
+/// Constants are written as numbers, everything else as ScalarEvolution prints it
+nlohmann::json DescribeSCEV(const SCEV *expr)
+{
+    if (auto con = dyn_cast<SCEVConstant>(expr))
+    {
+        if (con->getAPInt().isSignedIntN(64))
+        {
+            return con->getAPInt().getSExtValue();
+        }
+    }
+    string text;
+    raw_string_ostream os(text);
+    expr->print(os);
+    return os.str();
+}
+
+/// @brief Affine recurrence {start,+,step} of value in loop, null if value isn't one or its step isn't a constant
+nlohmann::json DescribeRecurrence(const Value *value, const Loop *loop, ScalarEvolution &SE)
+{
+    if (!SE.isSCEVable(value->getType()))
+    {
+        return nullptr;
+    }
+    auto rec = dyn_cast<SCEVAddRecExpr>(SE.getSCEV(const_cast<Value *>(value)));
+    if (!rec || (rec->getLoop() != loop) || !rec->isAffine())
+    {
+        return nullptr;
+    }
+    auto step = dyn_cast<SCEVConstant>(rec->getStepRecurrence(SE));
+    if (!step)
+    {
+        return nullptr;
+    }
+    nlohmann::json recurrence;
+    recurrence["Value"] = Cyclebite::Util::GetValueID(value);
+    recurrence["Start"] = DescribeSCEV(rec->getStart());
+    recurrence["Step"] = step->getAPInt().getSExtValue();
+    return recurrence;
+}
+
+/// @brief Value of the header phi phi when control leaves loop, null if ScalarEvolution can't compute it
+///
+/// This is the first value the body doesn't run with, the bound of the usual `i < N` test
+/// When the loop leaves from its latch the body ran with the phi up to the backedge-taken count and the exit sees the value after the step, when it leaves from its header the exit test sees the phi at the backedge-taken count
+/// Loops with more than one exiting block, or that exit from the middle of the body, have no single exit value
+nlohmann::json DescribeExitValue(const PHINode *phi, const Loop *loop, ScalarEvolution &SE)
+{
+    auto exiting = loop->getExitingBlock();
+    if (!exiting || ((exiting != loop->getLoopLatch()) && (exiting != loop->getHeader())))
+    {
+        return nullptr;
+    }
+    auto taken = SE.getExitCount(loop, exiting);
+    if (isa<SCEVCouldNotCompute>(taken))
+    {
+        return nullptr;
+    }
+    auto rec = cast<SCEVAddRecExpr>(SE.getSCEV(const_cast<PHINode *>(phi)));
+    auto exit = exiting == loop->getLoopLatch() ? rec->getPostIncExpr(SE)->evaluateAtIteration(taken, SE) : rec->evaluateAtIteration(taken, SE);
+    return DescribeSCEV(SE.getSCEVAtScope(exit, loop->getParentLoop()));
+}
+
+/// @brief Static summary of one loop, keyed by the block and value IDs of Annotate
+///
+/// Trip counts are 0 when ScalarEvolution can't bound them, the backedge-taken count is left out when it can't be computed
+/// Induction variables are the header phis that are affine in the loop (with the value they leave the loop at when it is known), accesses are the loads and stores of the loop (not its subloops) whose address is affine in it (step in bytes)
+nlohmann::json SummarizeLoop(Loop *loop, LoopInfo &LI, ScalarEvolution &SE)
+{
+    nlohmann::json summary;
+    summary["Header"] = Cyclebite::Util::GetBlockID(loop->getHeader());
+    summary["Latch"] = loop->getLoopLatch() ? Cyclebite::Util::GetBlockID(loop->getLoopLatch()) : -1;
+    summary["Parent"] = loop->getParentLoop() ? Cyclebite::Util::GetBlockID(loop->getParentLoop()->getHeader()) : -1;
+    summary["Depth"] = loop->getLoopDepth();
+    vector<int64_t> blocks;
+    for (auto b : loop->blocks())
+    {
+        blocks.push_back(Cyclebite::Util::GetBlockID(b));
+    }
+    summary["Blocks"] = blocks;
+    summary["TripCount"] = SE.getSmallConstantTripCount(loop);
+    summary["MaxTripCount"] = SE.getSmallConstantMaxTripCount(loop);
+    auto backedges = SE.getBackedgeTakenCount(loop);
+    if (!isa<SCEVCouldNotCompute>(backedges))
+    {
+        summary["BackedgeTakenCount"] = DescribeSCEV(backedges);
+    }
+    summary["InductionVariables"] = nlohmann::json::array();
+    for (auto &phi : loop->getHeader()->phis())
+    {
+        auto iv = DescribeRecurrence(&phi, loop, SE);
+        if (!iv.is_null())
+        {
+            auto exitValue = DescribeExitValue(&phi, loop, SE);
+            if (!exitValue.is_null())
+            {
+                iv["ExitValue"] = exitValue;
+            }
+            summary["InductionVariables"].push_back(iv);
+        }
+    }
+    summary["Accesses"] = nlohmann::json::array();
+    for (auto b : loop->blocks())
+    {
+        if (LI.getLoopFor(b) != loop)
+        {
+            continue;
+        }
+        for (auto &inst : *b)
+        {
+            if (!isa<LoadInst, StoreInst>(inst))
+            {
+                continue;
+            }
+            auto access = DescribeRecurrence(getLoadStorePointerOperand(&inst), loop, SE);
+            if (!access.is_null())
+            {
+                // the recurrence belongs to the pointer, the summary is keyed by the load or store
+                access["Value"] = Cyclebite::Util::GetValueID(&inst);
+                summary["Accesses"].push_back(access);
+            }
+        }
+    }
+    return summary;
+}
+
 int main(int argc, char *argv[])
 {
     cl::ParseCommandLineOptions(argc, argv);
@@ -43,60 +167,33 @@ int main(int argc, char *argv[])
         kernels[index] = kernel.get<vector<int64_t>>();
     }*/
 
-    //load the llvm file
-    LLVMContext context;
-    SMDiagnostic smerror;
-    auto sourceBitcode = parseIRFile(InputFile, smerror, context);
-    Cyclebite::Util::Format(*sourceBitcode);
-
-    // run loop analysis pass
-    /* this stuff uses the new pass manager and segfaults when main returns
-    PassBuilder PB;
-    ModuleAnalysisManager MAM;
-    FunctionAnalysisManager FAM;
-    LoopAnalysisManager LAM;
-    CGSCCAnalysisManager CGAM;
-    FAM.registerPass([&] { return PB.buildDefaultAAPipeline(); });
-
-    PB.registerModuleAnalyses(MAM);
-    PB.registerLoopAnalyses(LAM);
-    PB.registerFunctionAnalyses(FAM);
-    PB.registerCGSCCAnalyses(CGAM);
-    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
-
-    ModulePassManager MPM = PB.buildPerModuleDefaultPipeline(PassBuilder::OptimizationLevel::O0);
-    MPM.run(*sourceBitcode, MAM);
-    */
-
-    /*
-    llvm::legacy::FunctionPassManager FPM(sourceBitcode.get());
-    FPM.add(llvm::createConstantPropagationPass());
-    FPM.add(llvm::createIndVarSimplifyPass());
-    FPM.add(llvm::createDeadCodeEliminationPass());
-    FPM.add(llvm::createLoopSimplifyPass());
-    FPM.doInitialization();
-    for( auto f = sourceBitcode->begin(); f != sourceBitcode->end(); f++ )
+    // IDs have to match the ones the grammar sees, so the bitcode is read the same way
+    auto sourceBitcode = ReadBitcode(InputFile, false);
+    if (!sourceBitcode)
     {
-        FPM.run(*f);
+        return EXIT_FAILURE;
     }
-    FPM.doFinalization();
-    */
-
-    // this is the legacy pass manager
-    LPPassManager LPM;
-
-    llvm::legacy::PassManager PM;
-    PM.add(LPM.getAsPass());
-    PM.run(*sourceBitcode);
-
+    TargetLibraryInfoImpl TLII(Triple(sourceBitcode->getTargetTriple()));
+    TargetLibraryInfo TLI(TLII);
+    nlohmann::json summary;
+    summary["Loops"] = nlohmann::json::array();
     for (auto &f : *sourceBitcode)
     {
-        cout << string(f.getName()) << endl;
+        if (f.isDeclaration())
+        {
+            continue;
+        }
+        DominatorTree DT(f);
+        LoopInfo LI(DT);
+        AssumptionCache AC(f);
+        ScalarEvolution SE(f, TLI, AC, DT, LI);
+        for (auto loop : LI.getLoopsInPreorder())
+        {
+            summary["Loops"].push_back(SummarizeLoop(loop, LI, SE));
+        }
     }
-
-    //nlohmann::json finalJson = kernelParents;
-    //ofstream oStream(OutputFile);
-    //oStream << finalJson;
-    //oStream.close();
+    ofstream oStream(OutputFile);
+    oStream << setw(4) << summary;
+    oStream.close();
     return 0;
-}
\ No newline at end of file
+}
@@ -44,13 +44,10 @@ int main(int argc, char *argv[])
     //auto CG = getCallGraph(SourceBitcode.get(), blockCallers, BlockToFPtr, IDToBlock);
     // get the input profile
     Graph graph;
+    ProfileContext profileContext;
     try
     {
-        auto err = BuildCFG(graph, ProfileFileName, false);
-        if (err)
-        {
-            throw CyclebiteException("Failed to read input profile file!");
-        }
+        BuildCFG(profileContext, graph, ProfileFileName);
         if (graph.empty())
         {
             throw CyclebiteException("No nodes could be read from the input profile!");
@@ -62,7 +59,7 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
     // print the dot file of the graph
-    auto dot = GenerateDot(graph);
+    auto dot = GenerateDot(graph, false, profileContext.markovOrder);
     auto dotfile = ofstream(DotFileName);
     dotfile << setw(2) << dot;
     dotfile.close();
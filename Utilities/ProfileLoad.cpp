@@ -0,0 +1,78 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "Util/Exceptions.h"
+#include "Util/IO.h"
+#include "Graph.h"
+#include "IO.h"
+#include "MarkovProfile.h"
+#include <llvm/Support/CommandLine.h>
+#include <string>
+
+using namespace std;
+using namespace llvm;
+using namespace Cyclebite::Graph;
+
+cl::opt<string> ProfileFileName("i", cl::desc("Specify input profile filename"), cl::value_desc(".bin filename"), cl::Required);
+cl::opt<uint32_t> Iterations("n", cl::desc("Number of times to load the profile"), cl::value_desc("iterations"), cl::init(5));
+
+// This program benchmarks reading an input profile
+// It reports the time it takes to map and scan the raw edge array separately from the time it takes BuildCFG() to construct the graph
+int main(int argc, char *argv[])
+{
+    cl::ParseCommandLineOptions(argc, argv);
+    struct timespec start, end;
+    double scanTime = 0.0;
+    double buildTime = 0.0;
+    uint64_t nodes = 0;
+    uint64_t edges = 0;
+    try
+    {
+        for (uint32_t i = 0; i < Iterations; i++)
+        {
+            while (clock_gettime(CLOCK_MONOTONIC, &start))
+            {
+            }
+            // touch every edge so the page faults of the mapping are included in the measurement
+            MarkovProfile profile(ProfileFileName);
+            uint64_t totalFrequency = 0;
+            for (const auto &edge : profile)
+            {
+                totalFrequency += edge.frequency;
+            }
+            while (clock_gettime(CLOCK_MONOTONIC, &end))
+            {
+            }
+            scanTime += CalculateTime(&start, &end);
+            if (i == 0)
+            {
+                spdlog::info("PROFILEBLOCKS: " + to_string(profile.getBlockCount()));
+                spdlog::info("PROFILETOTALFREQUENCY: " + to_string(totalFrequency));
+            }
+
+            while (clock_gettime(CLOCK_MONOTONIC, &start))
+            {
+            }
+            Graph graph;
+            ProfileContext context;
+            BuildCFG(context, graph, ProfileFileName);
+            while (clock_gettime(CLOCK_MONOTONIC, &end))
+            {
+            }
+            buildTime += CalculateTime(&start, &end);
+            nodes = graph.node_count();
+            edges = graph.edge_count();
+        }
+    }
+    catch (CyclebiteException &e)
+    {
+        spdlog::critical(e.what());
+        return EXIT_FAILURE;
+    }
+    spdlog::info("PROFILENODES: " + to_string(nodes));
+    spdlog::info("PROFILEEDGES: " + to_string(edges));
+    spdlog::info("PROFILESCANTIME: " + to_string(scanTime / Iterations) + "s");
+    spdlog::info("PROFILEBUILDCFGTIME: " + to_string(buildTime / Iterations) + "s");
+    return 0;
+}
@@ -0,0 +1,396 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "Util/Exceptions.h"
+#include "MarkovProfile.h"
+#include "ProfileContainer.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <llvm/Support/CommandLine.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <queue>
+#include <set>
+#include <span>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+using namespace llvm;
+using namespace Cyclebite::Graph;
+using json = nlohmann::json;
+
+cl::list<string> ProfileFileNames("i", cl::desc("Specify input profiles (markov.bin files or profile containers)"), cl::value_desc(".bin filename"), cl::OneOrMore);
+cl::list<string> BlockInfoFilenames("bi", cl::desc("Specify the BlockInfo.json file of each input profile, in the same order as the profiles. Profile containers carry their own, so their entries are not read"), cl::value_desc(".json filename"));
+cl::list<double> Weights("w", cl::desc("Specify a weight for each input profile, in the same order as the profiles. Defaults to 1 for every profile"), cl::value_desc("weight"));
+cl::opt<string> OutputFilename("o", cl::desc("Specify output profile"), cl::value_desc(".bin filename"), cl::Required);
+cl::opt<string> BlockInfoOutput("ob", cl::desc("Specify output BlockInfo.json file"), cl::value_desc(".json filename"), cl::init("BlockInfo.json"));
+cl::opt<uint32_t> Threads("j", cl::desc("Number of profiles to sort concurrently"), cl::value_desc("threads"), cl::init(0));
+
+/// Number of words in the profile header: markov order, block count, edge count
+constexpr size_t PROFILE_HEADER_WORDS = 3;
+
+/// Header of a sorted run, kept for the merge phase
+struct RunInfo
+{
+    string path;
+    uint32_t markovOrder;
+    uint32_t blockCount;
+};
+
+/// Writes a profile header followed by edgeCount edges to f
+void writeProfile(ofstream &f, uint32_t markovOrder, uint32_t blockCount, uint32_t edgeCount, const ProfileEdge *edges)
+{
+    uint32_t header[PROFILE_HEADER_WORDS] = {markovOrder, blockCount, edgeCount};
+    f.write((const char *)header, sizeof(header));
+    f.write((const char *)edges, (streamsize)((size_t)edgeCount * sizeof(ProfileEdge)));
+}
+
+/// @brief Sorts the edges of one input profile by (source, sink) and spills them to a run file in markov.bin format
+///
+/// Only the edges of the profiles currently being sorted are in memory, the merge phase reads the runs back through read-only mappings
+RunInfo sortProfile(const string &input, const string &runPath)
+{
+    unique_ptr<ProfileContainer> container;
+    unique_ptr<MarkovProfile> profile;
+    if (ProfileContainer::isContainer(input))
+    {
+        container = make_unique<ProfileContainer>(input);
+        auto edges = container->getSection(__TA_SECTION_EDGES);
+        if (edges.empty())
+        {
+            throw CyclebiteException("Profile container " + input + " does not have an edge section!");
+        }
+        profile = make_unique<MarkovProfile>(edges.data(), edges.size());
+    }
+    else
+    {
+        profile = make_unique<MarkovProfile>(input);
+    }
+    vector<ProfileEdge> edges(profile->begin(), profile->end());
+    std::sort(edges.begin(), edges.end(), [](const ProfileEdge &lhs, const ProfileEdge &rhs) {
+        return (lhs.src < rhs.src) || ((lhs.src == rhs.src) && (lhs.snk < rhs.snk));
+    });
+    ofstream run(runPath, ios::binary);
+    writeProfile(run, profile->getMarkovOrder(), profile->getBlockCount(), (uint32_t)edges.size(), edges.data());
+    if (!run.good())
+    {
+        throw CyclebiteException("Could not write sorted run " + runPath);
+    }
+    return RunInfo{runPath, profile->getMarkovOrder(), profile->getBlockCount()};
+}
+
+/// @brief Merges the sorted runs into one profile, summing the (weighted) frequencies of equal edges
+///
+/// Edges are written as they come off the heap, so the output never lives in memory. The edge count in the header is patched at the end
+uint32_t mergeRuns(const vector<RunInfo> &runs, const vector<double> &weights, const string &output)
+{
+    vector<unique_ptr<MarkovProfile>> profiles;
+    uint32_t blockCount = 0;
+    for (const auto &run : runs)
+    {
+        profiles.push_back(make_unique<MarkovProfile>(run.path));
+        blockCount = max(blockCount, run.blockCount);
+    }
+    // (source, sink, run) of the next unmerged edge of each run
+    using Cursor = tuple<uint32_t, uint32_t, size_t>;
+    priority_queue<Cursor, vector<Cursor>, greater<Cursor>> heap;
+    vector<uint32_t> positions(runs.size(), 0);
+    for (size_t i = 0; i < profiles.size(); i++)
+    {
+        if (profiles[i]->getEdgeCount())
+        {
+            const auto &edge = (*profiles[i])[0];
+            heap.push(Cursor(edge.src, edge.snk, i));
+        }
+    }
+    ofstream out(output, ios::binary);
+    writeProfile(out, runs.front().markovOrder, blockCount, 0, nullptr);
+    uint32_t edgeCount = 0;
+    while (!heap.empty())
+    {
+        auto src = get<0>(heap.top());
+        auto snk = get<1>(heap.top());
+        // runs with weight 1 are summed exactly, every other run goes through floating point
+        uint64_t exact = 0;
+        double weighted = 0.0;
+        while (!heap.empty() && (get<0>(heap.top()) == src) && (get<1>(heap.top()) == snk))
+        {
+            auto run = get<2>(heap.top());
+            heap.pop();
+            auto frequency = (*profiles[run])[positions[run]].frequency;
+            if (weights[run] == 1.0)
+            {
+                exact += frequency;
+            }
+            else
+            {
+                weighted += weights[run] * (double)frequency;
+            }
+            if (++positions[run] < profiles[run]->getEdgeCount())
+            {
+                const auto &next = (*profiles[run])[positions[run]];
+                heap.push(Cursor(next.src, next.snk, run));
+            }
+        }
+        ProfileEdge merged;
+        merged.src = src;
+        merged.snk = snk;
+        merged.frequency = exact + (uint64_t)llround(weighted);
+        // an edge that was weighted down to nothing is dropped
+        if (merged.frequency)
+        {
+            out.write((const char *)&merged, sizeof(merged));
+            edgeCount++;
+        }
+    }
+    out.seekp(2 * sizeof(uint32_t));
+    out.write((const char *)&edgeCount, sizeof(edgeCount));
+    if (!out.good())
+    {
+        throw CyclebiteException("Could not write merged profile " + output);
+    }
+    return edgeCount;
+}
+
+/// @brief Sums the block information of the runs: label frequencies with the run weights, block callers and thread launchers/entrances as unions
+class BlockInfoMerge
+{
+public:
+    /// Adds a BlockInfo.json file
+    void addFile(const string &file, double weight)
+    {
+        json j;
+        ifstream f(file);
+        if (!f.is_open())
+        {
+            throw CyclebiteException("Could not open BlockInfo file " + file);
+        }
+        f >> j;
+        for (const auto &entry : j.items())
+        {
+            if (entry.key() == "ThreadLaunchers")
+            {
+                auto ids = entry.value().get<vector<int64_t>>();
+                launchers.insert(ids.begin(), ids.end());
+                continue;
+            }
+            else if (entry.key() == "ThreadEntrances")
+            {
+                auto ids = entry.value().get<vector<int64_t>>();
+                entrances.insert(ids.begin(), ids.end());
+                continue;
+            }
+            if (entry.value().contains("Labels"))
+            {
+                for (const auto &label : entry.value()["Labels"].items())
+                {
+                    labels[entry.key()][label.key()] += weight * label.value().get<double>();
+                }
+            }
+            if (entry.value().contains("BlockCallers"))
+            {
+                auto callees = entry.value()["BlockCallers"].get<vector<int64_t>>();
+                callers[entry.key()].insert(callees.begin(), callees.end());
+            }
+        }
+    }
+    /// @brief Adds the LABELS, CALLERS, THREAD_LAUNCHERS and THREAD_ENTRANCES sections of a profile container (see ProfileFormat.h)
+    /// @throws CyclebiteException when a section is corrupt
+    void addContainer(const ProfileContainer &container, const string &file, double weight)
+    {
+        auto labelSection = container.getSection(__TA_SECTION_LABELS);
+        uint64_t offset = 0;
+        while (offset < labelSection.size())
+        {
+            if (offset + 2 * sizeof(uint32_t) + sizeof(uint64_t) > labelSection.size())
+            {
+                throw CyclebiteException("Label section of profile container " + file + " is truncated!");
+            }
+            auto block = readPacked<uint32_t>(labelSection, offset);
+            auto length = readPacked<uint32_t>(labelSection, offset + sizeof(uint32_t));
+            auto frequency = readPacked<uint64_t>(labelSection, offset + 2 * sizeof(uint32_t));
+            offset += 2 * sizeof(uint32_t) + sizeof(uint64_t);
+            if (offset + length > labelSection.size())
+            {
+                throw CyclebiteException("Label section of profile container " + file + " is truncated!");
+            }
+            labels[to_string(block)][string((const char *)labelSection.data() + offset, length)] += weight * (double)frequency;
+            offset += length;
+        }
+        auto callerSection = container.getSection(__TA_SECTION_CALLERS);
+        constexpr uint64_t callerRecord = 3 * sizeof(uint32_t);
+        if (callerSection.size() % callerRecord)
+        {
+            throw CyclebiteException("Caller section of profile container " + file + " is truncated!");
+        }
+        for (offset = 0; offset < callerSection.size(); offset += callerRecord)
+        {
+            // the position of the call within its original block is dropped, just like in BlockInfo.json
+            callers[to_string(readPacked<uint32_t>(callerSection, offset))].insert(readPacked<uint32_t>(callerSection, offset + sizeof(uint32_t)));
+        }
+        addIDs(launchers, container.getSection(__TA_SECTION_THREAD_LAUNCHERS));
+        addIDs(entrances, container.getSection(__TA_SECTION_THREAD_ENTRANCES));
+    }
+    /// Returns the merged information in the layout of BlockInfo.json
+    json toJson() const
+    {
+        json merged;
+        for (const auto &block : labels)
+        {
+            for (const auto &label : block.second)
+            {
+                merged[block.first]["Labels"][label.first] = (uint64_t)llround(label.second);
+            }
+        }
+        for (const auto &caller : callers)
+        {
+            merged[caller.first]["BlockCallers"] = vector<int64_t>(caller.second.begin(), caller.second.end());
+        }
+        if (!launchers.empty())
+        {
+            merged["ThreadLaunchers"] = launchers;
+        }
+        if (!entrances.empty())
+        {
+            merged["ThreadEntrances"] = entrances;
+        }
+        return merged;
+    }
+
+private:
+    map<string, map<string, double>> labels;
+    map<string, set<int64_t>> callers;
+    set<int64_t> launchers;
+    set<int64_t> entrances;
+    /// Reads a packed array of T out of a container section, unaligned
+    template <typename T>
+    static T readPacked(span<const uint8_t> section, uint64_t offset)
+    {
+        T val;
+        memcpy(&val, section.data() + offset, sizeof(T));
+        return val;
+    }
+    static void addIDs(set<int64_t> &ids, span<const uint8_t> section)
+    {
+        for (uint64_t offset = 0; offset + sizeof(uint32_t) <= section.size(); offset += sizeof(uint32_t))
+        {
+            ids.insert(readPacked<uint32_t>(section, offset));
+        }
+    }
+};
+
+/// @brief Unions the block information of all runs
+///
+/// A profile container carries its own block information, every other profile takes it from its BlockInfo.json file (same position in files as in inputs)
+json mergeBlockInfo(const vector<string> &inputs, const vector<string> &files, const vector<double> &weights)
+{
+    BlockInfoMerge merge;
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        if (ProfileContainer::isContainer(inputs[i]))
+        {
+            merge.addContainer(ProfileContainer(inputs[i]), inputs[i], weights[i]);
+        }
+        else if (!files.empty())
+        {
+            merge.addFile(files[i], weights[i]);
+        }
+    }
+    return merge.toJson();
+}
+
+// This program merges the profiles of many runs of the same binary into one aggregate profile
+// Each input is sorted by edge and spilled to a temporary run concurrently, then all runs are k-way merged straight to the output file
+int main(int argc, char *argv[])
+{
+    cl::ParseCommandLineOptions(argc, argv);
+    vector<string> inputs(ProfileFileNames.begin(), ProfileFileNames.end());
+    vector<double> weights(Weights.begin(), Weights.end());
+    if (weights.empty())
+    {
+        weights.assign(inputs.size(), 1.0);
+    }
+    if (weights.size() != inputs.size())
+    {
+        spdlog::critical("Got " + to_string(weights.size()) + " weights for " + to_string(inputs.size()) + " profiles");
+        return EXIT_FAILURE;
+    }
+    if (!BlockInfoFilenames.empty() && (BlockInfoFilenames.size() != inputs.size()))
+    {
+        spdlog::critical("Got " + to_string(BlockInfoFilenames.size()) + " BlockInfo files for " + to_string(inputs.size()) + " profiles");
+        return EXIT_FAILURE;
+    }
+    auto tmpDir = filesystem::temp_directory_path() / ("cyclebite-merge-" + to_string(getpid()));
+    try
+    {
+        filesystem::create_directories(tmpDir);
+        vector<RunInfo> runs(inputs.size());
+        atomic<size_t> next = 0;
+        mutex errorLock;
+        string error;
+        auto worker = [&]() {
+            for (size_t i = next++; i < inputs.size(); i = next++)
+            {
+                try
+                {
+                    runs[i] = sortProfile(inputs[i], (tmpDir / (to_string(i) + ".bin")).string());
+                }
+                catch (std::exception &e)
+                {
+                    lock_guard<mutex> guard(errorLock);
+                    error = e.what();
+                }
+            }
+        };
+        uint32_t threadCount = Threads ? Threads : max(1u, thread::hardware_concurrency());
+        vector<thread> pool;
+        for (uint32_t i = 0; i < min<size_t>(threadCount, inputs.size()); i++)
+        {
+            pool.push_back(thread(worker));
+        }
+        for (auto &t : pool)
+        {
+            t.join();
+        }
+        if (!error.empty())
+        {
+            throw CyclebiteException(error);
+        }
+        for (const auto &run : runs)
+        {
+            if (run.markovOrder != runs.front().markovOrder)
+            {
+                throw CyclebiteException("Cannot merge profiles of different markov orders!");
+            }
+        }
+        auto edgeCount = mergeRuns(runs, weights, OutputFilename);
+        spdlog::info("Merged " + to_string(inputs.size()) + " profiles into " + to_string(edgeCount) + " edges");
+        bool containers = any_of(inputs.begin(), inputs.end(), [](const string &input) { return ProfileContainer::isContainer(input); });
+        if (!BlockInfoFilenames.empty() || containers)
+        {
+            auto blockInfo = mergeBlockInfo(inputs, vector<string>(BlockInfoFilenames.begin(), BlockInfoFilenames.end()), weights);
+            ofstream f(BlockInfoOutput);
+            f << setw(4) << blockInfo;
+        }
+    }
+    catch (std::exception &e)
+    {
+        spdlog::critical(e.what());
+        filesystem::remove_all(tmpDir);
+        return EXIT_FAILURE;
+    }
+    filesystem::remove_all(tmpDir);
+    return EXIT_SUCCESS;
+}
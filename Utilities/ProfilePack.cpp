@@ -0,0 +1,123 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "Util/Exceptions.h"
+#include "ProfileFormat.h"
+#include <fstream>
+#include <iterator>
+#include <llvm/Support/CommandLine.h>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace llvm;
+using json = nlohmann::json;
+
+cl::opt<string> ProfileFileName("i", cl::desc("Specify input profile"), cl::value_desc(".bin filename"), cl::Required);
+cl::opt<string> BlockInfoFilename("bi", cl::desc("Specify BlockInfo.json file"), cl::value_desc(".json filename"), cl::Required);
+cl::opt<string> LoopFileName("l", cl::desc("Specify Loopinfo.json file"), cl::value_desc(".json filename"));
+cl::opt<string> InstanceFileName("m", cl::desc("Specify instance.json file from the memory profiler"), cl::value_desc(".json filename"));
+cl::opt<string> OutputFilename("o", cl::desc("Specify output profile container"), cl::value_desc("container filename"), cl::Required);
+
+vector<uint8_t> readFile(const string &filename)
+{
+    ifstream f(filename, ios::binary);
+    if (!f.is_open())
+    {
+        throw CyclebiteException("Could not open " + filename);
+    }
+    return vector<uint8_t>(istreambuf_iterator<char>(f), istreambuf_iterator<char>());
+}
+
+template <typename T>
+void appendBytes(vector<uint8_t> &buf, const T &val)
+{
+    auto p = reinterpret_cast<const uint8_t *>(&val);
+    buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+// This program packs the separate files of a profile (markov.bin, BlockInfo.json, Loopinfo.json, instance.json) into one profile container
+int main(int argc, char *argv[])
+{
+    cl::ParseCommandLineOptions(argc, argv);
+    try
+    {
+        auto edges = readFile(ProfileFileName);
+        json blockInfo;
+        ifstream blockFile(BlockInfoFilename);
+        blockFile >> blockInfo;
+        vector<uint8_t> labels;
+        vector<uint8_t> callers;
+        vector<uint32_t> launchers;
+        vector<uint32_t> entrances;
+        for (const auto &entry : blockInfo.items())
+        {
+            if (entry.key() == "ThreadLaunchers")
+            {
+                launchers = entry.value().get<vector<uint32_t>>();
+                continue;
+            }
+            else if (entry.key() == "ThreadEntrances")
+            {
+                entrances = entry.value().get<vector<uint32_t>>();
+                continue;
+            }
+            auto block = (uint32_t)stoul(entry.key());
+            if (entry.value().contains("Labels"))
+            {
+                for (const auto &label : entry.value()["Labels"].items())
+                {
+                    appendBytes(labels, block);
+                    appendBytes(labels, (uint32_t)label.key().size());
+                    appendBytes(labels, label.value().get<uint64_t>());
+                    labels.insert(labels.end(), label.key().begin(), label.key().end());
+                }
+            }
+            if (entry.value().contains("BlockCallers"))
+            {
+                for (auto callee : entry.value()["BlockCallers"].get<vector<uint32_t>>())
+                {
+                    appendBytes(callers, block);
+                    appendBytes(callers, callee);
+                    appendBytes(callers, (uint32_t)0);
+                }
+            }
+        }
+        vector<__TA_ProfileSectionData> sections = {
+            {__TA_SECTION_EDGES, __TA_COMPRESSION_NONE, edges.data(), edges.size()},
+            {__TA_SECTION_LABELS, __TA_COMPRESSION_ZLIB, labels.data(), labels.size()},
+            {__TA_SECTION_CALLERS, __TA_COMPRESSION_ZLIB, callers.data(), callers.size()},
+            {__TA_SECTION_THREAD_LAUNCHERS, __TA_COMPRESSION_NONE, launchers.data(), launchers.size() * sizeof(uint32_t)},
+            {__TA_SECTION_THREAD_ENTRANCES, __TA_COMPRESSION_NONE, entrances.data(), entrances.size() * sizeof(uint32_t)}};
+        vector<uint8_t> loops;
+        if (!LoopFileName.empty())
+        {
+            loops = readFile(LoopFileName);
+            sections.push_back({__TA_SECTION_LOOPS, __TA_COMPRESSION_ZLIB, loops.data(), loops.size()});
+        }
+        vector<uint8_t> instance;
+        if (!InstanceFileName.empty())
+        {
+            instance = readFile(InstanceFileName);
+            sections.push_back({__TA_SECTION_MEMORY_EPOCHS, __TA_COMPRESSION_ZLIB, instance.data(), instance.size()});
+        }
+        if (__TA_WriteProfileContainer(OutputFilename.data(), sections.data(), (uint32_t)sections.size()))
+        {
+            throw CyclebiteException("Failed to write profile container " + OutputFilename);
+        }
+    }
+    catch (CyclebiteException &e)
+    {
+        spdlog::critical(e.what());
+        return EXIT_FAILURE;
+    }
+    catch (std::exception &e)
+    {
+        spdlog::critical(e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
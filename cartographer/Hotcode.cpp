@@ -3,12 +3,13 @@
 // SPDX-License-Identifier: Apache-2.0
 //==------------------------------==//
 #include "Hotcode.h"
-#include "IO.h"
-#include "Transforms.h"
-#include "UnconditionalEdge.h"
+#include "MarkovProfile.h"
+#include "Util/JsonWriter.h"
+#include <algorithm>
 #include <fstream>
-#include <nlohmann/json.hpp>
+#include <numeric>
 #include <spdlog/spdlog.h>
+#include <thread>
 
 using namespace llvm;
 using namespace std;
@@ -18,193 +19,166 @@ using json = nlohmann::json;
 
 constexpr uint64_t THRESHOLD_MAX_COLD = 256;
 constexpr uint64_t THRESHOLD_MIN_HOT = 16;
+/// Profiles with fewer edges than this are reduced on the calling thread
+constexpr uint32_t PARALLEL_EDGES = 1 << 16;
+/// Number of the hottest blocks sorted first, grown until the threshold is met
+constexpr size_t FIRST_TOP_K = 64;
 
-set<std::shared_ptr<MLCycle>, KCompare> Cyclebite::Cartographer::DetectHotCode(const set<std::shared_ptr<ControlNode>, p_GNCompare> &nodes, float hotThreshold)
+/// Disjoint sets of block IDs, used to group hot blocks that are connected by an edge
+class UnionFind
 {
-    set<std::shared_ptr<MLCycle>, KCompare> kernels;
-    // we are just detecting hot code
-    // which will require the frequencies of each block
-    map<int64_t, uint64_t> blockFrequencies;
-    // accumulate block frequencies
-    for (const auto &block : nodes)
+public:
+    UnionFind(uint32_t size) : parent(size)
     {
-        // we sum along the columns (the probabilities of going to the current node), so we use the edge weight coming from each predecessor to this node
-        for (const auto &pred : block->getPredecessors())
+        iota(parent.begin(), parent.end(), 0);
+    }
+    uint32_t find(uint32_t x)
+    {
+        while (parent[x] != x)
         {
-            if( auto ue = dynamic_pointer_cast<UnconditionalEdge>(pred) )
+            // path halving
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+    void join(uint32_t a, uint32_t b)
+    {
+        a = find(a);
+        b = find(b);
+        // the smaller ID stays the root so the grouping doesn't depend on edge order
+        if (a < b)
+        {
+            parent[b] = a;
+        }
+        else if (b < a)
+        {
+            parent[a] = b;
+        }
+    }
+
+private:
+    vector<uint32_t> parent;
+};
+
+/// Sums the frequencies of the edges that enter each block, split across threads that each own a copy of the result
+vector<uint64_t> BlockFrequencies(const MarkovProfile &profile)
+{
+    auto n = profile.getEdgeCount();
+    unsigned T = n < PARALLEL_EDGES ? 1 : max(1u, thread::hardware_concurrency());
+    vector<vector<uint64_t>> partial(T, vector<uint64_t>(profile.getBlockCount(), 0));
+    auto work = [&](unsigned t) {
+        auto lo = (uint32_t)((uint64_t)n * t / T);
+        auto hi = (uint32_t)((uint64_t)n * (t + 1) / T);
+        auto &freq = partial[t];
+        for (uint32_t i = lo; i < hi; i++)
+        {
+            const auto &edge = profile[i];
+            if (edge.snk < freq.size())
             {
-                // retrieve the edge frequency and accumulate it to this node
-                blockFrequencies[(int64_t)ue->getSnk()->NID] += ue->getFreq();
+                freq[edge.snk] += edge.frequency;
             }
         }
+    };
+    vector<thread> workers;
+    for (unsigned t = 1; t < T; t++)
+    {
+        workers.emplace_back(work, t);
     }
-    // Algorithm:
-    // 1. Sort all blocks in descending order until 95% of the total block frequency is accounted for
-    // 2. Partition the hot blocks based on who their successors are. These form "hot regions"
-    auto BFpairs = std::vector<std::pair<int64_t, uint64_t>>();
-    for (const auto &entry : blockFrequencies)
+    work(0);
+    for (auto &w : workers)
     {
-        BFpairs.push_back(pair<int64_t, uint64_t>(entry.first, entry.second));
+        w.join();
+    }
+    for (unsigned t = 1; t < T; t++)
+    {
+        for (size_t b = 0; b < partial[0].size(); b++)
+        {
+            partial[0][b] += partial[t][b];
+        }
     }
-    std::sort(BFpairs.begin(), BFpairs.end(), [](const pair<int64_t, uint64_t> &lhs, const pair<int64_t, uint64_t> &rhs) { return lhs.second > rhs.second; });
+    return std::move(partial[0]);
+}
+
+vector<HotRegion> Cyclebite::Cartographer::DetectHotCode(const MarkovProfile &profile, float hotThreshold)
+{
+    vector<HotRegion> regions;
+    auto frequencies = BlockFrequencies(profile);
+    // Algorithm:
+    // 1. Take blocks in descending order of frequency until hotThreshold of the total block frequency is accounted for
+    // 2. Group the hot blocks that have an edge between them. These form "hot regions"
+    vector<uint32_t> candidates;
     uint64_t totalFrequency = 0;
-    for (const auto &entry : BFpairs)
+    for (uint32_t b = 0; b < frequencies.size(); b++)
     {
-        totalFrequency += entry.second;
+        totalFrequency += frequencies[b];
+        // blocks at or below the minimum can never be hot
+        if (frequencies[b] > THRESHOLD_MIN_HOT)
+        {
+            candidates.push_back(b);
+        }
     }
-    if (BFpairs.empty())
+    if (totalFrequency == 0)
     {
         spdlog::critical("No blocks were found in the input profile!");
-        return kernels;
+        return regions;
     }
+    // ties are broken by block ID so the result doesn't depend on the sort
+    auto hotter = [&](uint32_t lhs, uint32_t rhs) {
+        return frequencies[lhs] != frequencies[rhs] ? frequencies[lhs] > frequencies[rhs] : lhs < rhs;
+    };
     // step one, identify all hot blocks
+    // only the top k candidates are ever sorted, k grows until the threshold is met or every candidate is hot
+    vector<bool> hot(frequencies.size(), false);
     float accountedFor = 0.0;
-    set<int64_t> hotBlocks;
-    auto hbcount = hotBlocks.size();
-    for (const auto &entry : BFpairs)
+    size_t taken = 0;
+    for (size_t k = min(FIRST_TOP_K, candidates.size()); (taken < candidates.size()) && (accountedFor < hotThreshold); k = min(k * 4, candidates.size()))
     {
-        if (entry.second > THRESHOLD_MIN_HOT)
-        {
-            hotBlocks.insert(entry.first);
-            accountedFor += (float)((float)entry.second / (float)totalFrequency);
-        }
-        // John [3/16/22]: hmmm, what about the case where every block has identical frequency... if our frequency counts have a large mode, we may get different results each time, depending on how ties are broken in the sort
-        // one solution: take the entire mode
-        if (accountedFor >= hotThreshold)
+        partial_sort(candidates.begin() + (ptrdiff_t)taken, candidates.begin() + (ptrdiff_t)k, candidates.end(), hotter);
+        for (; (taken < k) && (accountedFor < hotThreshold); taken++)
         {
-            break;
+            hot[candidates[taken]] = true;
+            accountedFor += (float)((float)frequencies[candidates[taken]] / (float)totalFrequency);
         }
-        else if (hbcount == hotBlocks.size())
-        {
-            // we didn't find any new blocks, meaning there aren't any more eligible blocks left
-            break;
-        }
-        hbcount = hotBlocks.size();
     }
     // make sure we got all blocks that are above the max threshold
-    for (const auto &entry : BFpairs)
+    for (const auto &b : candidates)
     {
-        if ((hotBlocks.find(entry.first) == hotBlocks.end()) && (entry.second > THRESHOLD_MAX_COLD))
+        if (frequencies[b] > THRESHOLD_MAX_COLD)
         {
-            hotBlocks.insert(entry.first);
+            hot[b] = true;
         }
     }
-    // step 2: group the hot blocks into kernels
-    // condition 1: hot blocks have an edge from one to another: they belong to a group
-    // condition 2: hot blocks are 1 block away from each other: they are grouped together and so is the non-hot block
-    // John [3/16/22]: this is a graph coloring problem, in this case each HB just needs a parent kernel ID, so no copy is necessary
-    vector<int64_t> tmpHotBlocks(hotBlocks.begin(), hotBlocks.end());
-    for (auto hbIt = tmpHotBlocks.begin(); hbIt != tmpHotBlocks.end(); hbIt++)
+    // step 2: group the hot blocks into regions
+    // hot blocks that have an edge from one to another belong to the same region
+    UnionFind groups((uint32_t)frequencies.size());
+    for (const auto &edge : profile)
     {
-        // check if this block still needs to be evaluated (if its not in the hotblocks set anymore it either was not hot or already belongs to a kernel)
-        if (hotBlocks.find(*hbIt) == hotBlocks.end())
+        if ((edge.src < hot.size()) && (edge.snk < hot.size()) && hot[edge.src] && hot[edge.snk])
         {
-            // we've already been removed, move onto the next
-            continue;
-        }
-        // check if this block is a neighbor to an existing kernel
-        bool found = false;
-        for (const auto& k : kernels)
-        {
-            for (const auto &block : k->getSubgraph())
-            {
-                for (const auto &bn : block->getSuccessors())
-                {
-                    if (bn->getSnk()->NID == (uint64_t)*hbIt)
-                    {
-                        found = true;
-                        break;
-                    }
-                }
-                if (found)
-                {
-                    break;
-                }
-            }
-            if (found)
-            {
-                k->addNode(*nodes.find(*hbIt));
-                hotBlocks.erase(*hbIt);
-                break;
-            }
-        }
-        if (found)
-        {
-            continue;
-        }
-
-        auto newKern = make_shared<MLCycle>();
-        kernels.insert(newKern);
-        auto block = *nodes.find(*hbIt);
-        // first condition, evaluate all successors and rope them into the kernel if they are hot
-        for (const auto &nei : block->getSuccessors())
-        {
-            if (hotBlocks.find((int64_t)nei->getSnk()->NID) != hotBlocks.end())
-            {
-                auto newNode = *nodes.find(nei->getSnk()->NID);
-                newKern->addNode(newNode);
-                hotBlocks.erase((int64_t)nei->getSnk()->NID);
-            }
+            groups.join(edge.src, edge.snk);
         }
     }
-
-    // even with the above checks, we can still have kernels that are next to each other
-    // go through all kernels and see if you can merge them together
-    // John [3/16/22]: these algorithms are graph coloring, with breadth first searches... so you can just use those algorithmic fundamentals to make these algorithms better
-    vector<std::shared_ptr<MLCycle>> tmpKernels(kernels.begin(), kernels.end());
-    for (auto kernIt = tmpKernels.begin(); kernIt != tmpKernels.end(); kernIt++)
+    // regions are numbered in the order of their smallest block
+    map<uint32_t, uint32_t> rootToRegion;
+    for (uint32_t b = 0; b < hot.size(); b++)
     {
-        if (kernels.find((*kernIt)->KID) == kernels.end())
-        {
-            continue;
-        }
-        for (auto neighborKernIt = next(kernIt); neighborKernIt != tmpKernels.end(); neighborKernIt++)
+        if (hot[b])
         {
-            if (kernels.find((*neighborKernIt)->KID) == kernels.end())
-            {
-                continue;
-            }
-            auto kern = *kernIt;
-            auto nKern = *neighborKernIt;
-            bool match = false;
-            for (const auto &block : kern->getSubgraph())
-            {
-                for (const auto &nei : block->getSuccessors())
-                {
-                    if (nKern->find(nei->getWeightedSnk()))
-                    {
-                        match = true;
-                        break;
-                    }
-                }
-                for (const auto &p : block->getPredecessors())
-                {
-                    if (nKern->find(p->getWeightedSrc()))
-                    {
-                        match = true;
-                        break;
-                    }
-                }
-                if (match)
-                {
-                    break;
-                }
-            }
-            if (match)
+            auto root = groups.find(b);
+            if (!rootToRegion.contains(root))
             {
-                kern->addNodes(nKern->getSubgraph());
-                kernels.erase(nKern);
-                break;
+                rootToRegion[root] = (uint32_t)regions.size();
+                regions.emplace_back();
             }
+            regions[rootToRegion[root]].blocks.insert((int64_t)b);
         }
     }
-    return kernels;
+    return regions;
 }
 
-set<std::shared_ptr<MLCycle>, KCompare> Cyclebite::Cartographer::DetectHotLoops(const set<std::shared_ptr<MLCycle>, KCompare> &hotKernels, const Graph::Graph &graph, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock, const string &loopfilename)
+vector<HotRegion> Cyclebite::Cartographer::DetectHotLoops(const vector<HotRegion> &hotRegions, const string &loopfilename)
 {
-    set<std::shared_ptr<MLCycle>, KCompare> kernels;
-    set<StaticLoop, StaticLoopCompare> staticLoops;
     // read in loop information
     ifstream loopfile;
     json j;
@@ -217,104 +191,175 @@ set<std::shared_ptr<MLCycle>, KCompare> Cyclebite::Cartographer::DetectHotLoops(
     catch (std::exception &e)
     {
         spdlog::warn("Couldn't open loop file " + string(loopfilename) + ": " + string(e.what())+". Hotloop analysis is not possible without this file.");
-        return kernels;
+        return vector<HotRegion>();
     }
+    return DetectHotLoops(hotRegions, j);
+}
 
-    map<int64_t, std::shared_ptr<ControlNode>> blockToNode;
-    for (int i = 0; i < (int)j["Loops"].size(); i++)
+vector<HotRegion> Cyclebite::Cartographer::DetectHotLoops(const vector<HotRegion> &hotRegions, const nlohmann::json &j)
+{
+    vector<HotRegion> regions;
+    if (!j.contains("Loops"))
     {
-        // for now the loop type constraints are relaxed
-        /*if (j[(uint64_t)i]["Type"] != 0)
+        spdlog::warn("Loop information does not contain any loops. Hotloop analysis is not possible without it.");
+        return regions;
+    }
+    // maps each hot block to its region
+    map<int64_t, size_t> blockToRegion;
+    for (size_t i = 0; i < hotRegions.size(); i++)
+    {
+        for (const auto &b : hotRegions[i].blocks)
         {
-            continue;
-        }*/
-        // each i is an index for each loop in the file, each loop index maps to a list of block IDs and a loop type
+            blockToRegion[b] = i;
+        }
+    }
+    // hotloop detection is a feature on top of hotcode, therefore the hotloop result is at least the hotcode result
+    for (const auto &loop : j["Loops"])
+    {
+        // for now the loop type constraints are relaxed
+        // each loop maps to a list of block IDs and a loop type
         // for a list of types please see the top of TraceInfrastructure/Passes/LoopInfoDump.cpp
-        auto newLoop = StaticLoop();
-        newLoop.id = i;
-        // type 0 represents a normal loop (ie eligible for hotloop detection)
-        // any other type indicates a loop that is not eligible
-        for (auto block : j["Loops"][(uint64_t)i]["Blocks"].get<vector<int64_t>>())
+        auto loopBlocks = loop["Blocks"].get<vector<int64_t>>();
+        // the first hot region this loop intersects makes a hot loop with it
+        size_t match = hotRegions.size();
+        for (const auto &b : loopBlocks)
+        {
+            auto found = blockToRegion.find(b);
+            if (found != blockToRegion.end())
+            {
+                match = min(match, found->second);
+            }
+        }
+        if (match == hotRegions.size())
         {
-            newLoop.blocks.insert(block);
+            continue;
         }
-        // now map each loop's blocks to a node in the graph
-        // we do this by finding an equivalent edge in the loop that is represented in the graph
-        // this is dependent on the markov order
-        for (auto &block : newLoop.blocks)
+        HotRegion hotLoop = hotRegions[match];
+        // dead blocks of the loop are included too
+        hotLoop.blocks.insert(loopBlocks.begin(), loopBlocks.end());
+        regions.push_back(std::move(hotLoop));
+    }
+    // as of 2/3/2022 hot kernels that did not find a loop are not added to the result. It gives the hotloop method more credence than it deserves
+    // even though this is what prior work did, we are trying to make comparisions to methods that are common to the research community. Therefore we don't want to optimize the hotloop result: we want to demonstrate its limitations
+    return regions;
+}
+
+void Cyclebite::Cartographer::WriteHotCodeFile(const vector<HotRegion> &regions, const MarkovProfile &profile, const map<int64_t, const llvm::BasicBlock *> &IDToBlock, const map<int64_t, vector<int64_t>> &blockCallers, const string &OutputFileName)
+{
+    // regions of hot loops can overlap, so each block knows every region it belongs to
+    auto blockCount = profile.getBlockCount();
+    vector<vector<uint32_t>> blockRegions(blockCount);
+    vector<vector<bool>> members(regions.size(), vector<bool>(blockCount, false));
+    for (uint32_t r = 0; r < regions.size(); r++)
+    {
+        for (const auto &b : regions[r].blocks)
         {
-            auto node = static_pointer_cast<ControlNode>(BlockToNode(graph, IDToBlock.at(block), NIDMap));
-            if (node)
+            if ((b >= 0) && (b < (int64_t)blockCount))
             {
-                newLoop.nodes.insert(node);
+                blockRegions[(size_t)b].push_back(r);
+                members[r][(size_t)b] = true;
             }
-            // else it is likely dead code
         }
-        staticLoops.insert(newLoop);
     }
-
-    // detect hot loops
-    // we always assume there is a 1:1 mapping between hot blocks and hot nodes
-    // hotloop detection is a feature on top of hotcode, therefore the hotloop result is at least the hotcode result
-    auto loops_copy = staticLoops;
-    while (!staticLoops.empty())
+    // one pass over the edges finds the borders of every region, and the blocks that are in no region at all
+    vector<map<int64_t, set<int64_t>>> entrances(regions.size());
+    vector<map<int64_t, set<int64_t>>> exits(regions.size());
+    set<int64_t> nonKernelBlocks;
+    for (const auto &edge : profile)
     {
-        auto loop = staticLoops.begin();
-        bool matched = false;
-        set<int64_t> intersect;
-        for (const auto &currentKernel : hotKernels)
+        if ((edge.src >= blockCount) || (edge.snk >= blockCount))
         {
-            auto kernelBlocks = currentKernel->blocks;
-            set_intersection(loop->blocks.begin(), loop->blocks.end(), kernelBlocks.begin(), kernelBlocks.end(), std::inserter(intersect, intersect.begin()));
-            if (!intersect.empty())
+            continue;
+        }
+        for (const auto &r : blockRegions[edge.snk])
+        {
+            if (!members[r][edge.src])
             {
-                // this loop intersects with hot blocks
-                // therefore, create a hot loop kernel
-                auto newKernel = make_shared<MLCycle>();
-                newKernel->addNodes(currentKernel->getSubgraph());
-                auto loopNodes = loop->nodes;
-                newKernel->addNodes(loopNodes);
-                // this line is going to add all dead blocks to the static loop finder
-                newKernel->addBlocks(loop->blocks);
-                kernels.insert(newKernel);
-                staticLoops.erase(loop);
-                matched = true;
-                break;
+                entrances[r][edge.src].insert(edge.snk);
             }
         }
-        if (!matched)
+        for (const auto &r : blockRegions[edge.src])
         {
-            staticLoops.erase(loop);
+            if (!members[r][edge.snk])
+            {
+                exits[r][edge.src].insert(edge.snk);
+            }
         }
-    }
-    // finally, for any hot kernel that did not find a loop, add them to the result
-    // as of 2/3/2022 we don't do this anymore. It gives the hotloop method more credence than it deserves
-    // even though this is what prior work did, we are trying to make comparisions to methods that are common to the research community. Therefore we don't want to optimize the hotloop result: we want to demonstrate its limitations
-    /*for( const auto& hk : hotKernels )
-    {
-        // try to find a loop that represents this hotkernel
-        bool matched = false;
-        for( const auto& sl : loops_copy)
+        for (const auto &b : {edge.src, edge.snk})
         {
-            // in order for a loop to match a hotkernel, the loop blocks have to cover all blocks from the hotkernel
-            // the first match we see is enough to end the algorithm because we're just looking to see if the hotcode has been included in the result (hotloops are a superset of hotcode result)
-            set<int64_t> intersect;
-            auto hkblocks = hk->getBlocks();
-            set_intersection(sl.blocks.begin(), sl.blocks.end(), hkblocks.begin(), hkblocks.end(), std::inserter(intersect, intersect.begin()));
-            if( intersect.size() >= hk->getBlocks().size() )
+            if (blockRegions[b].empty())
             {
-                matched = true;
-                break;
+                nonKernelBlocks.insert(b);
             }
         }
-        if( !matched )
+    }
+
+    float totalBlocks = 0.0;
+    ofstream oStream(OutputFileName);
+    Cyclebite::Util::JsonStreamWriter writer(oStream);
+    writer.beginObject();
+    writer.key("ValidBlocks");
+    writer.beginArray();
+    for (const auto &id : IDToBlock)
+    {
+        writer.value(id.first);
+    }
+    writer.endArray();
+    if (!blockCallers.empty())
+    {
+        writer.key("BlockCallers");
+        writer.beginObject();
+        for (const auto &bid : blockCallers)
+        {
+            writer.key(to_string(bid.first));
+            writer.array(bid.second);
+        }
+        writer.endObject();
+    }
+    auto writeBorders = [&](const string &name, const map<int64_t, set<int64_t>> &borders) {
+        if (borders.empty())
+        {
+            return;
+        }
+        writer.key(name);
+        writer.beginObject();
+        for (const auto &border : borders)
         {
-            // include the hot kernel
-            auto newKernel = new MLCycle(newKernelID++);
-            newKernel->addNodes(hk->subgraph);
-            newKernel->addNodes(hk->subgraph);
-            kernels.insert(newKernel);
+            writer.key(to_string(border.first));
+            writer.beginArray();
+            for (const auto &snk : border.second)
+            {
+                writer.value(to_string(snk));
+            }
+            writer.endArray();
         }
-    }*/
-    return kernels;
-}
\ No newline at end of file
+        writer.endObject();
+    };
+    writer.key("Kernels");
+    writer.beginObject();
+    for (uint32_t r = 0; r < regions.size(); r++)
+    {
+        totalBlocks += (float)regions[r].blocks.size();
+        writer.key(to_string(r));
+        writer.beginObject();
+        writer.key("Blocks");
+        writer.array(regions[r].blocks);
+        writer.field("Labels", vector<string>{""});
+        writeBorders("Entrances", entrances[r]);
+        writeBorders("Exits", exits[r]);
+        writer.key("Children");
+        writer.array(vector<uint32_t>());
+        writer.key("Parents");
+        writer.array(vector<uint32_t>());
+        writer.endObject();
+    }
+    writer.endObject();
+    writer.key("NonKernelBlocks");
+    writer.array(nonKernelBlocks);
+    // profiles are markov order 1, so each node of a region is exactly one block
+    auto average = regions.empty() ? 0.0f : float(totalBlocks / (float)regions.size());
+    writer.field("Average Kernel Size (Nodes)", average);
+    writer.field("Average Kernel Size (Blocks)", average);
+    writer.endObject();
+    oStream.close();
+}
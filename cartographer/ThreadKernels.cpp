@@ -0,0 +1,205 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#include "ThreadKernels.h"
+#include "Util/Exceptions.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <set>
+
+using namespace std;
+using namespace Cyclebite::Cartographer;
+using json = nlohmann::json;
+
+/// A kernel found in at least one thread
+struct UnifiedKernel
+{
+    json kernel;
+    set<uint32_t> threads;
+    set<string> labels;
+    map<string, set<string>> entrances;
+    map<string, set<string>> exits;
+    set<uint32_t> children;
+    set<uint32_t> parents;
+    set<uint32_t> dominators;
+};
+
+json ReadKernelFile(const string &filename)
+{
+    ifstream input(filename);
+    if (!input.good())
+    {
+        throw CyclebiteException("Could not open thread kernel file " + filename);
+    }
+    json j;
+    input >> j;
+    return j;
+}
+
+/// Adds the borders (entrances or exits) of one thread to borders
+void MergeBorders(map<string, set<string>> &borders, const json &kernel, const string &name)
+{
+    if (!kernel.contains(name))
+    {
+        return;
+    }
+    for (const auto &[src, snks] : kernel[name].items())
+    {
+        for (const auto &snk : snks.get<vector<string>>())
+        {
+            borders[src].insert(snk);
+        }
+    }
+}
+
+/// Maps the kernel IDs a thread uses in field to unified IDs
+void MergeHierarchy(set<uint32_t> &unified, const json &kernel, const string &field, const map<uint32_t, uint32_t> &toUnified)
+{
+    if (!kernel.contains(field))
+    {
+        return;
+    }
+    for (const auto &id : kernel[field].get<vector<uint32_t>>())
+    {
+        unified.insert(toUnified.at(id));
+    }
+}
+
+json BordersToJson(const map<string, set<string>> &borders)
+{
+    json j = json::object();
+    for (const auto &[src, snks] : borders)
+    {
+        j[src] = vector<string>(snks.begin(), snks.end());
+    }
+    return j;
+}
+
+void Cyclebite::Cartographer::UnifyThreadKernels(const vector<pair<uint32_t, string>> &threadFiles, const string &OutputFileName)
+{
+    vector<UnifiedKernel> kernels;
+    // sorted blocks of each unified kernel, the same blocks in two threads are the same kernel
+    map<vector<int64_t>, uint32_t> blocksToKernel;
+    set<int64_t> nonKernelBlocks;
+    json output;
+    for (const auto &[thread, file] : threadFiles)
+    {
+        auto j = ReadKernelFile(file);
+        if (output.is_null())
+        {
+            // valid blocks and block callers come from the bitcode and BlockInfo, so they are the same in every thread
+            output["ValidBlocks"] = j["ValidBlocks"];
+            if (j.contains("BlockCallers"))
+            {
+                output["BlockCallers"] = j["BlockCallers"];
+            }
+            output["Entropy"] = j["Entropy"];
+        }
+        output["ThreadEntropy"][to_string(thread)] = j["Entropy"];
+        if (j.contains("NonKernelBlocks"))
+        {
+            auto blocks = j["NonKernelBlocks"].get<vector<int64_t>>();
+            nonKernelBlocks.insert(blocks.begin(), blocks.end());
+        }
+        if (!j.contains("Kernels"))
+        {
+            continue;
+        }
+        // the hierarchy refers to kernels of this thread, so every kernel of the thread gets its unified ID first
+        map<uint32_t, uint32_t> toUnified;
+        for (const auto &[kid, kernel] : j["Kernels"].items())
+        {
+            auto blocks = kernel["Blocks"].get<vector<int64_t>>();
+            sort(blocks.begin(), blocks.end());
+            auto found = blocksToKernel.find(blocks);
+            if (found == blocksToKernel.end())
+            {
+                found = blocksToKernel.insert(pair(blocks, (uint32_t)kernels.size())).first;
+                kernels.emplace_back();
+                kernels.back().kernel = kernel;
+            }
+            toUnified[(uint32_t)stoul(kid)] = found->second;
+        }
+        for (const auto &[kid, kernel] : j["Kernels"].items())
+        {
+            auto &unified = kernels[toUnified.at((uint32_t)stoul(kid))];
+            unified.threads.insert(thread);
+            if (kernel.contains("Labels"))
+            {
+                for (const auto &label : kernel["Labels"].get<vector<string>>())
+                {
+                    unified.labels.insert(label);
+                }
+            }
+            MergeBorders(unified.entrances, kernel, "Entrances");
+            MergeBorders(unified.exits, kernel, "Exits");
+            MergeHierarchy(unified.children, kernel, "Children", toUnified);
+            MergeHierarchy(unified.parents, kernel, "Parents", toUnified);
+            MergeHierarchy(unified.dominators, kernel, "Dominators", toUnified);
+        }
+    }
+    if (output.is_null())
+    {
+        throw CyclebiteException("No thread kernel files to unify into " + OutputFileName);
+    }
+
+    // average nodes per kernel
+    float totalNodes = 0.0;
+    // average blocks per kernel
+    float totalBlocks = 0.0;
+    output["Kernels"] = json::object();
+    for (uint32_t i = 0; i < kernels.size(); i++)
+    {
+        // nodes are numbered by each thread's graph, the ones of the first thread that found the kernel are kept
+        auto kernel = kernels[i].kernel;
+        kernel["Threads"] = kernels[i].threads;
+        // the empty label is the vote for no label, it only stays when no thread found a label
+        if (kernels[i].labels.size() > 1)
+        {
+            kernels[i].labels.erase("");
+        }
+        kernel["Labels"] = kernels[i].labels;
+        kernel.erase("Entrances");
+        kernel.erase("Exits");
+        if (!kernels[i].entrances.empty())
+        {
+            kernel["Entrances"] = BordersToJson(kernels[i].entrances);
+        }
+        if (!kernels[i].exits.empty())
+        {
+            kernel["Exits"] = BordersToJson(kernels[i].exits);
+        }
+        kernel["Children"] = kernels[i].children;
+        kernel["Parents"] = kernels[i].parents;
+        if (kernel.contains("Dominators"))
+        {
+            kernel["Dominators"] = kernels[i].dominators;
+        }
+        totalNodes += (float)kernel["Nodes"].size();
+        totalBlocks += (float)kernel["Blocks"].size();
+        for (const auto &block : kernel["Blocks"].get<vector<int64_t>>())
+        {
+            // a block that is kernel code in one thread is kernel code in the program
+            nonKernelBlocks.erase(block);
+        }
+        output["Kernels"][to_string(i)] = kernel;
+    }
+    output["NonKernelBlocks"] = nonKernelBlocks;
+    if (!kernels.empty())
+    {
+        output["Average Kernel Size (Nodes)"] = float(totalNodes / (float)kernels.size());
+        output["Average Kernel Size (Blocks)"] = float(totalBlocks / (float)kernels.size());
+    }
+    else
+    {
+        output["Average Kernel Size (Nodes)"] = 0.0;
+        output["Average Kernel Size (Blocks)"] = 0.0;
+    }
+    ofstream oStream(OutputFileName);
+    oStream << setw(4) << output;
+    oStream.close();
+}
@@ -3,28 +3,38 @@
 // SPDX-License-Identifier: Apache-2.0
 //==------------------------------==//
 #pragma once
-#include "ControlNode.h"
-#include "Graph.h"
-#include "MLCycle.h"
+#include "Util/BlockSet.h"
 #include "llvm/IR/BasicBlock.h"
+#include <map>
+#include <nlohmann/json.hpp>
+#include <set>
+#include <string>
+#include <vector>
 
-namespace Cyclebite::Cartographer
+namespace Cyclebite::Graph
 {
-    struct StaticLoop
-    {
-        int id;
-        std::set<int64_t> blocks;
-        std::set<std::shared_ptr<Cyclebite::Graph::ControlNode>, Cyclebite::Graph::p_GNCompare> nodes;
-    };
+    class MarkovProfile;
+} // namespace Cyclebite::Graph
 
-    struct StaticLoopCompare
+namespace Cyclebite::Cartographer
+{
+    /// @brief A group of hot blocks, the hotcode/hotloop equivalent of a kernel
+    ///
+    /// Regions are found straight from the edges of the profile, so they are described by block IDs instead of nodes of a ControlGraph
+    struct HotRegion
     {
-        bool operator()(const StaticLoop &lhs, const StaticLoop &rhs) const
-        {
-            return lhs.id < rhs.id;
-        }
+        Cyclebite::Util::BlockSet blocks;
     };
 
-    std::set<std::shared_ptr<Cyclebite::Graph::MLCycle>, Cyclebite::Graph::KCompare> DetectHotCode(const std::set<std::shared_ptr<Cyclebite::Graph::ControlNode>, Cyclebite::Graph::p_GNCompare> &nodes, float hotTreshold);
-    std::set<std::shared_ptr<Cyclebite::Graph::MLCycle>, Cyclebite::Graph::KCompare> DetectHotLoops(const std::set<std::shared_ptr<Graph::MLCycle>, Graph::KCompare> &hotKernels, const Graph::Graph &graph, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock, const std::string &loopfilename);
+    /// @brief Finds the hot blocks of a profile and groups the ones that are connected by an edge into regions
+    ///
+    /// Blocks are taken in descending order of frequency until hotThreshold of the total block frequency is accounted for, then every block above a fixed hot frequency is added
+    /// Frequencies are a parallel reduction over the edge array and only as many of the hottest blocks as necessary are sorted
+    std::vector<HotRegion> DetectHotCode(const Cyclebite::Graph::MarkovProfile &profile, float hotThreshold);
+    /// Every static loop that touches a hot region becomes a region of the loop blocks and the hot region blocks
+    std::vector<HotRegion> DetectHotLoops(const std::vector<HotRegion> &hotRegions, const std::string &loopfilename);
+    /// Same as above, for loop information that has already been parsed (e.g. the LOOPS section of a profile container)
+    std::vector<HotRegion> DetectHotLoops(const std::vector<HotRegion> &hotRegions, const nlohmann::json &loops);
+    /// Writes hot regions in the layout of a kernel file, entrances and exits are the profile edges that cross the border of each region
+    void WriteHotCodeFile(const std::vector<HotRegion> &regions, const Cyclebite::Graph::MarkovProfile &profile, const std::map<int64_t, const llvm::BasicBlock *> &IDToBlock, const std::map<int64_t, std::vector<int64_t>> &blockCallers, const std::string &OutputFileName);
 } // namespace Cyclebite::Cartographer
@@ -0,0 +1,20 @@
+//==------------------------------==//
+// Copyright 2023 Benjamin Willis
+// SPDX-License-Identifier: Apache-2.0
+//==------------------------------==//
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Cyclebite::Cartographer
+{
+    /// @brief Merges the kernel files of the threads of one program into a single kernel file
+    ///
+    /// Kernels with the same blocks are one kernel, its "Threads" lists every thread it was found in and its entrances, exits, labels and hierarchy are the union of what each thread saw
+    /// Kernels are renumbered in the order they are first found, threads are taken in the order given
+    /// Throws when a kernel file can't be read
+    /// @param threadFiles Thread index and kernel file of each thread
+    void UnifyThreadKernels(const std::vector<std::pair<uint32_t, std::string>> &threadFiles, const std::string &OutputFileName);
+} // namespace Cyclebite::Cartographer
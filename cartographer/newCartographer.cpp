@@ -3,18 +3,27 @@
 // SPDX-License-Identifier: Apache-2.0
 //==------------------------------==//
 #include "Util/IO.h"
+#include "BlockIDIndex.h"
 #include "CallGraph.h"
 #include "ControlGraph.h"
 #include "Dijkstra.h"
 #include "Graph.h"
 #include "Hotcode.h"
 #include "IO.h"
+#include "ThreadKernels.h"
+#include "MarkovProfile.h"
+#include "ProfileContainer.h"
+#include "StationaryDistribution.h"
 #include "Transforms.h"
+#include "Util/Exceptions.h"
+#include <atomic>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <llvm/Support/CommandLine.h>
 #include <queue>
+#include <span>
+#include <thread>
 
 #ifdef WINDOWS
 #include <direct.h>
@@ -30,71 +39,243 @@ using namespace Cyclebite::Cartographer;
 using namespace Cyclebite::Graph;
 using json = nlohmann::json;
 
-cl::opt<string> ProfileFileName("i", cl::desc("Specify bin file"), cl::value_desc(".bin filename"), cl::Required);
+cl::opt<string> ProfileFileName("i", cl::desc("Specify bin file or profile container"), cl::value_desc(".bin filename"));
 cl::opt<string> BitcodeFileName("b", cl::desc("Specify bitcode file"), cl::value_desc(".bc filename"), cl::Required);
-cl::opt<string> BlockInfoFilename("bi", cl::desc("Specify BlockInfo.json file"), cl::value_desc(".json filename"), cl::Required);
+cl::opt<string> BlockInfoFilename("bi", cl::desc("Specify BlockInfo.json file (not needed when the input profile is a profile container)"), cl::value_desc(".json filename"));
 cl::opt<string> LoopFileName("l", cl::desc("Specify Loopinfo.json file"), cl::value_desc(".json filename"), cl::init("Loopinfo.json"));
 cl::opt<bool> HotCodeDetection("h", cl::desc("Perform hotcode detection"), cl::value_desc("Enable hot code detection only. Input profile must have markov order 1"), cl::init(false));
+cl::opt<bool> HotCodeOnly("ho", cl::desc("Perform hotcode detection only"), cl::value_desc("Write the hotcode and hotloop kernel files and skip segmentation"), cl::init(false));
 cl::opt<float> HotCodeThreshold("ht", cl::desc("Set hotcode threshold"), cl::value_desc("Set the threshold in which the hotcode algorithm will terminate. Should be a number between 0 and 1 (representing \% of runtime accounted for)"), cl::init(0.95f));
 cl::opt<string> DotFile("d", cl::desc("Specify dot filename"), cl::value_desc("dot file"));
 cl::opt<string> KernelPredictorScript("p", cl::desc("Specify path to label predictor script (should include the script name in the path)"), cl::value_desc("python file"));
-cl::opt<string> OutputFilename("o", cl::desc("Specify output json"), cl::value_desc("kernel filename"), cl::Required);
+cl::opt<string> OutputFilename("o", cl::desc("Specify output json"), cl::value_desc("kernel filename"));
+cl::opt<string> ManifestFileName("m", cl::desc("Specify a manifest of profiles of the bitcode to segment in one process (replaces -i, -bi, -o and -d)"), cl::value_desc(".json filename"));
+cl::opt<unsigned> BatchThreads("j", cl::desc("Number of manifest profiles (and threads of a profile with -threads) to segment at once"), cl::value_desc("Thread count, 0 picks the hardware concurrency"), cl::init(0));
+cl::opt<bool> PerThread("threads", cl::desc("Segment the profile of each program thread on its own and unify their kernels (the profile must be taken with MARKOV_THREADS)"), cl::init(false));
 
-extern uint32_t markovOrder;
+/// @brief Segmentations that may still start
+///
+/// Shared by the batch workers and SegmentThreads, so a batch of -threads profiles never segments more than -j graphs at once
+/// Every running segmentation holds one worker, the batch workers hold theirs until the manifest is empty
+atomic<size_t> idleWorkers = 0;
 
-int main(int argc, char **argv)
+/// Returns the number of graphs that may be segmented at once
+size_t WorkerBudget()
+{
+    return (size_t)(BatchThreads ? BatchThreads : max(1u, thread::hardware_concurrency()));
+}
+
+/// Takes an idle worker, false when every worker is busy
+bool AcquireWorker()
+{
+    auto idle = idleWorkers.load();
+    while (idle)
+    {
+        if (idleWorkers.compare_exchange_weak(idle, idle - 1))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// One profile of the input bitcode and where its results go
+struct Segmentation
+{
+    string profile;
+    string blockInfo;
+    string output;
+    string dot;
+};
+
+/// @brief Reads the batch manifest
+///
+/// The manifest is a json array with one object per profile: {"profile": "markov.bin", "blockinfo": "BlockInfo.json", "output": "kernel.json", "dot": "dot.dot"}
+/// "blockinfo" may be left out when the profile is a profile container, "dot" may always be left out
+vector<Segmentation> ReadManifest(const string &filename)
+{
+    ifstream inputJson(filename);
+    if (!inputJson.good())
+    {
+        throw CyclebiteException("Could not open manifest file " + filename);
+    }
+    json j;
+    inputJson >> j;
+    inputJson.close();
+    if (!j.is_array())
+    {
+        throw CyclebiteException("Manifest " + filename + " must be an array of profiles");
+    }
+    vector<Segmentation> jobs;
+    for (const auto &entry : j)
+    {
+        if (!entry.contains("profile") || !entry.contains("output"))
+        {
+            throw CyclebiteException("Every manifest entry needs a profile and an output");
+        }
+        jobs.push_back(Segmentation{entry["profile"].get<string>(), entry.value("blockinfo", ""), entry["output"].get<string>(), entry.value("dot", "")});
+    }
+    return jobs;
+}
+
+/// Returns the peak resident memory of the process in kB, or 0 where it can't be read
+uint64_t PeakMemory()
+{
+    uint64_t peak = 0;
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line))
+    {
+        if (line.starts_with("VmHWM:"))
+        {
+            peak = stoull(line.substr(6));
+        }
+    }
+    return peak;
+}
+
+/// Restarts the peak of PeakMemory() from the current resident memory, so a serial batch can measure each profile on its own
+void ResetPeakMemory()
+{
+    ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+}
+
+/// An open input profile, the container (when there is one) holds the memory the profiles point into
+struct InputProfile
+{
+    unique_ptr<ProfileContainer> container;
+    unique_ptr<MarkovProfile> profile;
+    /// the profile of each program thread, empty when the profile was not taken with MARKOV_THREADS
+    vector<span<const uint8_t>> threads;
+};
+
+/// @brief Opens a markov.bin file or profile container
+///
+/// Throws CyclebiteException when the profile can't be read or doesn't have markov order 1
+InputProfile OpenProfile(const string &filename)
+{
+    InputProfile input;
+    if (ProfileContainer::isContainer(filename))
+    {
+        input.container = make_unique<ProfileContainer>(filename);
+        auto edges = input.container->getSection(__TA_SECTION_EDGES);
+        input.profile = make_unique<MarkovProfile>(edges.data(), edges.size());
+        if (input.container->hasSection(__TA_SECTION_THREAD_EDGES))
+        {
+            input.threads = MarkovProfile::splitThreadProfiles(input.container->getSection(__TA_SECTION_THREAD_EDGES));
+            return input;
+        }
+    }
+    else
+    {
+        input.profile = make_unique<MarkovProfile>(filename);
+    }
+    // a markov.bin file (or one packed into a container) carries the threads after its last edge
+    input.threads = input.profile->getThreadProfiles();
+    return input;
+}
+
+/// @brief Segments one profile of SourceBitcode into kernels
+///
+/// Everything that depends on the profile lives in a ProfileContext of this segmentation, so several segmentations can run at once
+/// IDToBlock and IDToValue must already be initialized from SourceBitcode, they are only read from here
+/// @param thread Index of the program thread to segment on its own, -1 segments the profile of the whole program
+int Segment(const Segmentation &job, const unique_ptr<llvm::Module> &SourceBitcode, const llvm::CallGraph &staticCG, int64_t thread = -1)
 {
     // we measure the time taken for both the transforms section and the kernel virtualization section
     struct timespec start, end;
     while (clock_gettime(CLOCK_MONOTONIC, &start))
     {
     }
-    cl::ParseCommandLineOptions(argc, argv);
-
-    // static and dynamic information about the program structure
-    ReadBlockInfo(BlockInfoFilename);
-    auto SourceBitcode = ReadBitcode(BitcodeFileName);
-    if (SourceBitcode == nullptr)
+    InputProfile input;
+    // the profile this segmentation reads, either the whole program or one of its threads
+    unique_ptr<MarkovProfile> threadProfile;
+    try
+    {
+        input = OpenProfile(job.profile);
+        if (thread >= 0)
+        {
+            auto threadEdges = input.threads.at((size_t)thread);
+            threadProfile = make_unique<MarkovProfile>(threadEdges.data(), threadEdges.size());
+        }
+    }
+    catch (CyclebiteException &e)
     {
+        spdlog::critical(e.what());
         return EXIT_FAILURE;
     }
-    // Construct static callgraph
-    llvm::CallGraph staticCG(*SourceBitcode);
-#ifdef DEBUG
-    ofstream callGraphDot("StaticCallGraph.dot");
-    auto staticCallGraph = GenerateCallGraph(staticCG);
-    callGraphDot << staticCallGraph << "\n";
-    callGraphDot.close();
-#endif
-    // map IDs to blocks and values
-    InitializeIDMaps(SourceBitcode.get());
+    const auto &profile = threadProfile ? *threadProfile : *input.profile;
+    ProfileContext context;
+    // dynamic information about the program structure
+    if (input.container)
+    {
+        ReadBlockInfo(context, *input.container);
+    }
+    else if (job.blockInfo.empty())
+    {
+        spdlog::critical("A BlockInfo.json file is required when the input profile is not a profile container");
+        return EXIT_FAILURE;
+    }
+    else
+    {
+        ReadBlockInfo(context, job.blockInfo);
+    }
+
+    /// run hotcode structuring algorithms, if asked to do so
+    /// hotcode only needs block frequencies, so it works on the edges of the profile before any graph is built
+    if (HotCodeDetection || HotCodeOnly)
+    {
+        if (profile.getMarkovOrder() != 1)
+        {
+            spdlog::critical("Hot code detection can only be performed on an input profile that has markov order 1!");
+            return EXIT_FAILURE;
+        }
+        auto hotCode = DetectHotCode(profile, HotCodeThreshold);
+        WriteHotCodeFile(hotCode, profile, IDToBlock, context.blockCallers, job.output + "_HotCode.json");
+        vector<HotRegion> hotLoops;
+        if (input.container && input.container->hasSection(__TA_SECTION_LOOPS))
+        {
+            auto loops = input.container->getSection(__TA_SECTION_LOOPS);
+            hotLoops = DetectHotLoops(hotCode, json::parse(loops.begin(), loops.end()));
+        }
+        else
+        {
+            hotLoops = DetectHotLoops(hotCode, LoopFileName);
+        }
+        WriteHotCodeFile(hotLoops, profile, IDToBlock, context.blockCallers, job.output + "_HotLoop.json");
+        while (clock_gettime(CLOCK_MONOTONIC, &end))
+        {
+        }
+        spdlog::info("CARTOGRAPHERHOTCODETIME: " + to_string(CalculateTime(&start, &end)) + "s");
+        if (HotCodeOnly)
+        {
+            return EXIT_SUCCESS;
+        }
+    }
+
     // construct program control graph and call graph
     ControlGraph cg;
     Cyclebite::Graph::CallGraph dynamicCG;
-    getDynamicInformation(cg, dynamicCG, ProfileFileName, SourceBitcode, staticCG, blockCallers, threadStarts, IDToBlock, HotCodeDetection );
+    getDynamicInformation(context, cg, dynamicCG, profile, SourceBitcode, staticCG, IDToBlock);
 #ifdef DEBUG
-    FindAllRecursiveFunctions(staticCG, cg, IDToBlock);
-    FindAllRecursiveFunctions(dynamicCG, cg, IDToBlock);
+    FindAllRecursiveFunctions(context, staticCG, cg, IDToBlock);
+    FindAllRecursiveFunctions(context, dynamicCG, cg, IDToBlock);
 #endif
 
-    /// run hotcode structuring algorithms, if asked to do so
-    if (HotCodeDetection)
-    {
-        auto hotCodeKernels = DetectHotCode(cg.getControlNodes(), HotCodeThreshold);
-        EntropyInfo entropies;
-        WriteKernelFile(cg, hotCodeKernels, IDToBlock, blockCallers, entropies, OutputFilename + "_HotCode.json", true);
-        auto hotLoopKernels = DetectHotLoops(hotCodeKernels, cg, IDToBlock, LoopFileName);
-        WriteKernelFile(cg, hotLoopKernels, IDToBlock, blockCallers, entropies, OutputFilename + "_HotLoop.json", true);
-    }
+    // flattens kernel entrances and exits to profile blocks
+    BlockIDIndex blockIndex;
 
     /// Transform dynamic control flow graph before structuring its tasks
     EntropyInfo entropies;
-    entropies.start_entropy_rate = EntropyCalculation(cg.getControlNodes());
+    // the end solve warm-starts from the start solve
+    StationaryDistribution stationary;
+    entropies.start_entropy_rate = EntropyCalculation(cg.getControlNodes(), stationary);
     entropies.start_total_entropy = TotalEntropy(cg.getControlNodes());
     entropies.start_node_count = (uint32_t)cg.node_count();
     entropies.start_edge_count = (uint32_t)cg.edge_count();
-    ApplyCFGTransforms(cg, dynamicCG, false);
-    entropies.end_entropy_rate = EntropyCalculation(cg.getControlNodes());
+    ApplyCFGTransforms(context, cg, dynamicCG, false);
+    entropies.end_entropy_rate = EntropyCalculation(cg.getControlNodes(), stationary);
     entropies.end_total_entropy = TotalEntropy(cg.getControlNodes());
     entropies.end_node_count = (uint32_t)cg.node_count();
     entropies.end_edge_count = (uint32_t)cg.edge_count();
@@ -118,7 +299,7 @@ int main(int argc, char **argv)
     while (clock_gettime(CLOCK_MONOTONIC, &start))
     {
     }
-    auto kernels = FindMLCycles(cg, dynamicCG, true);
+    auto kernels = FindMLCycles(context, cg, dynamicCG, true);
     while (clock_gettime(CLOCK_MONOTONIC, &end))
     {
     }
@@ -136,8 +317,8 @@ int main(int argc, char **argv)
         {
             for (const auto &block : node->blocks)
             {
-                auto infoEntry = blockLabels.find(block);
-                if (infoEntry != blockLabels.end())
+                auto infoEntry = context.blockLabels.find(block);
+                if (infoEntry != context.blockLabels.end())
                 {
                     for (const auto &label : (*infoEntry).second)
                     {
@@ -170,19 +351,251 @@ int main(int argc, char **argv)
         }
         kernel->Label = maxVoteLabel;
     }
-    WriteKernelFile(cg, kernels, IDToBlock, blockCallers, entropies, OutputFilename);
-    if (!DotFile.empty())
+    WriteKernelFile(cg, kernels, IDToBlock, context.blockCallers, entropies, job.output, false, blockIndex);
+    if (!job.dot.empty())
     {
         auto unrolledGraph = reverseTransform_MLCycle(cg);
-        ofstream dStream(DotFile);
-        auto graphdot = GenerateDot(unrolledGraph);
+        ofstream dStream(job.dot);
+        auto graphdot = GenerateDot(unrolledGraph, false, context.markovOrder);
         dStream << graphdot << "\n";
         dStream.close();
         /*ofstream tStream("SegmentedTransformedGraph.dot");
-        graphdot = GenerateTransformedSegmentedDot(transformedGraph, kernels, (int)markovOrder);
+        graphdot = GenerateTransformedSegmentedDot(transformedGraph, kernels, (int)context.markovOrder);
         tStream << graphdot << "\n";
         tStream.close();*/
     }
 
     return 0;
+}
+
+/// @brief Segments the profile of each program thread in job on its own, then unifies their kernels into job.output
+///
+/// Threads are segmented at the same time, each with a ProfileContext of its own
+/// The caller segments on the worker it already holds, helpers only start on idle workers (see idleWorkers)
+/// Falls back to Segment() when the profile has no thread profiles
+int SegmentThreads(const Segmentation &job, const unique_ptr<llvm::Module> &SourceBitcode, const llvm::CallGraph &staticCG)
+{
+    // threads that never took an edge have no graph to segment
+    vector<uint32_t> active;
+    try
+    {
+        auto input = OpenProfile(job.profile);
+        for (uint32_t t = 0; t < input.threads.size(); t++)
+        {
+            if (MarkovProfile(input.threads[t].data(), input.threads[t].size()).getEdgeCount())
+            {
+                active.push_back(t);
+            }
+        }
+    }
+    catch (exception &e)
+    {
+        spdlog::critical(job.profile + ": " + e.what());
+        return EXIT_FAILURE;
+    }
+    if (active.empty())
+    {
+        spdlog::warn(job.profile + " has no thread profiles (profile with MARKOV_THREADS set), segmenting the whole program instead");
+        return Segment(job, SourceBitcode, staticCG);
+    }
+    struct timespec start, end;
+    while (clock_gettime(CLOCK_MONOTONIC, &start))
+    {
+    }
+    vector<Segmentation> threadJobs;
+    for (const auto &t : active)
+    {
+        threadJobs.push_back(Segmentation{job.profile, job.blockInfo, job.output + "_Thread" + to_string(t) + ".json", job.dot.empty() ? "" : job.dot + "_Thread" + to_string(t) + ".dot"});
+    }
+    vector<int> results(active.size(), EXIT_FAILURE);
+    atomic<size_t> nextThread = 0;
+    auto work = [&]() {
+        for (auto i = nextThread++; i < active.size(); i = nextThread++)
+        {
+            try
+            {
+                results[i] = Segment(threadJobs[i], SourceBitcode, staticCG, active[i]);
+            }
+            catch (exception &e)
+            {
+                spdlog::critical(job.profile + " thread " + to_string(active[i]) + ": " + e.what());
+                results[i] = EXIT_FAILURE;
+            }
+            catch (...)
+            {
+                spdlog::critical(job.profile + " thread " + to_string(active[i]) + ": unknown exception");
+                results[i] = EXIT_FAILURE;
+            }
+        }
+    };
+    vector<thread> pool;
+    for (size_t w = 1; (w < active.size()) && AcquireWorker(); w++)
+    {
+        pool.emplace_back([&]() {
+            work();
+            idleWorkers++;
+        });
+    }
+    work();
+    for (auto &w : pool)
+    {
+        w.join();
+    }
+    while (clock_gettime(CLOCK_MONOTONIC, &end))
+    {
+    }
+    spdlog::info("CARTOGRAPHERTHREADS: " + to_string(active.size()) + " threads in " + to_string(CalculateTime(&start, &end)) + "s");
+    vector<pair<uint32_t, string>> threadFiles;
+    for (size_t i = 0; i < active.size(); i++)
+    {
+        if (results[i] == EXIT_SUCCESS)
+        {
+            threadFiles.push_back(pair(active[i], threadJobs[i].output));
+        }
+    }
+    if (threadFiles.size() != active.size())
+    {
+        spdlog::critical(to_string(active.size() - threadFiles.size()) + " threads of " + job.profile + " could not be segmented");
+        return EXIT_FAILURE;
+    }
+    if (HotCodeOnly)
+    {
+        // hot code files are written for each thread, there are no kernel files to unify
+        return EXIT_SUCCESS;
+    }
+    try
+    {
+        UnifyThreadKernels(threadFiles, job.output);
+    }
+    catch (exception &e)
+    {
+        spdlog::critical(e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+    cl::ParseCommandLineOptions(argc, argv);
+
+    vector<Segmentation> jobs;
+    if (!ManifestFileName.empty())
+    {
+        try
+        {
+            jobs = ReadManifest(ManifestFileName);
+        }
+        catch (exception &e)
+        {
+            spdlog::critical(e.what());
+            return EXIT_FAILURE;
+        }
+    }
+    else if (ProfileFileName.empty() || OutputFilename.empty())
+    {
+        spdlog::critical("Either a profile (-i) and an output (-o), or a manifest (-m), is required");
+        return EXIT_FAILURE;
+    }
+    else
+    {
+        jobs.push_back(Segmentation{ProfileFileName, BlockInfoFilename, OutputFilename, DotFile});
+    }
+
+    // static information about the program structure is read once and shared by every profile
+    auto SourceBitcode = ReadBitcode(BitcodeFileName);
+    if (SourceBitcode == nullptr)
+    {
+        return EXIT_FAILURE;
+    }
+    // Construct static callgraph
+    llvm::CallGraph staticCG(*SourceBitcode);
+#ifdef DEBUG
+    ofstream callGraphDot("StaticCallGraph.dot");
+    auto staticCallGraph = GenerateCallGraph(staticCG);
+    callGraphDot << staticCallGraph << "\n";
+    callGraphDot.close();
+#endif
+    // map IDs to blocks and values
+    InitializeIDMaps(SourceBitcode.get());
+
+    if (ManifestFileName.empty())
+    {
+        // the main thread holds one worker
+        idleWorkers = WorkerBudget() - 1;
+        return PerThread ? SegmentThreads(jobs.front(), SourceBitcode, staticCG) : Segment(jobs.front(), SourceBitcode, staticCG);
+    }
+
+    // batch mode: BatchThreads workers pull profiles off of the manifest until it is empty
+    // each profile is segmented with a ProfileContext of its own, the bitcode and its ID maps are shared and only read
+    auto threads = min(WorkerBudget(), jobs.size());
+    // workers the batch does not need are left to the threads of -threads profiles
+    idleWorkers = WorkerBudget() - threads;
+    vector<int> results(jobs.size(), EXIT_FAILURE);
+    vector<double> times(jobs.size(), 0.0);
+    vector<uint64_t> peaks(jobs.size(), 0);
+    atomic<size_t> nextJob = 0;
+    auto work = [&]() {
+        for (auto i = nextJob++; i < jobs.size(); i = nextJob++)
+        {
+            if (threads == 1)
+            {
+                ResetPeakMemory();
+            }
+            struct timespec start, end;
+            while (clock_gettime(CLOCK_MONOTONIC, &start))
+            {
+            }
+            try
+            {
+                results[i] = PerThread ? SegmentThreads(jobs[i], SourceBitcode, staticCG) : Segment(jobs[i], SourceBitcode, staticCG);
+            }
+            catch (CyclebiteException &e)
+            {
+                spdlog::critical(jobs[i].profile + ": " + e.what());
+                results[i] = EXIT_FAILURE;
+            }
+            catch (exception &e)
+            {
+                // an exception that leaves a worker calls std::terminate, which would take every other profile of the batch with it
+                spdlog::critical(jobs[i].profile + ": " + e.what());
+                results[i] = EXIT_FAILURE;
+            }
+            catch (...)
+            {
+                spdlog::critical(jobs[i].profile + ": unknown exception");
+                results[i] = EXIT_FAILURE;
+            }
+            while (clock_gettime(CLOCK_MONOTONIC, &end))
+            {
+            }
+            times[i] = CalculateTime(&start, &end);
+            peaks[i] = PeakMemory();
+        }
+        // the manifest is empty, so this worker can help the profiles that are still running
+        idleWorkers++;
+    };
+    vector<thread> workers;
+    for (size_t t = 1; t < threads; t++)
+    {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto &w : workers)
+    {
+        w.join();
+    }
+
+    // when profiles overlap, the peak memory of each is the peak of the whole process up to the moment it finished
+    int failures = 0;
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        spdlog::info("CARTOGRAPHERBATCH: " + jobs[i].profile + " -> " + jobs[i].output + (results[i] == EXIT_SUCCESS ? "" : " (failed)") + ", " + to_string(times[i]) + "s, peak " + to_string(peaks[i]) + "kB");
+        if (results[i] != EXIT_SUCCESS)
+        {
+            failures++;
+        }
+    }
+    spdlog::info("CARTOGRAPHERBATCHPROFILES: " + to_string(jobs.size() - (size_t)failures) + "/" + to_string(jobs.size()));
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
 }
\ No newline at end of file